@@ -0,0 +1,102 @@
+#pragma once
+
+#include "GPMusic.h"
+#include "GPSynth.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace gpgui {
+
+namespace save {
+
+struct Song;
+
+} // namespace save
+
+namespace audio {
+
+// Frames rendered per block of the audio thread, 5.3 ms at 48 kHz
+constexpr int BUFFER_FRAMES = 256;
+// Delay between two strings of a strum
+constexpr int STRUM_FRAMES = synth::SAMPLE_RATE / 80;
+// Songs play one chord per bar of four beats
+constexpr int CHORD_BEATS = 4;
+// Tempos of the renderings, a bar of the slowest fits in an int of frames
+constexpr float MIN_BPM = 20.0f;
+constexpr float MAX_BPM = 400.0f;
+
+enum class WriteResult {
+	Ok,
+	Underrun,  // the device ran out of samples, counted as a missed deadline
+	Error
+};
+
+// Destination of the mono float samples of the audio thread
+class Sink {
+public:
+	virtual ~Sink() {}
+
+	virtual bool Open(int sampleRate) = 0;
+	virtual void Close() = 0;
+	// Blocking sinks (devices) pace the audio thread, the others are paced by the clock
+	virtual bool IsBlocking() const = 0;
+	// Called from the audio thread, must neither lock nor allocate
+	virtual WriteResult Write(const float* samples, int frames) = 0;
+};
+
+// ALSA default device (PulseAudio and PipeWire through their ALSA plugin), nullptr when not built with GP_HAVE_ALSA
+std::unique_ptr<Sink> CreateDeviceSink();
+std::unique_ptr<Sink> CreateWavSink(const std::string& fileName);
+std::unique_ptr<Sink> CreateNullSink();
+// The device when it can be opened, else the null sink
+std::unique_ptr<Sink> CreateDefaultSink();
+
+struct Stats {
+	std::uint64_t blocks = 0;
+	// blocks rendered after their deadline, or device underruns
+	std::uint64_t deadlineMisses = 0;
+	std::uint64_t droppedCommands = 0;
+	double maxRenderMs = 0;
+	double budgetMs = 0;
+	int activeVoices = 0;
+};
+
+// Starts the audio thread on the sink, false when the sink can't be opened
+bool Start(std::unique_ptr<Sink> sink);
+void Stop();
+bool IsRunning();
+
+// Commands to the audio thread, from the main thread only (single producer queue).
+// They never block, false when the queue is full or the engine is stopped.
+// time : sample position of the start (see GetSamplePosition), 0 plays as soon as possible
+bool PlayChord(const music::ChordOffsets& keys, const music::Tab& tab, int capo, std::uint64_t time = 0);
+bool ReleaseAll();
+bool SetVolume(float volume);
+
+// Samples rendered since Start
+std::uint64_t GetSamplePosition();
+Stats GetStats();
+
+// Starts the piano keys and plucks the strings (strummed from the lowest) of a chord
+void TriggerChord(synth::Synth& synth, const music::ChordOffsets& keys, const music::Tab& tab, int capo, int delayFrames = 0);
+// Plucks the strings from the lowest (down) or from the highest
+void StrumChord(synth::Synth& synth, const music::Tab& tab, int capo, bool down, float velocity, int delayFrames = 0);
+
+// Song playback, one bar per chord, scheduled a little ahead by UpdatePlayback
+void PlaySong(const save::Song& song, float bpm);
+void StopSong();
+bool IsPlayingSong();
+// Called once per frame, returns the index of the chord being heard, -1 when the playback ended
+int UpdatePlayback();
+
+// Offline rendering, far faster than real time (GPAudioRender.cpp).
+// Strum pattern : one character per subdivision of a bar, D strums down, U up and anything else rests ("D-DU-UDU").
+constexpr const char* DEFAULT_STRUM_PATTERN = "D-DU-UDU";
+
+// The bars are rendered in parallel then overlap-added, and streamed to the wav file
+bool RenderSongToWav(const save::Song& song, float bpm, const std::string& strumPattern, const std::string& fileName, unsigned threads = 0);
+
+} // namespace audio
+} // namespace gpgui
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "GPMemory.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace gpgui {
+namespace bench {
+
+struct Metric {
+	const char* name;
+	double value;
+};
+
+struct Result {
+	std::string name;
+	std::vector<Metric> metrics;
+	// allocations done during the benchmark, per tag (instrumentation builds)
+	std::array<memory::AllocationStats, static_cast<std::size_t>(memory::Tag::COUNT)> allocations;
+};
+
+struct Options {
+	std::string filter;  // runs the benchmarks whose name contains it
+	std::string jsonFile;
+	std::string libraryDirectory = ".";
+	std::string tablatureDirectory;  // Guitar Pro files of the guitarpro benchmark, generated when empty
+};
+
+// Runs, prints and exports the benchmarks, false when nothing matched the filter or the json can't be written
+bool Run(const Options& options);
+
+bool WriteJson(const std::vector<Result>& results, const std::string& fileName);
+
+} // namespace bench
+} // namespace gpgui
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "GPSave.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gpgui {
+namespace chordpro {
+
+struct Stats {
+	std::size_t chords = 0;
+	std::size_t unknownChords = 0;  // bracketed text which is not a chord symbol ("N.C.", "*Coda")
+};
+
+// Reads the chords of a ChordPro text in place : the [symbols] of the lyrics lines, the title and capo
+// directives ({title: ...}, {t: ...}, {capo: 2}, {meta: capo 2}). The title is left as is without directive.
+// The charts give the shapes played above the capo : the chords are raised by the capo, stored as heard like every
+// song, and lowered again by the export.
+void Parse(std::string_view text, save::Song& song, Stats& stats);
+
+// The file is mapped in memory, the title defaults to the file name
+bool ImportSong(const std::string& fileName, save::Song& song);
+// Title and capo directives then the chords, four per line
+bool ExportSong(const save::Song& song, const std::string& fileName);
+
+// Saves the song of every ChordPro file as outputDirectory/<title>.gp, the files being shared between threads.
+// Returns the number of songs written.
+std::size_t ImportFiles(const std::vector<std::string>& fileNames, const std::string& outputDirectory, unsigned threads = 0);
+// Every song as directory/<title>.cho. Returns the number of files written.
+std::size_t ExportFiles(const std::vector<save::Song>& songs, const std::string& directory, unsigned threads = 0);
+
+} // namespace chordpro
+} // namespace gpgui
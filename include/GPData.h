@@ -17,17 +17,66 @@ struct DrawData {
 	std::size_t vertexCount;
 };
 
+// Painter's order of the geometry inside a batch
+enum class Layer : std::uint8_t {
+	Keyboard = 0,
+	Strings,
+	Overlay,
+	Diagram,
+};
+
+// Pipeline states a batch can switch between. Sorted first so that each state is bound only once.
+enum class DrawState : std::uint8_t {
+	Flat = 0,
+};
+
+typedef std::uint32_t SortKey;
+
+struct BatchEntry {
+	SortKey key;
+	std::size_t first, count;  // range in Batch::vertices, in floats
+};
+
+struct BatchStats {
+	std::size_t drawCalls = 0;
+	std::size_t bytesUploaded = 0;
+};
+
+// Collects all the custom geometry of a frame in one vertex buffer
+struct Batch {
+	DrawData drawData;
+	std::size_t capacity = 0;  // size of the gpu buffer in bytes
+	VertexData vertices;  // geometry in submission order
+	VertexData sortedVertices;  // geometry in sort key order, uploaded to the gpu
+	VertexData shapeVertices;  // geometry of the submission being built, kept to avoid allocating at every rebuild
+	bool uploaded = true;  // sortedVertices is on the gpu
+	std::vector<BatchEntry> entries;
+	std::vector<std::pair<DrawState, std::size_t>> stateRanges;  // vertex count drawn for each state
+	BatchStats stats;
+};
+
 static const std::uint8_t EMPTY_TAB = 0xF;
 static const std::uint8_t EMPTY_NOTE = 0xFF;
 
 VertexData GetCircleData(float centerX, float centerY, float radius, float color, int precision);
 VertexData GetRectData(float x, float y, float dx, float dy, float color);
+// Same, appended to the data
+void AppendCircleData(VertexData& vertexData, float centerX, float centerY, float radius, float color, int precision);
+void AppendRectData(VertexData& vertexData, float x, float y, float dx, float dy, float color);
 
 DrawData GetDrawData(const VertexData& vertexData);
 void UpdateData(DrawData& buffer, const VertexData& newData);
 
 void DrawVertexData(const DrawData& vertexData);
 
+SortKey MakeSortKey(DrawState state, Layer layer, std::uint16_t order = 0);
+
+void InitBatch(Batch& batch);
+void BatchBegin(Batch& batch);
+void BatchSubmit(Batch& batch, SortKey key, const VertexData& vertexData);
+void BatchEnd(Batch& batch);  // sorts the geometry, without any OpenGL call
+void BatchDraw(Batch& batch);  // uploads the geometry sorted since the last draw
+
 float GetIntColor(const Color& color);
 
 } // namespace data
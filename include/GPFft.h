@@ -0,0 +1,35 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace gpgui {
+namespace fft {
+
+// Radix-2 complex fft of a fixed power of two size, the tables are computed once.
+// The data is split in real and imaginary arrays so that the butterflies are vectorized.
+class Plan {
+public:
+	explicit Plan(int size);
+
+	int GetSize() const { return m_Size; }
+
+	// In place forward transform, never allocates
+	void Forward(float* real, float* imaginary) const;
+
+private:
+	int m_Size;
+	std::vector<std::pair<int, int>> m_Swaps;  // bit reversal permutation
+	// twiddles of every stage one after the other, stage of half size h at offset h - 1
+	std::vector<float> m_TwiddleReal;
+	std::vector<float> m_TwiddleImaginary;
+};
+
+// Periodic Hann window of the given size
+std::vector<float> GetHannWindow(int size);
+
+// power[k] = |X[k]|^2 for k in [0, size / 2]
+void GetPowerSpectrum(const float* real, const float* imaginary, int size, float* power);
+
+} // namespace fft
+} // namespace gpgui
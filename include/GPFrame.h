@@ -0,0 +1,22 @@
+#pragma once
+
+namespace gpgui {
+namespace frame {
+
+// Time (in seconds) the main loop may sleep while nothing needs to be drawn
+constexpr double IDLE_TIMEOUT = 0.5;
+
+// Marks the window as dirty. Can be called from any thread.
+void RequestRedraw();
+
+// While at least one animation is running (playback, ...), frames are drawn continuously
+void BeginAnimation();
+void EndAnimation();
+
+bool NeedsRedraw();
+
+// Must be called once a frame has been presented
+void FrameRendered();
+
+} // namespace frame
+} // namespace gpgui
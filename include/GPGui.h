@@ -5,6 +5,8 @@ namespace gui {
 
 void Render();
 void Init();
+// Waits for the jobs started by the gui, before the window is destroyed
+void Shutdown();
 
 } // namespace gui
 } // namespace gpgui
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "GPMusic.h"
+#include "GPSave.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gpgui {
+namespace guitarpro {
+
+struct Beat {
+	music::Tab frets;  // from the lowest string, relative to the capo, data::EMPTY_TAB when the string is not played
+	float quarters;  // duration
+	std::uint32_t measure;
+};
+
+struct Track {
+	std::string name;
+	int strings = 6;  // beyond six, the lowest strings are left out of the frets
+	std::array<int, 6> tuning{};  // midi keys of the open strings, from the lowest
+	int capo = 0;
+	bool drums = false;
+	std::vector<Beat> beats;  // of the first voice, rests included
+};
+
+struct Tablature {
+	int version = 0;  // 300, 400, 406, 500 or 510
+	std::string title;
+	std::vector<Track> tracks;
+};
+
+// Reads a Guitar Pro 3, 4 or 5 file held in memory, every read being checked against the data.
+// False when the data is not such a file or is truncated.
+bool Parse(const std::uint8_t* data, std::size_t size, Tablature& tablature);
+
+// The track playing the most chords (drums left out), one chord per measure : the one lasting the longest among
+// the simultaneous fret sets, or the chord of all the notes of the measure when they are played one by one.
+// The title defaults to the file name.
+bool ImportSong(const std::string& fileName, save::Song& song);
+
+// Saves the song of every tablature as outputDirectory/<title>.gp, the files being shared between threads.
+// Returns the number of songs written.
+std::size_t ImportFiles(const std::vector<std::string>& fileNames, const std::string& outputDirectory, unsigned threads = 0);
+
+} // namespace guitarpro
+} // namespace gpgui
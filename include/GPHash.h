@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gpgui {
+namespace hash {
+
+// XXH64 : four lanes of 8 bytes per round, several GB/s on one core. The same bytes give the same hash on every
+// little endian machine, it can be saved.
+std::uint64_t Hash64(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+} // namespace hash
+} // namespace gpgui
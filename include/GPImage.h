@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gpgui {
+namespace image {
+
+struct Image {
+	int width = 0, height = 0;
+	std::vector<std::uint8_t> rgba;
+};
+
+// OpenGL reads pixels from the bottom
+void FlipVertically(Image& image);
+
+bool WritePng(const Image& image, const std::string& fileName);
+
+} // namespace image
+} // namespace gpgui
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gpgui {
+namespace jobs {
+
+typedef std::function<void()> Function;
+
+class Scheduler;
+
+// Jobs waited for or continued together. Must outlive its jobs, waiting for them is enough.
+class Group {
+public:
+	Group() = default;
+	Group(const Group&) = delete;
+	Group& operator=(const Group&) = delete;
+	~Group();
+
+	bool IsDone() const;
+
+private:
+	friend class Scheduler;
+
+	std::atomic<std::size_t> m_pending{ 0 };
+	// held by the last job while it takes the continuation, then by the waiters before they return
+	std::mutex m_mutex;
+	const char* m_continuationName = nullptr;
+	Function m_continuation;
+	Group* m_continuationGroup = nullptr;
+};
+
+// Called on the thread running a job, around it (profilers). Every job is also recorded in the trace under its name.
+struct TraceHooks {
+	void (*begin)(const char* name, unsigned worker) = nullptr;
+	void (*end)(const char* name, unsigned worker) = nullptr;
+};
+
+struct Stats {
+	std::uint64_t executed = 0;
+	std::uint64_t stolen = 0;  // taken from the queue of another thread
+};
+
+// Work stealing : every worker has its own queue, running its newest job first (the data it just touched) and taking
+// the oldest job of another queue when its own is empty. The threads outside the scheduler share one more queue.
+// A thread waiting for a group runs jobs meanwhile, and sleeps while the last ones run on other threads. A job may wait
+// for the jobs it schedules.
+class Scheduler {
+public:
+	// workerCount threads besides the threads waiting, 0 running every job in Wait
+	explicit Scheduler(unsigned workerCount);
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+	// Runs the jobs left, then joins the workers
+	~Scheduler();
+
+	// name must outlive the trace (string literals)
+	void Schedule(const char* name, Function function, Group* group = nullptr);
+	// Schedules the continuation once every job of the group is done, at once if they are. One continuation per group
+	// while its jobs run, the continuation may schedule the next ones. The continuation group, if any, counts the
+	// continuation from now on.
+	void Then(Group& group, const char* name, Function continuation, Group* continuationGroup = nullptr);
+	void Wait(Group& group);
+
+	unsigned GetWorkerCount() const;
+	Stats GetStats() const;
+
+private:
+	struct Job {
+		const char* name;
+		Function function;
+		Group* group;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void Push(Job job);
+	// The newest job of the queue, else the oldest one of another queue
+	bool TryRun(std::size_t queue);
+	void Finish(Group& group);
+	void RunWorker(unsigned worker);
+	std::size_t GetCurrentQueue() const;
+
+	std::vector<std::unique_ptr<Queue>> m_queues;  // the threads outside the scheduler, then one per worker
+	std::vector<std::thread> m_threads;
+	std::atomic<std::size_t> m_queued{ 0 };
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeup;
+	bool m_stopping = false;
+	std::atomic<std::uint64_t> m_executed{ 0 };
+	std::atomic<std::uint64_t> m_stolen{ 0 };
+};
+
+// Shared by the library, one worker per core but the one of the calling thread (one at least).
+// Started on first use.
+Scheduler& GetScheduler();
+
+// On the shared scheduler
+void Schedule(const char* name, Function function, Group* group = nullptr);
+void Then(Group& group, const char* name, Function continuation, Group* continuationGroup = nullptr);
+void Wait(Group& group);
+
+// Set before the first job
+void SetTraceHooks(const TraceHooks& hooks);
+
+// Runs the function on the main thread at its next DrainMainThread, from any thread (completion of a job)
+void PostToMainThread(Function function);
+// Once per frame. Returns the number of functions run, the ones they post waiting for the next frame.
+std::size_t DrainMainThread();
+// Called after a post, wakes up a main loop waiting for events
+void SetMainThreadWakeup(void (*wakeup)());
+
+} // namespace jobs
+} // namespace gpgui
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gpgui {
+namespace file {
+
+// Read-only view of a whole file, mapped in memory where possible (read in a buffer otherwise).
+// The parsers work on the bytes in place, nothing is copied.
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool Open(const std::string& fileName);
+	void Close();
+
+	const std::uint8_t* GetData() const { return m_Data; }
+	std::size_t GetSize() const { return m_Size; }
+
+private:
+	const std::uint8_t* m_Data = nullptr;
+	std::size_t m_Size = 0;
+	bool m_Mapped = false;
+	std::vector<std::uint8_t> m_Buffer;  // without mmap
+};
+
+// Size and modification time (nanoseconds or ticks of the file system) of a file in one call, false when it can't be read
+bool GetStatus(const std::string& fileName, std::uintmax_t& size, std::int64_t& time);
+
+} // namespace file
+} // namespace gpgui
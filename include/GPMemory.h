@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gpgui {
+namespace memory {
+
+// Subsystem an allocation is accounted to (instrumentation builds)
+enum class Tag : std::uint8_t {
+	Other = 0,
+	Gui,
+	Renderer,
+	Music,
+	Save,
+
+	COUNT
+};
+
+struct AllocationStats {
+	std::size_t allocations = 0;
+	std::size_t bytes = 0;  // allocated bytes
+	std::size_t liveBytes = 0;
+	std::size_t peakBytes = 0;  // maximum of liveBytes
+};
+
+// Resets the frame arena and the allocation counter of the calling thread (the main thread)
+void NewFrame();
+
+// steady : nothing happened since the previous frame (no input, no resize).
+// In debug builds, steady frames asserts that the main thread did not allocate.
+void EndFrame(bool steady);
+
+// false when the allocations are not counted (release builds)
+bool IsCountingAllocations();
+// Heap allocations of the main thread during the last frame
+std::size_t GetFrameAllocations();
+// Heap allocations of the calling thread (since NewFrame on the main thread), 0 when not counting
+std::size_t GetThreadAllocations();
+
+// Per tag statistics, only in builds with GP_ALLOC_TRACKING (xmake f --alloc_tracking=y)
+bool IsTrackingAllocations();
+const char* GetTagName(Tag tag);
+// allocations, bytes and peak of the last frame, from every thread
+const AllocationStats& GetFrameStats(Tag tag);
+// allocations and bytes since the start, peak since the last reset
+AllocationStats GetTotalStats(Tag tag);
+// Peaks restart from the live bytes, done by NewFrame
+void ResetPeaks();
+
+// Allocations of the calling thread are accounted to the tag until the end of the scope
+class ScopedTag {
+public:
+	ScopedTag(Tag tag);
+	~ScopedTag();
+
+private:
+	Tag m_PreviousTag;
+};
+
+// Allocator functions for ImGui::SetAllocatorFunctions, so that ImGui allocations are counted too
+void* ImGuiAlloc(std::size_t size, void* userData);
+void ImGuiFree(void* pointer, void* userData);
+
+// Formats into the frame arena, the text is valid until the next frame
+const char* FrameFormat(const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+	__attribute__((format(printf, 1, 2)))
+#endif
+	;
+
+} // namespace memory
+} // namespace gpgui
+
+#define GP_ALLOC_TAG_CONCAT_IMPL(a, b) a##b
+#define GP_ALLOC_TAG_CONCAT(a, b) GP_ALLOC_TAG_CONCAT_IMPL(a, b)
+
+#ifdef GP_ALLOC_TRACKING
+#define GP_ALLOC_TAG(tag) gpgui::memory::ScopedTag GP_ALLOC_TAG_CONCAT(gpAllocTag, __LINE__)(gpgui::memory::Tag::tag)
+#else
+#define GP_ALLOC_TAG(tag)
+#endif
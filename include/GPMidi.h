@@ -0,0 +1,49 @@
+#pragma once
+
+#include "GPSave.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gpgui {
+namespace midi {
+
+// Events of a standard midi file, in the order of each track (the tracks one after the other).
+// Times are in ticks from the beginning of the track.
+class Listener {
+public:
+	virtual ~Listener() {}
+
+	// ticksPerQuarter is negative for smpte time codes (ticks per second, negated)
+	virtual void OnHeader(int /*format*/, int /*tracks*/, int /*ticksPerQuarter*/) {}
+	virtual void OnTrack(int /*track*/) {}
+	// velocity 0 for a note off
+	virtual void OnNote(std::uint64_t /*tick*/, int /*channel*/, int /*key*/, int /*velocity*/) {}
+	virtual void OnTempo(std::uint64_t /*tick*/, std::uint32_t /*microsecondsPerQuarter*/) {}
+	virtual void OnTimeSignature(std::uint64_t /*tick*/, int /*numerator*/, int /*denominator*/) {}
+	// Points inside the parsed data
+	virtual void OnTrackName(std::string_view /*name*/) {}
+};
+
+// Parses the file held in memory in place, every length being checked against the data.
+// False when the data is not a midi file or is truncated, the events before the error have been sent.
+bool Parse(const std::uint8_t* data, std::size_t size, Listener& listener);
+
+struct Options {
+	int beatsPerChord = 0;  // 0 : one chord per bar of the time signature
+	float minWeight = 0.25f;  // notes sounding less than this part of the loudest pitch class are ignored
+};
+
+// One chord per bar, recognized from the pitch classes sounding the longest during it.
+// The drums (channel 10) and the bars without notes are left out.
+bool ImportSong(const std::string& fileName, save::Song& song, const Options& options);
+
+// Saves the song of every midi file as outputDirectory/<name>.gp, the files being shared between threads.
+// Returns the number of songs written.
+std::size_t ImportFiles(const std::vector<std::string>& fileNames, const std::string& outputDirectory, const Options& options, unsigned threads = 0);
+
+} // namespace midi
+} // namespace gpgui
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <array>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 namespace gpgui {
@@ -9,6 +12,7 @@ namespace gpgui {
 namespace save {
 
 struct ChordSave;
+struct Song;
 
 } // namespace save
 
@@ -45,16 +49,32 @@ enum class ChordType : std::uint8_t {
 typedef std::array<int, 6> Tab;
 typedef std::array<Note, 4> Chord;
 typedef std::array<std::uint8_t, 4> ChordOffsets;
+// One bit per note, 1 << Note
+typedef std::uint16_t PitchClasses;
 
 Note GetNote(std::uint8_t touche);
 std::uint8_t GetOctave(std::uint8_t touche);
 
+// Views on string literals (null terminated), they never allocate
+std::string_view GetName(Note note);
+std::string_view GetName(ChordType chord);
+
+// Chord symbols of songbooks ("C#m7", "Bbsus4", "F#dim/A"), the bass after a slash being ignored.
+// Qualities without a ChordType of their own take the one sharing the most notes : "9" and "13" the (dominant) seventh,
+// "maj7", "6" and "add9" the triad, "mMaj7" the minor triad, "m7b5" the diminished triad.
+// Never allocates, false when the symbol is not a chord ("N.C.", "Chorus", "Coda").
+bool ParseChordSymbol(std::string_view symbol, Note& root, ChordType& type);
+// Suffix of the type in a chord symbol : "", "m", "dim", "7", "m7", "sus4"
+std::string_view GetSymbolSuffix(ChordType type);
+
 std::string ToString(Note note);
 std::string ToString(ChordType chord);
 std::string ToString(const Tab& tab);
 std::string ToString(const save::ChordSave& tab);
 
 int GetStringOffset(int string);
+// Keyboard key sounding on a string, -1 when the string is not played
+int GetStringKey(int string, int fret, int capo);
 
 Tab FindChord(const Chord& chord, int capo);
 Tab FindFakeChord(const Chord& chord, int capo, int pCorde = 0);
@@ -64,5 +84,57 @@ Tab FindPianoChord(const ChordOffsets& notes, int capo = 0, int fretThreshold =
 ChordOffsets GetChordOffsets(Note note, ChordType type);
 Chord GetChord(Note note, ChordType type);
 
+// Chord of the dictionary sharing the most notes with the pitch classes, missing and extra notes
+// lowering the match. Between equal matches the bass is preferred as the root.
+// Looked up in a table built once, false when less than two notes match.
+bool RecognizeChord(PitchClasses pitchClasses, Note bass, Note& root, ChordType& type);
+
+// Piano keys of a saved chord (octave and inversion applied)
+ChordOffsets GetChordNotes(const save::ChordSave& chord);
+// Guitar voicing of a saved chord, either guitaro-piano or classic
+Tab GetChordTab(const save::ChordSave& chord, const ChordOffsets& notes, int capo);
+
+struct Key {
+	Note tonic;
+	bool minor;
+};
+
+// Chord relative to the tonic of the key
+struct Numeral {
+	std::uint8_t interval;  // semitones above the tonic, Note::TOTAL when the chord is not set
+	ChordType type;
+};
+
+struct SongAnalysis {
+	Key key;  // heard : the chords are stored as they sound, the capo included
+	float correlation;  // of the chords with the profile of the key, in [-1, 1], 0 without chords
+	std::vector<Numeral> numerals;  // one per chord
+};
+
+// Key by the profiles of Krumhansl and Kessler : the weight of each pitch class in the chords (the roots counted twice)
+// is correlated with the profile of each of the 24 keys, the best one being kept. Allocates the numerals only.
+SongAnalysis AnalyzeSong(const save::Song& song);
+// Spelled on the major scale of the tonic, whatever the mode : "I", "vi", "bVII7", "vii°", "Vsus", "N.C." when not set.
+// Relative to C, progression::ParseProgression reads them back.
+std::string ToString(const Numeral& numeral);
+
+// Analyses of the songs by content (save::HashSong), a song edited back to a previous content being found again.
+// Not thread safe, the batches using threads of their own.
+class AnalysisCache {
+public:
+	// Valid until the next call
+	const SongAnalysis& Analyze(const save::Song& song);
+	// The songs not analyzed yet are shared between the threads (0 : one per core). The analyses are valid until the next call.
+	void AnalyzeSongs(const std::vector<const save::Song*>& songs, std::vector<const SongAnalysis*>& analyses, unsigned threads = 0);
+
+	std::size_t GetSize() const;
+
+private:
+	// Forgets everything past a size, an analysis per edit adding up
+	void Reserve(std::size_t count);
+
+	std::unordered_map<std::uint64_t, SongAnalysis> m_analyses;
+};
+
 } // namespace music
 } // namespace gpgui
\ No newline at end of file
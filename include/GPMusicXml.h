@@ -0,0 +1,47 @@
+#pragma once
+
+#include "GPSave.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gpgui {
+namespace musicxml {
+
+// Tokens of an xml document, in the order of the file. Names and texts point inside the reading buffer
+// and are only valid during the call. Comments, processing instructions and the doctype are skipped,
+// the attributes are not reported and the entities are not decoded.
+class Listener {
+public:
+	virtual ~Listener() {}
+
+	// Empty elements (<name/>) are reported as a start then an end
+	virtual void OnStartElement(std::string_view /*name*/) {}
+	virtual void OnEndElement(std::string_view /*name*/) {}
+	// Texts longer than the reading buffer come in several pieces
+	virtual void OnText(std::string_view /*text*/) {}
+};
+
+// Reads the file through a buffer of fixed size, nothing of the document is kept in memory.
+// False when the document is truncated or a tag is longer than the buffer, the tokens before have been sent.
+bool Parse(std::FILE* file, Listener& listener);
+
+struct Stats {
+	std::size_t chords = 0;
+	std::size_t approximatedKinds = 0;  // kinds without a ChordType of their own, imported as the nearest one
+	std::size_t skippedHarmonies = 0;  // harmonies without root (functions) or without chord ("none")
+};
+
+// The <harmony> elements of the first part having some, one chord each, with the title (work then movement)
+// and the capo of the score. The title defaults to the file name. Compressed scores (.mxl) are not read.
+bool ImportSong(const std::string& fileName, save::Song& song, Stats& stats);
+
+// Saves the song of every score as outputDirectory/<name>.gp, the files being shared between threads.
+// The approximated kinds are reported for each file. Returns the number of songs written.
+std::size_t ImportFiles(const std::vector<std::string>& fileNames, const std::string& outputDirectory, unsigned threads = 0);
+
+} // namespace musicxml
+} // namespace gpgui
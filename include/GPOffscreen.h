@@ -0,0 +1,34 @@
+#pragma once
+
+#include "GPSave.h"
+
+#include <string>
+#include <vector>
+
+namespace gpgui {
+namespace offscreen {
+
+struct DiagramJob {
+	save::ChordSave chord;
+	int capo;
+	std::string fileName;
+};
+
+struct ExportOptions {
+	int width = 1280, height = 480;
+	unsigned threads = 0;  // 0 : one per core
+};
+
+// false when built without headless support
+bool IsAvailable();
+
+// Renders the keyboard and the strings of each job into a png file, without any window.
+// Each thread owns an offscreen context. Returns the number of written diagrams.
+std::size_t ExportDiagrams(const std::vector<DiagramJob>& jobs, const ExportOptions& options);
+
+// Every chord of the dictionary, in every inversion
+std::vector<DiagramJob> GetDictionaryJobs(const std::string& directory);
+std::vector<DiagramJob> GetSongJobs(const save::Song& song, const std::string& directory);
+
+} // namespace offscreen
+} // namespace gpgui
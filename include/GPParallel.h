@@ -0,0 +1,47 @@
+#pragma once
+
+#include "GPJobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace gpgui {
+namespace parallel {
+
+inline unsigned GetThreadCount() {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs function(workerIndex) for threadCount workers, the calling thread being the worker 0. The others are jobs of the
+// shared scheduler : they may run one after the other, never make them wait for each other.
+template<typename Function>
+void RunWorkers(unsigned threadCount, Function&& function) {
+	if (threadCount == 0)
+		threadCount = GetThreadCount();
+
+	jobs::Group group;
+	for (unsigned worker = 1; worker < threadCount; worker++) {
+		jobs::Schedule("Worker", [&function, worker]() { function(worker); }, &group);
+	}
+	function(0u);
+	jobs::Wait(group);
+}
+
+// Calls function(index) for every index in [0, count), indices are shared dynamically between the workers
+template<typename Function>
+void ForEach(std::size_t count, Function&& function, unsigned threadCount = 0) {
+	std::atomic<std::size_t> next{ 0 };
+	if (threadCount == 0)
+		threadCount = GetThreadCount();
+	threadCount = static_cast<unsigned>(std::min<std::size_t>(threadCount, std::max<std::size_t>(count, 1)));
+
+	RunWorkers(threadCount, [&](unsigned) {
+		for (std::size_t index = next++; index < count; index = next++) {
+			function(index);
+		}
+	});
+}
+
+} // namespace parallel
+} // namespace gpgui
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace gpgui {
+namespace profiler {
+
+enum class Phase : std::uint8_t {
+	GuiRender = 0,
+	UpdateBuffers,
+	DrawWidgets,
+	ImGuiRender,
+
+	COUNT
+};
+
+// Number of frames kept for the histograms
+constexpr std::size_t HISTORY_SIZE = 240;
+
+typedef std::array<float, HISTORY_SIZE> History;
+
+// Durations are in milliseconds
+struct PhaseStats {
+	float p50, p99, max;
+};
+
+void Init();  // needs a current OpenGL context
+void NewFrame();
+
+// Also records the phase in the trace
+void AddCpuTime(Phase phase, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+void BeginGpu(Phase phase);
+void EndGpu(Phase phase);
+bool HasGpuTimers();
+
+const char* GetPhaseName(Phase phase);
+
+// History is a ring buffer, the oldest value is at GetHistoryOffset()
+const History& GetCpuHistory(Phase phase);
+const History& GetGpuHistory(Phase phase);
+std::size_t GetHistoryOffset();
+
+PhaseStats GetStats(const History& history);
+
+class ScopedCpuTimer {
+public:
+	ScopedCpuTimer(Phase phase) : m_Phase(phase), m_Start(std::chrono::steady_clock::now()) {}
+	~ScopedCpuTimer() { AddCpuTime(m_Phase, m_Start, std::chrono::steady_clock::now()); }
+
+private:
+	Phase m_Phase;
+	std::chrono::steady_clock::time_point m_Start;
+};
+
+class ScopedGpuTimer {
+public:
+	ScopedGpuTimer(Phase phase) : m_Phase(phase) { BeginGpu(phase); }
+	~ScopedGpuTimer() { EndGpu(m_Phase); }
+
+private:
+	Phase m_Phase;
+};
+
+} // namespace profiler
+} // namespace gpgui
+
+#define GP_PROFILE_CONCAT_IMPL(a, b) a##b
+#define GP_PROFILE_CONCAT(a, b) GP_PROFILE_CONCAT_IMPL(a, b)
+
+#define GP_PROFILE_CPU(phase) gpgui::profiler::ScopedCpuTimer GP_PROFILE_CONCAT(gpCpuTimer, __LINE__)(gpgui::profiler::Phase::phase)
+#define GP_PROFILE_GPU(phase) gpgui::profiler::ScopedGpuTimer GP_PROFILE_CONCAT(gpGpuTimer, __LINE__)(gpgui::profiler::Phase::phase)
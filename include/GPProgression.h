@@ -0,0 +1,69 @@
+#pragma once
+
+#include "GPSave.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace gpgui {
+namespace progression {
+
+typedef std::uint32_t SongId;
+
+struct Skip {
+	std::uint32_t previous;  // last document before the block
+	std::uint32_t offset;  // first byte of the block
+};
+
+// Documents containing an n-gram
+struct Postings {
+	std::vector<std::uint8_t> gaps;  // between the sorted documents, varint coded
+	std::vector<Skip> skips;  // one per block of documents but the first
+	std::uint32_t count = 0;
+	std::uint32_t last = 0;
+};
+
+// Inverted index of the chord progressions of songs, in any key : every chord is kept as its type and the interval
+// from the root of the previous chord, so "C G Am F" and "D A Bm G" are the same progression (I V vi IV).
+// Repeated chords count once and chords without note or type break the progression.
+// The n-grams of one to three chords each have a posting list of the songs containing them, sorted and delta coded.
+// Longer progressions intersect the lists of their three chords n-grams, then the candidates are checked.
+class Index {
+public:
+	// Ids are never reused, an edited song keeps its id
+	SongId Add(const std::vector<save::ChordSave>& chords);
+	void Update(SongId song, const std::vector<save::ChordSave>& chords);
+	void Remove(SongId song);
+
+	// Songs containing the progression, by increasing id. Nothing is found for an empty progression.
+	void Find(const std::vector<save::ChordSave>& progression, std::vector<SongId>& songs) const;
+
+	std::size_t GetSongCount() const;
+	// Memory of the posting lists and of the progressions of the songs
+	std::size_t GetByteCount() const;
+
+private:
+	// The steps appended after the last document are the progression of the song
+	void IndexDocument(SongId song);
+	// Renumbers the live documents once the removed ones are the most
+	void Compact();
+
+	// Songs are documents numbered in the order of their indexing, an edit removing the song and indexing it again
+	// at the end : the posting lists only ever grow at their end.
+	std::vector<Postings> m_postings;
+	std::vector<std::uint8_t> m_steps;  // progressions of the documents one after the other
+	std::vector<std::uint32_t> m_stepOffsets{ 0 };  // per document, and the end
+	std::vector<SongId> m_songs;  // per document
+	std::vector<bool> m_removed;  // per document
+	std::vector<std::uint32_t> m_documents;  // per song id
+	std::size_t m_removedCount = 0;
+};
+
+// Roman numerals relative to C ("I V vi IV", "ii7 V7 I", "bVII", "vii°") or chord symbols ("C G Am F"),
+// separated by spaces, commas, dashes or bars. False when a chord is not understood.
+bool ParseProgression(std::string_view text, std::vector<save::ChordSave>& chords);
+
+} // namespace progression
+} // namespace gpgui
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "GPSave.h"
+
+#include <string>
+#include <vector>
+
+namespace gpgui {
+
+namespace wav {
+
+class Reader;
+
+} // namespace wav
+
+namespace recognition {
+
+struct Options {
+	float bpm = 90;  // tempo of the song, one chord per bar
+	float minChordSeconds = 0.5f;  // shorter chords are merged into the previous one
+};
+
+// Chord heard between two times of a recording, in seconds
+struct Segment {
+	save::ChordSave chord;
+	double start;
+	double end;
+};
+
+// Streams the recording frame by frame, the audio is not kept in memory, only the segments.
+// Every frame gets the chord of the dictionary whose notes match its chromagram best,
+// the silences are left out of the segments.
+bool RecognizeChords(wav::Reader& reader, std::vector<Segment>& segments, const Options& options);
+
+// One chord per bar, a segment being repeated over the bars it lasts
+save::Song ToSong(const std::vector<Segment>& segments, const std::string& title, const Options& options);
+
+// Saves the song of every recording as outputDirectory/<name>.gp, one recording per thread.
+// Returns the number of songs written.
+std::size_t RecognizeFiles(const std::vector<std::string>& wavFiles, const std::string& outputDirectory, const Options& options, unsigned threads = 0);
+
+} // namespace recognition
+} // namespace gpgui
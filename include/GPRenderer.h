@@ -1,8 +1,45 @@
 #pragma once
 
+#include "GPData.h"
+#include "GPMusic.h"
+#include "GPSave.h"
+#include "GPScene.h"
+
+#include <array>
+#include <memory>
+
 namespace gpgui {
+
+class ShaderProgram;
+
 namespace renderer {
 
+// Part of the window (from the bottom) covered by the keyboard and the strings
+constexpr float KEYBOARD_HEIGHT = 0.3;
+constexpr float TAB_HEIGHT = 0.3;
+constexpr float WIDGETS_HEIGHT = KEYBOARD_HEIGHT + TAB_HEIGHT;
+
+// Everything needed to draw the keyboard and the strings
+struct WidgetState {
+	std::array<std::uint8_t, 7> highlitedKeys{}; // not 6 to avoid visual glitches with the strings
+	std::array<std::uint8_t, 6> highlitedStrings{ data::EMPTY_TAB, data::EMPTY_TAB, data::EMPTY_TAB, data::EMPTY_TAB, data::EMPTY_TAB, data::EMPTY_TAB };
+	int capo = 0;
+};
+
+bool IsKeyHighlited(const WidgetState& state, int key);
+void SetKeyHighlight(WidgetState& state, int key, bool highlight);
+void SetChord(WidgetState& state, const music::ChordOffsets& notes, const music::Tab& tab);
+WidgetState GetChordState(const save::ChordSave& chord, int capo);
+
+// Shapes of the keyboard and the strings, used by the OpenGL batch and the vector exports
+void BuildScene(scene::Scene& scene, const WidgetState& state);
+
+// Used to draw widgets in other contexts than the window one (offscreen, ...)
+std::unique_ptr<ShaderProgram> CreateWidgetShader();
+// scene : shapes of the previous build, cleared and reused
+void BuildWidgetBatch(data::Batch& batch, scene::Scene& scene, const WidgetState& state);
+void DrawWidgetBatch(data::Batch& batch, const ShaderProgram& shader);
+
 void InitRendering();
 
 void DrawWidgets();
@@ -19,5 +56,8 @@ void SetTab(int tab, int fret);
 
 void SetCapoPos(int capo);
 
+// Draw calls and uploads of the last drawn frame
+const data::BatchStats& GetFrameStats();
+
 } // namespace renderer
 } // namespace gpgui
@@ -2,6 +2,8 @@
 
 #include "GPMusic.h"
 
+#include <unordered_map>
+
 namespace gpgui {
 namespace save {
 
@@ -17,6 +19,8 @@ struct ChordSave {
 
 	ChordSave() : note(music::Note::TOTAL) {}
 };
+// Saved and hashed as is
+static_assert(sizeof(ChordSave) == 2, "ChordSave is not packed");
 
 struct Song {
 	std::string title;
@@ -26,8 +30,65 @@ struct Song {
 	Song(const std::string& songTitle, CapoPosType songCapo) : title(songTitle), capo(songCapo) {}
 };
 
+enum class MidiVoicing : std::uint8_t {
+	Piano = 0,  // the keys of the chord, octave and inversion applied
+	Guitar,  // the pitches of the strings of the tab
+};
+
+// Longest chord of the midi export, far below the largest delta time of a midi file
+constexpr int MAX_BEATS_PER_CHORD = 64;
+
+struct MidiOptions {
+	MidiVoicing voicing = MidiVoicing::Piano;
+	float bpm = 90;
+	int beatsPerChord = 4;  // from 1 to MAX_BEATS_PER_CHORD
+	std::uint8_t velocity = 90;
+};
+
 void SaveSongToFile(const Song& save, const std::string& fileName);
+// Standard midi file of one track, every chord sounding its notes together for beatsPerChord beats.
+// The file is written in one pass in a buffer sized beforehand.
+bool SaveSongToMidi(const Song& song, const std::string& fileName, const MidiOptions& options);
+// Every song as directory/<title>.mid, the songs being shared between the threads (0 : one per core).
+// Returns the number of files written.
+std::size_t SaveSongsToMidi(const std::vector<Song>& songs, const std::string& directory, const MidiOptions& options, unsigned threads = 0);
+// Hash of the capo and of the chords, the title left out : the key of the data derived from a song (analysis)
+// and of the songs of the same content. Hashes the bytes of the chords as saved.
+std::uint64_t HashSong(const Song& song);
+// File name of a song saved in a directory, the separators of paths in the title being replaced
+std::string GetFileName(const std::string& title);
 Song LoadSongFromFile(const std::string& filePath);
+// Every .gp file of the directory, titled after their file name
+std::vector<Song> LoadSongsInDirectory(const std::string& directory);
+
+struct ScanStats {
+	std::size_t files = 0;  // .gp files of the directory
+	std::size_t read = 0;  // new or of another size or modification time
+	std::size_t parsed = 0;  // read with bytes never seen
+};
+
+// Files of a directory kept between its scans, a rescan of an unchanged library only listing the directory
+class ScanCache {
+public:
+	// Songs of the .gp files added or modified since the previous scan, titled after their file name. A file of the same
+	// size and modification time is not read, a file of the same bytes as one seen before (hash) is not parsed.
+	std::vector<Song> Scan(const std::string& directory);
+
+	const ScanStats& GetStats() const;  // of the last scan
+
+private:
+	struct File {
+		std::uintmax_t size;
+		std::int64_t time;
+		std::uint64_t hash;  // of the bytes
+		std::uint32_t scan;  // last one finding the file
+	};
+
+	std::unordered_map<std::string, File> m_files;  // by path
+	std::unordered_map<std::uint64_t, Song> m_songs;  // by hash of the file, the songs of a failed parse left out
+	std::uint32_t m_scan = 0;
+	ScanStats m_stats;
+};
 
 } // namespace save
 } // namespace gpgui
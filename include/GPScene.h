@@ -0,0 +1,33 @@
+#pragma once
+
+#include "GPData.h"
+
+#include <vector>
+
+namespace gpgui {
+namespace scene {
+
+enum class ShapeType : std::uint8_t {
+	Rect = 0,
+	Circle,
+};
+
+// Coordinates are the ones of the window, x in [0, 1] from the left and y in [0, 1] from the bottom
+struct Shape {
+	ShapeType type;
+	data::Layer layer;
+	data::Color color;
+	float x, y, dx, dy;  // rect : bottom left and top right corners, circle : center and radius (dx)
+};
+
+// Backend agnostic description of what to draw, in painter's order
+typedef std::vector<Shape> Scene;
+
+void AddRect(Scene& scene, data::Layer layer, float x, float y, float dx, float dy, const data::Color& color);
+void AddCircle(Scene& scene, data::Layer layer, float centerX, float centerY, float radius, const data::Color& color);
+
+// Tessellates the shapes into the OpenGL batch
+void SubmitScene(data::Batch& batch, const Scene& scene);
+
+} // namespace scene
+} // namespace gpgui
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace gpgui {
+namespace search {
+
+typedef std::uint32_t TitleId;
+
+struct Match {
+	TitleId title;
+	bool subsequence;  // every character of the query is in the title, in order
+	int score;  // of the subsequence, else the number of trigrams shared with the query
+	int distance;  // edit distance between the query and the nearest part of the title
+};
+
+// Fuzzy search of titles as they are typed. Titles are lower cased, their accents removed and their punctuation turned
+// into spaces. Each trigram of the titles has the list of the titles containing it : a query of three characters or
+// more only looks at the titles sharing half its trigrams, typos included. They come first when the query is a
+// subsequence of the title, by the score of the subsequence (following characters, starts of words), then by edit
+// distance. Shorter queries match the titles containing them, the starts of words first.
+class TitleIndex {
+public:
+	// Ids are never reused
+	TitleId Add(std::string_view title);
+	void Remove(TitleId title);
+
+	// The best matches first, at most maxMatches. Returns the number of titles matching.
+	// Uses buffers of the index, kept between the queries.
+	std::size_t Find(std::string_view query, std::size_t maxMatches, std::vector<Match>& matches);
+
+	std::size_t GetTitleCount() const;
+
+private:
+	void IndexTitle(TitleId title);
+	// Drops the removed titles from the lists once they are the most, the ids staying
+	void Compact();
+	void AddMatch(TitleId title, int sharedTrigrams);
+	void ScanCharacter();
+	void FindPair();
+
+	std::vector<std::vector<TitleId>> m_postings;  // per trigram, sorted
+	std::vector<std::uint8_t> m_characters;  // normalized titles one after the other, each starting with a space
+	std::vector<std::uint32_t> m_offsets{ 0 };  // per title, and the end
+	std::vector<bool> m_removed;  // per title
+	std::vector<std::uint64_t> m_characterSets;  // per title, one bit per character
+	std::vector<std::uint64_t> m_wordStartSets;  // per title, the characters starting a word
+	std::size_t m_removedCount = 0;
+	std::size_t m_staleCount = 0;  // removed titles still in the lists
+
+	// Query
+	std::vector<std::uint8_t> m_query;
+	std::vector<std::uint64_t> m_queryMasks;  // per character, the positions of the query holding it
+	std::uint64_t m_querySet = 0;
+	std::vector<std::uint8_t> m_shared;  // per title, trigrams shared with the query
+	std::vector<TitleId> m_candidates;
+	std::vector<Match> m_matches;
+};
+
+} // namespace search
+} // namespace gpgui
@@ -0,0 +1,168 @@
+#pragma once
+
+// Minimal float vector selected at compile time : AVX (8 lanes) when built with it (xmake f --native=y),
+// SSE2 on every x86-64, NEON on arm64, else a scalar fallback with the same interface (forced by GP_SIMD_SCALAR).
+
+#if defined(GP_SIMD_SCALAR)
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define GP_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GP_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define GP_SIMD_NEON
+#endif
+
+#include <cmath>
+
+namespace gpgui {
+namespace simd {
+
+#if defined(GP_SIMD_AVX)
+
+constexpr int WIDTH = 8;
+constexpr const char* NAME = "avx";
+typedef __m256 Float;
+
+inline Float Set1(float value) { return _mm256_set1_ps(value); }
+inline Float Load(const float* data) { return _mm256_load_ps(data); }
+inline void Store(float* data, Float value) { _mm256_store_ps(data, value); }
+inline Float LoadUnaligned(const float* data) { return _mm256_loadu_ps(data); }
+inline void StoreUnaligned(float* data, Float value) { _mm256_storeu_ps(data, value); }
+inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+inline Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+inline Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+inline Float Abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+#if defined(__FMA__)
+inline Float MulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+inline Float MulAdd(Float a, Float b, Float c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+// scalar loads rather than vgatherdps, microcoded (and much slower with the GDS mitigation) on many Intel cpus
+inline Float Gather(const float* base, const int* indices) {
+	return _mm256_set_ps(base[indices[7]], base[indices[6]], base[indices[5]], base[indices[4]],
+		base[indices[3]], base[indices[2]], base[indices[1]], base[indices[0]]);
+}
+inline float HorizontalSum(Float a) {
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+#elif defined(GP_SIMD_SSE2)
+
+constexpr int WIDTH = 4;
+constexpr const char* NAME = "sse2";
+typedef __m128 Float;
+
+inline Float Set1(float value) { return _mm_set1_ps(value); }
+inline Float Load(const float* data) { return _mm_load_ps(data); }
+inline void Store(float* data, Float value) { _mm_store_ps(data, value); }
+inline Float LoadUnaligned(const float* data) { return _mm_loadu_ps(data); }
+inline void StoreUnaligned(float* data, Float value) { _mm_storeu_ps(data, value); }
+inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+inline Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+inline Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+inline Float Abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline Float MulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline Float Gather(const float* base, const int* indices) {
+	return _mm_set_ps(base[indices[3]], base[indices[2]], base[indices[1]], base[indices[0]]);
+}
+inline float HorizontalSum(Float a) {
+	__m128 sum = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+#elif defined(GP_SIMD_NEON)
+
+constexpr int WIDTH = 4;
+constexpr const char* NAME = "neon";
+typedef float32x4_t Float;
+
+inline Float Set1(float value) { return vdupq_n_f32(value); }
+inline Float Load(const float* data) { return vld1q_f32(data); }
+inline void Store(float* data, Float value) { vst1q_f32(data, value); }
+inline Float LoadUnaligned(const float* data) { return vld1q_f32(data); }
+inline void StoreUnaligned(float* data, Float value) { vst1q_f32(data, value); }
+inline Float Add(Float a, Float b) { return vaddq_f32(a, b); }
+inline Float Sub(Float a, Float b) { return vsubq_f32(a, b); }
+inline Float Mul(Float a, Float b) { return vmulq_f32(a, b); }
+inline Float Max(Float a, Float b) { return vmaxq_f32(a, b); }
+inline Float Abs(Float a) { return vabsq_f32(a); }
+inline Float MulAdd(Float a, Float b, Float c) { return vmlaq_f32(c, a, b); }
+inline Float Gather(const float* base, const int* indices) {
+	float32x4_t result = vdupq_n_f32(base[indices[0]]);
+	result = vsetq_lane_f32(base[indices[1]], result, 1);
+	result = vsetq_lane_f32(base[indices[2]], result, 2);
+	return vsetq_lane_f32(base[indices[3]], result, 3);
+}
+#if defined(__aarch64__)
+inline Float Div(Float a, Float b) { return vdivq_f32(a, b); }
+inline float HorizontalSum(Float a) { return vaddvq_f32(a); }
+#else
+inline Float Div(Float a, Float b) {
+	// two Newton steps on the reciprocal estimate
+	float32x4_t inverse = vrecpeq_f32(b);
+	inverse = vmulq_f32(vrecpsq_f32(b, inverse), inverse);
+	inverse = vmulq_f32(vrecpsq_f32(b, inverse), inverse);
+	return vmulq_f32(a, inverse);
+}
+inline float HorizontalSum(Float a) {
+	float32x2_t sum = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+	return vget_lane_f32(vpadd_f32(sum, sum), 0);
+}
+#endif
+
+#else
+
+constexpr int WIDTH = 4;
+constexpr const char* NAME = "scalar";
+struct Float {
+	float lanes[WIDTH];
+};
+
+template<typename Operation>
+inline Float Map(Float a, Float b, Operation operation) {
+	Float result;
+	for (int i = 0; i < WIDTH; i++) {
+		result.lanes[i] = operation(a.lanes[i], b.lanes[i]);
+	}
+	return result;
+}
+
+inline Float Set1(float value) { return { { value, value, value, value } }; }
+inline Float Load(const float* data) { return { { data[0], data[1], data[2], data[3] } }; }
+inline void Store(float* data, Float value) {
+	for (int i = 0; i < WIDTH; i++) {
+		data[i] = value.lanes[i];
+	}
+}
+inline Float LoadUnaligned(const float* data) { return Load(data); }
+inline void StoreUnaligned(float* data, Float value) { Store(data, value); }
+inline Float Add(Float a, Float b) { return Map(a, b, [](float x, float y) { return x + y; }); }
+inline Float Sub(Float a, Float b) { return Map(a, b, [](float x, float y) { return x - y; }); }
+inline Float Mul(Float a, Float b) { return Map(a, b, [](float x, float y) { return x * y; }); }
+inline Float Div(Float a, Float b) { return Map(a, b, [](float x, float y) { return x / y; }); }
+inline Float Max(Float a, Float b) { return Map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline Float Abs(Float a) { return Map(a, a, [](float x, float) { return std::abs(x); }); }
+inline Float MulAdd(Float a, Float b, Float c) { return Add(Mul(a, b), c); }
+inline Float Gather(const float* base, const int* indices) {
+	return { { base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]] } };
+}
+inline float HorizontalSum(Float a) { return a.lanes[0] + a.lanes[1] + a.lanes[2] + a.lanes[3]; }
+
+#endif
+
+// Float arrays given to Load and Store, and the indices of Gather, are aligned on it
+constexpr int ALIGNMENT = WIDTH * sizeof(float);
+
+} // namespace simd
+} // namespace gpgui
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "GPSave.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gpgui {
+namespace similarity {
+
+constexpr int TYPE_FEATURES = static_cast<int>(music::ChordType::COUNT);
+constexpr int INTERVAL_FEATURES = music::Note::TOTAL;
+// The chord types, the intervals between the roots of following chords and the capo
+constexpr int FEATURES = TYPE_FEATURES + INTERVAL_FEATURES + 1;
+
+typedef std::array<float, FEATURES> Features;
+typedef std::uint32_t SongId;
+constexpr SongId NO_SONG = 0xFFFFFFFF;
+
+struct Match {
+	SongId song;
+	float score;  // cosine similarity, in ]0, 1]
+};
+
+// Style and difficulty of a song, the same in every key : how often each chord type is played, how often the root moves
+// by each interval (repeated chords left out) and the capo. Each part is normalized then weighted, the vector having
+// a length of 1 unless the song has no chord.
+Features GetFeatures(const save::Song& song);
+
+// Features of every song, one column per feature (structure of arrays) : a query reads the columns in order,
+// several songs per simd lane.
+class Index {
+public:
+	// Ids are rows, never reused
+	SongId Add(const save::Song& song);
+	void Update(SongId id, const save::Song& song);
+	void Remove(SongId id);
+
+	// The count songs most similar to one of the index, best first, the song itself left out
+	void FindSimilar(SongId id, std::size_t count, std::vector<Match>& matches) const;
+	// Songs sharing nothing with the features (score 0) are never matched, nor the excluded one (or NO_SONG)
+	void FindSimilar(const Features& features, std::size_t count, std::vector<Match>& matches, SongId excluded) const;
+
+	std::size_t GetSongCount() const;
+
+private:
+	void SetRow(SongId id, const Features& features);
+
+	// Padded with null rows to a multiple of the simd width
+	std::array<std::vector<float>, FEATURES> m_columns;
+	std::vector<bool> m_removed;
+	std::size_t m_removedCount = 0;
+};
+
+} // namespace similarity
+} // namespace gpgui
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "GPSave.h"
+
+#include <string>
+#include <vector>
+
+namespace gpgui {
+namespace songbook {
+
+enum class Format : std::uint8_t {
+	Svg = 0,
+	Pdf,
+};
+
+struct Options {
+	Format format = Format::Pdf;
+	int columns = 3;  // diagrams per row
+	unsigned threads = 0;  // 0 : one per core
+};
+
+// Pdf when the file name ends with .pdf, svg otherwise
+Format GetFormat(const std::string& fileName);
+
+// Lays out the diagram of every chord of every song across A4 pages.
+// Pages are generated in parallel by small groups and streamed to the disk in order.
+// Svg writes one file per page (name_1.svg, name_2.svg, ...).
+bool ExportSongbook(const std::vector<save::Song>& songs, const std::string& fileName, const Options& options);
+
+} // namespace songbook
+} // namespace gpgui
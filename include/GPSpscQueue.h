@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace gpgui {
+
+// Wait-free single producer / single consumer ring, neither side ever blocks nor allocates.
+// Capacity must be a power of two, one slot is kept empty.
+template<typename T, std::size_t Capacity>
+class SpscQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	// Producer thread only, false when the queue is full
+	bool TryPush(const T& value) {
+		std::size_t tail = m_Tail.load(std::memory_order_relaxed);
+		std::size_t next = (tail + 1) & (Capacity - 1);
+		if (next == m_Head.load(std::memory_order_acquire))
+			return false;
+		m_Items[tail] = value;
+		m_Tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer thread only, false when the queue is empty
+	bool TryPop(T& value) {
+		std::size_t head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire))
+			return false;
+		value = m_Items[head];
+		m_Head.store((head + 1) & (Capacity - 1), std::memory_order_release);
+		return true;
+	}
+
+	bool IsEmpty() const {
+		return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+	}
+
+private:
+	// head and tail on their own cache lines, the two threads don't invalidate each other
+	alignas(64) std::atomic<std::size_t> m_Head{ 0 };
+	alignas(64) std::atomic<std::size_t> m_Tail{ 0 };
+	alignas(64) std::array<T, Capacity> m_Items;
+};
+
+} // namespace gpgui
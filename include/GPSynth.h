@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace gpgui {
+namespace synth {
+
+constexpr int SAMPLE_RATE = 48000;
+
+// One voice per string, plucking a string again restarts it
+constexpr int STRING_VOICES = 6;
+// Two chords of four notes may ring together
+constexpr int PIANO_VOICES = 8;
+constexpr int PIANO_HARMONICS = 4;
+// Samples of a string delay line (a power of two), enough for 24 Hz
+constexpr int MAX_DELAY = 2048;
+// Notes waiting for their start inside the next buffers
+constexpr int MAX_PENDING_NOTES = 32;
+
+// Lanes of the kernels, multiples of every simd width (see GPSimd.h)
+constexpr int PIANO_LANES = PIANO_VOICES * PIANO_HARMONICS;
+constexpr int STRING_LANES = 8;
+// Longer buffers are rendered in several blocks
+constexpr int BLOCK_FRAMES = 256;
+
+// Frequency of a keyboard key, the key 0 being A1 (55 Hz) like the strings offsets
+float GetFrequency(int key);
+
+// Keeps chords of ten voices below 1
+inline float SoftClip(float sample) {
+	return sample / (1.0f + (sample < 0 ? -sample : sample));
+}
+
+// Polyphonic piano (additive) and plucked strings (Karplus-Strong) synthesizer.
+// The voices are kept in structures of arrays and rendered by simd kernels, several voices per instruction.
+// Every voice is preallocated, nothing allocates nor locks after construction.
+class Synth {
+public:
+	Synth();
+
+	// delayFrames : the voice starts after this number of rendered frames
+	void PlayKey(int key, float velocity, int delayFrames = 0);
+	void PluckString(int string, int key, float velocity, int delayFrames = 0);
+	// Every voice fades out quickly, the pending ones are dropped
+	void Release();
+	void SetVolume(float volume);
+	// Without clipping the output is linear, renders of parts of a song can be summed then clipped
+	void SetClipping(bool clipping);
+
+	// Writes frames mono samples
+	void Render(float* out, int frames);
+
+	int GetActiveVoices() const;
+
+private:
+	struct PendingNote {
+		int delay;
+		int string;  // -1 for a piano key
+		int key;
+		float velocity;
+	};
+
+	// One lane per harmonic (voice * PIANO_HARMONICS + harmonic), a rotating phasor whose sine is the imaginary part
+	struct PianoLanes {
+		alignas(32) std::array<float, PIANO_LANES> re;
+		alignas(32) std::array<float, PIANO_LANES> im;
+		alignas(32) std::array<float, PIANO_LANES> cosStep;
+		alignas(32) std::array<float, PIANO_LANES> sinStep;
+		alignas(32) std::array<float, PIANO_LANES> amplitude;
+		alignas(32) std::array<float, PIANO_LANES> decay;
+		std::array<bool, PIANO_VOICES> active;
+	};
+
+	// One lane per string. The delay lines are interleaved and share their write position,
+	// the kernel writes a whole vector per sample and gathers the reads.
+	struct StringLanes {
+		alignas(32) std::array<float, STRING_LANES> halfLoss;  // loss of the averaging filter
+		alignas(32) std::array<float, STRING_LANES> previous;
+		// first order allpass for the fractional part of the period
+		alignas(32) std::array<float, STRING_LANES> allpassCoefficient;
+		alignas(32) std::array<float, STRING_LANES> allpassInput;
+		alignas(32) std::array<float, STRING_LANES> allpassOutput;
+		alignas(32) std::array<float, STRING_LANES> peak;
+		std::array<int, STRING_LANES> length;
+		std::array<bool, STRING_LANES> active;
+		alignas(32) std::array<float, MAX_DELAY * STRING_LANES> lines;  // [position][lane]
+		int writePosition;
+	};
+
+	void StartNote(const PendingNote& note);
+	void StartKey(int key, float velocity);
+	void StartString(int string, int key, float velocity);
+	void AddPendingNote(const PendingNote& note);
+
+	void RenderBlock(float* out, int frames);
+	void RenderPiano(int frames);
+	void RenderStrings(int frames);
+	float NextNoise();
+
+	PianoLanes m_Piano;
+	StringLanes m_Strings;
+	std::array<PendingNote, MAX_PENDING_NOTES> m_Pending;
+	int m_PendingCount;
+	// per frame sums of the lanes, one vector per frame
+	alignas(32) std::array<float, BLOCK_FRAMES * 8> m_Accumulator;
+	float m_Volume;
+	bool m_Clipping;
+	std::uint32_t m_NoiseState;
+};
+
+} // namespace synth
+} // namespace gpgui
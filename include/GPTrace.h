@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace gpgui {
+namespace trace {
+
+typedef std::chrono::steady_clock Clock;
+
+// name must outlive the trace (string literals)
+void Record(const char* name, Clock::time_point start, Clock::time_point end);
+
+// Writes every recorded event in the Chrome trace event format (chrome://tracing, Perfetto)
+bool WriteChromeTrace(const std::string& fileName);
+
+class ScopedEvent {
+public:
+	ScopedEvent(const char* name) : m_Name(name), m_Start(Clock::now()) {}
+	~ScopedEvent() { Record(m_Name, m_Start, Clock::now()); }
+
+private:
+	const char* m_Name;
+	Clock::time_point m_Start;
+};
+
+} // namespace trace
+} // namespace gpgui
+
+#define GP_TRACE_CONCAT_IMPL(a, b) a##b
+#define GP_TRACE_CONCAT(a, b) GP_TRACE_CONCAT_IMPL(a, b)
+
+#define GP_TRACE_SCOPE(name) gpgui::trace::ScopedEvent GP_TRACE_CONCAT(gpTraceEvent, __LINE__)(name)
+#define GP_TRACE_FUNCTION() GP_TRACE_SCOPE(__func__)
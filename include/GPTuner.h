@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gpgui {
+namespace tuner {
+
+// Hops of 5 ms, a new reading every hop
+constexpr int HOP_MS = 5;
+// Lowest pitch heard, below a drop D
+constexpr float MIN_FREQUENCY = 60.0f;
+constexpr float MAX_FREQUENCY = 1400.0f;
+
+// Mono float samples analysed by the tuner
+class Source {
+public:
+	virtual ~Source() {}
+
+	virtual int GetSampleRate() const = 0;
+	// Blocking sources (capture devices) pace the tuner thread, the others are paced by the clock
+	virtual bool IsBlocking() const = 0;
+	// Returns fewer frames at the end of the stream, must not allocate
+	virtual std::size_t Read(float* samples, std::size_t frames) = 0;
+};
+
+// A wav file, or stdin for "-", nullptr when it can't be read
+std::unique_ptr<Source> CreateWavSource(const std::string& fileName);
+// ALSA default capture device, nullptr when it can't be opened or without GP_HAVE_ALSA
+std::unique_ptr<Source> CreateCaptureSource();
+
+struct Reading {
+	bool valid = false;  // a pitch was heard
+	float frequency = 0;
+	float clarity = 0;  // 1 for a perfectly periodic sound
+	int key = 0;  // nearest keyboard key, 0 being A1
+	int string = 0;  // nearest open string of the tuning, 0 being the lowest
+	float cents = 0;  // deviation from the open string, positive when too high
+};
+
+// Nearest open string and its deviation, the reading is valid when a frequency is given
+Reading GetStringReading(float frequency, float clarity);
+
+// Yin pitch detector over a window of four hops, updated incrementally every hop.
+// The difference function is kept per hop so that only the newest hop is computed,
+// its lags being vectorized. Nothing allocates after construction.
+class Detector {
+public:
+	explicit Detector(int sampleRate);
+
+	int GetHopFrames() const { return m_HopFrames; }
+	// Samples analysed at once, the latency of the readings
+	int GetWindowFrames() const { return m_WindowFrames + m_MaxLag; }
+
+	Reading Process(const float* hop);
+
+private:
+	int m_SampleRate;
+	int m_HopFrames;
+	int m_WindowFrames;
+	int m_MinLag;
+	int m_MaxLag;  // multiple of the simd width
+	std::vector<float> m_History;  // window and lags, the newest samples at the end
+	std::vector<float> m_HopDifferences;  // difference function of every hop of the window
+	int m_OldestHop = 0;
+	std::vector<float> m_Difference;
+};
+
+struct Stats {
+	std::uint64_t hops = 0;
+	std::uint64_t overruns = 0;  // hops processed after the next one was due
+	double maxProcessUs = 0;
+	double budgetUs = 0;
+};
+
+// Runs the detector on its own thread, false when the source is nullptr
+bool Start(std::unique_ptr<Source> source);
+void Stop();
+bool IsRunning();
+
+// Main thread only, the readings in order, false once they have all been read
+bool PopReading(Reading& reading);
+Stats GetStats();
+
+} // namespace tuner
+} // namespace gpgui
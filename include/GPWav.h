@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace gpgui {
+namespace wav {
+
+// Streams 16 bits PCM samples to a wav file, the sizes are written when closing
+class Writer {
+public:
+	Writer() = default;
+	Writer(const Writer&) = delete;
+	Writer& operator=(const Writer&) = delete;
+	~Writer();
+
+	bool Open(const std::string& fileName, int sampleRate, int channels);
+	// Interleaved samples in [-1, 1], never allocates
+	bool Write(const float* samples, std::size_t frames);
+	bool Close();
+
+	bool IsOpen() const { return m_File != nullptr; }
+
+private:
+	FILE* m_File = nullptr;
+	int m_SampleRate = 0;
+	int m_Channels = 0;
+	std::uint32_t m_DataSize = 0;
+	std::array<std::uint8_t, 4096> m_Buffer;
+};
+
+// Streams the samples of a wav file (8, 16, 24 and 32 bits PCM or 32 bits float), mixed down to mono
+class Reader {
+public:
+	Reader() = default;
+	Reader(const Reader&) = delete;
+	Reader& operator=(const Reader&) = delete;
+	~Reader();
+
+	bool Open(const std::string& fileName);
+	// Reads from an already opened stream (stdin, ...), which is not closed
+	bool Open(FILE* file);
+	// Mono samples in [-1, 1], returns the number of frames read (0 at the end), never allocates
+	std::size_t Read(float* samples, std::size_t frames);
+	void Close();
+
+	int GetSampleRate() const { return m_SampleRate; }
+	int GetChannels() const { return m_Channels; }
+
+private:
+	bool ReadHeader();
+
+	FILE* m_File = nullptr;
+	bool m_OwnsFile = false;
+	int m_SampleRate = 0;
+	int m_Channels = 0;
+	int m_BytesPerSample = 0;
+	bool m_Float = false;
+	std::uint64_t m_Remaining = 0;  // bytes of the data chunk
+	std::array<std::uint8_t, 8192> m_Buffer;
+};
+
+} // namespace wav
+} // namespace gpgui
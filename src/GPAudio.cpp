@@ -0,0 +1,455 @@
+#include "GPAudio.h"
+#include "GPData.h"
+#include "GPFrame.h"
+#include "GPMemory.h"
+#include "GPSave.h"
+#include "GPSpscQueue.h"
+#include "GPWav.h"
+
+#ifdef GP_HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace gpgui {
+namespace audio {
+
+typedef std::chrono::steady_clock Clock;
+
+// Blocks buffered by the clock when it replaces a device
+static constexpr std::int64_t CLOCK_BUFFER_BLOCKS = 3;
+// Commands waiting for their start time on the audio thread
+static constexpr std::size_t MAX_SCHEDULED = 64;
+// Song chords are sent this much in advance
+static constexpr std::uint64_t PLAYBACK_LOOKAHEAD = synth::SAMPLE_RATE / 4;
+
+static constexpr float PIANO_VELOCITY = 0.5f;
+static constexpr float STRING_VELOCITY = 0.6f;
+
+enum class CommandType : std::uint8_t {
+	PlayChord,
+	Release,
+	SetVolume
+};
+
+struct Command {
+	CommandType type = CommandType::Release;
+	std::uint8_t capo = 0;
+	music::ChordOffsets keys{};
+	music::Tab tab{};
+	std::uint64_t time = 0;
+	float volume = 0;
+};
+
+// Sinks
+
+class NullSink : public Sink {
+public:
+	bool Open(int) { return true; }
+	void Close() {}
+	bool IsBlocking() const { return false; }
+	WriteResult Write(const float*, int) { return WriteResult::Ok; }
+};
+
+class WavSink : public Sink {
+public:
+	WavSink(const std::string& fileName) : m_FileName(fileName) {}
+
+	bool Open(int sampleRate) { return m_Writer.Open(m_FileName, sampleRate, 1); }
+	void Close() { m_Writer.Close(); }
+	bool IsBlocking() const { return false; }
+	WriteResult Write(const float* samples, int frames) {
+		return m_Writer.Write(samples, frames) ? WriteResult::Ok : WriteResult::Error;
+	}
+
+private:
+	std::string m_FileName;
+	wav::Writer m_Writer;
+};
+
+#ifdef GP_HAVE_ALSA
+
+class AlsaSink : public Sink {
+public:
+	~AlsaSink() { Close(); }
+
+	bool Open(int sampleRate) {
+		if (snd_pcm_open(&m_Pcm, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+			m_Pcm = nullptr;
+			return false;
+		}
+		// three blocks of latency, resampled by the plug layer if needed
+		unsigned latency = static_cast<unsigned>(3 * BUFFER_FRAMES * 1000000ull / sampleRate);
+		if (snd_pcm_set_params(m_Pcm, SND_PCM_FORMAT_FLOAT, SND_PCM_ACCESS_RW_INTERLEAVED, 1, sampleRate, 1, latency) < 0) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close() {
+		if (m_Pcm == nullptr)
+			return;
+		snd_pcm_drop(m_Pcm);
+		snd_pcm_close(m_Pcm);
+		m_Pcm = nullptr;
+	}
+
+	bool IsBlocking() const { return true; }
+
+	WriteResult Write(const float* samples, int frames) {
+		WriteResult result = WriteResult::Ok;
+		while (frames > 0) {
+			snd_pcm_sframes_t written = snd_pcm_writei(m_Pcm, samples, frames);
+			if (written < 0) {
+				if (snd_pcm_recover(m_Pcm, static_cast<int>(written), 1) < 0)
+					return WriteResult::Error;
+				result = WriteResult::Underrun;
+				continue;
+			}
+			samples += written;
+			frames -= static_cast<int>(written);
+		}
+		return result;
+	}
+
+private:
+	snd_pcm_t* m_Pcm = nullptr;
+};
+
+#endif
+
+std::unique_ptr<Sink> CreateDeviceSink() {
+#ifdef GP_HAVE_ALSA
+	return std::make_unique<AlsaSink>();
+#else
+	return nullptr;
+#endif
+}
+
+std::unique_ptr<Sink> CreateWavSink(const std::string& fileName) {
+	return std::make_unique<WavSink>(fileName);
+}
+
+std::unique_ptr<Sink> CreateNullSink() {
+	return std::make_unique<NullSink>();
+}
+
+std::unique_ptr<Sink> CreateDefaultSink() {
+	std::unique_ptr<Sink> device = CreateDeviceSink();
+	if (device != nullptr && device->Open(synth::SAMPLE_RATE)) {
+		device->Close();
+		return device;
+	}
+	fprintf(stderr, "No audio device, the sound is discarded\n");
+	return CreateNullSink();
+}
+
+// Engine, every variable below is either atomic or owned by a single thread
+
+static SpscQueue<Command, 256> commands;
+static std::thread audioThread;
+static std::atomic<bool> running{ false };
+static std::unique_ptr<Sink> sink;
+
+// audio thread only
+static synth::Synth synthesizer;
+static std::array<float, BUFFER_FRAMES> buffer;
+static std::array<Command, MAX_SCHEDULED> scheduled;
+static std::size_t scheduledCount = 0;
+
+static std::atomic<std::uint64_t> samplePosition{ 0 };
+static std::atomic<std::uint64_t> blocks{ 0 };
+static std::atomic<std::uint64_t> deadlineMisses{ 0 };
+static std::atomic<std::uint64_t> droppedCommands{ 0 };
+static std::atomic<std::uint64_t> maxRenderNs{ 0 };
+static std::atomic<int> activeVoices{ 0 };
+
+void TriggerChord(synth::Synth& synth, const music::ChordOffsets& keys, const music::Tab& tab, int capo, int delayFrames) {
+	for (std::uint8_t key : keys) {
+		if (key != data::EMPTY_NOTE)
+			synth.PlayKey(key, PIANO_VELOCITY, delayFrames);
+	}
+	StrumChord(synth, tab, capo, true, STRING_VELOCITY, delayFrames);
+}
+
+void StrumChord(synth::Synth& synth, const music::Tab& tab, int capo, bool down, float velocity, int delayFrames) {
+	int strum = 0;
+	for (int i = 0; i < static_cast<int>(tab.size()); i++) {
+		int string = down ? i : static_cast<int>(tab.size()) - 1 - i;
+		int key = music::GetStringKey(string, tab[string], capo);
+		if (key < 0)
+			continue;
+		synth.PluckString(string, key, velocity, delayFrames + strum * STRUM_FRAMES);
+		strum++;
+	}
+}
+
+static void Execute(const Command& command, int delayFrames) {
+	switch (command.type) {
+	case CommandType::PlayChord:
+		TriggerChord(synthesizer, command.keys, command.tab, command.capo, delayFrames);
+		break;
+	case CommandType::Release:
+		synthesizer.Release();
+		break;
+	case CommandType::SetVolume:
+		synthesizer.SetVolume(command.volume);
+		break;
+	}
+}
+
+// Starts the commands due in the block beginning at position
+static void ProcessCommands(std::uint64_t position) {
+	const std::uint64_t blockEnd = position + BUFFER_FRAMES;
+	Command command;
+	while (commands.TryPop(command)) {
+		if (command.type == CommandType::Release)
+			scheduledCount = 0;  // the chords scheduled by a stopped song
+
+		if (command.time < blockEnd) {
+			Execute(command, command.time > position ? static_cast<int>(command.time - position) : 0);
+		} else if (scheduledCount < MAX_SCHEDULED) {
+			scheduled[scheduledCount++] = command;
+		} else {
+			droppedCommands.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	for (std::size_t i = 0; i < scheduledCount;) {
+		if (scheduled[i].time < blockEnd) {
+			Execute(scheduled[i], scheduled[i].time > position ? static_cast<int>(scheduled[i].time - position) : 0);
+			scheduled[i] = scheduled[--scheduledCount];
+		} else {
+			i++;
+		}
+	}
+}
+
+static void SetRealTimePriority() {
+#ifdef __linux__
+	// needs the rtprio limit, the thread simply keeps the default policy otherwise
+	sched_param parameters{};
+	parameters.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+	pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+#endif
+}
+
+static void AudioThread() {
+	SetRealTimePriority();
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(static_cast<double>(BUFFER_FRAMES) / synth::SAMPLE_RATE));
+	const bool blocking = sink->IsBlocking();
+	const std::size_t allocationsAtStart = memory::GetThreadAllocations();
+
+	std::uint64_t position = 0;
+	std::int64_t block = 0;
+	// the clock plays the block k at clockStart + k periods, like a device starting once its buffer is full
+	Clock::time_point clockStart = Clock::now() + (CLOCK_BUFFER_BLOCKS - 1) * period;
+	while (running.load(std::memory_order_acquire)) {
+		Clock::time_point start = Clock::now();
+		ProcessCommands(position);
+		synthesizer.Render(buffer.data(), BUFFER_FRAMES);
+		position += BUFFER_FRAMES;
+		Clock::time_point rendered = Clock::now();
+
+		std::uint64_t renderNs = std::chrono::duration_cast<std::chrono::nanoseconds>(rendered - start).count();
+		if (renderNs > maxRenderNs.load(std::memory_order_relaxed))
+			maxRenderNs.store(renderNs, std::memory_order_relaxed);
+
+		WriteResult result = sink->Write(buffer.data(), BUFFER_FRAMES);
+		if (result == WriteResult::Error) {
+			fprintf(stderr, "Audio output failed, stopping the audio thread\n");
+			break;
+		}
+
+		bool missed = result == WriteResult::Underrun || rendered - start > period;
+		if (!blocking) {
+			Clock::time_point deadline = clockStart + block * period;
+			if (rendered > deadline) {
+				// underrun, the clock restarts from now
+				missed = true;
+				clockStart += rendered - deadline;
+			}
+			block++;
+			// waits for a free block in the buffer
+			std::this_thread::sleep_until(clockStart + (block + 1 - CLOCK_BUFFER_BLOCKS) * period);
+		}
+		if (missed)
+			deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+
+		samplePosition.store(position, std::memory_order_release);
+		activeVoices.store(synthesizer.GetActiveVoices(), std::memory_order_relaxed);
+		blocks.fetch_add(1, std::memory_order_relaxed);
+		assert(memory::GetThreadAllocations() == allocationsAtStart && "The audio thread allocated");
+	}
+	running.store(false, std::memory_order_release);
+}
+
+bool Start(std::unique_ptr<Sink> newSink) {
+	Stop();
+	if (newSink == nullptr || !newSink->Open(synth::SAMPLE_RATE))
+		return false;
+
+	sink = std::move(newSink);
+	synthesizer = synth::Synth();
+	scheduledCount = 0;
+	Command command;
+	while (commands.TryPop(command)) {}
+	samplePosition = 0;
+	blocks = 0;
+	deadlineMisses = 0;
+	droppedCommands = 0;
+	maxRenderNs = 0;
+
+	running = true;
+	audioThread = std::thread(AudioThread);
+	return true;
+}
+
+void Stop() {
+	StopSong();
+	running = false;
+	if (audioThread.joinable())
+		audioThread.join();
+	if (sink != nullptr) {
+		sink->Close();
+		sink.reset();
+	}
+}
+
+bool IsRunning() {
+	return running.load(std::memory_order_acquire);
+}
+
+static bool Push(const Command& command) {
+	if (!IsRunning())
+		return false;
+	if (!commands.TryPush(command)) {
+		droppedCommands.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+bool PlayChord(const music::ChordOffsets& keys, const music::Tab& tab, int capo, std::uint64_t time) {
+	Command command;
+	command.type = CommandType::PlayChord;
+	command.keys = keys;
+	command.tab = tab;
+	command.capo = static_cast<std::uint8_t>(capo);
+	command.time = time;
+	return Push(command);
+}
+
+bool ReleaseAll() {
+	Command command;
+	command.type = CommandType::Release;
+	return Push(command);
+}
+
+bool SetVolume(float volume) {
+	Command command;
+	command.type = CommandType::SetVolume;
+	command.volume = volume;
+	return Push(command);
+}
+
+std::uint64_t GetSamplePosition() {
+	return samplePosition.load(std::memory_order_acquire);
+}
+
+Stats GetStats() {
+	Stats stats;
+	stats.blocks = blocks.load(std::memory_order_relaxed);
+	stats.deadlineMisses = deadlineMisses.load(std::memory_order_relaxed);
+	stats.droppedCommands = droppedCommands.load(std::memory_order_relaxed);
+	stats.maxRenderMs = maxRenderNs.load(std::memory_order_relaxed) / 1e6;
+	stats.budgetMs = 1000.0 * BUFFER_FRAMES / synth::SAMPLE_RATE;
+	stats.activeVoices = activeVoices.load(std::memory_order_relaxed);
+	return stats;
+}
+
+// Song playback, main thread only
+
+struct PlaybackChord {
+	music::ChordOffsets keys;
+	music::Tab tab;
+};
+
+static std::vector<PlaybackChord> playbackChords;
+static std::size_t playbackNext = 0;
+static std::uint64_t playbackStart = 0;
+static std::uint64_t playbackChordFrames = 0;
+static int playbackCapo = 0;
+static bool playing = false;
+
+void PlaySong(const save::Song& song, float bpm) {
+	StopSong();
+	if (!IsRunning() || song.chords.empty() || bpm <= 0)
+		return;
+
+	playbackChords.clear();
+	for (const save::ChordSave& chord : song.chords) {
+		PlaybackChord playbackChord;
+		playbackChord.keys = music::GetChordNotes(chord);
+		playbackChord.tab = music::GetChordTab(chord, playbackChord.keys, song.capo);
+		playbackChords.push_back(playbackChord);
+	}
+	playbackCapo = song.capo;
+	playbackChordFrames = static_cast<std::uint64_t>(CHORD_BEATS * 60.0f / bpm * synth::SAMPLE_RATE);
+	playbackStart = GetSamplePosition() + 2 * BUFFER_FRAMES;
+	playbackNext = 0;
+	playing = true;
+	frame::BeginAnimation();
+}
+
+void StopSong() {
+	if (!playing)
+		return;
+	playing = false;
+	frame::EndAnimation();
+	ReleaseAll();
+}
+
+bool IsPlayingSong() {
+	return playing;
+}
+
+int UpdatePlayback() {
+	if (!playing)
+		return -1;
+
+	std::uint64_t position = GetSamplePosition();
+	while (playbackNext < playbackChords.size()) {
+		std::uint64_t time = playbackStart + playbackNext * playbackChordFrames;
+		if (time > position + PLAYBACK_LOOKAHEAD)
+			break;
+		const PlaybackChord& chord = playbackChords[playbackNext];
+		if (!PlayChord(chord.keys, chord.tab, playbackCapo, time))
+			break;  // sent again next frame
+		playbackNext++;
+	}
+
+	std::uint64_t current = position > playbackStart ? (position - playbackStart) / playbackChordFrames : 0;
+	if (current >= playbackChords.size()) {
+		// the last chord keeps ringing
+		playing = false;
+		frame::EndAnimation();
+		return -1;
+	}
+	return static_cast<int>(current);
+}
+
+} // namespace audio
+} // namespace gpgui
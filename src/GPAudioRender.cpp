@@ -0,0 +1,99 @@
+#include "GPAudio.h"
+#include "GPData.h"
+#include "GPParallel.h"
+#include "GPSave.h"
+#include "GPTrace.h"
+#include "GPWav.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace gpgui {
+namespace audio {
+
+// Rendered after the end of a bar, while its voices fade out under the next one
+static constexpr int TAIL_FRAMES = synth::SAMPLE_RATE / 10;
+// Bars rendered in parallel per thread before being written, bounds the memory
+static constexpr unsigned BARS_PER_THREAD = 2;
+
+static constexpr float DOWN_VELOCITY = 0.6f;
+static constexpr float UP_VELOCITY = 0.45f;
+static constexpr float PIANO_VELOCITY = 0.4f;
+
+// Renders a bar and its tail from silence, the voices are released at the end of the bar
+static void RenderBar(const save::ChordSave& chord, int capo, const std::string& strumPattern, int barFrames, std::vector<float>& out) {
+	synth::Synth synthesizer;
+	synthesizer.SetClipping(false);
+
+	music::ChordOffsets keys = music::GetChordNotes(chord);
+	music::Tab tab = music::GetChordTab(chord, keys, capo);
+	for (std::uint8_t key : keys) {
+		if (key != data::EMPTY_NOTE)
+			synthesizer.PlayKey(key, PIANO_VELOCITY);
+	}
+	// step by step, only the strokes of the current step are pending in the synthesizer
+	const int steps = std::max(static_cast<int>(strumPattern.size()), 1);
+	int rendered = 0;
+	for (int step = 0; step < steps; step++) {
+		char stroke = step < static_cast<int>(strumPattern.size()) ? strumPattern[step] : '-';
+		if (stroke == 'D' || stroke == 'U')
+			StrumChord(synthesizer, tab, capo, stroke == 'D', stroke == 'D' ? DOWN_VELOCITY : UP_VELOCITY);
+		int end = static_cast<int>(static_cast<long long>(barFrames) * (step + 1) / steps);
+		synthesizer.Render(out.data() + rendered, end - rendered);
+		rendered = end;
+	}
+	synthesizer.Release();
+	synthesizer.Render(out.data() + barFrames, TAIL_FRAMES);
+}
+
+static bool WriteClipped(wav::Writer& writer, std::vector<float>& samples, std::size_t count) {
+	for (std::size_t i = 0; i < count; i++) {
+		samples[i] = synth::SoftClip(samples[i]);
+	}
+	return writer.Write(samples.data(), count);
+}
+
+bool RenderSongToWav(const save::Song& song, float bpm, const std::string& strumPattern, const std::string& fileName, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	if (song.chords.empty() || !(bpm >= MIN_BPM && bpm <= MAX_BPM))
+		return false;
+
+	wav::Writer writer;
+	if (!writer.Open(fileName, synth::SAMPLE_RATE, 1))
+		return false;
+
+	if (threads == 0)
+		threads = parallel::GetThreadCount();
+	const int barFrames = static_cast<int>(CHORD_BEATS * 60.0f / bpm * synth::SAMPLE_RATE);
+	const std::size_t groupSize = threads * BARS_PER_THREAD;
+
+	// the tail of the previous group stays at the beginning of the mix
+	std::vector<std::vector<float>> bars(std::min(groupSize, song.chords.size()), std::vector<float>(barFrames + TAIL_FRAMES));
+	std::vector<float> mix(bars.size() * barFrames + TAIL_FRAMES, 0.0f);
+
+	for (std::size_t first = 0; first < song.chords.size(); first += groupSize) {
+		const std::size_t count = std::min(groupSize, song.chords.size() - first);
+		parallel::ForEach(count, [&](std::size_t i) {
+			RenderBar(song.chords[first + i], song.capo, strumPattern, barFrames, bars[i]);
+		}, threads);
+
+		// overlap-add, every tail goes under the beginning of the next bar
+		for (std::size_t i = 0; i < count; i++) {
+			float* destination = mix.data() + i * barFrames;
+			for (std::size_t frame = 0; frame < bars[i].size(); frame++) {
+				destination[frame] += bars[i][frame];
+			}
+		}
+
+		const std::size_t written = count * barFrames;
+		if (!WriteClipped(writer, mix, written))
+			return false;
+		std::copy(mix.begin() + written, mix.begin() + written + TAIL_FRAMES, mix.begin());
+		std::fill(mix.begin() + TAIL_FRAMES, mix.end(), 0.0f);
+	}
+
+	return WriteClipped(writer, mix, TAIL_FRAMES) && writer.Close();
+}
+
+} // namespace audio
+} // namespace gpgui
@@ -0,0 +1,1879 @@
+#include "GPBench.h"
+#include "GPAudio.h"
+#include "GPChordPro.h"
+#include "GPData.h"
+#include "GPMappedFile.h"
+#include "GPGui.h"
+#include "GPGuitarPro.h"
+#include "GPHash.h"
+#include "GPJobs.h"
+#include "GPMidi.h"
+#include "GPMusic.h"
+#include "GPMusicXml.h"
+#include "GPParallel.h"
+#include "GPProgression.h"
+#include "GPRecognition.h"
+#include "GPRenderer.h"
+#include "GPSave.h"
+#include "GPSearch.h"
+#include "GPSimd.h"
+#include "GPSimilarity.h"
+#include "GPSynth.h"
+#include "GPTrace.h"
+#include "GPTuner.h"
+#include "GPWav.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
+namespace gpgui {
+namespace bench {
+
+typedef std::chrono::steady_clock Clock;
+
+static constexpr int GUI_WARMUP_FRAMES = 60;
+static constexpr int GUI_FRAMES = 1000;
+
+static constexpr int FIND_CHORD_ROUNDS = 20;
+
+// Low latency buffers, 1.3 ms at 48 kHz
+static constexpr int SYNTH_BUFFER_FRAMES = 64;
+static constexpr int SYNTH_BUFFERS = 20000;
+
+static constexpr int RENDER_CHORDS = 64;
+static constexpr float RENDER_BPM = 90;
+
+static constexpr int RECOGNIZE_CHORDS = 24;
+
+// Silence then a note, per string and detuning
+static constexpr int TUNER_SILENCE_MS = 50;
+static constexpr int TUNER_NOTE_MS = 500;
+static constexpr float TUNER_DETUNINGS[] = { -30.0f, -5.0f, 0.0f, 12.0f };
+// A reading is correct within this many cents
+static constexpr float TUNER_TOLERANCE = 2.0f;
+
+static constexpr int MIDI_BARS = 4000;
+static constexpr int MIDI_TICKS_PER_QUARTER = 480;
+static constexpr int MIDI_PARSE_ROUNDS = 50;
+static constexpr int MIDI_FILES = 32;
+
+static constexpr int MIDI_EXPORT_SONGS = 1000;
+static constexpr int MIDI_EXPORT_CHORDS = 64;
+
+// A corpus of several thousand songs
+static constexpr int CHORDPRO_SONGS = 4000;
+static constexpr int CHORDPRO_CHORDS = 64;
+static constexpr int CHORDPRO_SYMBOL_ROUNDS = 20000;
+static constexpr int CHORDPRO_PARSE_ROUNDS = 2000;
+static constexpr const char* CHORDPRO_SYMBOLS[] = {
+	"C", "C#m7", "Bb", "F#dim", "Ebmaj7", "Gsus4", "A7", "Dm", "E7/G#", "Abm7b5", "B9", "Fadd9", "N.C.",
+};
+// Section labels in brackets between the chords, none of them is a chord
+static constexpr const char* CHORDPRO_LABELED = "[Chorus]\n[C]Sous le [Am]pont [Dsus2/4]Mira[G7(#9)]beau\n[Bridge]\n[C6/9]coule la [F#m7b5/C]Seine\n"
+	"[Break] [Bass] [Coda]\n";
+static constexpr std::size_t CHORDPRO_LABELED_CHORDS = 6;
+static constexpr std::size_t CHORDPRO_LABELS = 5;
+// G shapes above a capo on the second fret sound as A
+static constexpr const char* CHORDPRO_CAPO = "{capo: 2}\n[G]\n";
+
+// A score of an orchestra, its harmonies in the first part and a second part of notes only
+static constexpr std::size_t MUSICXML_BYTES = 50 * 1024 * 1024;
+static constexpr int MUSICXML_NOTES_PER_MEASURE = 4;
+// The kinds of the harmonies in turn and their chord types, the ninth being approximated
+static constexpr std::pair<const char*, music::ChordType> MUSICXML_KINDS[] = {
+	{ "major", music::ChordType::Major },
+	{ "minor", music::ChordType::Minor },
+	{ "diminished", music::ChordType::Dim },
+	{ "dominant", music::ChordType::Major7 },
+	{ "minor-seventh", music::ChordType::Minor7 },
+	{ "suspended-fourth", music::ChordType::Sus },
+	{ "major-ninth", music::ChordType::Major },
+};
+
+static constexpr int GUITARPRO_FILES = 400;
+static constexpr int GUITARPRO_MEASURES = 64;
+static constexpr int GUITARPRO_VERSIONS[] = { 300, 406, 500, 510 };
+
+// The usual progressions in C, by style, the songs of the libraries keeping to the progressions of one style
+static constexpr const char* LIBRARY_PARTS[] = {
+	"C G Am F", "Am F C G", "C Am F G", "F G Em Am",
+	"Dm7 G7 C", "C F G7", "Em Am7 D7 G", "Dm Bdim E7 Am",
+	"Am G F E7", "C Bb F C", "C Csus4 C", "Cm Ab Bb Gsus4",
+};
+static constexpr int LIBRARY_STYLES = 3;
+static constexpr int LIBRARY_CHORDS = 64;
+static constexpr int LIBRARY_CAPO_MAX = 5;
+
+// A library of a school, searched by progression
+static constexpr int PROGRESSION_SONGS = 10000;
+static constexpr int PROGRESSION_QUERY_ROUNDS = 100;
+static constexpr int PROGRESSION_EDITS = 1000;
+static constexpr const char* PROGRESSION_QUERIES[] = {
+	"I V vi IV", "I\xE2\x80\x93V\xE2\x80\x93vi\xE2\x80\x93IV", "ii7 V7 I", "vi IV I V", "I IV", "V7", "i bVI bVII Vsus",
+	"Am F C G", "I V vi IV I vi IV V", "vii\xC2\xB0 III7 vi",
+};
+
+// Every song of a large library compared to the others
+static constexpr int SIMILARITY_SONGS = 100000;
+static constexpr int SIMILARITY_QUERIES = 200;
+static constexpr int SIMILARITY_TOP = 10;
+// Scores of the index and of the reference are the same within it
+static constexpr float SIMILARITY_TOLERANCE = 1e-5f;
+
+// Titles of a large library typed one character at a time, some with a typo
+static constexpr int TITLE_SEARCH_TITLES = 50000;
+static constexpr int TITLE_SEARCH_TYPED = 100;
+static constexpr std::size_t TITLE_SEARCH_RESULTS = 500;
+// A typed title is found when it is in the first results
+static constexpr std::size_t TITLE_SEARCH_TOP = 10;
+static constexpr const char* TITLE_SEARCH_WORDS[] = {
+	"la", "le", "les", "du", "de", "mon", "ton", "amour", "chanson", "été", "hiver", "Noël", "soleil", "lune", "mer",
+	"rivière", "café", "cœur", "fille", "garçon", "blues", "valse", "tango", "ballade", "nuit", "jour", "matin", "soir",
+	"ville", "Paris", "Lyon", "Marseille", "rouge", "bleu", "vert", "noir", "blanc", "petite", "grand", "vieux",
+	"nouveau", "danse", "rêve", "voyage", "route", "train", "bateau", "oiseau", "fleur", "jardin", "pluie", "vent",
+	"the", "love", "song", "night", "road", "river", "heart", "blue", "moon", "dream", "rock", "rain", "home",
+};
+
+// Progressions of a known key, in C major then in A minor
+static constexpr const char* ANALYSIS_MAJOR_PARTS[] = {
+	"C G Am F", "C F G7 C", "Dm7 G7 C", "C Am F G", "F G C", "C Em F G7",
+};
+static constexpr const char* ANALYSIS_MINOR_PARTS[] = {
+	"Am Dm E7 Am", "Am F G E7", "Dm7 E7 Am", "Am G F E7", "Am Dm Am E7",
+};
+static constexpr int ANALYSIS_KEYED_SONGS = 2000;
+static constexpr int ANALYSIS_KEYED_CHORDS = 32;
+static constexpr int ANALYSIS_SONGS = 10000;
+
+// A library of song files scanned again and again, some of them copies of others under another title
+static constexpr int SCAN_FILES = 2000;
+static constexpr int SCAN_COPY_INTERVAL = 10;
+static constexpr int SCAN_TOUCH_INTERVAL = 10;
+static constexpr std::size_t HASH_BYTES = 16 << 20;
+static constexpr int HASH_SONG_ROUNDS = 100;
+
+// Batches of small jobs waited for by a job of their batch, then summed by a continuation
+static constexpr int JOBS_BATCHES = 64;
+static constexpr int JOBS_PER_BATCH = 64;
+static constexpr int JOBS_WORK = 20000;
+static constexpr int JOBS_ROUNDS = 3;
+// the thread counts measured, powers of two and every thread
+static constexpr const char* JOBS_SCALING_METRICS[] = {
+	"ms_1_thread", "ms_2_threads", "ms_4_threads", "ms_8_threads", "ms_16_threads", "ms_32_threads", "ms_64_threads",
+};
+
+// A bar per chord, 50 ms each
+static constexpr int PLAYBACK_CHORDS = 16;
+static constexpr float PLAYBACK_BPM = 4800;
+static constexpr auto PLAYBACK_FRAME_INTERVAL = std::chrono::milliseconds(4);
+
+static constexpr int AUDIO_CHORDS = 40;
+static constexpr auto AUDIO_CHORD_INTERVAL = std::chrono::milliseconds(50);
+
+static double ElapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Full gui frames without any backend, the draw lists are built but not drawn
+static void BenchGuiFrames(Result& result, const Options&) {
+	ImGui::SetAllocatorFunctions(memory::ImGuiAlloc, memory::ImGuiFree);
+	ImGuiContext* context = ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(1280, 720);
+	io.DeltaTime = 1.0f / 60.0f;
+	io.IniFilename = nullptr;
+	unsigned char* pixels;
+	int width, height;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+	gui::Init();
+
+	std::size_t allocations = 0;
+	auto frame = [&]() {
+		memory::NewFrame();
+		ImGui::NewFrame();
+		gui::Render();
+		ImGui::Render();
+		memory::EndFrame(false);
+		allocations += memory::GetFrameAllocations();
+	};
+	for (int i = 0; i < GUI_WARMUP_FRAMES; i++) {
+		frame();
+	}
+
+	allocations = 0;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < GUI_FRAMES; i++) {
+		frame();
+	}
+	double elapsed = ElapsedMs(start);
+
+	ImGui::DestroyContext(context);
+
+	result.metrics.push_back({ "ms_per_frame", elapsed / GUI_FRAMES });
+	if (memory::IsCountingAllocations()) {
+		result.metrics.push_back({ "allocations_per_frame", static_cast<double>(allocations) / GUI_FRAMES });
+	}
+}
+
+static void BenchLoadLibrary(Result& result, const Options& options) {
+	Clock::time_point start = Clock::now();
+	std::vector<save::Song> songs = save::LoadSongsInDirectory(options.libraryDirectory);
+	double elapsed = ElapsedMs(start);
+
+	result.metrics.push_back({ "songs", static_cast<double>(songs.size()) });
+	result.metrics.push_back({ "ms", elapsed });
+}
+
+static void BenchFindChord(Result& result, const Options&) {
+	int playedStrings = 0;
+	int calls = 0;
+	Clock::time_point start = Clock::now();
+	for (int round = 0; round < FIND_CHORD_ROUNDS; round++) {
+		for (int note = 0; note < music::TOTAL; note++) {
+			for (int type = 0; type < static_cast<int>(music::ChordType::COUNT); type++) {
+				music::Chord chord = music::GetChord(music::Note(note), music::ChordType(type));
+				for (int capo = 0; capo < 12; capo++) {
+					music::Tab tab = music::FindChord(chord, capo);
+					for (int fret : tab) {
+						playedStrings += fret != data::EMPTY_TAB;
+					}
+					calls++;
+				}
+			}
+		}
+	}
+	double elapsed = ElapsedMs(start);
+
+	result.metrics.push_back({ "ns_per_chord", elapsed * 1e6 / calls });
+	result.metrics.push_back({ "played_strings_per_chord", static_cast<double>(playedStrings) / calls });
+}
+
+// Synthesizer kernels on one core, a chord (4 keys and 6 strings) is played every second
+static void BenchSynthVoices(Result& result, const Options&) {
+	std::unique_ptr<synth::Synth> synthesizer = std::make_unique<synth::Synth>();
+	alignas(simd::ALIGNMENT) float buffer[SYNTH_BUFFER_FRAMES];
+	const int chordInterval = synth::SAMPLE_RATE / SYNTH_BUFFER_FRAMES;
+	const int keys[] = { 24, 28, 31, 34 };
+
+	double voices = 0;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < SYNTH_BUFFERS; i++) {
+		if (i % chordInterval == 0) {
+			for (int key : keys) {
+				synthesizer->PlayKey(key, 0.5f);
+			}
+			for (int string = 0; string < synth::STRING_VOICES; string++) {
+				synthesizer->PluckString(string, music::GetStringKey(string, 2, 0), 0.6f, string * 600);
+			}
+		}
+		synthesizer->Render(buffer, SYNTH_BUFFER_FRAMES);
+		voices += synthesizer->GetActiveVoices();
+	}
+	double bufferNs = ElapsedMs(start) * 1e6 / SYNTH_BUFFERS;
+	double budgetNs = 1e9 * SYNTH_BUFFER_FRAMES / synth::SAMPLE_RATE;
+	voices /= SYNTH_BUFFERS;
+
+	result.metrics.push_back({ "simd_width", static_cast<double>(simd::WIDTH) });
+	result.metrics.push_back({ "average_voices", voices });
+	result.metrics.push_back({ "ns_per_buffer", bufferNs });
+	result.metrics.push_back({ "realtime_factor", budgetNs / bufferNs });
+	result.metrics.push_back({ "voices_per_core", voices * budgetNs / bufferNs });
+}
+
+// Offline rendering of a song of 64 bars, on every core
+static void BenchRenderSong(Result& result, const Options&) {
+	save::Song song("bench", 0);
+	for (int i = 0; i < RENDER_CHORDS; i++) {
+		save::ChordSave chord;
+		chord.note = music::Note(i * 5 % music::TOTAL);
+		chord.type = music::ChordType(i % static_cast<int>(music::ChordType::COUNT));
+		chord.octave = 2;
+		chord.inversion = 0;
+		chord.fretMax = 5;
+		chord.guitaroPiano = i % 2 == 0;
+		song.chords.push_back(chord);
+	}
+	std::string fileName = (std::filesystem::temp_directory_path() / "gp_bench_render.wav").string();
+
+	Clock::time_point start = Clock::now();
+	bool rendered = audio::RenderSongToWav(song, RENDER_BPM, audio::DEFAULT_STRUM_PATTERN, fileName);
+	double elapsed = ElapsedMs(start) / 1000.0;
+	std::filesystem::remove(fileName);
+	if (!rendered)
+		return;
+
+	double audioSeconds = RENDER_CHORDS * audio::CHORD_BEATS * 60.0 / RENDER_BPM;
+	result.metrics.push_back({ "audio_seconds", audioSeconds });
+	result.metrics.push_back({ "seconds", elapsed });
+	result.metrics.push_back({ "realtime_factor", audioSeconds / elapsed });
+}
+
+// Chords recognized back from a rendered song, the accuracy is counted per bar
+static void BenchRecognizeChords(Result& result, const Options&) {
+	save::Song song("bench", 0);
+	for (int i = 0; i < RECOGNIZE_CHORDS; i++) {
+		save::ChordSave chord;
+		chord.note = music::Note(i * 7 % music::TOTAL);
+		chord.type = music::ChordType(i % static_cast<int>(music::ChordType::COUNT));
+		chord.octave = 2;
+		chord.inversion = 0;
+		chord.fretMax = 5;
+		chord.guitaroPiano = true;
+		song.chords.push_back(chord);
+	}
+	std::string fileName = (std::filesystem::temp_directory_path() / "gp_bench_recognize.wav").string();
+	if (!audio::RenderSongToWav(song, RENDER_BPM, audio::DEFAULT_STRUM_PATTERN, fileName))
+		return;
+
+	recognition::Options options;
+	options.bpm = RENDER_BPM;
+	std::vector<recognition::Segment> segments;
+	wav::Reader reader;
+	Clock::time_point start = Clock::now();
+	bool recognized = reader.Open(fileName) && recognition::RecognizeChords(reader, segments, options);
+	double elapsed = ElapsedMs(start) / 1000.0;
+	reader.Close();
+	std::filesystem::remove(fileName);
+	if (!recognized)
+		return;
+
+	save::Song recognizedSong = recognition::ToSong(segments, "bench", options);
+	int correct = 0;
+	for (std::size_t i = 0; i < song.chords.size() && i < recognizedSong.chords.size(); i++) {
+		if (song.chords[i].note == recognizedSong.chords[i].note && song.chords[i].type == recognizedSong.chords[i].type)
+			correct++;
+	}
+
+	double audioSeconds = RECOGNIZE_CHORDS * audio::CHORD_BEATS * 60.0 / RENDER_BPM;
+	result.metrics.push_back({ "audio_seconds", audioSeconds });
+	result.metrics.push_back({ "realtime_factor", audioSeconds / elapsed });
+	result.metrics.push_back({ "recognized_bars", static_cast<double>(recognizedSong.chords.size()) });
+	result.metrics.push_back({ "accuracy", static_cast<double>(correct) / RECOGNIZE_CHORDS });
+}
+
+// Open strings detuned by a few cents, harmonic tones plus the plucked strings of the synthesizer.
+// The latency runs from the beginning of the note to the first correct reading.
+static void BenchTuner(Result& result, const Options&) {
+	const int sampleRate = synth::SAMPLE_RATE;
+	tuner::Detector detector(sampleRate);
+	const int hopFrames = detector.GetHopFrames();
+	const int silenceHops = TUNER_SILENCE_MS * sampleRate / 1000 / hopFrames;
+	const int noteHops = TUNER_NOTE_MS * sampleRate / 1000 / hopFrames;
+	std::vector<float> samples(static_cast<std::size_t>(silenceHops + noteHops) * hopFrames);
+
+	double processNs = 0;
+	double maxProcessNs = 0;
+	double latencyMs = 0;
+	double maxLatencyMs = 0;
+	double maxErrorCents = 0;
+	int notes = 0;
+	int hops = 0;
+	for (int string = 0; string < 6; string++) {
+		const int key = music::GetStringOffset(string);
+		for (int tone = 0; tone <= static_cast<int>(std::size(TUNER_DETUNINGS)); tone++) {
+			std::fill(samples.begin(), samples.end(), 0.0f);
+			float* note = samples.data() + silenceHops * hopFrames;
+			float cents = 0;
+			if (tone < static_cast<int>(std::size(TUNER_DETUNINGS))) {
+				cents = TUNER_DETUNINGS[tone];
+				float frequency = synth::GetFrequency(key) * std::exp2(cents / 1200.0f);
+				for (int i = 0; i < noteHops * hopFrames; i++) {
+					float t = static_cast<float>(i) / sampleRate;
+					for (int harmonic = 1; harmonic <= 6; harmonic++) {
+						note[i] += 0.3f / harmonic * std::sin(2 * 3.14159265f * harmonic * frequency * t) * std::exp(-3.0f * t);
+					}
+				}
+			} else {
+				synth::Synth synthesizer;
+				synthesizer.PluckString(string, key, 0.8f);
+				synthesizer.Render(note, noteHops * hopFrames);
+			}
+
+			detector = tuner::Detector(sampleRate);  // forgets the previous note
+			int firstCorrect = -1;
+			for (int hop = 0; hop < silenceHops + noteHops; hop++) {
+				Clock::time_point start = Clock::now();
+				tuner::Reading reading = detector.Process(samples.data() + hop * hopFrames);
+				double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+				processNs += ns;
+				maxProcessNs = std::max(maxProcessNs, ns);
+				hops++;
+
+				if (hop < silenceHops || !reading.valid)
+					continue;
+				bool correct = reading.string == string && std::abs(reading.cents - cents) < TUNER_TOLERANCE;
+				if (firstCorrect < 0 && correct)
+					firstCorrect = hop;
+				else if (firstCorrect >= 0)
+					maxErrorCents = std::max(maxErrorCents, static_cast<double>(std::abs(reading.cents - cents)));
+			}
+			// the reading of a hop is available once the whole hop has been received
+			double noteLatencyMs = firstCorrect < 0 ? TUNER_NOTE_MS : (firstCorrect + 1 - silenceHops) * tuner::HOP_MS;
+			latencyMs += noteLatencyMs;
+			maxLatencyMs = std::max(maxLatencyMs, noteLatencyMs);
+			notes++;
+		}
+	}
+
+	const double budgetNs = 1e6 * tuner::HOP_MS;
+	result.metrics.push_back({ "hop_ms", static_cast<double>(tuner::HOP_MS) });
+	result.metrics.push_back({ "window_ms", 1000.0 * detector.GetWindowFrames() / sampleRate });
+	result.metrics.push_back({ "us_per_hop", processNs / hops / 1000.0 });
+	result.metrics.push_back({ "max_us_per_hop", maxProcessNs / 1000.0 });
+	result.metrics.push_back({ "realtime_factor", budgetNs * hops / processNs });
+	result.metrics.push_back({ "latency_ms", latencyMs / notes });
+	result.metrics.push_back({ "max_latency_ms", maxLatencyMs });
+	result.metrics.push_back({ "max_error_cents", maxErrorCents });
+}
+
+static void WriteVarint(std::vector<std::uint8_t>& data, std::uint32_t value) {
+	std::uint8_t bytes[4];
+	int count = 0;
+	do {
+		bytes[count++] = value & 0x7F;
+		value >>= 7;
+	} while (value != 0);
+	while (count > 0) {
+		count--;
+		data.push_back(bytes[count] | (count > 0 ? 0x80 : 0));
+	}
+}
+
+static void WriteTrack(std::vector<std::uint8_t>& data, const std::vector<std::uint8_t>& track) {
+	const std::uint8_t header[] = { 'M', 'T', 'r', 'k' };
+	data.insert(data.end(), header, header + 4);
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		data.push_back(static_cast<std::uint8_t>(track.size() >> shift));
+	}
+	data.insert(data.end(), track.begin(), track.end());
+}
+
+// Format 1 file of three tracks : tempo, held chords over their bass, and a melody with passing notes over drums.
+// The notes are released by note ons of velocity 0 under running status, like most sequencers write them.
+static std::vector<std::uint8_t> GetTestMidi(const std::vector<save::ChordSave>& chords) {
+	const std::uint8_t header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 3, MIDI_TICKS_PER_QUARTER >> 8, MIDI_TICKS_PER_QUARTER & 0xFF };
+	std::vector<std::uint8_t> data(header, header + sizeof(header));
+
+	const std::uint8_t tempo[] = { 0, 0xFF, 0x58, 4, 4, 2, 24, 8, 0, 0xFF, 0x51, 3, 0x07, 0xA1, 0x20, 0, 0xFF, 0x2F, 0 };
+	WriteTrack(data, std::vector<std::uint8_t>(tempo, tempo + sizeof(tempo)));
+
+	const std::uint32_t barTicks = 4 * MIDI_TICKS_PER_QUARTER;
+	std::vector<std::uint8_t> harmony;
+	std::vector<std::uint8_t> melody;
+	for (const save::ChordSave& chord : chords) {
+		// midi keys count from C, the notes from A
+		const int root = 48 + (chord.note + 9) % music::Note::TOTAL;
+		std::vector<int> keys = { root - 12 };
+		for (std::uint8_t offset : music::GetChordOffsets(chord.note, chord.type)) {
+			if (offset != data::EMPTY_NOTE)
+				keys.push_back(root + offset);
+		}
+		harmony.insert(harmony.end(), { 0, 0x90 });
+		for (std::size_t i = 0; i < keys.size(); i++) {
+			if (i > 0)
+				harmony.push_back(0);
+			harmony.insert(harmony.end(), { static_cast<std::uint8_t>(keys[i]), 80 });
+		}
+		for (std::size_t i = 0; i < keys.size(); i++) {
+			WriteVarint(harmony, i == 0 ? barTicks : 0);
+			harmony.insert(harmony.end(), { static_cast<std::uint8_t>(keys[i]), 0 });
+		}
+
+		// eighth notes on the chord with a passing note, the drums on every beat
+		for (int step = 0; step < 8; step++) {
+			int key = step == 5 ? keys[1] + 14 : keys[1 + step % (keys.size() - 1)] + 12;
+			melody.insert(melody.end(), { 0, 0x90, static_cast<std::uint8_t>(key), 100 });
+			if (step % 2 == 0)
+				melody.insert(melody.end(), { 0, 0x99, 36, 110 });
+			WriteVarint(melody, MIDI_TICKS_PER_QUARTER / 2);
+			melody.insert(melody.end(), { 0x90, static_cast<std::uint8_t>(key), 0 });
+			if (step % 2 == 0)
+				melody.insert(melody.end(), { 0, 0x99, 36, 0 });
+		}
+	}
+	harmony.insert(harmony.end(), { 0, 0xFF, 0x2F, 0 });
+	melody.insert(melody.end(), { 0, 0xFF, 0x2F, 0 });
+	WriteTrack(data, harmony);
+	WriteTrack(data, melody);
+	return data;
+}
+
+class NoteCounter : public midi::Listener {
+public:
+	void OnNote(std::uint64_t, int, int, int) { notes++; }
+
+	std::size_t notes = 0;
+};
+
+// Parsing throughput of a generated file, then the import of the chords back, in parallel over copies of the file
+static void BenchMidiImport(Result& result, const Options&) {
+	std::vector<save::ChordSave> chords(MIDI_BARS);
+	for (int i = 0; i < MIDI_BARS; i++) {
+		chords[i].note = music::Note(i * 5 % music::TOTAL);
+		chords[i].type = music::ChordType(i % static_cast<int>(music::ChordType::COUNT));
+	}
+	std::vector<std::uint8_t> data = GetTestMidi(chords);
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "gp_bench_midi";
+	std::filesystem::create_directories(directory);
+	std::vector<std::string> fileNames;
+	for (int i = 0; i < MIDI_FILES; i++) {
+		fileNames.push_back((directory / ("song" + std::to_string(i) + ".mid")).string());
+		FILE* file = fopen(fileNames.back().c_str(), "wb");
+		if (file == nullptr)
+			return;
+		fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+	}
+
+	file::MappedFile mapped;
+	if (!mapped.Open(fileNames[0]))
+		return;
+	NoteCounter counter;
+	Clock::time_point start = Clock::now();
+	for (int round = 0; round < MIDI_PARSE_ROUNDS; round++) {
+		midi::Parse(mapped.GetData(), mapped.GetSize(), counter);
+	}
+	double parseSeconds = ElapsedMs(start) / 1000.0;
+
+	save::Song song("", 0);
+	midi::ImportSong(fileNames[0], song, midi::Options());
+	int correct = 0;
+	for (std::size_t i = 0; i < chords.size() && i < song.chords.size(); i++) {
+		if (chords[i].note == song.chords[i].note && chords[i].type == song.chords[i].type)
+			correct++;
+	}
+
+	start = Clock::now();
+	std::size_t imported = midi::ImportFiles(fileNames, directory.string(), midi::Options());
+	double importSeconds = ElapsedMs(start) / 1000.0;
+	std::filesystem::remove_all(directory);
+
+	result.metrics.push_back({ "file_kb", data.size() / 1024.0 });
+	result.metrics.push_back({ "notes", static_cast<double>(counter.notes / MIDI_PARSE_ROUNDS) });
+	result.metrics.push_back({ "parse_mb_per_s", data.size() * MIDI_PARSE_ROUNDS / parseSeconds / 1e6 });
+	result.metrics.push_back({ "accuracy", static_cast<double>(correct) / MIDI_BARS });
+	result.metrics.push_back({ "import_files_per_s", imported / importSeconds });
+	result.metrics.push_back({ "import_mb_per_s", data.size() * imported / importSeconds / 1e6 });
+}
+
+// Export of a library to midi on every core, and import of the piano voicings back
+static void BenchMidiExport(Result& result, const Options&) {
+	std::vector<save::Song> songs;
+	for (int s = 0; s < MIDI_EXPORT_SONGS; s++) {
+		save::Song song("song" + std::to_string(s), static_cast<save::CapoPosType>(s % 3));
+		for (int i = 0; i < MIDI_EXPORT_CHORDS; i++) {
+			save::ChordSave chord;
+			chord.note = music::Note((s + i * 5) % music::TOTAL);
+			chord.type = music::ChordType(i % static_cast<int>(music::ChordType::COUNT));
+			chord.octave = 2;
+			chord.inversion = i % 3;
+			chord.fretMax = 5;
+			chord.guitaroPiano = i % 2 == 0;
+			song.chords.push_back(chord);
+		}
+		songs.push_back(std::move(song));
+	}
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "gp_bench_midi_export";
+	std::filesystem::create_directories(directory);
+
+	save::MidiOptions options;
+	Clock::time_point start = Clock::now();
+	std::size_t written = save::SaveSongsToMidi(songs, directory.string(), options);
+	double seconds = ElapsedMs(start) / 1000.0;
+
+	std::uintmax_t bytes = 0;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory)) {
+		bytes += entry.file_size();
+	}
+	save::Song imported("", 0);
+	int correct = 0;
+	if (midi::ImportSong((directory / "song0.mid").string(), imported, midi::Options())) {
+		for (std::size_t i = 0; i < imported.chords.size() && i < songs[0].chords.size(); i++) {
+			if (imported.chords[i].note == songs[0].chords[i].note && imported.chords[i].type == songs[0].chords[i].type)
+				correct++;
+		}
+	}
+	std::filesystem::remove_all(directory);
+
+	result.metrics.push_back({ "songs", static_cast<double>(written) });
+	result.metrics.push_back({ "songs_per_s", written / seconds });
+	result.metrics.push_back({ "mb_per_s", bytes / seconds / 1e6 });
+	result.metrics.push_back({ "roundtrip_accuracy", static_cast<double>(correct) / MIDI_EXPORT_CHORDS });
+}
+
+// Guitar Pro writer of the tablature benchmark, the little endian types of the format
+
+static void WriteGpByte(std::vector<std::uint8_t>& data, int value) {
+	data.push_back(static_cast<std::uint8_t>(value));
+}
+
+static void WriteGpInt(std::vector<std::uint8_t>& data, int value) {
+	for (int shift = 0; shift < 32; shift += 8) {
+		data.push_back(static_cast<std::uint8_t>(static_cast<std::uint32_t>(value) >> shift));
+	}
+}
+
+static void WriteGpZeros(std::vector<std::uint8_t>& data, std::size_t count) {
+	data.insert(data.end(), count, 0);
+}
+
+static void WriteGpByteSizeString(std::vector<std::uint8_t>& data, const std::string& text, std::size_t fieldSize) {
+	WriteGpByte(data, static_cast<int>(text.size()));
+	data.insert(data.end(), text.begin(), text.end());
+	WriteGpZeros(data, fieldSize - text.size());
+}
+
+static void WriteGpIntByteSizeString(std::vector<std::uint8_t>& data, const std::string& text) {
+	WriteGpInt(data, static_cast<int>(text.size()) + 1);
+	WriteGpByteSizeString(data, text, text.size());
+}
+
+// Open strings from the highest, as in the files
+static constexpr int GUITARPRO_TUNING[] = { 64, 59, 55, 50, 45, 40, 0 };
+
+// Frets of a strum from the highest string, the bass on the root and the other strings going through the chord notes
+static std::array<int, 6> GetTestStrum(const save::ChordSave& chord) {
+	music::ChordOffsets offsets = music::GetChordOffsets(chord.note, chord.type);
+	int notes = offsets[3] == data::EMPTY_NOTE ? 3 : 4;
+	std::array<int, 6> frets;
+	for (int string = 0; string < 6; string++) {
+		// keys count from A0 (21) in the notes
+		int pitchClass = (chord.note + offsets[(5 - string) % notes]) % music::Note::TOTAL;
+		int openClass = (GUITARPRO_TUNING[string] - 21) % music::Note::TOTAL;
+		frets[string] = (pitchClass - openClass + music::Note::TOTAL) % music::Note::TOTAL;
+	}
+	return frets;
+}
+
+enum GpNote {
+	GP_NOTE_NORMAL = 1,
+	GP_NOTE_TIE,
+};
+
+// Beat of the notes given from the highest string (-1 : not played), with the effects of the test
+struct GpBeat {
+	int duration = 0;
+	int tuplet = 0;
+	bool rest = false;
+	bool chordDiagram = false;
+	bool text = false;
+	bool beatEffects = false;
+	bool mixTable = false;
+	bool noteEffects = false;
+	int noteType = GP_NOTE_NORMAL;
+	std::array<int, 6> frets = { -1, -1, -1, -1, -1, -1 };
+};
+
+static void WriteGpBeat(std::vector<std::uint8_t>& data, int version, const GpBeat& beat) {
+	WriteGpByte(data, (beat.chordDiagram ? 0x02 : 0) | (beat.text ? 0x04 : 0) | (beat.beatEffects ? 0x08 : 0) | (beat.mixTable ? 0x10 : 0)
+		| (beat.tuplet > 0 ? 0x20 : 0) | (beat.rest ? 0x40 : 0));
+	if (beat.rest)
+		WriteGpByte(data, 2);
+	WriteGpByte(data, beat.duration);
+	if (beat.tuplet > 0)
+		WriteGpInt(data, beat.tuplet);
+	if (beat.chordDiagram) {
+		if (version >= 500) {
+			WriteGpByte(data, 1);
+			WriteGpZeros(data, 106);
+		} else if (version >= 400) {
+			// old format : name, first fret and frets
+			WriteGpByte(data, 0);
+			WriteGpIntByteSizeString(data, "Am");
+			WriteGpInt(data, 1);
+			for (int fret : { 0, 1, 2, 2, 0, -1 })
+				WriteGpInt(data, fret);
+		} else {
+			WriteGpByte(data, 1);
+			WriteGpZeros(data, 124);
+		}
+	}
+	if (beat.text)
+		WriteGpIntByteSizeString(data, "Refrain");
+	if (beat.beatEffects) {
+		if (version >= 400) {
+			// stroke, tremolo bar of two points and pick stroke
+			WriteGpByte(data, 0x40);
+			WriteGpByte(data, 0x04 | 0x02);
+			WriteGpZeros(data, 5);
+			WriteGpInt(data, 2);
+			WriteGpZeros(data, 2 * 9);
+			WriteGpByte(data, 6);
+			WriteGpByte(data, 0);
+			WriteGpByte(data, 1);
+		} else {
+			// tremolo bar, then stroke
+			WriteGpByte(data, 0x20 | 0x40);
+			WriteGpByte(data, 0);
+			WriteGpInt(data, -50);
+			WriteGpByte(data, 6);
+			WriteGpByte(data, 0);
+		}
+	}
+	if (beat.mixTable) {
+		// volume and tempo changed
+		WriteGpByte(data, 24);
+		if (version >= 500)
+			WriteGpZeros(data, 16);
+		for (int value : { 12, -1, -1, -1, -1, -1 })
+			WriteGpByte(data, value);
+		if (version >= 500)
+			WriteGpIntByteSizeString(data, "Moderato");
+		WriteGpInt(data, 100);
+		WriteGpByte(data, 1);
+		WriteGpByte(data, 0);
+		if (version >= 510)
+			WriteGpByte(data, 0);
+		if (version >= 400)
+			WriteGpByte(data, 0x01);
+		if (version >= 500)
+			WriteGpByte(data, -1);
+		if (version >= 510) {
+			WriteGpIntByteSizeString(data, "");
+			WriteGpIntByteSizeString(data, "");
+		}
+	}
+
+	int strings = 0;
+	for (int string = 0; string < 6; string++) {
+		if (beat.frets[string] >= 0)
+			strings |= 1 << (6 - string);
+	}
+	WriteGpByte(data, strings);
+	for (int string = 0; string < 6; string++) {
+		if (beat.frets[string] < 0)
+			continue;
+		const bool effects = beat.noteEffects && string == 0;
+		WriteGpByte(data, 0x20 | 0x10 | (effects ? 0x08 : 0));
+		WriteGpByte(data, beat.noteType);
+		WriteGpByte(data, 6);
+		// the fret of a tied note is not the one sounding
+		WriteGpByte(data, beat.noteType == GP_NOTE_TIE ? 0 : beat.frets[string]);
+		if (version >= 500)
+			WriteGpByte(data, 0);
+		if (effects) {
+			// bend of one point, then slide and artificial harmonic
+			WriteGpByte(data, 0x01);
+			if (version >= 400)
+				WriteGpByte(data, 0x08 | 0x10);
+			WriteGpByte(data, 1);
+			WriteGpInt(data, 50);
+			WriteGpInt(data, 1);
+			WriteGpZeros(data, 9);
+			if (version >= 400) {
+				WriteGpByte(data, 1);
+				WriteGpByte(data, 2);
+				if (version >= 500)
+					WriteGpZeros(data, 3);
+			}
+		}
+	}
+	if (version >= 500)
+		WriteGpZeros(data, 2);
+}
+
+// One measure of 4/4 per chord on a guitar with a capo, over drums. The chord is strummed then tied then
+// arpeggiated in triplets, and one measure out of four is arpeggiated in eighths only.
+static std::vector<std::uint8_t> GetTestTablature(const std::vector<save::ChordSave>& chords, int version, int capo) {
+	std::vector<std::uint8_t> data;
+	const char* versionName = version == 300 ? "FICHIER GUITAR PRO v3.00" : version == 406 ? "FICHIER GUITAR PRO v4.06" : version == 500 ? "FICHIER GUITAR PRO v5.00" : "FICHIER GUITAR PRO v5.10";
+	WriteGpByteSizeString(data, versionName, 30);
+	for (const char* info : { "Bench", "", "Artiste", "Album", "", "", "", "" }) {
+		WriteGpIntByteSizeString(data, info);
+	}
+	if (version >= 500)
+		WriteGpIntByteSizeString(data, "");  // music
+	WriteGpInt(data, 1);
+	WriteGpIntByteSizeString(data, "notice");
+	if (version < 500)
+		WriteGpByte(data, 0);
+	if (version >= 400) {
+		WriteGpInt(data, 0);
+		for (int line = 0; line < 5; line++) {
+			WriteGpInt(data, 0);
+			WriteGpInt(data, 0);
+		}
+	}
+	if (version >= 500) {
+		WriteGpZeros(data, version >= 510 ? 49 : 30);
+		for (int i = 0; i < 11; i++) {
+			WriteGpIntByteSizeString(data, "%N%");
+		}
+	}
+	WriteGpInt(data, 90);
+	if (version >= 510)
+		WriteGpByte(data, 0);
+	WriteGpZeros(data, version >= 400 ? 5 : 4);
+	for (int channel = 0; channel < 64; channel++) {
+		WriteGpInt(data, 24);
+		for (int value : { 13, 8, 0, 0, 0, 0, 0, 0 })
+			WriteGpByte(data, value);
+	}
+	if (version >= 500) {
+		for (int direction = 0; direction < 19; direction++) {
+			WriteGpByte(data, 0xFF);
+			WriteGpByte(data, 0xFF);
+		}
+		WriteGpInt(data, 0);
+	}
+
+	WriteGpInt(data, static_cast<int>(chords.size()));
+	WriteGpInt(data, 2);
+	for (std::size_t measure = 0; measure < chords.size(); measure++) {
+		if (version >= 500 && measure > 0)
+			WriteGpByte(data, 0);
+		if (measure == 0) {
+			// time signature and marker
+			WriteGpByte(data, 0x01 | 0x02 | 0x20);
+			WriteGpByte(data, 4);
+			WriteGpByte(data, 4);
+			WriteGpIntByteSizeString(data, "Intro");
+			WriteGpInt(data, 0xFF0000);
+			if (version >= 500) {
+				WriteGpZeros(data, 4);
+				WriteGpByte(data, 0);
+			}
+		} else {
+			WriteGpByte(data, 0);
+			if (version >= 500)
+				WriteGpByte(data, 0);
+		}
+		if (version >= 500)
+			WriteGpByte(data, 0);
+	}
+
+	for (int track = 0; track < 2; track++) {
+		if (version >= 500 && (track == 0 || version == 500))
+			WriteGpByte(data, 0);
+		WriteGpByte(data, track == 0 ? 0 : 0x01);
+		WriteGpByteSizeString(data, track == 0 ? "Guitare" : "Batterie", 40);
+		WriteGpInt(data, 6);
+		for (int tuning : GUITARPRO_TUNING)
+			WriteGpInt(data, track == 0 ? tuning : 0);
+		WriteGpInt(data, 1);
+		WriteGpInt(data, track == 0 ? 0 : 9);
+		WriteGpInt(data, track == 0 ? 1 : 9);
+		WriteGpInt(data, 24);
+		WriteGpInt(data, track == 0 ? capo : 0);
+		WriteGpInt(data, 0xFF);
+		if (version >= 500) {
+			WriteGpZeros(data, version >= 510 ? 49 : 44);
+			if (version >= 510) {
+				WriteGpIntByteSizeString(data, "");
+				WriteGpIntByteSizeString(data, "");
+			}
+		}
+	}
+	if (version >= 500)
+		WriteGpZeros(data, version == 500 ? 2 : 1);
+
+	for (std::size_t measure = 0; measure < chords.size(); measure++) {
+		// the files hold the frets from the capo
+		std::array<int, 6> strum = GetTestStrum(chords[measure]);
+		for (int& fret : strum) {
+			fret = (fret - capo + 2 * music::Note::TOTAL) % music::Note::TOTAL;
+		}
+		std::vector<GpBeat> beats;
+		if (measure % 4 == 3) {
+			for (int step = 0; step < 8; step++) {
+				GpBeat beat;
+				beat.duration = 1;
+				int string = 5 - (step < 5 ? step : 8 - step);
+				beat.frets[string] = strum[string];
+				beats.push_back(beat);
+			}
+		} else {
+			GpBeat chord;
+			chord.duration = -1;
+			chord.frets = strum;
+			chord.chordDiagram = measure == 0;
+			chord.text = measure == 0;
+			chord.mixTable = measure % 8 == 0;
+			chord.beatEffects = measure % 2 == 1;
+			beats.push_back(chord);
+			chord = GpBeat();
+			chord.frets = strum;
+			chord.noteType = GP_NOTE_TIE;
+			beats.push_back(chord);
+			for (int step = 0; step < 3; step++) {
+				GpBeat beat;
+				beat.duration = 1;
+				beat.tuplet = 3;
+				beat.frets[step] = strum[step];
+				beat.noteEffects = step == 0;
+				beats.push_back(beat);
+			}
+		}
+
+		WriteGpInt(data, static_cast<int>(beats.size()));
+		for (const GpBeat& beat : beats) {
+			WriteGpBeat(data, version, beat);
+		}
+		if (version >= 500) {
+			// second voice, a rest
+			WriteGpInt(data, 1);
+			GpBeat rest;
+			rest.rest = true;
+			rest.duration = -2;
+			WriteGpBeat(data, version, rest);
+			WriteGpByte(data, 0);
+		}
+
+		GpBeat drums;
+		drums.duration = -2;
+		drums.frets[5] = 36;
+		WriteGpInt(data, 1);
+		WriteGpBeat(data, version, drums);
+		if (version >= 500) {
+			WriteGpInt(data, 0);
+			WriteGpByte(data, 0);
+		}
+	}
+	return data;
+}
+
+// Import of a corpus of tablatures on every core : the files of Options::tablatureDirectory,
+// or a generated one in every version whose chords are checked
+static void BenchGuitarPro(Result& result, const Options& options) {
+	std::vector<save::ChordSave> chords(GUITARPRO_MEASURES);
+	for (int i = 0; i < GUITARPRO_MEASURES; i++) {
+		chords[i].note = music::Note(i * 5 % music::TOTAL);
+		chords[i].type = music::ChordType(i % static_cast<int>(music::ChordType::COUNT));
+	}
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "gp_bench_guitarpro";
+	std::filesystem::create_directories(directory / "library");
+	const bool generated = options.tablatureDirectory.empty();
+	std::vector<std::string> fileNames;
+	if (generated) {
+		for (int i = 0; i < GUITARPRO_FILES; i++) {
+			const int version = GUITARPRO_VERSIONS[i % std::size(GUITARPRO_VERSIONS)];
+			std::vector<std::uint8_t> data = GetTestTablature(chords, version, i % 3);
+			fileNames.push_back((directory / ("song" + std::to_string(i) + ".gp" + std::to_string(version / 100))).string());
+			FILE* file = fopen(fileNames.back().c_str(), "wb");
+			if (file == nullptr)
+				return;
+			fwrite(data.data(), 1, data.size(), file);
+			fclose(file);
+		}
+	} else {
+		for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(options.tablatureDirectory)) {
+			std::string extension = entry.path().extension().string();
+			if (extension == ".gp3" || extension == ".gp4" || extension == ".gp5")
+				fileNames.push_back(entry.path().string());
+		}
+	}
+
+	std::uintmax_t bytes = 0;
+	std::size_t failures = 0;
+	double parseSeconds = 0;
+	for (const std::string& fileName : fileNames) {
+		file::MappedFile mapped;
+		guitarpro::Tablature tablature;
+		if (!mapped.Open(fileName))
+			continue;
+		Clock::time_point start = Clock::now();
+		bool parsed = guitarpro::Parse(mapped.GetData(), mapped.GetSize(), tablature);
+		parseSeconds += ElapsedMs(start) / 1000.0;
+		bytes += mapped.GetSize();
+		failures += parsed ? 0 : 1;
+	}
+
+	int correct = 0;
+	if (generated) {
+		for (std::size_t version = 0; version < std::size(GUITARPRO_VERSIONS); version++) {
+			save::Song song("", 0);
+			if (!guitarpro::ImportSong(fileNames[version], song))
+				continue;
+			for (std::size_t i = 0; i < song.chords.size() && i < chords.size(); i++) {
+				if (song.chords[i].note == chords[i].note && song.chords[i].type == chords[i].type)
+					correct++;
+			}
+		}
+	}
+
+	Clock::time_point start = Clock::now();
+	std::size_t imported = guitarpro::ImportFiles(fileNames, (directory / "library").string());
+	double importSeconds = ElapsedMs(start) / 1000.0;
+	std::filesystem::remove_all(directory);
+
+	result.metrics.push_back({ "files", static_cast<double>(fileNames.size()) });
+	result.metrics.push_back({ "parse_failures", static_cast<double>(failures) });
+	result.metrics.push_back({ "parse_mb_per_s", bytes / parseSeconds / 1e6 });
+	result.metrics.push_back({ "import_files_per_s", imported / importSeconds });
+	if (generated)
+		result.metrics.push_back({ "accuracy", static_cast<double>(correct) / (GUITARPRO_MEASURES * std::size(GUITARPRO_VERSIONS)) });
+}
+
+// Chord symbols parsed in a loop, then the export of a corpus to ChordPro and its import back, on every core
+static void BenchChordPro(Result& result, const Options&) {
+	music::Note root;
+	music::ChordType type;
+	std::size_t parsed = 0;
+	std::size_t allocations = memory::GetThreadAllocations();
+	Clock::time_point start = Clock::now();
+	for (int round = 0; round < CHORDPRO_SYMBOL_ROUNDS; round++) {
+		for (const char* symbol : CHORDPRO_SYMBOLS) {
+			parsed += music::ParseChordSymbol(symbol, root, type) ? 1 : 0;
+		}
+	}
+	double symbolSeconds = ElapsedMs(start) / 1000.0;
+	allocations = memory::GetThreadAllocations() - allocations;
+	const std::size_t symbols = CHORDPRO_SYMBOL_ROUNDS * std::size(CHORDPRO_SYMBOLS);
+
+	std::vector<save::Song> songs;
+	for (int s = 0; s < CHORDPRO_SONGS; s++) {
+		save::Song song("song" + std::to_string(s), static_cast<save::CapoPosType>(s % 4));
+		for (int i = 0; i < CHORDPRO_CHORDS; i++) {
+			save::ChordSave chord;
+			chord.note = music::Note((s + i * 7) % music::TOTAL);
+			chord.type = music::ChordType(i % static_cast<int>(music::ChordType::COUNT));
+			song.chords.push_back(chord);
+		}
+		songs.push_back(std::move(song));
+	}
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "gp_bench_chordpro";
+	std::filesystem::create_directories(directory / "library");
+
+	start = Clock::now();
+	std::size_t exported = chordpro::ExportFiles(songs, directory.string());
+	double exportSeconds = ElapsedMs(start) / 1000.0;
+
+	std::vector<std::string> fileNames;
+	std::uintmax_t bytes = 0;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory)) {
+		if (entry.path().extension() == ".cho") {
+			fileNames.push_back(entry.path().string());
+			bytes += entry.file_size();
+		}
+	}
+	start = Clock::now();
+	std::size_t imported = chordpro::ImportFiles(fileNames, (directory / "library").string());
+	double importSeconds = ElapsedMs(start) / 1000.0;
+
+	save::Song song("", 0);
+	int correct = 0;
+	if (chordpro::ImportSong((directory / "song1.cho").string(), song) && song.capo == songs[1].capo) {
+		for (std::size_t i = 0; i < song.chords.size() && i < songs[1].chords.size(); i++) {
+			if (song.chords[i].note == songs[1].chords[i].note && song.chords[i].type == songs[1].chords[i].type)
+				correct++;
+		}
+	}
+
+	file::MappedFile mapped;
+	double parseSeconds = 0;
+	if (mapped.Open((directory / "song1.cho").string())) {
+		std::string_view text(reinterpret_cast<const char*>(mapped.GetData()), mapped.GetSize());
+		chordpro::Stats stats;
+		start = Clock::now();
+		for (int round = 0; round < CHORDPRO_PARSE_ROUNDS; round++) {
+			song.chords.clear();
+			chordpro::Parse(text, song, stats);
+		}
+		parseSeconds = ElapsedMs(start) / 1000.0;
+	}
+	std::filesystem::remove_all(directory);
+
+	save::Song labeled("", 0);
+	chordpro::Stats labeledStats;
+	chordpro::Parse(CHORDPRO_LABELED, labeled, labeledStats);
+	const bool labelsSkipped = labeledStats.chords == CHORDPRO_LABELED_CHORDS && labeledStats.unknownChords == CHORDPRO_LABELS;
+	save::Song capoSong("", 0);
+	chordpro::Parse(CHORDPRO_CAPO, capoSong, labeledStats);
+	const bool capoTransposed = capoSong.capo == 2 && capoSong.chords.size() == 1 && capoSong.chords[0].note == music::Note::A;
+
+	result.metrics.push_back({ "ns_per_symbol", symbolSeconds * 1e9 / symbols });
+	result.metrics.push_back({ "parsed_symbols", static_cast<double>(parsed) / CHORDPRO_SYMBOL_ROUNDS });
+	if (memory::IsCountingAllocations()) {
+		result.metrics.push_back({ "allocations_per_symbol", static_cast<double>(allocations) / symbols });
+	}
+	result.metrics.push_back({ "parse_mb_per_s", mapped.GetSize() * CHORDPRO_PARSE_ROUNDS / parseSeconds / 1e6 });
+	result.metrics.push_back({ "export_files_per_s", exported / exportSeconds });
+	result.metrics.push_back({ "import_files_per_s", imported / importSeconds });
+	result.metrics.push_back({ "import_mb_per_s", bytes / importSeconds / 1e6 });
+	result.metrics.push_back({ "roundtrip_accuracy", static_cast<double>(correct) / CHORDPRO_CHORDS });
+	result.metrics.push_back({ "labels_skipped", labelsSkipped ? 1.0 : 0.0 });
+	result.metrics.push_back({ "capo_transposed", capoTransposed ? 1.0 : 0.0 });
+}
+
+static music::Note GetMusicXmlRoot(std::size_t measure) {
+	return music::Note(measure * 7 % music::TOTAL);
+}
+
+// Writes measures of the part until the file reaches its size, returns the number of measures
+static std::size_t WriteMusicXmlPart(FILE* file, const char* id, bool harmonies, std::size_t bytes) {
+	static const char* const STEPS = "ABCDEFG";
+	static const int STEP_NOTES[] = { 0, 2, 3, 5, 7, 8, 10 };
+	fprintf(file, "  <part id=\"%s\">\n", id);
+	std::size_t measure = 0;
+	for (; static_cast<std::size_t>(ftell(file)) < bytes; measure++) {
+		fprintf(file, "    <measure number=\"%zu\">\n", measure + 1);
+		if (harmonies) {
+			int root = GetMusicXmlRoot(measure);
+			int step = 0;
+			while (step < 6 && STEP_NOTES[step + 1] <= root)
+				step++;
+			const auto& kind = MUSICXML_KINDS[measure % std::size(MUSICXML_KINDS)];
+			fprintf(file, "      <harmony print-frame=\"no\">\n        <root>\n          <root-step>%c</root-step>\n", STEPS[step]);
+			if (root != STEP_NOTES[step])
+				fprintf(file, "          <root-alter>1</root-alter>\n");
+			fprintf(file, "        </root>\n        <kind text=\"\">%s</kind>\n      </harmony>\n", kind.first);
+		}
+		for (int note = 0; note < MUSICXML_NOTES_PER_MEASURE; note++) {
+			fprintf(file, "      <note default-x=\"%d\">\n        <pitch>\n          <step>%c</step>\n          <octave>4</octave>\n        </pitch>\n"
+				"        <duration>1</duration>\n        <voice>1</voice>\n        <type>quarter</type>\n        <stem>up</stem>\n      </note>\n",
+				20 + note * 40, STEPS[(measure + note) % 7]);
+		}
+		fprintf(file, "    </measure>\n");
+	}
+	fprintf(file, "  </part>\n");
+	return measure;
+}
+
+// Streaming import of a large generated score, its memory being independent of its size
+static void BenchMusicXml(Result& result, const Options&) {
+	std::string fileName = (std::filesystem::temp_directory_path() / "gp_bench_score.musicxml").string();
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == nullptr)
+		return;
+	fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+		"<!DOCTYPE score-partwise PUBLIC \"-//Recordare//DTD MusicXML 4.0 Partwise//EN\" \"http://www.musicxml.org/dtds/partwise.dtd\">\n"
+		"<score-partwise version=\"4.0\">\n  <work>\n    <work-title>Bench &amp; score</work-title>\n  </work>\n"
+		"  <!-- generated -->\n  <part-list>\n    <score-part id=\"P1\"><part-name>Guitare</part-name></score-part>\n"
+		"    <score-part id=\"P2\"><part-name>Basse</part-name></score-part>\n  </part-list>\n");
+	std::size_t measures = WriteMusicXmlPart(file, "P1", true, MUSICXML_BYTES / 2);
+	WriteMusicXmlPart(file, "P2", false, MUSICXML_BYTES);
+	fprintf(file, "</score-partwise>\n");
+	std::size_t bytes = ftell(file);
+	fclose(file);
+
+	save::Song song("", 0);
+	musicxml::Stats stats;
+	std::size_t allocations = memory::GetThreadAllocations();
+	Clock::time_point start = Clock::now();
+	bool parsed = musicxml::ImportSong(fileName, song, stats);
+	double seconds = ElapsedMs(start) / 1000.0;
+	allocations = memory::GetThreadAllocations() - allocations;
+	std::filesystem::remove(fileName);
+	if (!parsed)
+		return;
+
+	std::size_t correct = 0;
+	for (std::size_t i = 0; i < song.chords.size() && i < measures; i++) {
+		if (song.chords[i].note == GetMusicXmlRoot(i) && song.chords[i].type == MUSICXML_KINDS[i % std::size(MUSICXML_KINDS)].second)
+			correct++;
+	}
+
+	result.metrics.push_back({ "file_mb", bytes / 1e6 });
+	result.metrics.push_back({ "mb_per_s", bytes / seconds / 1e6 });
+	result.metrics.push_back({ "harmonies", static_cast<double>(stats.chords) });
+	result.metrics.push_back({ "accuracy", static_cast<double>(correct) / measures });
+	result.metrics.push_back({ "approximated_kinds", static_cast<double>(stats.approximatedKinds) });
+	if (memory::IsCountingAllocations()) {
+		// the buffer, the title and the growth of the chords
+		result.metrics.push_back({ "allocations", static_cast<double>(allocations) });
+	}
+}
+
+// Whether the song has the progression in any key, the index being left aside
+static bool HasProgression(const std::vector<save::ChordSave>& song, const std::vector<save::ChordSave>& progression) {
+	std::vector<save::ChordSave> chords;
+	for (const save::ChordSave& chord : song) {
+		if (chords.empty() || chord.note != chords.back().note || chord.type != chords.back().type)
+			chords.push_back(chord);
+	}
+	for (std::size_t start = 0; start + progression.size() <= chords.size(); start++) {
+		const int transposition = chords[start].note - progression[0].note + music::TOTAL;
+		std::size_t i = 0;
+		while (i < progression.size() && chords[start + i].type == progression[i].type
+			&& chords[start + i].note == (progression[i].note + transposition) % music::TOTAL)
+			i++;
+		if (i == progression.size())
+			return true;
+	}
+	return false;
+}
+
+static std::vector<std::vector<save::ChordSave>> GetLibraryParts() {
+	std::vector<std::vector<save::ChordSave>> parts;
+	for (const char* part : LIBRARY_PARTS) {
+		parts.emplace_back();
+		progression::ParseProgression(part, parts.back());
+	}
+	return parts;
+}
+
+// Songs of a style in a random key, with a random capo
+static std::vector<save::Song> GetTestLibrary(std::size_t count, std::mt19937& random) {
+	const std::vector<std::vector<save::ChordSave>> parts = GetLibraryParts();
+	const std::size_t partsPerStyle = parts.size() / LIBRARY_STYLES;
+	std::vector<save::Song> songs;
+	songs.reserve(count);
+	for (std::size_t s = 0; s < count; s++) {
+		songs.emplace_back("song" + std::to_string(s), static_cast<save::CapoPosType>(random() % (LIBRARY_CAPO_MAX + 1)));
+		std::vector<save::ChordSave>& chords = songs.back().chords;
+		const std::size_t style = random() % LIBRARY_STYLES;
+		const int key = random() % music::TOTAL;
+		while (chords.size() < LIBRARY_CHORDS) {
+			for (save::ChordSave chord : parts[style * partsPerStyle + random() % partsPerStyle]) {
+				chord.note = music::Note((chord.note + key) % music::TOTAL);
+				chord.guitaroPiano = true;
+				chord.octave = 2;
+				chord.inversion = 0;
+				chord.fretMax = 5;
+				chords.push_back(chord);
+			}
+		}
+		chords.resize(LIBRARY_CHORDS);
+	}
+	return songs;
+}
+
+static void BenchProgression(Result& result, const Options&) {
+	const std::vector<std::vector<save::ChordSave>> parts = GetLibraryParts();
+	std::mt19937 random(45);
+	std::vector<save::Song> songs = GetTestLibrary(PROGRESSION_SONGS, random);
+
+	progression::Index index;
+	std::vector<progression::SongId> ids;
+	Clock::time_point start = Clock::now();
+	for (const save::Song& song : songs) {
+		ids.push_back(index.Add(song.chords));
+	}
+	double buildMs = ElapsedMs(start);
+
+	std::vector<std::vector<save::ChordSave>> queries(std::size(PROGRESSION_QUERIES));
+	for (std::size_t q = 0; q < queries.size(); q++) {
+		progression::ParseProgression(PROGRESSION_QUERIES[q], queries[q]);
+	}
+	// every query against a scan of the songs, before and after the edits
+	auto checkQueries = [&]() {
+		int correct = 0;
+		std::vector<progression::SongId> found;
+		for (const std::vector<save::ChordSave>& query : queries) {
+			std::vector<progression::SongId> expected;
+			for (std::size_t s = 0; s < songs.size(); s++) {
+				if (HasProgression(songs[s].chords, query))
+					expected.push_back(ids[s]);
+			}
+			std::sort(expected.begin(), expected.end());
+			index.Find(query, found);
+			correct += found == expected && !query.empty() ? 1 : 0;
+		}
+		return correct;
+	};
+	int correct = checkQueries();
+
+	std::vector<progression::SongId> found;
+	std::size_t matches = 0;
+	double maxQueryMs = 0;
+	start = Clock::now();
+	for (int round = 0; round < PROGRESSION_QUERY_ROUNDS; round++) {
+		for (const std::vector<save::ChordSave>& query : queries) {
+			Clock::time_point queryStart = Clock::now();
+			index.Find(query, found);
+			maxQueryMs = std::max(maxQueryMs, ElapsedMs(queryStart));
+			matches += found.size();
+		}
+	}
+	double queryMs = ElapsedMs(start) / (PROGRESSION_QUERY_ROUNDS * queries.size());
+
+	// a chord added to a song then the song removed and added again, as edited in the gui
+	start = Clock::now();
+	for (int edit = 0; edit < PROGRESSION_EDITS; edit++) {
+		const std::size_t s = random() % songs.size();
+		if (edit % 2 == 0) {
+			songs[s].chords.push_back(parts[edit % parts.size()][0]);
+			index.Update(ids[s], songs[s].chords);
+		} else {
+			index.Remove(ids[s]);
+			ids[s] = index.Add(songs[s].chords);
+		}
+	}
+	double editMs = ElapsedMs(start) / PROGRESSION_EDITS;
+	correct += checkQueries();
+
+	result.metrics.push_back({ "songs", static_cast<double>(index.GetSongCount()) });
+	result.metrics.push_back({ "build_ms", buildMs });
+	result.metrics.push_back({ "index_kb", index.GetByteCount() / 1024.0 });
+	result.metrics.push_back({ "query_ms", queryMs });
+	result.metrics.push_back({ "max_query_ms", maxQueryMs });
+	result.metrics.push_back({ "matches_per_query", static_cast<double>(matches) / (PROGRESSION_QUERY_ROUNDS * queries.size()) });
+	result.metrics.push_back({ "edit_ms", editMs });
+	result.metrics.push_back({ "accuracy", static_cast<double>(correct) / (2 * queries.size()) });
+}
+
+static void BenchSimilarity(Result& result, const Options&) {
+	std::mt19937 random(46);
+	std::vector<save::Song> songs = GetTestLibrary(SIMILARITY_SONGS, random);
+
+	similarity::Index index;
+	Clock::time_point start = Clock::now();
+	for (const save::Song& song : songs) {
+		index.Add(song);
+	}
+	double buildMs = ElapsedMs(start);
+
+	std::vector<similarity::SongId> queries;
+	for (int q = 0; q < SIMILARITY_QUERIES; q++) {
+		queries.push_back(static_cast<similarity::SongId>(random() % songs.size()));
+	}
+	std::vector<similarity::Match> matches;
+	std::vector<std::vector<similarity::Match>> found;
+	double maxQueryMs = 0;
+	start = Clock::now();
+	for (similarity::SongId query : queries) {
+		Clock::time_point queryStart = Clock::now();
+		index.FindSimilar(query, SIMILARITY_TOP, matches);
+		maxQueryMs = std::max(maxQueryMs, ElapsedMs(queryStart));
+		found.push_back(matches);
+	}
+	double queryMs = ElapsedMs(start) / queries.size();
+
+	// the same scores with the rows of features one after the other and a full sort
+	std::vector<similarity::Features> rows;
+	for (const save::Song& song : songs) {
+		rows.push_back(similarity::GetFeatures(song));
+	}
+	int correct = 0;
+	std::vector<std::pair<float, similarity::SongId>> scores(rows.size());
+	start = Clock::now();
+	for (std::size_t q = 0; q < queries.size(); q++) {
+		for (std::size_t s = 0; s < rows.size(); s++) {
+			float score = 0;
+			for (int feature = 0; feature < similarity::FEATURES; feature++) {
+				score += rows[queries[q]][feature] * rows[s][feature];
+			}
+			scores[s] = { s == queries[q] ? 0.0f : score, static_cast<similarity::SongId>(s) };
+		}
+		std::partial_sort(scores.begin(), scores.begin() + SIMILARITY_TOP, scores.end(), [](const auto& a, const auto& b) {
+			return a.first > b.first;
+		});
+		bool same = found[q].size() == SIMILARITY_TOP;
+		for (std::size_t i = 0; same && i < found[q].size(); i++) {
+			same = std::abs(found[q][i].score - scores[i].first) < SIMILARITY_TOLERANCE;
+		}
+		correct += same ? 1 : 0;
+	}
+	double scalarQueryMs = ElapsedMs(start) / queries.size();
+
+	result.metrics.push_back({ "songs", static_cast<double>(index.GetSongCount()) });
+	result.metrics.push_back({ "build_ms", buildMs });
+	result.metrics.push_back({ "query_ms", queryMs });
+	result.metrics.push_back({ "max_query_ms", maxQueryMs });
+	result.metrics.push_back({ "gb_per_s", songs.size() * similarity::FEATURES * sizeof(float) / (queryMs / 1000.0) / 1e9 });
+	result.metrics.push_back({ "scalar_query_ms", scalarQueryMs });
+	result.metrics.push_back({ "accuracy", static_cast<double>(correct) / queries.size() });
+}
+
+static void BenchTitleSearch(Result& result, const Options&) {
+	std::mt19937 random(47);
+	std::vector<std::string> titles;
+	for (int t = 0; t < TITLE_SEARCH_TITLES; t++) {
+		std::string title;
+		const int words = 2 + random() % 3;
+		for (int w = 0; w < words; w++) {
+			title += w == 0 ? "" : " ";
+			title += TITLE_SEARCH_WORDS[random() % std::size(TITLE_SEARCH_WORDS)];
+		}
+		if (random() % 4 == 0)
+			title += " " + std::to_string(random() % 20);
+		titles.push_back(std::move(title));
+	}
+
+	search::TitleIndex index;
+	Clock::time_point start = Clock::now();
+	for (const std::string& title : titles) {
+		index.Add(title);
+	}
+	double buildMs = ElapsedMs(start);
+
+	// found when a title of the same text is in the first results, the library having duplicates
+	std::vector<search::Match> matches;
+	auto isFound = [&](const std::string& title) {
+		for (std::size_t i = 0; i < matches.size() && i < TITLE_SEARCH_TOP; i++) {
+			if (titles[matches[i].title] == title)
+				return true;
+		}
+		return false;
+	};
+	std::size_t keystrokes = 0;
+	std::size_t matching = 0;
+	int found = 0;
+	int typoFound = 0;
+	double totalMs = 0;
+	double maxKeystrokeMs = 0;
+	for (int typed = 0; typed < TITLE_SEARCH_TYPED; typed++) {
+		std::string title = titles[random() % titles.size()];
+		std::string query;
+		for (std::size_t i = 0; i <= title.size(); i++) {
+			Clock::time_point keystrokeStart = Clock::now();
+			matching += index.Find(query, TITLE_SEARCH_RESULTS, matches);
+			const double keystrokeMs = ElapsedMs(keystrokeStart);
+			totalMs += keystrokeMs;
+			maxKeystrokeMs = std::max(maxKeystrokeMs, keystrokeMs);
+			keystrokes++;
+			if (i == title.size())
+				break;
+			query += title[i];
+			if (static_cast<unsigned char>(title[i]) >= 0xC0)
+				query += title[++i];  // accented letters are two bytes long
+		}
+		found += isFound(title) ? 1 : 0;
+
+		// two letters swapped in the middle of the title
+		std::string typo = query;
+		const std::size_t middle = typo.size() / 2;
+		if (typo[middle] != ' ' && typo[middle + 1] != ' ')
+			std::swap(typo[middle], typo[middle + 1]);
+		index.Find(typo, TITLE_SEARCH_RESULTS, matches);
+		typoFound += isFound(title) ? 1 : 0;
+	}
+
+	result.metrics.push_back({ "titles", static_cast<double>(index.GetTitleCount()) });
+	result.metrics.push_back({ "build_ms", buildMs });
+	result.metrics.push_back({ "keystroke_ms", totalMs / keystrokes });
+	result.metrics.push_back({ "max_keystroke_ms", maxKeystrokeMs });
+	result.metrics.push_back({ "matches_per_keystroke", static_cast<double>(matching) / keystrokes });
+	result.metrics.push_back({ "found", static_cast<double>(found) / TITLE_SEARCH_TYPED });
+	result.metrics.push_back({ "found_with_typo", static_cast<double>(typoFound) / TITLE_SEARCH_TYPED });
+}
+
+static void BenchAnalysis(Result& result, const Options&) {
+	std::mt19937 random(48);
+	// songs of known key, whatever the transposition
+	std::vector<std::vector<save::ChordSave>> majorParts;
+	for (const char* part : ANALYSIS_MAJOR_PARTS) {
+		majorParts.emplace_back();
+		progression::ParseProgression(part, majorParts.back());
+	}
+	std::vector<std::vector<save::ChordSave>> minorParts;
+	for (const char* part : ANALYSIS_MINOR_PARTS) {
+		minorParts.emplace_back();
+		progression::ParseProgression(part, minorParts.back());
+	}
+	int keysFound = 0;
+	for (int s = 0; s < ANALYSIS_KEYED_SONGS; s++) {
+		save::Song song("keyed" + std::to_string(s), 0);
+		const bool minor = s % 2 == 1;
+		const std::vector<std::vector<save::ChordSave>>& parts = minor ? minorParts : majorParts;
+		const int transposition = random() % music::TOTAL;
+		while (song.chords.size() < ANALYSIS_KEYED_CHORDS) {
+			for (save::ChordSave chord : parts[random() % parts.size()]) {
+				chord.note = music::Note((chord.note + transposition) % music::TOTAL);
+				song.chords.push_back(chord);
+			}
+		}
+		const music::Note tonic = music::Note(((minor ? music::A : music::C) + transposition) % music::TOTAL);
+		const music::Key key = music::AnalyzeSong(song).key;
+		keysFound += key.tonic == tonic && key.minor == minor ? 1 : 0;
+	}
+
+	std::vector<save::Song> songs = GetTestLibrary(ANALYSIS_SONGS, random);
+	Clock::time_point start = Clock::now();
+	for (const save::Song& song : songs) {
+		music::AnalyzeSong(song);
+	}
+	double songUs = ElapsedMs(start) * 1000 / songs.size();
+
+	// the numerals read back in C are the chords transposed to C
+	int numeralsRead = 0;
+	std::vector<save::ChordSave> chords;
+	for (std::size_t s = 0; s < songs.size(); s += songs.size() / 100) {
+		const music::SongAnalysis analysis = music::AnalyzeSong(songs[s]);
+		std::string text;
+		for (const music::Numeral& numeral : analysis.numerals) {
+			text += music::ToString(numeral) + " ";
+		}
+		bool same = progression::ParseProgression(text, chords) && chords.size() == songs[s].chords.size();
+		for (std::size_t c = 0; same && c < chords.size(); c++) {
+			same = chords[c].type == songs[s].chords[c].type
+				&& (chords[c].note - music::C + music::TOTAL) % music::TOTAL == (songs[s].chords[c].note - analysis.key.tonic + music::TOTAL) % music::TOTAL;
+		}
+		numeralsRead += same ? 1 : 0;
+	}
+
+	std::vector<const save::Song*> batch;
+	for (const save::Song& song : songs) {
+		batch.push_back(&song);
+	}
+	music::AnalysisCache cache;
+	std::vector<const music::SongAnalysis*> analyses;
+	start = Clock::now();
+	cache.AnalyzeSongs(batch, analyses);
+	double batchMs = ElapsedMs(start);
+	// nothing edited, every song found by its content
+	start = Clock::now();
+	cache.AnalyzeSongs(batch, analyses);
+	double cachedBatchMs = ElapsedMs(start);
+
+	result.metrics.push_back({ "key_accuracy", static_cast<double>(keysFound) / ANALYSIS_KEYED_SONGS });
+	result.metrics.push_back({ "song_us", songUs });
+	result.metrics.push_back({ "songs", static_cast<double>(songs.size()) });
+	result.metrics.push_back({ "threads", static_cast<double>(parallel::GetThreadCount()) });
+	result.metrics.push_back({ "batch_ms", batchMs });
+	result.metrics.push_back({ "cached_batch_ms", cachedBatchMs });
+	result.metrics.push_back({ "distinct_songs", static_cast<double>(cache.GetSize()) });
+	result.metrics.push_back({ "numerals_read_back", numeralsRead / 100.0 });
+}
+
+// Byte at a time reference of the content hash
+static std::uint64_t HashFnv(const std::uint8_t* data, std::size_t size) {
+	std::uint64_t hash = 0xCBF29CE484222325ull;
+	for (std::size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+static void BenchLibraryScan(Result& result, const Options&) {
+	std::mt19937 random(49);
+	std::vector<std::uint8_t> bytes(HASH_BYTES);
+	for (std::uint8_t& byte : bytes) {
+		byte = static_cast<std::uint8_t>(random());
+	}
+	Clock::time_point start = Clock::now();
+	std::uint64_t hash = hash::Hash64(bytes.data(), bytes.size());
+	double hashGbPerS = bytes.size() / (ElapsedMs(start) / 1000.0) / 1e9;
+	start = Clock::now();
+	hash ^= HashFnv(bytes.data(), bytes.size());
+	double fnvGbPerS = bytes.size() / (ElapsedMs(start) / 1000.0) / 1e9;
+
+	std::vector<save::Song> songs = GetTestLibrary(SCAN_FILES, random);
+	start = Clock::now();
+	for (int round = 0; round < HASH_SONG_ROUNDS; round++) {
+		for (const save::Song& song : songs) {
+			hash ^= save::HashSong(song);
+		}
+	}
+	double songHashNs = ElapsedMs(start) * 1e6 / (HASH_SONG_ROUNDS * songs.size());
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "gp_bench_scan";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	std::vector<std::string> fileNames;
+	for (std::size_t s = 0; s < songs.size(); s++) {
+		// a copy of the previous song
+		const save::Song& song = s % SCAN_COPY_INTERVAL == 1 ? songs[s - 1] : songs[s];
+		fileNames.push_back((directory / (songs[s].title + ".gp")).string());
+		save::SaveSongToFile(song, fileNames.back());
+	}
+
+	save::ScanCache cache;
+	start = Clock::now();
+	std::vector<save::Song> scanned = cache.Scan(directory.string());
+	double scanMs = ElapsedMs(start);
+	std::unordered_set<std::uint64_t> contents;
+	for (const save::Song& song : scanned) {
+		contents.insert(save::HashSong(song));
+	}
+	const save::ScanStats firstStats = cache.GetStats();
+
+	start = Clock::now();
+	const std::size_t rescanned = cache.Scan(directory.string()).size();
+	double rescanMs = ElapsedMs(start);
+	const save::ScanStats rescanStats = cache.GetStats();
+
+	// saved again with the same chords, read but not parsed
+	for (std::size_t f = 0; f < fileNames.size(); f += SCAN_TOUCH_INTERVAL) {
+		save::SaveSongToFile(songs[f], fileNames[f]);
+		std::filesystem::last_write_time(fileNames[f], std::filesystem::last_write_time(fileNames[f]) + std::chrono::seconds(1));
+	}
+	start = Clock::now();
+	const std::size_t touched = cache.Scan(directory.string()).size();
+	double touchedMs = ElapsedMs(start);
+	const save::ScanStats touchedStats = cache.GetStats();
+	std::filesystem::remove_all(directory);
+
+	result.metrics.push_back({ "hash_gb_per_s", hashGbPerS });
+	result.metrics.push_back({ "fnv_gb_per_s", fnvGbPerS });
+	result.metrics.push_back({ "song_hash_ns", songHashNs });
+	result.metrics.push_back({ "files", static_cast<double>(firstStats.files) });
+	result.metrics.push_back({ "parsed", static_cast<double>(firstStats.parsed) });
+	result.metrics.push_back({ "duplicates", static_cast<double>(scanned.size() - contents.size()) });
+	result.metrics.push_back({ "scan_ms", scanMs });
+	result.metrics.push_back({ "rescan_ms", rescanMs });
+	result.metrics.push_back({ "rescan_read", static_cast<double>(rescanStats.read + rescanned) });
+	result.metrics.push_back({ "touched_rescan_ms", touchedMs });
+	result.metrics.push_back({ "touched_read", static_cast<double>(touchedStats.read) });
+	result.metrics.push_back({ "touched_parsed", static_cast<double>(touchedStats.parsed + touched) });
+	// keeps the hashes computed
+	result.metrics.push_back({ "hash_parity", static_cast<double>(hash & 1) });
+}
+
+static std::uint64_t RunJobWork(std::uint64_t seed) {
+	std::uint64_t x = seed * 0x9E3779B97F4A7C15ull + 1;
+	for (int i = 0; i < JOBS_WORK; i++) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+	}
+	return x;
+}
+
+// The same jobs on schedulers of 1 to every thread, the best of a few rounds
+static double RunJobs(unsigned threadCount, std::uint64_t& sum, jobs::Stats& stats) {
+	jobs::Scheduler scheduler(threadCount - 1);
+	double best = 0.0;
+	for (int round = 0; round < JOBS_ROUNDS; round++) {
+		std::vector<std::uint64_t> batchSums(JOBS_BATCHES);
+		sum = 0;
+		Clock::time_point start = Clock::now();
+		jobs::Group batches;
+		jobs::Group done;
+		for (int b = 0; b < JOBS_BATCHES; b++) {
+			scheduler.Schedule("BenchBatch", [&scheduler, &batchSums, b]() {
+				std::uint64_t results[JOBS_PER_BATCH];
+				jobs::Group group;
+				for (int j = 0; j < JOBS_PER_BATCH; j++) {
+					scheduler.Schedule("BenchJob", [&results, b, j]() {
+						results[j] = RunJobWork(static_cast<std::uint64_t>(b) * JOBS_PER_BATCH + j);
+					}, &group);
+				}
+				scheduler.Wait(group);
+				for (std::uint64_t result : results) {
+					batchSums[b] += result;
+				}
+			}, &batches);
+		}
+		scheduler.Then(batches, "BenchSum", [&]() {
+			for (std::uint64_t batchSum : batchSums) {
+				sum += batchSum;
+			}
+		}, &done);
+		scheduler.Wait(done);
+		double elapsed = ElapsedMs(start);
+		if (round == 0 || elapsed < best)
+			best = elapsed;
+	}
+	stats = scheduler.GetStats();
+	return best;
+}
+
+static void BenchJobs(Result& result, const Options&) {
+	std::uint64_t expected = 0;
+	for (int task = 0; task < JOBS_BATCHES * JOBS_PER_BATCH; task++) {
+		expected += RunJobWork(task);
+	}
+
+	const unsigned threadCount = parallel::GetThreadCount();
+	std::uint64_t sum = 0;
+	jobs::Stats stats;
+	bool correct = true;
+	double oneThreadMs = 0.0;
+	for (std::size_t m = 0; m < std::size(JOBS_SCALING_METRICS) && (1u << m) < threadCount; m++) {
+		double elapsed = RunJobs(1u << m, sum, stats);
+		correct &= sum == expected;
+		if (m == 0)
+			oneThreadMs = elapsed;
+		result.metrics.push_back({ JOBS_SCALING_METRICS[m], elapsed });
+	}
+	double allThreadsMs = RunJobs(threadCount, sum, stats);
+	correct &= sum == expected;
+	if (threadCount == 1)
+		oneThreadMs = allThreadsMs;
+
+	result.metrics.push_back({ "threads", static_cast<double>(threadCount) });
+	result.metrics.push_back({ "ms_all_threads", allThreadsMs });
+	result.metrics.push_back({ "speedup", oneThreadMs / allThreadsMs });
+	result.metrics.push_back({ "efficiency", oneThreadMs / allThreadsMs / threadCount });
+	result.metrics.push_back({ "jobs_per_round", static_cast<double>(stats.executed) / JOBS_ROUNDS });
+	result.metrics.push_back({ "stolen_per_round", static_cast<double>(stats.stolen) / JOBS_ROUNDS });
+	result.metrics.push_back({ "correct", correct ? 1.0 : 0.0 });
+}
+
+// A song played without any input : every chord heard rebuilds the widgets like the gui does (FollowPlayback). The
+// frames are steady, debug builds assert they do not allocate.
+static void BenchPlaybackFrames(Result& result, const Options&) {
+	if (!audio::Start(audio::CreateNullSink()))
+		return;
+	std::mt19937 random(35);
+	save::Song song = std::move(GetTestLibrary(1, random)[0]);
+	song.chords.resize(PLAYBACK_CHORDS);
+
+	// the allocator checks start after their own warm-up
+	for (int i = 0; i < GUI_WARMUP_FRAMES; i++) {
+		memory::NewFrame();
+		memory::EndFrame(false);
+	}
+	memory::NewFrame();
+	renderer::UpdateBuffers();
+	audio::PlaySong(song, PLAYBACK_BPM);
+	memory::EndFrame(false);
+
+	int playedChord = -1;
+	int chordChanges = 0;
+	std::size_t allocations = 0;
+	double rebuildMs = 0.0;
+	for (;;) {
+		std::this_thread::sleep_for(PLAYBACK_FRAME_INTERVAL);
+		memory::NewFrame();
+		const int chord = audio::UpdatePlayback();
+		if (chord < 0) {
+			memory::EndFrame(true);
+			break;
+		}
+		if (chord != playedChord) {
+			playedChord = chord;
+			chordChanges++;
+			Clock::time_point start = Clock::now();
+			const save::ChordSave& chordSave = song.chords[chord];
+			music::ChordOffsets notes = music::GetChordNotes(chordSave);
+			renderer::ClearKeyboard();
+			for (std::uint8_t note : notes) {
+				if (note != data::EMPTY_NOTE)
+					renderer::SetKeyHighlight(note, true);
+			}
+			music::Tab tab = music::GetChordTab(chordSave, notes, song.capo);
+			renderer::ClearTab();
+			for (int i = 0; i < static_cast<int>(tab.size()); i++) {
+				renderer::SetTab(i, tab[i]);
+			}
+			renderer::UpdateBuffers();
+			rebuildMs += ElapsedMs(start);
+		}
+		memory::EndFrame(true);
+		allocations += memory::GetFrameAllocations();
+	}
+	audio::Stop();
+
+	result.metrics.push_back({ "chord_changes", static_cast<double>(chordChanges) });
+	result.metrics.push_back({ "ms_per_rebuild", chordChanges > 0 ? rebuildMs / chordChanges : 0.0 });
+	if (memory::IsCountingAllocations()) {
+		result.metrics.push_back({ "allocations_per_chord", chordChanges > 0 ? static_cast<double>(allocations) / chordChanges : 0.0 });
+	}
+}
+
+// Real-time audio thread on the null sink, paced by the clock like a device
+static void BenchAudioEngine(Result& result, const Options&) {
+	if (!audio::Start(audio::CreateNullSink()))
+		return;
+	for (int i = 0; i < AUDIO_CHORDS; i++) {
+		save::ChordSave chord;
+		chord.note = music::Note(i % music::TOTAL);
+		chord.type = music::ChordType(i % static_cast<int>(music::ChordType::COUNT));
+		chord.octave = 2;
+		chord.inversion = 0;
+		chord.fretMax = 5;
+		chord.guitaroPiano = true;
+		music::ChordOffsets keys = music::GetChordNotes(chord);
+		audio::PlayChord(keys, music::GetChordTab(chord, keys, 0), 0);
+		std::this_thread::sleep_for(AUDIO_CHORD_INTERVAL);
+	}
+	audio::Stats stats = audio::GetStats();
+	audio::Stop();
+
+	result.metrics.push_back({ "blocks", static_cast<double>(stats.blocks) });
+	result.metrics.push_back({ "deadline_misses", static_cast<double>(stats.deadlineMisses) });
+	result.metrics.push_back({ "max_render_ms", stats.maxRenderMs });
+	result.metrics.push_back({ "budget_ms", stats.budgetMs });
+}
+
+struct Benchmark {
+	const char* name;
+	void (*function)(Result&, const Options&);
+};
+
+static const Benchmark BENCHMARKS[] = {
+	{ "gui_frames", BenchGuiFrames },
+	{ "playback_frames", BenchPlaybackFrames },
+	{ "load_library", BenchLoadLibrary },
+	{ "find_chord", BenchFindChord },
+	{ "synth_voices", BenchSynthVoices },
+	{ "render_song", BenchRenderSong },
+	{ "recognize_chords", BenchRecognizeChords },
+	{ "tuner", BenchTuner },
+	{ "midi_import", BenchMidiImport },
+	{ "midi_export", BenchMidiExport },
+	{ "chordpro", BenchChordPro },
+	{ "musicxml", BenchMusicXml },
+	{ "guitarpro", BenchGuitarPro },
+	{ "progression", BenchProgression },
+	{ "similarity", BenchSimilarity },
+	{ "title_search", BenchTitleSearch },
+	{ "analysis", BenchAnalysis },
+	{ "library_scan", BenchLibraryScan },
+	{ "jobs", BenchJobs },
+	{ "audio_engine", BenchAudioEngine },
+};
+
+bool Run(const Options& options) {
+	std::vector<Result> results;
+	for (const Benchmark& benchmark : BENCHMARKS) {
+		if (std::string(benchmark.name).find(options.filter) == std::string::npos)
+			continue;
+
+		GP_TRACE_SCOPE(benchmark.name);
+		Result result;
+		result.name = benchmark.name;
+
+		std::array<memory::AllocationStats, static_cast<std::size_t>(memory::Tag::COUNT)> before;
+		memory::ResetPeaks();
+		for (std::size_t tag = 0; tag < before.size(); tag++) {
+			before[tag] = memory::GetTotalStats(memory::Tag(tag));
+		}
+		benchmark.function(result, options);
+		for (std::size_t tag = 0; tag < before.size(); tag++) {
+			result.allocations[tag] = memory::GetTotalStats(memory::Tag(tag));
+			result.allocations[tag].allocations -= before[tag].allocations;
+			result.allocations[tag].bytes -= before[tag].bytes;
+		}
+
+		printf("%s\n", result.name.c_str());
+		for (const Metric& metric : result.metrics) {
+			printf("  %-24s %.4f\n", metric.name, metric.value);
+		}
+		results.push_back(std::move(result));
+	}
+
+	if (results.empty()) {
+		fprintf(stderr, "No benchmark matches %s\n", options.filter.c_str());
+		return false;
+	}
+	if (!options.jsonFile.empty() && !WriteJson(results, options.jsonFile)) {
+		fprintf(stderr, "Unable to write %s\n", options.jsonFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool WriteJson(const std::vector<Result>& results, const std::string& fileName) {
+	FILE* file = fopen(fileName.c_str(), "w");
+	if (file == nullptr)
+		return false;
+
+	fprintf(file, "{\n\t\"allocationTracking\": %s,\n\t\"benchmarks\": [", memory::IsTrackingAllocations() ? "true" : "false");
+	for (std::size_t i = 0; i < results.size(); i++) {
+		const Result& result = results[i];
+		fprintf(file, "%s\n\t\t{\n\t\t\t\"name\": \"%s\",\n\t\t\t\"metrics\": {", i == 0 ? "" : ",", result.name.c_str());
+		for (std::size_t m = 0; m < result.metrics.size(); m++) {
+			fprintf(file, "%s\"%s\": %.6g", m == 0 ? "" : ", ", result.metrics[m].name, result.metrics[m].value);
+		}
+		fprintf(file, "}");
+		if (memory::IsTrackingAllocations()) {
+			fprintf(file, ",\n\t\t\t\"allocations\": {");
+			for (std::size_t tag = 0; tag < result.allocations.size(); tag++) {
+				const memory::AllocationStats& stats = result.allocations[tag];
+				fprintf(file, "%s\n\t\t\t\t\"%s\": { \"allocations\": %zu, \"bytes\": %zu, \"liveBytes\": %zu, \"peakBytes\": %zu }",
+					tag == 0 ? "" : ",", memory::GetTagName(memory::Tag(tag)), stats.allocations, stats.bytes, stats.liveBytes, stats.peakBytes);
+			}
+			fprintf(file, "\n\t\t\t}");
+		}
+		fprintf(file, "\n\t\t}");
+	}
+	fprintf(file, "\n\t]\n}\n");
+
+	return fclose(file) == 0;
+}
+
+} // namespace bench
+} // namespace gpgui
@@ -0,0 +1,217 @@
+#include "GPChordPro.h"
+#include "GPMappedFile.h"
+#include "GPMemory.h"
+#include "GPMusic.h"
+#include "GPParallel.h"
+#include "GPTrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+
+namespace gpgui {
+namespace chordpro {
+
+// Same range as the capo of the gui
+static constexpr int MAX_CAPO = 10;
+static constexpr int CHORDS_PER_LINE = 4;
+
+static bool IsSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static std::string_view Trim(std::string_view text) {
+	while (!text.empty() && IsSpace(text.front()))
+		text.remove_prefix(1);
+	while (!text.empty() && IsSpace(text.back()))
+		text.remove_suffix(1);
+	return text;
+}
+
+// Directive names are case insensitive
+static bool IsName(std::string_view name, std::string_view expected) {
+	if (name.size() != expected.size())
+		return false;
+	for (std::size_t i = 0; i < name.size(); i++) {
+		char c = name[i];
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		if (c != expected[i])
+			return false;
+	}
+	return true;
+}
+
+static int ParseCapo(std::string_view value) {
+	int capo = 0;
+	for (char c : value) {
+		if (c < '0' || c > '9')
+			break;
+		capo = std::min(capo * 10 + (c - '0'), MAX_CAPO);
+	}
+	return capo;
+}
+
+static void ParseDirective(std::string_view directive, save::Song& song) {
+	std::size_t separator = directive.find_first_of(": \t");
+	std::string_view name = directive.substr(0, separator);
+	std::string_view value = separator == std::string_view::npos ? std::string_view() : Trim(directive.substr(separator + 1));
+	if (IsName(name, "meta")) {
+		// {meta: name value}
+		separator = value.find_first_of(" \t");
+		if (separator == std::string_view::npos)
+			return;
+		name = value.substr(0, separator);
+		value = Trim(value.substr(separator + 1));
+	}
+
+	if (IsName(name, "title") || IsName(name, "t")) {
+		if (!value.empty())
+			song.title.assign(value.data(), value.size());
+	} else if (IsName(name, "capo")) {
+		song.capo = static_cast<save::CapoPosType>(ParseCapo(value));
+	}
+}
+
+static void ParseLine(std::string_view line, save::Song& song, Stats& stats) {
+	for (std::size_t open = line.find('['); open != std::string_view::npos; open = line.find('[', open)) {
+		std::size_t close = line.find(']', open + 1);
+		if (close == std::string_view::npos)
+			return;
+		save::ChordSave chord;
+		music::Note root;
+		music::ChordType type;
+		if (music::ParseChordSymbol(Trim(line.substr(open + 1, close - open - 1)), root, type)) {
+			chord.note = root;
+			chord.type = type;
+			chord.guitaroPiano = true;
+			chord.octave = 2;
+			chord.inversion = 0;
+			chord.fretMax = 5;
+			song.chords.push_back(chord);
+			stats.chords++;
+		} else {
+			stats.unknownChords++;
+		}
+		open = close + 1;
+	}
+}
+
+void Parse(std::string_view text, save::Song& song, Stats& stats) {
+	const std::size_t first = song.chords.size();
+	song.chords.reserve(song.chords.size() + std::count(text.begin(), text.end(), '['));
+	while (!text.empty()) {
+		std::size_t end = text.find('\n');
+		std::string_view line = Trim(text.substr(0, end));
+		text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+		if (line.empty() || line.front() == '#')
+			continue;  // comment
+		if (line.front() == '{') {
+			std::size_t close = line.find('}');
+			ParseDirective(Trim(line.substr(1, close == std::string_view::npos ? std::string_view::npos : close - 1)), song);
+		} else {
+			ParseLine(line, song, stats);
+		}
+	}
+	// the charts give the shapes played above the capo, the songs the chords heard
+	for (std::size_t i = first; i < song.chords.size(); i++) {
+		song.chords[i].note = music::Note((song.chords[i].note + song.capo) % music::TOTAL);
+	}
+}
+
+bool ImportSong(const std::string& fileName, save::Song& song) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Save);
+	file::MappedFile file;
+	if (!file.Open(fileName))
+		return false;
+	song = save::Song(std::filesystem::path(fileName).stem().string(), 0);
+	Stats stats;
+	Parse(std::string_view(reinterpret_cast<const char*>(file.GetData()), file.GetSize()), song, stats);
+	return true;
+}
+
+static void WriteSong(const save::Song& song, std::string& text) {
+	text.clear();
+	text += "{title: ";
+	text += song.title;
+	text += "}\n";
+	if (song.capo > 0) {
+		text += "{capo: ";
+		text += std::to_string(song.capo);
+		text += "}\n";
+	}
+	text += '\n';
+	// the shapes played above the capo
+	for (std::size_t i = 0; i < song.chords.size(); i++) {
+		text += '[';
+		text += music::GetName(music::Note((song.chords[i].note - song.capo % music::TOTAL + music::TOTAL) % music::TOTAL));
+		text += music::GetSymbolSuffix(song.chords[i].type);
+		text += ']';
+		text += (i + 1) % CHORDS_PER_LINE == 0 || i + 1 == song.chords.size() ? '\n' : ' ';
+	}
+}
+
+static bool WriteText(const std::string& text, const std::string& fileName) {
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+	return fclose(file) == 0 && written;
+}
+
+bool ExportSong(const save::Song& song, const std::string& fileName) {
+	GP_ALLOC_TAG(Save);
+	std::string text;
+	WriteSong(song, text);
+	return WriteText(text, fileName);
+}
+
+std::size_t ImportFiles(const std::vector<std::string>& fileNames, const std::string& outputDirectory, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	std::atomic<std::size_t> written{ 0 };
+	parallel::ForEach(fileNames.size(), [&](std::size_t i) {
+		save::Song song("", 0);
+		if (!ImportSong(fileNames[i], song)) {
+			fprintf(stderr, "Unable to read %s\n", fileNames[i].c_str());
+			return;
+		}
+		if (song.chords.empty()) {
+			fprintf(stderr, "No chord found in %s\n", fileNames[i].c_str());
+			return;
+		}
+		save::SaveSongToFile(song, (std::filesystem::path(outputDirectory) / (save::GetFileName(song.title) + ".gp")).string());
+		written++;
+	}, threads);
+	return written;
+}
+
+std::size_t ExportFiles(const std::vector<save::Song>& songs, const std::string& directory, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	std::atomic<std::size_t> next{ 0 };
+	std::atomic<std::size_t> written{ 0 };
+	if (threads == 0)
+		threads = parallel::GetThreadCount();
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(songs.size(), 1)));
+	parallel::RunWorkers(threads, [&](unsigned) {
+		GP_ALLOC_TAG(Save);
+		// one text per worker, grown to the longest of its songs
+		std::string text;
+		std::string fileName;
+		for (std::size_t i = next++; i < songs.size(); i = next++) {
+			WriteSong(songs[i], text);
+			fileName = directory;
+			fileName += '/';
+			fileName += save::GetFileName(songs[i].title);
+			fileName += ".cho";
+			if (WriteText(text, fileName))
+				written++;
+		}
+	});
+	return written;
+}
+
+} // namespace chordpro
+} // namespace gpgui
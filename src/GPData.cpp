@@ -2,6 +2,7 @@
 
 #include <GL/glew.h>
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
@@ -13,7 +14,19 @@ namespace data {
 #endif
 
 VertexData GetRectData(float x, float y, float dx, float dy, float color) {
-	return {
+	VertexData vertexData;
+	AppendRectData(vertexData, x, y, dx, dy, color);
+	return vertexData;
+}
+
+VertexData GetCircleData(float centerX, float centerY, float radius, float color, int precision) {
+	VertexData vertexData;
+	AppendCircleData(vertexData, centerX, centerY, radius, color, precision);
+	return vertexData;
+}
+
+void AppendRectData(VertexData& vertexData, float x, float y, float dx, float dy, float color) {
+	vertexData.insert(vertexData.end(), {
 		dx, dy, color,
 		x, dy, color,
 		dx, y, color,
@@ -21,12 +34,11 @@ VertexData GetRectData(float x, float y, float dx, float dy, float color) {
 		x, dy, color,
 		x, y, color,
 		dx, y, color,
-	};
+	});
 }
 
-VertexData GetCircleData(float centerX, float centerY, float radius, float color, int precision) {
-	VertexData vertexData;
-	vertexData.reserve(9 * precision);
+void AppendCircleData(VertexData& vertexData, float centerX, float centerY, float radius, float color, int precision) {
+	vertexData.reserve(vertexData.size() + 9 * precision);
 
 	for (int i = 0; i < precision; i++) {
 		float theta = 2.0f * M_PI * float(i) / float(precision); // get the current angle
@@ -44,8 +56,6 @@ VertexData GetCircleData(float centerX, float centerY, float radius, float color
 			dx + centerX, dy + centerY, color,
 		});
 	}
-
-	return vertexData;
 }
 
 float GetIntColor(const Color& color) {
@@ -92,5 +102,78 @@ void DrawVertexData(const DrawData& vertexData) {
 	glBindVertexArray(0);
 }
 
+SortKey MakeSortKey(DrawState state, Layer layer, std::uint16_t order) {
+	return static_cast<SortKey>(state) << 24 | static_cast<SortKey>(layer) << 16 | order;
+}
+
+static DrawState GetKeyState(SortKey key) {
+	return DrawState(key >> 24);
+}
+
+void InitBatch(Batch& batch) {
+	batch.drawData = GetDrawData({});
+	batch.capacity = 0;
+}
+
+void BatchBegin(Batch& batch) {
+	batch.vertices.clear();
+	batch.entries.clear();
+}
+
+void BatchSubmit(Batch& batch, SortKey key, const VertexData& vertexData) {
+	batch.entries.push_back({ key, batch.vertices.size(), vertexData.size() });
+	batch.vertices.insert(batch.vertices.end(), vertexData.begin(), vertexData.end());
+}
+
+void BatchEnd(Batch& batch) {
+	// in submission order for equal keys, std::stable_sort would allocate its buffer at every rebuild
+	std::sort(batch.entries.begin(), batch.entries.end(), [](const BatchEntry& a, const BatchEntry& b) {
+		return a.key != b.key ? a.key < b.key : a.first < b.first;
+	});
+
+	batch.sortedVertices.clear();
+	batch.stateRanges.clear();
+	for (const BatchEntry& entry : batch.entries) {
+		DrawState state = GetKeyState(entry.key);
+		if (batch.stateRanges.empty() || batch.stateRanges.back().first != state)
+			batch.stateRanges.push_back({ state, 0 });
+		batch.stateRanges.back().second += entry.count / 3;
+
+		auto begin = batch.vertices.begin() + entry.first;
+		batch.sortedVertices.insert(batch.sortedVertices.end(), begin, begin + entry.count);
+	}
+	batch.uploaded = false;
+}
+
+static void BatchUpload(Batch& batch) {
+	std::size_t byteSize = batch.sortedVertices.size() * sizeof(float);
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch.drawData.vbo);
+	if (byteSize > batch.capacity) {
+		// growing the buffer, with some room for the next updates
+		batch.capacity = byteSize * 2;
+		glBufferData(GL_ARRAY_BUFFER, batch.capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_ARRAY_BUFFER, 0, byteSize, batch.sortedVertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	batch.drawData.vertexCount = batch.sortedVertices.size() / 3;
+	batch.stats.bytesUploaded += byteSize;
+	batch.uploaded = true;
+}
+
+void BatchDraw(Batch& batch) {
+	if (!batch.uploaded)
+		BatchUpload(batch);
+	// the vao is left bound, the next draws (ImGui) bind their own
+	glBindVertexArray(batch.drawData.vao);
+	std::size_t first = 0;
+	for (const auto& [state, count] : batch.stateRanges) {
+		glDrawArrays(GL_TRIANGLES, first, count);
+		first += count;
+		batch.stats.drawCalls++;
+	}
+}
+
 } // namespace data
 } // namespace gpgui
@@ -0,0 +1,107 @@
+#include "GPFft.h"
+#include "GPSimd.h"
+
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace gpgui {
+namespace fft {
+
+static constexpr double PI = 3.14159265358979323846;
+
+Plan::Plan(int size) : m_Size(size) {
+	assert(size >= 2 && (size & (size - 1)) == 0);
+
+	int bits = 0;
+	while ((1 << bits) < size) {
+		bits++;
+	}
+	for (int i = 0; i < size; i++) {
+		int reversed = 0;
+		for (int bit = 0; bit < bits; bit++) {
+			reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+		}
+		if (i < reversed)
+			m_Swaps.emplace_back(i, reversed);
+	}
+
+	m_TwiddleReal.resize(size - 1);
+	m_TwiddleImaginary.resize(size - 1);
+	for (int half = 1; half < size; half *= 2) {
+		for (int j = 0; j < half; j++) {
+			double angle = -PI * j / half;
+			m_TwiddleReal[half - 1 + j] = static_cast<float>(std::cos(angle));
+			m_TwiddleImaginary[half - 1 + j] = static_cast<float>(std::sin(angle));
+		}
+	}
+}
+
+void Plan::Forward(float* real, float* imaginary) const {
+	for (const std::pair<int, int>& swap : m_Swaps) {
+		std::swap(real[swap.first], real[swap.second]);
+		std::swap(imaginary[swap.first], imaginary[swap.second]);
+	}
+
+	// first stages, narrower than a vector
+	int half = 1;
+	for (; half < m_Size && half < simd::WIDTH; half *= 2) {
+		const float* twiddleReal = m_TwiddleReal.data() + half - 1;
+		const float* twiddleImaginary = m_TwiddleImaginary.data() + half - 1;
+		for (int start = 0; start < m_Size; start += 2 * half) {
+			for (int j = 0; j < half; j++) {
+				int a = start + j;
+				int b = a + half;
+				float tr = real[b] * twiddleReal[j] - imaginary[b] * twiddleImaginary[j];
+				float ti = real[b] * twiddleImaginary[j] + imaginary[b] * twiddleReal[j];
+				real[b] = real[a] - tr;
+				imaginary[b] = imaginary[a] - ti;
+				real[a] += tr;
+				imaginary[a] += ti;
+			}
+		}
+	}
+
+	// the butterflies of a group are contiguous, so are their twiddles
+	for (; half < m_Size; half *= 2) {
+		const float* twiddleReal = m_TwiddleReal.data() + half - 1;
+		const float* twiddleImaginary = m_TwiddleImaginary.data() + half - 1;
+		for (int start = 0; start < m_Size; start += 2 * half) {
+			float* ar = real + start;
+			float* ai = imaginary + start;
+			float* br = ar + half;
+			float* bi = ai + half;
+			for (int j = 0; j < half; j += simd::WIDTH) {
+				simd::Float wr = simd::LoadUnaligned(twiddleReal + j);
+				simd::Float wi = simd::LoadUnaligned(twiddleImaginary + j);
+				simd::Float xr = simd::LoadUnaligned(br + j);
+				simd::Float xi = simd::LoadUnaligned(bi + j);
+				simd::Float tr = simd::Sub(simd::Mul(xr, wr), simd::Mul(xi, wi));
+				simd::Float ti = simd::MulAdd(xr, wi, simd::Mul(xi, wr));
+				simd::Float yr = simd::LoadUnaligned(ar + j);
+				simd::Float yi = simd::LoadUnaligned(ai + j);
+				simd::StoreUnaligned(br + j, simd::Sub(yr, tr));
+				simd::StoreUnaligned(bi + j, simd::Sub(yi, ti));
+				simd::StoreUnaligned(ar + j, simd::Add(yr, tr));
+				simd::StoreUnaligned(ai + j, simd::Add(yi, ti));
+			}
+		}
+	}
+}
+
+std::vector<float> GetHannWindow(int size) {
+	std::vector<float> window(size);
+	for (int i = 0; i < size; i++) {
+		window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * PI * i / size));
+	}
+	return window;
+}
+
+void GetPowerSpectrum(const float* real, const float* imaginary, int size, float* power) {
+	for (int k = 0; k <= size / 2; k++) {
+		power[k] = real[k] * real[k] + imaginary[k] * imaginary[k];
+	}
+}
+
+} // namespace fft
+} // namespace gpgui
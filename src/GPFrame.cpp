@@ -0,0 +1,41 @@
+#include "GPFrame.h"
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+
+namespace gpgui {
+namespace frame {
+
+// ImGui needs a few frames to settle after an input (hover, popups, ...)
+static constexpr int REDRAW_FRAMES = 3;
+
+static std::atomic<int> pendingFrames{ REDRAW_FRAMES };
+static std::atomic<int> runningAnimations{ 0 };
+
+void RequestRedraw() {
+	if (pendingFrames.exchange(REDRAW_FRAMES) == 0)
+		glfwPostEmptyEvent();  // wakes up the main loop if it is waiting
+}
+
+void BeginAnimation() {
+	if (runningAnimations.fetch_add(1) == 0)
+		glfwPostEmptyEvent();
+}
+
+void EndAnimation() {
+	runningAnimations.fetch_sub(1);
+	RequestRedraw();  // draw the last state
+}
+
+bool NeedsRedraw() {
+	return pendingFrames.load() > 0 || runningAnimations.load() > 0;
+}
+
+void FrameRendered() {
+	int frames = pendingFrames.load();
+	while (frames > 0 && !pendingFrames.compare_exchange_weak(frames, frames - 1)) {}
+}
+
+} // namespace frame
+} // namespace gpgui
@@ -1,15 +1,28 @@
 #include "GPGui.h"
+#include "GPAudio.h"
 #include "GPMusic.h"
 #include "GPRenderer.h"
 #include "GPData.h"
+#include "GPJobs.h"
+#include "GPMemory.h"
+#include "GPProfiler.h"
+#include "GPProgression.h"
 #include "GPSave.h"
+#include "GPSearch.h"
+#include "GPSimilarity.h"
+#include "GPSongbook.h"
+#include "GPTrace.h"
+#include "GPTuner.h"
 
 #include "imgui.h"
 
 #include <algorithm>
+#include <array>
 #include <memory>
 #include <filesystem>
 #include <cmath>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace fs = std::filesystem;
 
@@ -41,20 +54,65 @@ static int currentOctave = 2;
 static std::vector<SongPtr> loadedSongs;
 static SongPtr editSong = nullptr;
 
+// ids of a loaded song in the indexes, updated at every edit
+struct SongIds {
+	progression::SongId progression;
+	similarity::SongId similarity;
+	search::TitleId title;
+	std::uint64_t content;  // save::HashSong
+};
+static std::unordered_map<const Song*, SongIds> songIds;
+// Loaded songs of each content, more than one being duplicates whatever their title
+static std::unordered_map<std::uint64_t, int> contentCounts;
+
+static progression::Index progressionIndex;
+static char progressionQuery[128] = "";
+static bool progressionValid = true;
+static std::vector<save::ChordSave> progressionChords;
+static std::vector<progression::SongId> foundIds;
+
+static search::TitleIndex titleIndex;
+static std::vector<SongPtr> titleRows;  // loaded song of every title, null once deleted
+static char titleQuery[128] = "";
+static std::vector<search::Match> titleMatches;
+static constexpr std::size_t TITLE_MATCHES = 500;
+
+static bool searchDirty = false;  // songs edited since the last search
+static std::vector<SongPtr> foundSongs;
+
+static similarity::Index similarityIndex;
+static std::vector<SongPtr> similarityRows;  // loaded song of every row, null once deleted
+static std::vector<similarity::Match> similarMatches;
+static const Song* similarSource = nullptr;  // song of the matches
+static bool similarDirty = false;
+static constexpr std::size_t SIMILAR_SONGS = 5;
+
+static music::AnalysisCache analysisCache;
+static const Song* analyzedSong = nullptr;
+static std::uint64_t analyzedHash = 0;  // content of the song when analyzed
+static music::Key analyzedKey;
+static std::string analyzedNumerals;
+
+static float volume = 0.3f;
+static int tempo = 90;
+// chord of the edited song being played, -1 when stopped
+static int playedChord = -1;
+
+// last pitch heard by the tuner, and the last deviation of every string
+static tuner::Reading tunerReading;
+static bool tunerHearing = false;
+static std::array<float, 6> stringCents{};
+static std::array<bool, 6> stringHeard{};
+static bool captureFailed = false;
+
 constexpr ImVec4 SAVE_COLOR{ 0, 0.5, 0, 1 };
 constexpr ImVec4 SAVE_HOVERED_COLOR{ 0, 0.7, 0, 1 };
 
 constexpr ImVec4 DELETE_COLOR{ 0.5, 0, 0, 1 };
 constexpr ImVec4 DELETE_HOVERED_COLOR{ 0.7, 0, 0, 1 };
 
-static void ApplyPianoChord(ChordType ct, std::uint8_t note, int octave, const ChordOffsets& notes) {
-	renderer::ClearKeyboard();
-	for (int i = 0; i < notes.size(); i++) {
-		if (notes[i] == data::EMPTY_NOTE)
-			continue;
-		renderer::SetKeyHighlight(notes[i], true);
-	}
-}
+constexpr float SONG_FRAME_WIDTH = 200;
+constexpr float SONG_FRAME_HEIGHT = 190;
 
 static void ApplyTab(const Tab& tab) {
 	renderer::ClearTab();
@@ -67,72 +125,154 @@ static void ApplyTabPreview(const Tab& tab) {
 	ApplyTab(tab);
 	renderer::ClearKeyboard();
 	for (int i = 0; i < tab.size(); i++) {
-		if (tab[i] == data::EMPTY_TAB)
-			continue;
-
-		if (tab[i] == 0) {
-			renderer::SetKeyHighlight(music::GetStringOffset(i) + currentCapo, true);
-		} else {
-			renderer::SetKeyHighlight(music::GetStringOffset(i) + tab[i], true);
+		int key = music::GetStringKey(i, tab[i], currentCapo);
+		if (key >= 0) {
+			renderer::SetKeyHighlight(key, true);
 		}
 	}
 }
 
-static Tab GetTabChord(ChordType ct, std::uint8_t note, const ChordOffsets& notes) {
-	if (pianoChordOnGuitar) {
-		return music::FindPianoChord(notes, currentCapo, currentChord.fretMax);
-	} else {
-		return music::FindChord(music::GetChord(Note(note), ct), currentCapo);
+static void ApplyChord(bool sound) {
+	ChordOffsets notes = music::GetChordNotes(currentChord);
+
+	renderer::ClearKeyboard();
+	for (int i = 0; i < notes.size(); i++) {
+		if (notes[i] == data::EMPTY_NOTE)
+			continue;
+		renderer::SetKeyHighlight(notes[i], true);
+	}
+	Tab tab = music::GetChordTab(currentChord, notes, currentCapo);
+	ApplyTab(tab);
+
+	renderer::UpdateBuffers();
+
+	if (sound) {
+		audio::PlayChord(notes, tab, currentCapo);
 	}
 }
 
-static void ApplyGuitarChord(ChordType ct, std::uint8_t note, int octave, const ChordOffsets& notes) {
-	Tab tab = GetTabChord(ct, note, notes);
-	ApplyTab(tab);
+static void RefreshRendering(bool sound = true) {
+	if (currentChord.note != Note::TOTAL && currentChord.type != ChordType::COUNT)
+		ApplyChord(sound);
 }
 
-static void InverseChord(ChordOffsets& notes) {
-	for (int i = 0; i < currentChord.inversion; i++) {
-		std::uint8_t lastNote = notes[notes[3] == data::EMPTY_NOTE ? 2 : 3] - 12;
-		std::uint8_t count = notes[3] == data::EMPTY_NOTE ? 2 : 3;
-		for (int j = count; j > 0; j--) {
-			notes[j] = notes[j - 1];
-		}
-		notes[0] = lastNote;
-	}
+// Shows the chord of the song heard, the audio thread plays it
+static void FollowPlayback() {
+	int chord = audio::UpdatePlayback();
+	if (chord == playedChord)
+		return;
+	playedChord = chord;
+	if (chord < 0 || editSong == nullptr || chord >= static_cast<int>(editSong->chords.size()))
+		return;
+	currentChord = editSong->chords[chord];
+	RefreshRendering(false);
 }
 
-static ChordOffsets OffsetsToNote(const ChordOffsets& offsets, int octave) {
-	ChordOffsets notes;
-	for (int i = 0; i < offsets.size(); i++) {
-		if (offsets[i] == data::EMPTY_NOTE) {
-			notes[i] = data::EMPTY_NOTE;
+// Every reading of the hops since the last frame, the needle shows the newest
+static void FollowTuner() {
+	tuner::Reading reading;
+	while (tuner::PopReading(reading)) {
+		tunerHearing = reading.valid;
+		if (!reading.valid)
 			continue;
-		}
-		notes[i] = currentChord.note + offsets[i] + 12 * octave;
+		tunerReading = reading;
+		stringCents[reading.string] = reading.cents;
+		stringHeard[reading.string] = true;
 	}
-	return notes;
+	if (!tuner::IsRunning())
+		tunerHearing = false;
 }
 
-static void ApplyChord(ChordType ct, std::uint8_t note, int octave) {
-	ChordOffsets offsets = GetChordOffsets(Note(note), ct);
-	ChordOffsets notes = OffsetsToNote(offsets, octave);
+static void RemoveContent(std::uint64_t content) {
+	auto it = contentCounts.find(content);
+	if (it != contentCounts.end() && --it->second == 0)
+		contentCounts.erase(it);
+}
 
-	InverseChord(notes);
-	ApplyPianoChord(ct, note, octave, notes);
-	ApplyGuitarChord(ct, note, octave, notes);
+static void IndexSong(const SongPtr& song) {
+	const std::uint64_t content = save::HashSong(*song);
+	auto it = songIds.find(song.get());
+	if (it == songIds.end()) {
+		SongIds ids{ progressionIndex.Add(song->chords), similarityIndex.Add(*song), titleIndex.Add(song->title), content };
+		songIds.emplace(song.get(), ids);
+		similarityRows.push_back(song);
+		titleRows.push_back(song);
+	} else {
+		progressionIndex.Update(it->second.progression, song->chords);
+		similarityIndex.Update(it->second.similarity, *song);
+		RemoveContent(it->second.content);
+		it->second.content = content;
+	}
+	contentCounts[content]++;
+	searchDirty = true;
+	similarDirty = true;
+}
 
-	renderer::UpdateBuffers();
+static void UnindexSong(const SongPtr& song) {
+	auto it = songIds.find(song.get());
+	if (it == songIds.end())
+		return;
+	progressionIndex.Remove(it->second.progression);
+	similarityIndex.Remove(it->second.similarity);
+	similarityRows[it->second.similarity] = nullptr;
+	titleIndex.Remove(it->second.title);
+	titleRows[it->second.title] = nullptr;
+	RemoveContent(it->second.content);
+	songIds.erase(it);
+	searchDirty = true;
+	similarDirty = true;
 }
 
-static void RefreshRendering() {
-	if (currentChord.note != Note::TOTAL && currentChord.type != ChordType::COUNT)
-		ApplyChord(currentChord.type, static_cast<std::uint8_t>(currentChord.note), currentChord.octave);
+static bool IsSearchingProgression() {
+	return progressionQuery[0] != '\0';
+}
+
+static bool IsSearchingTitle() {
+	return titleQuery[0] != '\0';
+}
+
+static bool IsSearching() {
+	return IsSearchingProgression() || IsSearchingTitle();
+}
+
+static bool HasProgression(const SongPtr& song) {
+	auto it = songIds.find(song.get());
+	return it != songIds.end() && std::binary_search(foundIds.begin(), foundIds.end(), it->second.progression);
+}
+
+// The songs whose title matches, best first, or else in the order of the list. Both searches narrow the songs.
+static void SearchSongs() {
+	GP_TRACE_FUNCTION();
+	searchDirty = false;
+	foundSongs.clear();
+	if (!IsSearching())
+		return;
+	if (IsSearchingProgression()) {
+		progressionValid = progression::ParseProgression(progressionQuery, progressionChords);
+		if (!progressionValid)
+			return;
+		progressionIndex.Find(progressionChords, foundIds);
+	}
+	if (!IsSearchingTitle()) {
+		for (const SongPtr& song : loadedSongs) {
+			if (HasProgression(song))
+				foundSongs.push_back(song);
+		}
+		return;
+	}
+	// every match when the progression filters them
+	const std::size_t maxMatches = IsSearchingProgression() ? titleIndex.GetTitleCount() : TITLE_MATCHES;
+	titleIndex.Find(titleQuery, maxMatches, titleMatches);
+	for (const search::Match& match : titleMatches) {
+		const SongPtr& song = titleRows[match.title];
+		if (!IsSearchingProgression() || HasProgression(song))
+			foundSongs.push_back(song);
+	}
 }
 
 static void RenderChordButtons(ChordType ct) {
 	for (int i = 0; i < Note::TOTAL; i++) {
-		if (ImGui::Button(ToString(Note(i)).c_str())) {
+		if (ImGui::Button(music::GetName(Note(i)).data())) {
 			currentChord.note = Note(i);
 			currentChord.type = ct;
 			RefreshRendering();
@@ -155,7 +295,7 @@ static void RenderChordButtons(ChordType ct) {
 		RefreshRendering();
 	}
 	if (currentChord.note != Note::TOTAL) {
-		ImGui::Text("Accord actuel : %s %s", ToString(Note(currentChord.note)).c_str(), ToString(ct).c_str());
+		ImGui::Text("Accord actuel : %s %s", music::GetName(currentChord.note).data(), music::GetName(ct).data());
 	}
 }
 
@@ -164,8 +304,8 @@ static void RenderChordsTab() {
 		ImGui::BeginTabBar("Chords");
 		for (int i = 0; i < static_cast<int>(ChordType::COUNT); i++) {
 			ChordType ct = ChordType(i);
-			if (ImGui::BeginTabItem(ToString(ct).c_str())) {
-				ImGui::Text("%s :", ToString(ct).c_str());
+			if (ImGui::BeginTabItem(music::GetName(ct).data())) {
+				ImGui::Text("%s :", music::GetName(ct).data());
 				RenderChordButtons(ct);
 				ImGui::EndTabItem();
 			}
@@ -175,6 +315,7 @@ static void RenderChordsTab() {
 			if (ImGui::Button("Ajouter l'accord")) {
 				if (currentChord.note != Note::TOTAL) {
 					editSong->chords.push_back(currentChord);
+					IndexSong(editSong);
 				}
 			}
 		}
@@ -199,6 +340,18 @@ static void RenderOptions() {
 		if (editSong != nullptr) {
 			ImGui::EndDisabled();
 		}
+		bool soundEnabled = audio::IsRunning();
+		if (ImGui::Checkbox("Son", &soundEnabled)) {
+			if (soundEnabled) {
+				audio::Start(audio::CreateDefaultSink());
+				audio::SetVolume(volume);
+			} else {
+				audio::Stop();
+			}
+		}
+		if (ImGui::SliderFloat("Volume", &volume, 0.0f, 1.0f)) {
+			audio::SetVolume(volume);
+		}
 		ImGui::EndTabItem();
 	}
 }
@@ -206,7 +359,7 @@ static void RenderOptions() {
 static void RenderSaveSongButton(const SongPtr& song) {
 	ImGui::PushStyleColor(ImGuiCol_Button, SAVE_COLOR);
 	ImGui::PushStyleColor(ImGuiCol_ButtonHovered, SAVE_HOVERED_COLOR);
-	if (ImGui::Button(std::string("Enregistrer##" + song->title).c_str())) {
+	if (ImGui::Button("Enregistrer")) {
 		Song saveSong = *song;
 		save::SaveSongToFile(saveSong, saveSong.title + ".gp");
 	}
@@ -218,16 +371,14 @@ static bool RenderDeleteSongButton(const SongPtr& song) {
 		return false;
 
 
-	const std::string popupId = "DeleteSongConfirm" + song->title;
-
 	bool deleted = false;
 
 	ImGui::PushStyleColor(ImGuiCol_Button, DELETE_COLOR);
 	ImGui::PushStyleColor(ImGuiCol_ButtonHovered, DELETE_HOVERED_COLOR);
-	if (ImGui::Button(std::string("Supprimer##" + song->title).c_str())) {
-		ImGui::OpenPopup(popupId.c_str());
+	if (ImGui::Button("Supprimer")) {
+		ImGui::OpenPopup("DeleteSongConfirm");
 	}
-	if (ImGui::BeginPopup(popupId.c_str())) {
+	if (ImGui::BeginPopup("DeleteSongConfirm")) {
 		ImGui::Text("Supprimer ?");
 		if (ImGui::Button("Oui")) {
 			ImGui::CloseCurrentPopup();
@@ -238,6 +389,7 @@ static bool RenderDeleteSongButton(const SongPtr& song) {
 			}
 			auto it = std::find(loadedSongs.begin(), loadedSongs.end(), song);
 			loadedSongs.erase(it);
+			UnindexSong(song);
 		}
 		ImGui::PopStyleColor(2);
 		ImGui::SameLine();
@@ -254,33 +406,105 @@ static bool RenderDeleteSongButton(const SongPtr& song) {
 	return deleted;
 }
 
+static void SelectSong(const SongPtr& song) {
+	editSong = song;
+	currentCapo = song->capo;
+	renderer::SetCapoPos(currentCapo);
+	RefreshRendering();
+}
+
+static bool IsDuplicate(const SongPtr& song) {
+	auto it = songIds.find(song.get());
+	return it != songIds.end() && contentCounts[it->second.content] > 1;
+}
+
+static bool RenderSongRow(const SongPtr& song) {
+	ImGui::Text("%s (capo %i)", song->title.c_str(), song->capo);
+	ImGui::SameLine();
+	if (IsDuplicate(song)) {
+		ImGui::TextDisabled("(doublon)");
+		ImGui::SameLine();
+	}
+	if (song == editSong) {
+		ImGui::BeginDisabled();
+		ImGui::Button("Séléctionnée");
+		ImGui::EndDisabled();
+	} else {
+		if (ImGui::Button("Sélectionner")) {
+			SelectSong(song);
+		}
+	}
+	ImGui::SameLine();
+	RenderSaveSongButton(song);
+	ImGui::SameLine();
+	return RenderDeleteSongButton(song);
+}
+
 static void RenderSongs() {
 	if (loadedSongs.empty()) {
 		ImGui::Text("Aucune chanson chargée");
 		return;
 	}
+	if (searchDirty && IsSearching())
+		SearchSongs();
+	const std::vector<SongPtr>& songs = IsSearching() ? foundSongs : loadedSongs;
+	if (songs.empty()) {
+		if (IsSearchingProgression() && !progressionValid)
+			ImGui::Text("Progression non reconnue");
+		else if (IsSearchingTitle())
+			ImGui::Text("Aucune chanson trouvée");
+		else
+			ImGui::Text("Aucune chanson ne contient cette progression");
+		return;
+	}
 	ImGui::BeginChild("Songs");
-	for (auto& song : loadedSongs) {
-		ImGui::Text("%s (capo %i)", song->title.c_str(), song->capo);
-		ImGui::SameLine();
-		if (song == editSong) {
-			ImGui::BeginDisabled();
-			ImGui::Button("Séléctionnée");
-			ImGui::EndDisabled();
+	// only the visible rows are submitted
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(songs.size()));
+	bool deleted = false;
+	while (!deleted && clipper.Step()) {
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+			SongPtr song = songs[i];  // copied, the row may delete it
+			// ids are scoped by song, without building labels every frame
+			ImGui::PushID(song.get());
+			deleted = RenderSongRow(song);
+			ImGui::PopID();
+			if (deleted)
+				break;
+		}
+	}
+	clipper.End();
+	ImGui::EndChild();
+}
+
+// The songs nearest the selected one in chord types, root moves and capo, whatever their key
+static void RenderSimilarSongs() {
+	if (editSong == nullptr || !ImGui::CollapsingHeader("Chansons similaires"))
+		return;
+	if (similarDirty || similarSource != editSong.get()) {
+		similarDirty = false;
+		similarSource = editSong.get();
+		auto it = songIds.find(editSong.get());
+		if (it != songIds.end()) {
+			similarityIndex.FindSimilar(it->second.similarity, SIMILAR_SONGS, similarMatches);
 		} else {
-			if (ImGui::Button(std::string("Sélectionner##" + song->title).c_str())) {
-				editSong = song;
-				currentCapo = song->capo;
-				renderer::SetCapoPos(currentCapo);
-				RefreshRendering();
-			}
+			similarMatches.clear();
 		}
+	}
+	if (similarMatches.empty()) {
+		ImGui::TextDisabled("Aucune chanson proche de %s", editSong->title.c_str());
+		return;
+	}
+	for (const similarity::Match& match : similarMatches) {
+		SongPtr song = similarityRows[match.song];  // copied, selecting it changes the matches
+		ImGui::PushID(song.get());
+		ImGui::Text("%3.0f %%  %s (capo %i)", match.score * 100, song->title.c_str(), song->capo);
 		ImGui::SameLine();
-		RenderSaveSongButton(song);
-		ImGui::SameLine();
-		RenderDeleteSongButton(song);
+		if (ImGui::SmallButton("Sélectionner")) {
+			SelectSong(song);
+		}
+		ImGui::PopID();
 	}
-	ImGui::EndChild();
 }
 
 static void RenderNewSongPopup() {
@@ -292,6 +516,7 @@ static void RenderNewSongPopup() {
 		songCapo = std::clamp(songCapo, CAPO_MIN, CAPO_MAX);
 		if (ImGui::Button("Créer une nouvelle chanson")) {
 			loadedSongs.push_back(std::make_shared<Song>(buffer, static_cast<save::CapoPosType>(songCapo)));
+			IndexSong(loadedSongs.back());
 			// resetting buffers
 			songCapo = 0;
 			std::fill(std::begin(buffer), std::end(buffer), 0);
@@ -302,24 +527,50 @@ static void RenderNewSongPopup() {
 	}
 }
 
-static void AddSongsInDirectory() {
-	for (const auto& entry : fs::directory_iterator(".")) {
-		auto path = entry.path();
-		if (path.extension().string() == ".gp") {
-			std::string fileName = path.filename().string();
-			Song newSong = save::LoadSongFromFile(fileName);
-			if (newSong.title.empty())
-				continue;
-
-			auto it = std::find_if(loadedSongs.begin(), loadedSongs.end(), [&newSong](SongPtr song) {
-				return newSong.title == song->title;
-			});
-
-			if (it == loadedSongs.end()) { // add only if does not already exist
-				loadedSongs.push_back(std::make_shared<Song>(newSong));
-			}
+// Only the files added or modified since the last scan are read, by one scan at a time
+static save::ScanCache scanCache;
+static bool scanning = false;
+static jobs::Group scanGroup;
+
+static void AddScannedSongs(std::vector<Song>& scannedSongs) {
+	GP_TRACE_FUNCTION();
+	if (scannedSongs.empty())
+		return;
+	std::unordered_set<std::string_view> titles;
+	for (const SongPtr& song : loadedSongs) {
+		titles.insert(song->title);
+	}
+	std::vector<const Song*> newSongs;
+	for (Song& newSong : scannedSongs) {
+		if (titles.count(newSong.title) == 0) { // add only if does not already exist
+			loadedSongs.push_back(std::make_shared<Song>(std::move(newSong)));
+			IndexSong(loadedSongs.back());
+			newSongs.push_back(loadedSongs.back().get());
 		}
 	}
+	// selecting a song then finds its analysis
+	std::vector<const music::SongAnalysis*> analyses;
+	analysisCache.AnalyzeSongs(newSongs, analyses);
+}
+
+static void AddSongsInDirectory() {
+	GP_TRACE_FUNCTION();
+	std::vector<Song> scannedSongs = scanCache.Scan(".");
+	AddScannedSongs(scannedSongs);
+}
+
+// The songs are read by a job, then added on the main thread
+static void ScanSongsInBackground() {
+	if (scanning)
+		return;
+	scanning = true;
+	jobs::Schedule("ScanLibrary", []() {
+		auto scannedSongs = std::make_shared<std::vector<Song>>(scanCache.Scan("."));
+		jobs::PostToMainThread([scannedSongs]() {
+			AddScannedSongs(*scannedSongs);
+			scanning = false;
+		});
+	}, &scanGroup);
 }
 
 static void RenderSongsTab() {
@@ -330,9 +581,33 @@ static void RenderSongsTab() {
 		RenderNewSongPopup();
 		ImGui::SameLine();
 		if (ImGui::Button("Actualiser")) {
-			AddSongsInDirectory();
+			ScanSongsInBackground();
+		}
+		if (scanning) {
+			ImGui::SameLine();
+			ImGui::TextDisabled("Lecture des chansons...");
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Exporter le recueil")) {
+			std::vector<Song> songs;
+			for (const SongPtr& song : loadedSongs) {
+				songs.push_back(*song);
+			}
+			songbook::ExportSongbook(songs, "recueil.pdf", {});
+		}
+		// typos allowed, the list updated at every key
+		ImGui::SetNextItemWidth(250);
+		if (ImGui::InputTextWithHint("Titre", "Rechercher une chanson", titleQuery, sizeof(titleQuery))) {
+			SearchSongs();
+		}
+		ImGui::SameLine();
+		// in any key : "I V vi IV" also finds the songs in D or in A
+		ImGui::SetNextItemWidth(250);
+		if (ImGui::InputTextWithHint("Progression", "I V vi IV ou C G Am F", progressionQuery, sizeof(progressionQuery))) {
+			SearchSongs();
 		}
 		ImGui::Separator();
+		RenderSimilarSongs();
 		RenderSongs();
 		ImGui::EndTabItem();
 	}
@@ -344,52 +619,122 @@ unsigned int HashTab(const Tab& tab) {
 		| tab[5] & 0xF);
 }
 
-static void RenderSongFrames() {
-	static int eraseIndex = 0;
-	for (int i = 0; i < editSong->chords.size(); i++) {
-		ImGui::BeginChildFrame(100 + i * 100, ImVec2(200, 190));
-		ImGui::Text(music::ToString(editSong->chords[i]).c_str());
-		if (i > 0) {
-			if (ImGui::Button("<-")) {
-				auto previousTab = editSong->chords[i - 1];
-				editSong->chords[i - 1] = editSong->chords[i];
-				editSong->chords[i] = previousTab;
-			}
-			ImGui::SameLine();
+// returns true if the chord was erased
+static bool RenderSongFrame(int i) {
+	ImGui::BeginChildFrame(100 + i * 100, ImVec2(SONG_FRAME_WIDTH, SONG_FRAME_HEIGHT));
+	const ChordSave& chord = editSong->chords[i];
+	ImGui::Text("%s %s", music::GetName(chord.note).data(), music::GetName(chord.type).data());
+	if (i > 0) {
+		if (ImGui::Button("<-")) {
+			auto previousTab = editSong->chords[i - 1];
+			editSong->chords[i - 1] = editSong->chords[i];
+			editSong->chords[i] = previousTab;
+			IndexSong(editSong);
 		}
-		if (i < editSong->chords.size() - 1) {
-			if (ImGui::Button("->")) {
-				auto nextTab = editSong->chords[i + 1];
-				editSong->chords[i + 1] = editSong->chords[i];
-				editSong->chords[i] = nextTab;
-			}
-		} else {
-			ImGui::NewLine();
+		ImGui::SameLine();
+	}
+	if (i < editSong->chords.size() - 1) {
+		if (ImGui::Button("->")) {
+			auto nextTab = editSong->chords[i + 1];
+			editSong->chords[i + 1] = editSong->chords[i];
+			editSong->chords[i] = nextTab;
+			IndexSong(editSong);
 		}
-		if (ImGui::Button("Visualiser")) {
-			currentChord = editSong->chords[i];
-			currentOctave = currentChord.octave;
-			pianoChordOnGuitar = currentChord.guitaroPiano;
-			RefreshRendering();
+	} else {
+		ImGui::NewLine();
+	}
+	if (ImGui::Button("Visualiser")) {
+		currentChord = editSong->chords[i];
+		currentOctave = currentChord.octave;
+		pianoChordOnGuitar = currentChord.guitaroPiano;
+		RefreshRendering();
+	}
+	if (ImGui::Button("Supprimer")) {
+		ImGui::OpenPopup("EraseTab");
+	}
+	bool erased = false;
+	if (ImGui::BeginPopup("EraseTab")) {
+		ImGui::Text("Supprimer ?");
+		if (ImGui::Button("Oui")) {
+			editSong->chords.erase(editSong->chords.begin() + i);
+			IndexSong(editSong);
+			erased = true;
+			ImGui::CloseCurrentPopup();
 		}
-		if (ImGui::Button("Supprimer")) {
-			ImGui::OpenPopup("EraseTab");
+		ImGui::SameLine();
+		if (ImGui::Button("Non")) {
+			ImGui::CloseCurrentPopup();
 		}
-		if (ImGui::BeginPopup("EraseTab")) {
-			ImGui::Text("Supprimer ?");
-			if (ImGui::Button("Oui")) {
-				editSong->chords.erase(editSong->chords.begin() + i);
-				ImGui::CloseCurrentPopup();
-			}
-			ImGui::SameLine();
-			if (ImGui::Button("Non")) {
-				ImGui::CloseCurrentPopup();
+		ImGui::EndPopup();
+	}
+	ImGui::EndChildFrame();
+	return erased;
+}
+
+static void RenderSongFrames() {
+	// horizontal clipping : only the frames inside the visible part of the scroll area are submitted
+	const float stride = SONG_FRAME_WIDTH + ImGui::GetStyle().ItemSpacing.x;
+	const int chordCount = static_cast<int>(editSong->chords.size());
+	const ImVec2 start = ImGui::GetCursorPos();
+	const float scrollX = ImGui::GetScrollX();
+
+	int first = std::clamp(static_cast<int>((scrollX - start.x) / stride), 0, chordCount);
+	int last = std::clamp(static_cast<int>((scrollX + ImGui::GetWindowWidth() - start.x) / stride) + 1, first, chordCount);
+	for (int i = first; i < last; i++) {
+		ImGui::SetCursorPos(ImVec2(start.x + i * stride, start.y));
+		if (RenderSongFrame(i))
+			break;
+	}
+
+	// the whole timeline is still reserved for the scrollbar
+	ImGui::SetCursorPos(start);
+	ImGui::Dummy(ImVec2(chordCount * stride, SONG_FRAME_HEIGHT));
+}
+
+static void RenderPlaybackButtons() {
+	if (!audio::IsRunning()) {
+		ImGui::TextDisabled("Activez le son dans les options pour écouter");
+		return;
+	}
+	if (audio::IsPlayingSong()) {
+		if (ImGui::Button("Arrêter")) {
+			audio::StopSong();
+		}
+	} else if (ImGui::Button("Écouter")) {
+		audio::PlaySong(*editSong, static_cast<float>(tempo));
+	}
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(150);
+	ImGui::SliderInt("Tempo", &tempo, 40, 200);
+}
+
+// Key and numerals of the chords, analyzed again when the chords change
+static void RenderSongAnalysis() {
+	const std::uint64_t hash = save::HashSong(*editSong);
+	if (analyzedSong != editSong.get() || analyzedHash != hash) {
+		analyzedSong = editSong.get();
+		analyzedHash = hash;
+		const music::SongAnalysis& analysis = analysisCache.Analyze(*editSong);
+		analyzedKey = analysis.key;
+		analyzedNumerals.clear();
+		if (analysis.correlation != 0) {
+			for (const music::Numeral& numeral : analysis.numerals) {
+				analyzedNumerals += analyzedNumerals.empty() ? "" : " ";
+				analyzedNumerals += music::ToString(numeral);
 			}
-			ImGui::EndPopup();
 		}
-		ImGui::EndChildFrame();
-		ImGui::SameLine();
 	}
+	if (analyzedNumerals.empty())
+		return;
+	const char* mode = analyzedKey.minor ? "mineur" : "majeur";
+	if (editSong->capo == 0) {
+		ImGui::Text("Tonalité : %s %s", music::GetName(analyzedKey.tonic).data(), mode);
+	} else {
+		// the chords are stored as heard, the shapes are played lower by the capo
+		const Note shapes = Note((analyzedKey.tonic - editSong->capo + Note::TOTAL) % Note::TOTAL);
+		ImGui::Text("Tonalité : %s %s (formes en %s)", music::GetName(analyzedKey.tonic).data(), mode, music::GetName(shapes).data());
+	}
+	ImGui::TextWrapped("%s", analyzedNumerals.c_str());
 }
 
 static void RenderEditTab() {
@@ -398,18 +743,24 @@ static void RenderEditTab() {
 			ImGui::Text("Sélectionnez une chanson pour commencer");
 		} else {
 			ImGui::Text("Edition de %s (capo %i)", editSong->title.c_str(), editSong->capo);
+			RenderSongAnalysis();
 
 			ImGui::BeginChild("SongContent", {}, false, ImGuiWindowFlags_HorizontalScrollbar);
 			RenderSongFrames();
-			ImGui::NewLine();
+			RenderPlaybackButtons();
+			ImGui::PushID(editSong.get());
 			RenderSaveSongButton(editSong);
 			ImGui::SameLine();
-			if (RenderDeleteSongButton(editSong)) {
+			bool deleted = RenderDeleteSongButton(editSong);
+			ImGui::PopID();
+			if (deleted) {
 				editSong = nullptr;
+				audio::StopSong();
 			}
 			ImGui::SameLine();
 			if (ImGui::Button("Terminé")) {
 				editSong = nullptr;
+				audio::StopSong();
 			}
 			ImGui::SameLine();
 			ImGui::EndChild();
@@ -418,9 +769,152 @@ static void RenderEditTab() {
 	}
 }
 
+// Half dial from -50 to +50 cents, green when the string is in tune
+static void RenderTunerNeedle() {
+	constexpr float RADIUS = 140;
+	constexpr float MAX_CENTS = 50;
+	constexpr float MAX_ANGLE = 1.0471976f;  // 60 degrees on both sides
+	constexpr float IN_TUNE_CENTS = 5;
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImVec2 center(origin.x + RADIUS + 10, origin.y + RADIUS + 10);
+	auto dialPoint = [&](float cents, float radius) {
+		float angle = std::clamp(cents, -MAX_CENTS, MAX_CENTS) / MAX_CENTS * MAX_ANGLE;
+		return ImVec2(center.x + radius * std::sin(angle), center.y - radius * std::cos(angle));
+	};
+	for (int cents = -50; cents <= 50; cents += 10) {
+		float length = cents == 0 ? 20.0f : 10.0f;
+		drawList->AddLine(dialPoint(static_cast<float>(cents), RADIUS - length), dialPoint(static_cast<float>(cents), RADIUS), IM_COL32(200, 200, 200, 255), 2.0f);
+	}
+
+	ImU32 color = IM_COL32(120, 120, 120, 255);  // the last pitch, nothing is heard anymore
+	if (tunerHearing)
+		color = std::abs(tunerReading.cents) < IN_TUNE_CENTS ? IM_COL32(0, 200, 0, 255) : IM_COL32(230, 150, 0, 255);
+	drawList->AddLine(center, dialPoint(tunerReading.cents, RADIUS - 5), color, 3.0f);
+	drawList->AddCircleFilled(center, 6, color);
+	ImGui::Dummy(ImVec2(2 * RADIUS + 20, RADIUS + 20));
+
+	if (tunerReading.valid) {
+		ImGui::Text("%s  %.2f Hz  corde %d  %+.1f cents", music::GetName(music::GetNote(static_cast<std::uint8_t>(tunerReading.key))).data(),
+			tunerReading.frequency, 6 - tunerReading.string, tunerReading.cents);
+	} else {
+		ImGui::TextDisabled("Jouez une corde à vide");
+	}
+}
+
+static void RenderStringDeviations() {
+	for (int string = 5; string >= 0; string--) {
+		ImGui::BeginGroup();
+		ImGui::Text("%d  %s", 6 - string, music::GetName(music::GetNote(static_cast<std::uint8_t>(music::GetStringOffset(string)))).data());
+		if (stringHeard[string])
+			ImGui::Text("%+.1f", stringCents[string]);
+		else
+			ImGui::TextDisabled("-");
+		ImGui::EndGroup();
+		ImGui::SameLine(0, 30);
+	}
+	ImGui::NewLine();
+}
+
+static void RenderTunerTab() {
+	if (ImGui::BeginTabItem("Accordeur")) {
+		bool listening = tuner::IsRunning();
+		if (ImGui::Checkbox("Micro", &listening)) {
+			captureFailed = false;
+			if (listening)
+				captureFailed = !tuner::Start(tuner::CreateCaptureSource());
+			else
+				tuner::Stop();
+		}
+		if (captureFailed) {
+			ImGui::SameLine();
+			ImGui::TextDisabled("Aucun micro disponible");
+		}
+		RenderTunerNeedle();
+		RenderStringDeviations();
+		ImGui::EndTabItem();
+	}
+}
+
+static void RenderPhaseHistory(const char* label, const profiler::History& history) {
+	profiler::PhaseStats stats = profiler::GetStats(history);
+	const char* overlay = memory::FrameFormat("p50 %.2f ms  p99 %.2f ms  max %.2f ms", stats.p50, stats.p99, stats.max);
+	ImGui::PlotHistogram(label, history.data(), static_cast<int>(history.size()), static_cast<int>(profiler::GetHistoryOffset()),
+		overlay, 0.0f, std::max(stats.max, 1.0f), ImVec2(0, 40));
+}
+
+static void RenderProfiler() {
+	if (!ImGui::CollapsingHeader("Profilage"))
+		return;
+	for (int i = 0; i < static_cast<int>(profiler::Phase::COUNT); i++) {
+		profiler::Phase phase = profiler::Phase(i);
+		ImGui::PushID(i);
+		ImGui::Text("%s", profiler::GetPhaseName(phase));
+		RenderPhaseHistory("CPU", profiler::GetCpuHistory(phase));
+		if (profiler::HasGpuTimers() && (phase == profiler::Phase::DrawWidgets || phase == profiler::Phase::ImGuiRender)) {
+			RenderPhaseHistory("GPU", profiler::GetGpuHistory(phase));
+		}
+		ImGui::PopID();
+	}
+}
+
+static void RenderAllocations() {
+	if (!ImGui::CollapsingHeader("Allocations"))
+		return;
+	if (!ImGui::BeginTable("Allocations", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchSame))
+		return;
+	ImGui::TableSetupColumn("Module");
+	ImGui::TableSetupColumn("Allocs/image");
+	ImGui::TableSetupColumn("Octets/image");
+	ImGui::TableSetupColumn("Octets vivants");
+	ImGui::TableSetupColumn("Pic");
+	ImGui::TableHeadersRow();
+	for (int i = 0; i < static_cast<int>(memory::Tag::COUNT); i++) {
+		const memory::AllocationStats& stats = memory::GetFrameStats(memory::Tag(i));
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(memory::GetTagName(memory::Tag(i)));
+		ImGui::TableNextColumn();
+		ImGui::Text("%zu", stats.allocations);
+		ImGui::TableNextColumn();
+		ImGui::Text("%zu", stats.bytes);
+		ImGui::TableNextColumn();
+		ImGui::Text("%zu", stats.liveBytes);
+		ImGui::TableNextColumn();
+		ImGui::Text("%zu", stats.peakBytes);
+	}
+	ImGui::EndTable();
+}
+
 static void RenderInfos() {
 	if (ImGui::BeginTabItem("Infos")) {
 		ImGui::Text("FPS : %i", (int) std::ceil(ImGui::GetIO().Framerate));
+		const data::BatchStats& stats = renderer::GetFrameStats();
+		ImGui::Text("Appels de dessin : %zu", stats.drawCalls);
+		ImGui::Text("Données envoyées : %zu octets", stats.bytesUploaded);
+		if (memory::IsCountingAllocations()) {
+			ImGui::Text("Allocations par image : %zu", memory::GetFrameAllocations());
+		}
+		if (audio::IsRunning()) {
+			audio::Stats audioStats = audio::GetStats();
+			ImGui::Text("Audio : %i voix, rendu max %.3f ms / %.2f ms", audioStats.activeVoices, audioStats.maxRenderMs, audioStats.budgetMs);
+			ImGui::Text("Échéances manquées : %llu / %llu blocs", static_cast<unsigned long long>(audioStats.deadlineMisses),
+				static_cast<unsigned long long>(audioStats.blocks));
+		}
+		if (tuner::IsRunning()) {
+			tuner::Stats tunerStats = tuner::GetStats();
+			ImGui::Text("Accordeur : analyse max %.0f us / %.0f us, %llu retards / %llu pas", tunerStats.maxProcessUs, tunerStats.budgetUs,
+				static_cast<unsigned long long>(tunerStats.overruns), static_cast<unsigned long long>(tunerStats.hops));
+		}
+		if (memory::IsTrackingAllocations()) {
+			RenderAllocations();
+		}
+		RenderProfiler();
+		if (ImGui::Button("Exporter la trace")) {
+			trace::WriteChromeTrace("trace.json");
+		}
+		ImGui::EndTabItem();
 	}
 }
 
@@ -429,12 +923,16 @@ static void RenderTabs() {
 	RenderChordsTab();
 	RenderEditTab();
 	RenderSongsTab();
+	RenderTunerTab();
 	RenderOptions();
 	RenderInfos();
 	ImGui::EndTabBar();
 }
 
 void Render() {
+	GP_ALLOC_TAG(Gui);
+	FollowPlayback();
+	FollowTuner();
 	ImGuiIO& io = ImGui::GetIO();
 	ImGui::Begin("Piano", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove);
 	ImGui::SetWindowPos({ 0, 0 }, ImGuiCond_Always);
@@ -444,11 +942,17 @@ void Render() {
 }
 
 void Init() {
+	GP_ALLOC_TAG(Gui);
 	AddSongsInDirectory();
 	currentChord.octave = currentOctave;  // adjust the slider
 	currentChord.fretMax = fretMax;
 	currentChord.guitaroPiano = pianoChordOnGuitar;
 }
 
+void Shutdown() {
+	// the songs read meanwhile are dropped with the functions posted to the main thread
+	jobs::Wait(scanGroup);
+}
+
 } // namespace gui
 } // namespace gpgui
@@ -0,0 +1,610 @@
+#include "GPGuitarPro.h"
+#include "GPData.h"
+#include "GPMappedFile.h"
+#include "GPMemory.h"
+#include "GPParallel.h"
+#include "GPTrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <string_view>
+
+namespace gpgui {
+namespace guitarpro {
+
+static constexpr std::size_t VERSION_LENGTH = 30;
+static constexpr std::size_t MIDI_CHANNELS_BYTES = 64 * 12;
+static constexpr int MAX_STRINGS = 7;
+static constexpr int MAX_TRACKS = 256;
+// Same range as the capo of the gui
+static constexpr int MAX_CAPO = 10;
+// Midi key of the lowest A, A0
+static constexpr int MIDI_A0 = 21;
+static constexpr std::size_t MAX_CHORDS = std::numeric_limits<std::uint16_t>::max();
+// Notes of a measure played one by one sounding less than this part of the longest pitch class are ignored
+static constexpr float MIN_WEIGHT = 0.25f;
+
+struct Version {
+	std::string_view name;
+	int version;
+};
+
+static constexpr Version VERSIONS[] = {
+	{ "FICHIER GUITAR PRO v3.00", 300 },
+	{ "FICHIER GUITAR PRO v4.00", 400 },
+	{ "FICHIER GUITAR PRO v4.06", 406 },
+	{ "FICHIER GUITAR PRO L4.06", 406 },
+	{ "FICHIER GUITAR PRO v5.00", 500 },
+	{ "FICHIER GUITAR PRO v5.10", 510 },
+};
+
+// Reader, little endian values checked against the end of the data
+
+namespace {
+
+class Reader {
+public:
+	Reader(const std::uint8_t* data, std::size_t size) : m_Data(data), m_End(data + size) {}
+
+	std::size_t GetRemaining() const { return static_cast<std::size_t>(m_End - m_Data); }
+
+	bool Skip(std::size_t bytes) {
+		if (GetRemaining() < bytes)
+			return false;
+		m_Data += bytes;
+		return true;
+	}
+
+	bool ReadUnsignedByte(int& value) {
+		if (GetRemaining() < 1)
+			return false;
+		value = *m_Data++;
+		return true;
+	}
+
+	bool ReadSignedByte(int& value) {
+		if (GetRemaining() < 1)
+			return false;
+		value = static_cast<std::int8_t>(*m_Data++);
+		return true;
+	}
+
+	bool ReadInt(int& value) {
+		if (GetRemaining() < 4)
+			return false;
+		value = static_cast<std::int32_t>(m_Data[0] | (m_Data[1] << 8) | (m_Data[2] << 16) | (static_cast<std::uint32_t>(m_Data[3]) << 24));
+		m_Data += 4;
+		return true;
+	}
+
+	// Byte of length then the characters, in a field of fixed size
+	bool ReadByteSizeString(std::size_t fieldSize, std::string_view& text) {
+		int length;
+		if (!ReadUnsignedByte(length) || GetRemaining() < fieldSize)
+			return false;
+		text = std::string_view(reinterpret_cast<const char*>(m_Data), std::min<std::size_t>(length, fieldSize));
+		m_Data += fieldSize;
+		return true;
+	}
+
+	// Int of the size of the field (length byte included), byte of length, characters
+	bool ReadIntByteSizeString(std::string_view& text) {
+		int size;
+		if (!ReadInt(size))
+			return false;
+		if (size > 0)
+			return ReadByteSizeString(static_cast<std::size_t>(size - 1), text);
+		// without field, as long as the length
+		int length;
+		if (!ReadUnsignedByte(length) || GetRemaining() < static_cast<std::size_t>(length))
+			return false;
+		text = std::string_view(reinterpret_cast<const char*>(m_Data), length);
+		m_Data += length;
+		return true;
+	}
+
+	bool SkipIntByteSizeString() {
+		std::string_view text;
+		return ReadIntByteSizeString(text);
+	}
+
+	// Int of length then the characters
+	bool SkipIntSizeString() {
+		int length;
+		return ReadInt(length) && length >= 0 && Skip(length);
+	}
+
+private:
+	const std::uint8_t* m_Data;
+	const std::uint8_t* m_End;
+};
+
+} // namespace
+
+static bool SkipBend(Reader& reader) {
+	int points;
+	if (!reader.Skip(5) || !reader.ReadInt(points) || points < 0)
+		return false;
+	// position, value and vibrato of each point
+	return reader.Skip(static_cast<std::size_t>(points) * 9);
+}
+
+static bool SkipMarker(Reader& reader) {
+	return reader.SkipIntByteSizeString() && reader.Skip(4);  // name and color
+}
+
+static bool SkipMeasureHeader(Reader& reader, int version, bool first) {
+	int flags;
+	if ((version >= 500 && !first && !reader.Skip(1)) || !reader.ReadUnsignedByte(flags))
+		return false;
+	// numerator and denominator
+	if (!reader.Skip((flags & 0x01 ? 1 : 0) + (flags & 0x02 ? 1 : 0)))
+		return false;
+	if (version < 500) {
+		return reader.Skip(flags & 0x08 ? 1 : 0)  // repeat close
+			&& reader.Skip(flags & 0x10 ? 1 : 0)  // alternative ending
+			&& (!(flags & 0x20) || SkipMarker(reader))
+			&& reader.Skip(flags & 0x40 ? 2 : 0);  // key signature
+	}
+	return reader.Skip(flags & 0x08 ? 1 : 0)
+		&& (!(flags & 0x20) || SkipMarker(reader))
+		&& reader.Skip(flags & 0x10 ? 1 : 0)
+		&& reader.Skip(flags & 0x40 ? 2 : 0)
+		&& reader.Skip(flags & 0x03 ? 4 : 0)  // beams
+		&& reader.Skip(flags & 0x10 ? 0 : 1)
+		&& reader.Skip(1);  // triplet feel
+}
+
+static bool ReadTrack(Reader& reader, int version, bool first, Track& track) {
+	int flags;
+	std::string_view name;
+	if ((version >= 500 && (first || version == 500) && !reader.Skip(1)) || !reader.ReadUnsignedByte(flags) || !reader.ReadByteSizeString(40, name))
+		return false;
+	track.name.assign(name.data(), name.size());
+	track.drums = flags & 0x01;
+
+	if (!reader.ReadInt(track.strings) || track.strings < 1 || track.strings > MAX_STRINGS)
+		return false;
+	// from the highest string, the lowest ones beyond six left out
+	for (int string = 0; string < MAX_STRINGS; string++) {
+		int tuning;
+		if (!reader.ReadInt(tuning))
+			return false;
+		int index = std::min(track.strings, 6) - 1 - string;
+		if (string < track.strings && index >= 0)
+			track.tuning[index] = tuning;
+	}
+	// port, channel, effect channel and fret count
+	if (!reader.Skip(16) || !reader.ReadInt(track.capo) || !reader.Skip(4))
+		return false;
+	if (version >= 500) {
+		// rse settings and equalizer
+		if (!reader.Skip(version >= 510 ? 49 : 44))
+			return false;
+		if (version >= 510 && (!reader.SkipIntByteSizeString() || !reader.SkipIntByteSizeString()))
+			return false;
+	}
+	return true;
+}
+
+static bool SkipChordDiagram(Reader& reader, int version) {
+	if (version >= 500)
+		return reader.Skip(107);
+	int format;
+	if (!reader.ReadUnsignedByte(format))
+		return false;
+	if (format & 0x01)
+		return reader.Skip(version >= 400 ? 106 : 124);
+	// old format, the name then the frets when the first fret is given
+	int firstFret;
+	if (!reader.SkipIntByteSizeString() || !reader.ReadInt(firstFret))
+		return false;
+	return firstFret == 0 || reader.Skip(6 * 4);
+}
+
+static bool SkipBeatEffects(Reader& reader, int version) {
+	int flags1;
+	int flags2 = 0;
+	if (!reader.ReadUnsignedByte(flags1) || (version >= 400 && !reader.ReadUnsignedByte(flags2)))
+		return false;
+	if (flags1 & 0x20) {
+		// tapping, slapping or popping, the tremolo bar value following in version 3
+		if (!reader.Skip(version >= 400 ? 1 : 5))
+			return false;
+	}
+	if ((flags2 & 0x04) && !SkipBend(reader))
+		return false;  // tremolo bar
+	return reader.Skip(flags1 & 0x40 ? 2 : 0)  // strokes
+		&& reader.Skip(flags2 & 0x02 ? 1 : 0);  // pick stroke
+}
+
+static bool SkipMixTableChange(Reader& reader, int version) {
+	// instrument, then the rse instrument
+	if (!reader.Skip(1) || (version >= 500 && !reader.Skip(16)))
+		return false;
+	// volume, balance, chorus, reverb, phaser, tremolo then the tempo, each followed by a duration when changed
+	int changes = 0;
+	for (int i = 0; i < 6; i++) {
+		int value;
+		if (!reader.ReadSignedByte(value))
+			return false;
+		changes += value >= 0 ? 1 : 0;
+	}
+	int tempo;
+	if ((version >= 500 && !reader.SkipIntByteSizeString()) || !reader.ReadInt(tempo))
+		return false;
+	if (tempo >= 0)
+		changes += version >= 510 ? 2 : 1;  // and whether the tempo is hidden
+	if (!reader.Skip(changes))
+		return false;
+	if (version >= 400 && !reader.Skip(1))
+		return false;  // changes applied to all the tracks
+	if (version >= 500) {
+		// wah, then the rse effect
+		if (!reader.Skip(1))
+			return false;
+		if (version >= 510 && (!reader.SkipIntByteSizeString() || !reader.SkipIntByteSizeString()))
+			return false;
+	}
+	return true;
+}
+
+static bool SkipNoteEffects(Reader& reader, int version) {
+	int flags1;
+	int flags2 = 0;
+	if (!reader.ReadUnsignedByte(flags1) || (version >= 400 && !reader.ReadUnsignedByte(flags2)))
+		return false;
+	if ((flags1 & 0x01) && !SkipBend(reader))
+		return false;
+	if ((flags1 & 0x10) && !reader.Skip(version >= 500 ? 5 : 4))
+		return false;  // grace note
+	if (!reader.Skip(flags2 & 0x04 ? 1 : 0) || !reader.Skip(flags2 & 0x08 ? 1 : 0))
+		return false;  // tremolo picking, slide
+	if (flags2 & 0x10) {
+		int harmonic = 0;
+		if (!reader.ReadSignedByte(harmonic))
+			return false;
+		// artificial harmonics have their pitch, tapped ones their fret
+		if (version >= 500 && !reader.Skip(harmonic == 2 ? 3 : harmonic == 3 ? 1 : 0))
+			return false;
+	}
+	return reader.Skip(flags2 & 0x20 ? 2 : 0);  // trill
+}
+
+enum NoteType {
+	NORMAL = 1,
+	TIE,
+	DEAD,
+};
+
+// fret is -1 without a fret (dead note)
+static bool ReadNote(Reader& reader, int version, int& fret, int& type) {
+	int flags;
+	if (!reader.ReadUnsignedByte(flags))
+		return false;
+	type = NORMAL;
+	fret = -1;
+	if ((flags & 0x20) && !reader.ReadUnsignedByte(type))
+		return false;
+	if (version < 500 && (flags & 0x01) && !reader.Skip(2))
+		return false;  // duration and tuplet of the note
+	if ((flags & 0x10) && !reader.Skip(1))
+		return false;  // dynamic
+	if ((flags & 0x20) && !reader.ReadSignedByte(fret))
+		return false;
+	if ((flags & 0x80) && !reader.Skip(2))
+		return false;  // fingerings
+	if (version >= 500 && (!reader.Skip(flags & 0x01 ? 8 : 0) || !reader.Skip(1)))
+		return false;  // duration percent, flags
+	if ((flags & 0x08) && !SkipNoteEffects(reader, version))
+		return false;
+	// frets from EMPTY_TAB on would read as strings not played
+	if (type == DEAD || fret < 0 || fret >= data::EMPTY_TAB)
+		fret = -1;
+	return true;
+}
+
+// Quarters of a duration, from -2 for a whole note, dotted or in a tuplet
+static float GetQuarters(int duration, bool dotted, int tuplet) {
+	float quarters = std::ldexp(1.0f, -std::clamp(duration, -2, 6));
+	if (dotted)
+		quarters *= 1.5f;
+	if (tuplet > 1 && tuplet < 64) {
+		// the notes of the tuplet last as long as the power of two below them
+		int times = 1;
+		while (times * 2 < tuplet)
+			times *= 2;
+		quarters = quarters * times / tuplet;
+	}
+	return quarters;
+}
+
+// Adds the beat to the track when kept (first voice)
+static bool ReadBeat(Reader& reader, int version, Track& track, std::uint32_t measure, bool keep) {
+	int flags;
+	if (!reader.ReadUnsignedByte(flags) || ((flags & 0x40) && !reader.Skip(1)))
+		return false;  // the status of empty beats and rests
+	int duration;
+	int tuplet = 0;
+	if (!reader.ReadSignedByte(duration) || ((flags & 0x20) && !reader.ReadInt(tuplet)))
+		return false;
+	if ((flags & 0x02) && !SkipChordDiagram(reader, version))
+		return false;
+	if ((flags & 0x04) && !reader.SkipIntByteSizeString())
+		return false;  // text
+	if ((flags & 0x08) && !SkipBeatEffects(reader, version))
+		return false;
+	if ((flags & 0x10) && !SkipMixTableChange(reader, version))
+		return false;
+
+	Beat beat;
+	beat.frets.fill(data::EMPTY_TAB);
+	beat.quarters = GetQuarters(duration, flags & 0x01, tuplet);
+	beat.measure = measure;
+	int strings;
+	if (!reader.ReadUnsignedByte(strings))
+		return false;
+	// the highest string on the bit 6
+	for (int string = 0; string < MAX_STRINGS; string++) {
+		if (!(strings & (1 << (6 - string))) || string >= track.strings)
+			continue;
+		int fret;
+		int type;
+		if (!ReadNote(reader, version, fret, type))
+			return false;
+		int index = std::min(track.strings, 6) - 1 - string;
+		if (index < 0)
+			continue;
+		if (type == TIE && !track.beats.empty())
+			fret = track.beats.back().frets[index];  // the fret of the tied note is not reliable
+		if (fret >= 0)
+			beat.frets[index] = fret;
+	}
+	if (version >= 500) {
+		// display flags, the second byte telling whether a break follows
+		int displayFlags;
+		if (!reader.Skip(1) || !reader.ReadUnsignedByte(displayFlags) || ((displayFlags & 0x08) && !reader.Skip(1)))
+			return false;
+	}
+	if (keep)
+		track.beats.push_back(beat);
+	return true;
+}
+
+bool Parse(const std::uint8_t* data, std::size_t size, Tablature& tablature) {
+	GP_TRACE_FUNCTION();
+	Reader reader(data, size);
+	std::string_view versionName;
+	if (!reader.ReadByteSizeString(VERSION_LENGTH, versionName))
+		return false;
+	tablature.version = 0;
+	for (const Version& version : VERSIONS) {
+		if (version.name == versionName)
+			tablature.version = version.version;
+	}
+	const int version = tablature.version;
+	if (version == 0)
+		return false;
+
+	// title, subtitle, artist, album, words, music (5), copyright, tab author, instructions, notice lines
+	std::string_view title;
+	if (!reader.ReadIntByteSizeString(title))
+		return false;
+	tablature.title.assign(title.data(), title.size());
+	for (int i = 0; i < (version >= 500 ? 8 : 7); i++) {
+		if (!reader.SkipIntByteSizeString())
+			return false;
+	}
+	int notices;
+	if (!reader.ReadInt(notices) || notices < 0)
+		return false;
+	for (int i = 0; i < notices; i++) {
+		if (!reader.SkipIntByteSizeString())
+			return false;
+	}
+
+	if (version < 500 && !reader.Skip(1))
+		return false;  // triplet feel, per measure since version 5
+	if (version >= 400) {
+		// lyrics track, then the measure and the text of five lines
+		if (!reader.Skip(4))
+			return false;
+		for (int i = 0; i < 5; i++) {
+			if (!reader.Skip(4) || !reader.SkipIntSizeString())
+				return false;
+		}
+	}
+	if (version >= 500) {
+		// master effect and page setup, its header and footer texts then the tempo name
+		if (!reader.Skip(version >= 510 ? 49 : 30))
+			return false;
+		for (int i = 0; i < 11; i++) {
+			if (!reader.SkipIntByteSizeString())
+				return false;
+		}
+	}
+	// tempo, whether it is hidden, key and octave
+	if (!reader.Skip(4 + (version >= 510 ? 1 : 0) + (version >= 400 ? 5 : 4)) || !reader.Skip(MIDI_CHANNELS_BYTES))
+		return false;
+	if (version >= 500 && !reader.Skip(42))
+		return false;  // musical directions and master reverb
+
+	int measures;
+	int tracks;
+	if (!reader.ReadInt(measures) || !reader.ReadInt(tracks) || measures < 0 || static_cast<std::size_t>(measures) > reader.GetRemaining() || tracks < 0 || tracks > MAX_TRACKS)
+		return false;
+	for (int measure = 0; measure < measures; measure++) {
+		if (!SkipMeasureHeader(reader, version, measure == 0))
+			return false;
+	}
+	tablature.tracks.resize(tracks);
+	for (int track = 0; track < tracks; track++) {
+		if (!ReadTrack(reader, version, track == 0, tablature.tracks[track]))
+			return false;
+	}
+	if (version >= 500 && !reader.Skip(version == 500 ? 2 : 1))
+		return false;
+
+	// the measures of every track, two voices since version 5
+	for (int measure = 0; measure < measures; measure++) {
+		for (Track& track : tablature.tracks) {
+			for (int voice = 0; voice < (version >= 500 ? 2 : 1); voice++) {
+				int beats;
+				if (!reader.ReadInt(beats) || beats < 0 || static_cast<std::size_t>(beats) > reader.GetRemaining())
+					return false;
+				for (int beat = 0; beat < beats; beat++) {
+					if (!ReadBeat(reader, version, track, measure, voice == 0))
+						return false;
+				}
+			}
+			if (version >= 500 && !reader.Skip(1))
+				return false;  // line break
+		}
+	}
+	return true;
+}
+
+static music::Note GetNote(int key) {
+	return music::Note((key + music::Note::TOTAL - MIDI_A0 % music::Note::TOTAL) % music::Note::TOTAL);
+}
+
+// Pitch classes of a fret set and its lowest key, false when no string is played
+static bool GetPitchClasses(const Track& track, const music::Tab& frets, music::PitchClasses& pitchClasses, int& lowestKey, int& notes) {
+	pitchClasses = 0;
+	notes = 0;
+	lowestKey = std::numeric_limits<int>::max();
+	for (int string = 0; string < static_cast<int>(frets.size()); string++) {
+		if (frets[string] == data::EMPTY_TAB)
+			continue;
+		int key = track.tuning[string] + track.capo + frets[string];
+		pitchClasses |= 1 << GetNote(key);
+		lowestKey = std::min(lowestKey, key);
+		notes++;
+	}
+	return notes > 0;
+}
+
+static std::size_t CountChords(const Track& track) {
+	std::size_t chords = 0;
+	for (const Beat& beat : track.beats) {
+		music::PitchClasses pitchClasses;
+		int lowestKey, notes;
+		if (GetPitchClasses(track, beat.frets, pitchClasses, lowestKey, notes) && notes >= 2)
+			chords++;
+	}
+	return chords;
+}
+
+// Chord of the measure [first, last) of the track, false without any
+static bool GetMeasureChord(const Track& track, std::size_t first, std::size_t last, save::ChordSave& chord) {
+	constexpr std::size_t TYPES = static_cast<std::size_t>(music::ChordType::COUNT);
+	std::array<float, music::Note::TOTAL * TYPES> chordWeights{};
+	std::array<float, music::Note::TOTAL> pitchWeights{};
+	int measureLowestKey = std::numeric_limits<int>::max();
+	for (std::size_t i = first; i < last; i++) {
+		const Beat& beat = track.beats[i];
+		music::PitchClasses pitchClasses;
+		int lowestKey, notes;
+		if (!GetPitchClasses(track, beat.frets, pitchClasses, lowestKey, notes))
+			continue;
+		for (int pitch = 0; pitch < music::Note::TOTAL; pitch++) {
+			if (pitchClasses & (1 << pitch))
+				pitchWeights[pitch] += beat.quarters;
+		}
+		measureLowestKey = std::min(measureLowestKey, lowestKey);
+		music::Note root;
+		music::ChordType type;
+		if (notes >= 2 && music::RecognizeChord(pitchClasses, GetNote(lowestKey), root, type))
+			chordWeights[root * TYPES + static_cast<std::size_t>(type)] += beat.quarters;
+	}
+
+	music::Note root;
+	music::ChordType type;
+	auto longest = std::max_element(chordWeights.begin(), chordWeights.end());
+	if (*longest > 0) {
+		std::size_t index = longest - chordWeights.begin();
+		root = music::Note(index / TYPES);
+		type = music::ChordType(index % TYPES);
+	} else {
+		// notes played one by one
+		float maxWeight = *std::max_element(pitchWeights.begin(), pitchWeights.end());
+		if (maxWeight <= 0)
+			return false;
+		music::PitchClasses pitchClasses = 0;
+		for (int pitch = 0; pitch < music::Note::TOTAL; pitch++) {
+			if (pitchWeights[pitch] >= MIN_WEIGHT * maxWeight)
+				pitchClasses |= 1 << pitch;
+		}
+		if (!music::RecognizeChord(pitchClasses, GetNote(measureLowestKey), root, type))
+			return false;
+	}
+	chord.note = root;
+	chord.type = type;
+	chord.guitaroPiano = true;
+	chord.octave = 2;
+	chord.inversion = 0;
+	chord.fretMax = 5;
+	return true;
+}
+
+bool ImportSong(const std::string& fileName, save::Song& song) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Save);
+	file::MappedFile file;
+	Tablature tablature;
+	if (!file.Open(fileName) || !Parse(file.GetData(), file.GetSize(), tablature))
+		return false;
+
+	song = save::Song(tablature.title.empty() ? std::filesystem::path(fileName).stem().string() : tablature.title, 0);
+	const Track* track = nullptr;
+	std::size_t trackChords = 0;
+	for (const Track& candidate : tablature.tracks) {
+		if (candidate.drums)
+			continue;
+		std::size_t chords = CountChords(candidate);
+		if (track == nullptr || chords > trackChords) {
+			track = &candidate;
+			trackChords = chords;
+		}
+	}
+	if (track == nullptr)
+		return true;
+
+	song.capo = static_cast<save::CapoPosType>(std::clamp(track->capo, 0, MAX_CAPO));
+	for (std::size_t first = 0; first < track->beats.size() && song.chords.size() < MAX_CHORDS;) {
+		std::size_t last = first;
+		while (last < track->beats.size() && track->beats[last].measure == track->beats[first].measure)
+			last++;
+		save::ChordSave chord;
+		if (GetMeasureChord(*track, first, last, chord))
+			song.chords.push_back(chord);
+		first = last;
+	}
+	return true;
+}
+
+std::size_t ImportFiles(const std::vector<std::string>& fileNames, const std::string& outputDirectory, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	std::atomic<std::size_t> written{ 0 };
+	parallel::ForEach(fileNames.size(), [&](std::size_t i) {
+		save::Song song("", 0);
+		if (!ImportSong(fileNames[i], song)) {
+			fprintf(stderr, "Unable to read %s\n", fileNames[i].c_str());
+			return;
+		}
+		if (song.chords.empty()) {
+			fprintf(stderr, "No chord found in %s\n", fileNames[i].c_str());
+			return;
+		}
+		save::SaveSongToFile(song, (std::filesystem::path(outputDirectory) / (save::GetFileName(song.title) + ".gp")).string());
+		written++;
+	}, threads);
+	return written;
+}
+
+} // namespace guitarpro
+} // namespace gpgui
@@ -0,0 +1,87 @@
+#include "GPHash.h"
+
+#include <cstring>
+
+namespace gpgui {
+namespace hash {
+
+static constexpr std::uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+static constexpr std::uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr std::uint64_t PRIME_3 = 0x165667B19E3779F9ull;
+static constexpr std::uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ull;
+static constexpr std::uint64_t PRIME_5 = 0x27D4EB2F165667C5ull;
+static constexpr std::size_t STRIPE = 32;
+
+static std::uint64_t RotateLeft(std::uint64_t value, int bits) {
+	return value << bits | value >> (64 - bits);
+}
+
+static std::uint64_t Read64(const std::uint8_t* data) {
+	std::uint64_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static std::uint32_t Read32(const std::uint8_t* data) {
+	std::uint32_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static std::uint64_t Round(std::uint64_t lane, std::uint64_t input) {
+	lane += input * PRIME_2;
+	return RotateLeft(lane, 31) * PRIME_1;
+}
+
+static std::uint64_t MergeLane(std::uint64_t hash, std::uint64_t lane) {
+	hash ^= Round(0, lane);
+	return hash * PRIME_1 + PRIME_4;
+}
+
+std::uint64_t Hash64(const void* data, std::size_t size, std::uint64_t seed) {
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	const std::uint8_t* end = bytes + size;
+	std::uint64_t hash;
+	if (size >= STRIPE) {
+		std::uint64_t lanes[4] = { seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1 };
+		// independent lanes, the multiplications overlap
+		for (; bytes + STRIPE <= end; bytes += STRIPE) {
+			lanes[0] = Round(lanes[0], Read64(bytes));
+			lanes[1] = Round(lanes[1], Read64(bytes + 8));
+			lanes[2] = Round(lanes[2], Read64(bytes + 16));
+			lanes[3] = Round(lanes[3], Read64(bytes + 24));
+		}
+		hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+		for (std::uint64_t lane : lanes) {
+			hash = MergeLane(hash, lane);
+		}
+	} else {
+		hash = seed + PRIME_5;
+	}
+	hash += size;
+
+	for (; bytes + 8 <= end; bytes += 8) {
+		hash ^= Round(0, Read64(bytes));
+		hash = RotateLeft(hash, 27) * PRIME_1 + PRIME_4;
+	}
+	if (bytes + 4 <= end) {
+		hash ^= Read32(bytes) * PRIME_1;
+		hash = RotateLeft(hash, 23) * PRIME_2 + PRIME_3;
+		bytes += 4;
+	}
+	for (; bytes < end; bytes++) {
+		hash ^= *bytes * PRIME_5;
+		hash = RotateLeft(hash, 11) * PRIME_1;
+	}
+
+	// avalanche
+	hash ^= hash >> 33;
+	hash *= PRIME_2;
+	hash ^= hash >> 29;
+	hash *= PRIME_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+} // namespace hash
+} // namespace gpgui
@@ -0,0 +1,79 @@
+#include "GPImage.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace gpgui {
+namespace image {
+
+typedef std::vector<std::uint8_t> DataBuffer;
+
+void FlipVertically(Image& image) {
+	std::size_t rowSize = static_cast<std::size_t>(image.width) * 4;
+	for (int y = 0; y < image.height / 2; y++) {
+		auto top = image.rgba.begin() + y * rowSize;
+		auto bottom = image.rgba.begin() + (image.height - 1 - y) * rowSize;
+		std::swap_ranges(top, top + rowSize, bottom);
+	}
+}
+
+static void WriteBigEndian(DataBuffer& buffer, std::uint32_t value) {
+	buffer.insert(buffer.end(), {
+		static_cast<std::uint8_t>(value >> 24), static_cast<std::uint8_t>(value >> 16),
+		static_cast<std::uint8_t>(value >> 8), static_cast<std::uint8_t>(value),
+	});
+}
+
+static void WriteChunk(DataBuffer& buffer, const char type[4], const std::uint8_t* data, std::size_t size) {
+	WriteBigEndian(buffer, static_cast<std::uint32_t>(size));
+	std::size_t typePos = buffer.size();
+	buffer.insert(buffer.end(), type, type + 4);
+	buffer.insert(buffer.end(), data, data + size);
+	// the crc covers the type and the data
+	std::uint32_t crc = crc32(0, buffer.data() + typePos, static_cast<uInt>(size + 4));
+	WriteBigEndian(buffer, crc);
+}
+
+bool WritePng(const Image& image, const std::string& fileName) {
+	static const std::uint8_t SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	DataBuffer header;
+	WriteBigEndian(header, image.width);
+	WriteBigEndian(header, image.height);
+	header.insert(header.end(), {
+		8,  // bit depth
+		6,  // color type : rgba
+		0, 0, 0,  // compression, filter, interlace
+	});
+
+	// each row starts with its filter type (none)
+	std::size_t rowSize = static_cast<std::size_t>(image.width) * 4;
+	DataBuffer rows((rowSize + 1) * image.height);
+	for (int y = 0; y < image.height; y++) {
+		rows[y * (rowSize + 1)] = 0;
+		std::memcpy(rows.data() + y * (rowSize + 1) + 1, image.rgba.data() + y * rowSize, rowSize);
+	}
+
+	uLongf compressedSize = compressBound(static_cast<uLong>(rows.size()));
+	DataBuffer compressed(compressedSize);
+	if (compress2(compressed.data(), &compressedSize, rows.data(), static_cast<uLong>(rows.size()), Z_BEST_SPEED) != Z_OK)
+		return false;
+
+	DataBuffer buffer(std::begin(SIGNATURE), std::end(SIGNATURE));
+	WriteChunk(buffer, "IHDR", header.data(), header.size());
+	WriteChunk(buffer, "IDAT", compressed.data(), compressedSize);
+	WriteChunk(buffer, "IEND", nullptr, 0);
+
+	std::ofstream fileStream(fileName, std::ios::binary);
+	if (!fileStream)
+		return false;
+
+	fileStream.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+	return static_cast<bool>(fileStream);
+}
+
+} // namespace image
+} // namespace gpgui
@@ -0,0 +1,246 @@
+#include "GPJobs.h"
+#include "GPTrace.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace gpgui {
+namespace jobs {
+
+// Scheduler and queue of the worker running on this thread, none outside the schedulers
+static thread_local const Scheduler* currentScheduler = nullptr;
+static thread_local std::size_t currentQueue = 0;
+
+static std::atomic<void (*)(const char*, unsigned)> beginHook{ nullptr };
+static std::atomic<void (*)(const char*, unsigned)> endHook{ nullptr };
+
+Group::~Group() {
+	// the last job may still hold the mutex
+	std::lock_guard<std::mutex> lock(m_mutex);
+}
+
+bool Group::IsDone() const {
+	return m_pending.load(std::memory_order_acquire) == 0;
+}
+
+Scheduler::Scheduler(unsigned workerCount) {
+	for (unsigned queue = 0; queue <= workerCount; queue++) {
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+	m_threads.reserve(workerCount);
+	for (unsigned worker = 1; worker <= workerCount; worker++) {
+		m_threads.emplace_back([this, worker]() { RunWorker(worker); });
+	}
+}
+
+Scheduler::~Scheduler() {
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wakeup.notify_all();
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+	// without workers
+	while (TryRun(0)) {}
+}
+
+std::size_t Scheduler::GetCurrentQueue() const {
+	return currentScheduler == this ? currentQueue : 0;
+}
+
+void Scheduler::Schedule(const char* name, Function function, Group* group) {
+	if (group != nullptr)
+		group->m_pending.fetch_add(1, std::memory_order_relaxed);
+	Push({ name, std::move(function), group });
+}
+
+void Scheduler::Push(Job job) {
+	Queue& queue = *m_queues[GetCurrentQueue()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	m_queued.fetch_add(1);
+	// a worker checking the count before falling asleep sees it
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wakeup.notify_one();
+}
+
+void Scheduler::Then(Group& group, const char* name, Function continuation, Group* continuationGroup) {
+	if (continuationGroup != nullptr)
+		continuationGroup->m_pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(group.m_mutex);
+		if (group.m_pending.load(std::memory_order_acquire) > 0) {
+			assert(!group.m_continuation && "One continuation per group");
+			group.m_continuationName = name;
+			group.m_continuation = std::move(continuation);
+			group.m_continuationGroup = continuationGroup;
+			return;
+		}
+	}
+	Push({ name, std::move(continuation), continuationGroup });
+}
+
+void Scheduler::Finish(Group& group) {
+	Job continuation{ nullptr, nullptr, nullptr };
+	bool done = false;
+	{
+		std::lock_guard<std::mutex> lock(group.m_mutex);
+		done = group.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+		if (done && group.m_continuation) {
+			continuation = { group.m_continuationName, std::move(group.m_continuation), group.m_continuationGroup };
+			group.m_continuation = nullptr;
+		}
+	}
+	// the group may be gone now
+	if (continuation.function)
+		Push(std::move(continuation));
+	if (done) {
+		// wakes up the threads waiting for it
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_wakeup.notify_all();
+	}
+}
+
+bool Scheduler::TryRun(std::size_t queue) {
+	Job job{ nullptr, nullptr, nullptr };
+	bool found = false;
+	{
+		Queue& own = *m_queues[queue];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty()) {
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			found = true;
+		}
+	}
+	for (std::size_t i = 1; !found && i < m_queues.size(); i++) {
+		Queue& other = *m_queues[(queue + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if (!other.jobs.empty()) {
+			job = std::move(other.jobs.front());
+			other.jobs.pop_front();
+			found = true;
+			m_stolen.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	if (!found)
+		return false;
+	m_queued.fetch_sub(1);
+
+	const unsigned worker = static_cast<unsigned>(queue);
+	if (auto begin = beginHook.load(std::memory_order_relaxed))
+		begin(job.name, worker);
+	{
+		trace::ScopedEvent event(job.name);
+		job.function();
+	}
+	if (auto end = endHook.load(std::memory_order_relaxed))
+		end(job.name, worker);
+	m_executed.fetch_add(1, std::memory_order_relaxed);
+	if (job.group != nullptr)
+		Finish(*job.group);
+	return true;
+}
+
+void Scheduler::RunWorker(unsigned worker) {
+	currentScheduler = this;
+	currentQueue = worker;
+	for (;;) {
+		if (TryRun(worker))
+			continue;
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wakeup.wait(lock, [this]() { return m_queued.load() > 0 || m_stopping; });
+		if (m_stopping && m_queued.load() == 0)
+			return;
+	}
+}
+
+void Scheduler::Wait(Group& group) {
+	const std::size_t queue = GetCurrentQueue();
+	while (!group.IsDone()) {
+		if (TryRun(queue))
+			continue;
+		// the last jobs are running on other threads, sleeps until they are done or another job comes
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wakeup.wait(lock, [this, &group]() { return group.IsDone() || m_queued.load() > 0; });
+	}
+	// the last job releases the group
+	std::lock_guard<std::mutex> lock(group.m_mutex);
+}
+
+unsigned Scheduler::GetWorkerCount() const {
+	return static_cast<unsigned>(m_threads.size());
+}
+
+Stats Scheduler::GetStats() const {
+	return { m_executed.load(), m_stolen.load() };
+}
+
+Scheduler& GetScheduler() {
+	// a worker on a single core too, the jobs nobody waits for must run
+	static Scheduler scheduler(std::max(2u, std::thread::hardware_concurrency()) - 1);
+	return scheduler;
+}
+
+void Schedule(const char* name, Function function, Group* group) {
+	GetScheduler().Schedule(name, std::move(function), group);
+}
+
+void Then(Group& group, const char* name, Function continuation, Group* continuationGroup) {
+	GetScheduler().Then(group, name, std::move(continuation), continuationGroup);
+}
+
+void Wait(Group& group) {
+	GetScheduler().Wait(group);
+}
+
+void SetTraceHooks(const TraceHooks& hooks) {
+	beginHook.store(hooks.begin);
+	endHook.store(hooks.end);
+}
+
+static std::mutex mainThreadMutex;
+static std::vector<Function> mainThreadFunctions;
+static std::atomic<void (*)()> mainThreadWakeup{ nullptr };
+
+void PostToMainThread(Function function) {
+	{
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		mainThreadFunctions.push_back(std::move(function));
+	}
+	if (auto wakeup = mainThreadWakeup.load())
+		wakeup();
+}
+
+std::size_t DrainMainThread() {
+	// swapped with the buffer of the previous frame, nothing is allocated once they have grown
+	static std::vector<Function> running;
+	{
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		if (mainThreadFunctions.empty())
+			return 0;
+		std::swap(running, mainThreadFunctions);
+	}
+	GP_TRACE_FUNCTION();
+	for (Function& function : running) {
+		function();
+	}
+	const std::size_t count = running.size();
+	running.clear();
+	return count;
+}
+
+void SetMainThreadWakeup(void (*wakeup)()) {
+	mainThreadWakeup.store(wakeup);
+}
+
+} // namespace jobs
+} // namespace gpgui
@@ -0,0 +1,116 @@
+#include "GPMappedFile.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GP_HAVE_MMAP
+#endif
+
+#include <cstdio>
+#include <filesystem>
+
+namespace gpgui {
+namespace file {
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef GP_HAVE_MMAP
+
+bool MappedFile::Open(const std::string& fileName) {
+	Close();
+	int descriptor = open(fileName.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return false;
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode)) {
+		close(descriptor);
+		return false;
+	}
+	m_Size = static_cast<std::size_t>(status.st_size);
+	if (m_Size == 0) {
+		// empty files can't be mapped
+		close(descriptor);
+		m_Data = m_Buffer.data();
+		return true;
+	}
+	void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);  // the mapping keeps the file open
+	if (data == MAP_FAILED) {
+		m_Size = 0;
+		return false;
+	}
+	// read once from the beginning to the end
+	madvise(data, m_Size, MADV_SEQUENTIAL);
+	m_Data = static_cast<const std::uint8_t*>(data);
+	m_Mapped = true;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (m_Mapped)
+		munmap(const_cast<std::uint8_t*>(m_Data), m_Size);
+	m_Data = nullptr;
+	m_Size = 0;
+	m_Mapped = false;
+	m_Buffer.clear();
+}
+
+bool GetStatus(const std::string& fileName, std::uintmax_t& size, std::int64_t& time) {
+	struct stat status;
+	if (stat(fileName.c_str(), &status) != 0)
+		return false;
+#ifdef __APPLE__
+	const struct timespec& modified = status.st_mtimespec;
+#else
+	const struct timespec& modified = status.st_mtim;
+#endif
+	size = static_cast<std::uintmax_t>(status.st_size);
+	time = static_cast<std::int64_t>(modified.tv_sec) * 1000000000 + modified.tv_nsec;
+	return true;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& fileName) {
+	Close();
+	FILE* file = fopen(fileName.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	std::uint8_t chunk[65536];
+	for (std::size_t read; (read = fread(chunk, 1, sizeof(chunk), file)) > 0;) {
+		m_Buffer.insert(m_Buffer.end(), chunk, chunk + read);
+	}
+	bool failed = ferror(file) != 0;
+	fclose(file);
+	if (failed) {
+		m_Buffer.clear();
+		return false;
+	}
+	m_Data = m_Buffer.data();
+	m_Size = m_Buffer.size();
+	return true;
+}
+
+void MappedFile::Close() {
+	m_Data = nullptr;
+	m_Size = 0;
+	m_Buffer.clear();
+}
+
+bool GetStatus(const std::string& fileName, std::uintmax_t& size, std::int64_t& time) {
+	std::error_code error;
+	size = std::filesystem::file_size(fileName, error);
+	if (error)
+		return false;
+	time = std::filesystem::last_write_time(fileName, error).time_since_epoch().count();
+	return !error;
+}
+
+#endif
+
+} // namespace file
+} // namespace gpgui
@@ -0,0 +1,302 @@
+#include "GPMemory.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(GP_DEBUG) || defined(GP_ALLOC_TRACKING)
+#define GP_COUNT_ALLOCATIONS
+#endif
+
+namespace gpgui {
+namespace memory {
+
+static constexpr std::size_t ARENA_SIZE = 64 * 1024;
+
+// Frames drawn before checking for allocations (fonts, first windows, ...)
+static constexpr std::size_t WARMUP_FRAMES = 60;
+
+static constexpr std::size_t TAG_COUNT = static_cast<std::size_t>(Tag::COUNT);
+
+static char frameArena[ARENA_SIZE];
+static std::size_t arenaOffset = 0;
+
+static thread_local Tag currentTag = Tag::Other;
+
+#ifdef GP_COUNT_ALLOCATIONS
+static thread_local std::size_t threadAllocations = 0;
+static std::size_t frameAllocations = 0;
+static std::size_t frameCount = 0;
+static int steadyFrames = 0;
+#endif
+
+#ifdef GP_ALLOC_TRACKING
+
+struct TagCounters {
+	std::atomic<std::size_t> allocations{ 0 };
+	std::atomic<std::size_t> bytes{ 0 };
+	std::atomic<std::size_t> liveBytes{ 0 };
+	std::atomic<std::size_t> peakBytes{ 0 };
+};
+
+// Stored in front of every block to know its size and tag when freed
+struct alignas(alignof(std::max_align_t)) BlockHeader {
+	std::size_t size;
+	Tag tag;
+};
+
+static std::array<TagCounters, TAG_COUNT> tagCounters;
+static std::array<AllocationStats, TAG_COUNT> frameStart;
+static std::array<AllocationStats, TAG_COUNT> frameStats;
+
+static void* TrackedAlloc(std::size_t size, Tag tag) {
+	BlockHeader* header = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+	if (header == nullptr)
+		return nullptr;
+	header->size = size;
+	header->tag = tag;
+
+	TagCounters& counters = tagCounters[static_cast<std::size_t>(tag)];
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	counters.bytes.fetch_add(size, std::memory_order_relaxed);
+	std::size_t live = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	std::size_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+	return header + 1;
+}
+
+static void TrackedFree(void* pointer) {
+	if (pointer == nullptr)
+		return;
+	BlockHeader* header = static_cast<BlockHeader*>(pointer) - 1;
+	tagCounters[static_cast<std::size_t>(header->tag)].liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+	std::free(header);
+}
+
+AllocationStats GetTotalStats(Tag tag) {
+	const TagCounters& counters = tagCounters[static_cast<std::size_t>(tag)];
+	AllocationStats stats;
+	stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+	stats.bytes = counters.bytes.load(std::memory_order_relaxed);
+	stats.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void ResetPeaks() {
+	for (TagCounters& counters : tagCounters) {
+		counters.peakBytes.store(counters.liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+}
+
+bool IsTrackingAllocations() {
+	return true;
+}
+
+#else
+
+static void* TrackedAlloc(std::size_t size, Tag) {
+	return std::malloc(size);
+}
+
+static void TrackedFree(void* pointer) {
+	std::free(pointer);
+}
+
+AllocationStats GetTotalStats(Tag) {
+	return {};
+}
+
+void ResetPeaks() {}
+
+bool IsTrackingAllocations() {
+	return false;
+}
+
+#endif
+
+static void* CountedAlloc(std::size_t size, Tag tag) {
+#ifdef GP_COUNT_ALLOCATIONS
+	threadAllocations++;
+#endif
+	return TrackedAlloc(size == 0 ? 1 : size, tag);
+}
+
+bool IsCountingAllocations() {
+#ifdef GP_COUNT_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+void NewFrame() {
+	arenaOffset = 0;
+#ifdef GP_COUNT_ALLOCATIONS
+	threadAllocations = 0;
+#endif
+#ifdef GP_ALLOC_TRACKING
+	ResetPeaks();
+	for (std::size_t tag = 0; tag < TAG_COUNT; tag++) {
+		frameStart[tag] = GetTotalStats(Tag(tag));
+	}
+#endif
+}
+
+void EndFrame(bool steady) {
+#ifdef GP_ALLOC_TRACKING
+	for (std::size_t tag = 0; tag < TAG_COUNT; tag++) {
+		AllocationStats total = GetTotalStats(Tag(tag));
+		frameStats[tag] = total;
+		frameStats[tag].allocations -= frameStart[tag].allocations;
+		frameStats[tag].bytes -= frameStart[tag].bytes;
+	}
+#endif
+#ifdef GP_COUNT_ALLOCATIONS
+	frameAllocations = threadAllocations;
+	frameCount++;
+	steadyFrames = steady ? steadyFrames + 1 : 0;
+	// the first steady frame may still finish the layout started by the last input
+	if (steadyFrames >= 2 && frameCount > WARMUP_FRAMES) {
+		assert(frameAllocations == 0 && "A steady frame allocated on the heap");
+	}
+#else
+	(void)steady;
+#endif
+}
+
+std::size_t GetFrameAllocations() {
+#ifdef GP_COUNT_ALLOCATIONS
+	return frameAllocations;
+#else
+	return 0;
+#endif
+}
+
+std::size_t GetThreadAllocations() {
+#ifdef GP_COUNT_ALLOCATIONS
+	return threadAllocations;
+#else
+	return 0;
+#endif
+}
+
+const char* GetTagName(Tag tag) {
+	switch (tag) {
+	case Tag::Other:
+		return "other";
+	case Tag::Gui:
+		return "gui";
+	case Tag::Renderer:
+		return "renderer";
+	case Tag::Music:
+		return "music";
+	case Tag::Save:
+		return "save";
+	default:
+		return "";
+	}
+}
+
+#ifdef GP_ALLOC_TRACKING
+const AllocationStats& GetFrameStats(Tag tag) {
+	return frameStats[static_cast<std::size_t>(tag)];
+}
+#else
+const AllocationStats& GetFrameStats(Tag) {
+	static const AllocationStats empty;
+	return empty;
+}
+#endif
+
+ScopedTag::ScopedTag(Tag tag) : m_PreviousTag(currentTag) {
+	currentTag = tag;
+}
+
+ScopedTag::~ScopedTag() {
+	currentTag = m_PreviousTag;
+}
+
+void* ImGuiAlloc(std::size_t size, void*) {
+	return CountedAlloc(size, Tag::Gui);
+}
+
+void ImGuiFree(void* pointer, void*) {
+	TrackedFree(pointer);
+}
+
+const char* FrameFormat(const char* format, ...) {
+	char* text = frameArena + arenaOffset;
+	std::size_t available = ARENA_SIZE - arenaOffset;
+
+	va_list args;
+	va_start(args, format);
+	int length = std::vsnprintf(text, available, format, args);
+	va_end(args);
+
+	if (length < 0)
+		return "";
+	// truncated texts are kept, the arena is simply full until the next frame
+	arenaOffset += std::min<std::size_t>(length + 1, available);
+	return text;
+}
+
+#ifdef GP_COUNT_ALLOCATIONS
+// Global operators use these two
+static void* OperatorNew(std::size_t size) {
+	return CountedAlloc(size, currentTag);
+}
+
+static void OperatorDelete(void* pointer) {
+	TrackedFree(pointer);
+}
+#endif
+
+} // namespace memory
+} // namespace gpgui
+
+#ifdef GP_COUNT_ALLOCATIONS
+
+// Counting (and tracking) every heap allocation
+
+void* operator new(std::size_t size) {
+	if (void* pointer = gpgui::memory::OperatorNew(size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return gpgui::memory::OperatorNew(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return gpgui::memory::OperatorNew(size);
+}
+
+void operator delete(void* pointer) noexcept {
+	gpgui::memory::OperatorDelete(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	gpgui::memory::OperatorDelete(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+	gpgui::memory::OperatorDelete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+	gpgui::memory::OperatorDelete(pointer);
+}
+
+#endif
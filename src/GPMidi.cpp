@@ -0,0 +1,354 @@
+#include "GPMidi.h"
+#include "GPMappedFile.h"
+#include "GPMusic.h"
+#include "GPParallel.h"
+#include "GPTrace.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+namespace gpgui {
+namespace midi {
+
+static constexpr int CHANNELS = 16;
+static constexpr int KEYS = 128;
+static constexpr int DRUMS_CHANNEL = 9;
+// Midi key of the lowest A, A0
+static constexpr int MIDI_A0 = 21;
+// Tempo of the smpte files, which have no beats
+static constexpr int SMPTE_QUARTERS_PER_SECOND = 2;
+static constexpr std::size_t MAX_CHORDS = std::numeric_limits<std::uint16_t>::max();
+// Notes sounding beyond are ignored, whatever their length in the file
+static constexpr std::uint64_t MAX_BEATS = MAX_CHORDS * 8;
+
+// Parser, a cursor checked against the end of its chunk
+
+namespace {
+
+class Cursor {
+public:
+	Cursor(const std::uint8_t* data, const std::uint8_t* end) : m_Data(data), m_End(end) {}
+
+	bool IsAtEnd() const { return m_Data >= m_End; }
+	std::size_t GetRemaining() const { return static_cast<std::size_t>(m_End - m_Data); }
+	const std::uint8_t* GetData() const { return m_Data; }
+
+	bool Peek(std::uint8_t& value) const {
+		if (m_Data >= m_End)
+			return false;
+		value = *m_Data;
+		return true;
+	}
+
+	bool Read(std::uint8_t& value) {
+		if (!Peek(value))
+			return false;
+		m_Data++;
+		return true;
+	}
+
+	bool ReadBigEndian(int bytes, std::uint32_t& value) {
+		if (GetRemaining() < static_cast<std::size_t>(bytes))
+			return false;
+		value = 0;
+		for (int i = 0; i < bytes; i++) {
+			value = (value << 8) | *m_Data++;
+		}
+		return true;
+	}
+
+	// Variable length quantity, 7 bits per byte and at most four bytes
+	bool ReadVarint(std::uint32_t& value) {
+		value = 0;
+		for (int i = 0; i < 4; i++) {
+			std::uint8_t byte;
+			if (!Read(byte))
+				return false;
+			value = (value << 7) | (byte & 0x7F);
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	bool Skip(std::size_t bytes) {
+		if (GetRemaining() < bytes)
+			return false;
+		m_Data += bytes;
+		return true;
+	}
+
+private:
+	const std::uint8_t* m_Data;
+	const std::uint8_t* m_End;
+};
+
+} // namespace
+
+static bool ParseMetaEvent(Cursor& cursor, std::uint64_t tick, Listener& listener, bool& endOfTrack) {
+	std::uint8_t type;
+	std::uint32_t length;
+	if (!cursor.Read(type) || !cursor.ReadVarint(length) || cursor.GetRemaining() < length)
+		return false;
+	const std::uint8_t* data = cursor.GetData();
+	switch (type) {
+	case 0x03:
+		listener.OnTrackName(std::string_view(reinterpret_cast<const char*>(data), length));
+		break;
+	case 0x2F:
+		endOfTrack = true;
+		break;
+	case 0x51:
+		if (length >= 3)
+			listener.OnTempo(tick, (data[0] << 16) | (data[1] << 8) | data[2]);
+		break;
+	case 0x58:
+		if (length >= 2 && data[1] < 8)
+			listener.OnTimeSignature(tick, data[0], 1 << data[1]);
+		break;
+	default:
+		break;
+	}
+	return cursor.Skip(length);
+}
+
+static bool ParseTrack(Cursor cursor, Listener& listener) {
+	std::uint64_t tick = 0;
+	std::uint8_t runningStatus = 0;
+	bool endOfTrack = false;
+	while (!cursor.IsAtEnd() && !endOfTrack) {
+		std::uint32_t delta;
+		std::uint8_t status;
+		if (!cursor.ReadVarint(delta) || !cursor.Peek(status))
+			return false;
+		tick += delta;
+
+		if (status & 0x80) {
+			cursor.Skip(1);
+		} else if (runningStatus != 0) {
+			status = runningStatus;  // the byte is the first data byte
+		} else {
+			return false;
+		}
+
+		if (status == 0xFF) {
+			runningStatus = 0;
+			if (!ParseMetaEvent(cursor, tick, listener, endOfTrack))
+				return false;
+		} else if (status == 0xF0 || status == 0xF7) {
+			runningStatus = 0;
+			std::uint32_t length;
+			if (!cursor.ReadVarint(length) || !cursor.Skip(length))
+				return false;
+		} else if (status < 0xF0) {
+			runningStatus = status;
+			const int type = status & 0xF0;
+			std::uint8_t first;
+			std::uint8_t second = 0;
+			if (!cursor.Read(first) || (type != 0xC0 && type != 0xD0 && !cursor.Read(second)))
+				return false;
+			if (type == 0x90)
+				listener.OnNote(tick, status & 0x0F, first & 0x7F, second & 0x7F);
+			else if (type == 0x80)
+				listener.OnNote(tick, status & 0x0F, first & 0x7F, 0);
+		} else {
+			return false;  // system messages are not allowed in files
+		}
+	}
+	return true;
+}
+
+bool Parse(const std::uint8_t* data, std::size_t size, Listener& listener) {
+	const std::uint8_t* end = data + size;
+	Cursor cursor(data, end);
+	std::uint32_t headerLength, format, tracks, division;
+	if (size < 14 || std::memcmp(data, "MThd", 4) != 0 || !cursor.Skip(4) || !cursor.ReadBigEndian(4, headerLength) || headerLength < 6)
+		return false;
+	Cursor header(cursor.GetData(), cursor.GetData() + std::min<std::size_t>(headerLength, cursor.GetRemaining()));
+	if (!header.ReadBigEndian(2, format) || !header.ReadBigEndian(2, tracks) || !header.ReadBigEndian(2, division) || !cursor.Skip(headerLength))
+		return false;
+
+	int ticksPerQuarter = static_cast<int>(division);
+	if (division & 0x8000) {
+		// negative frames per second in the high byte, ticks per frame in the low one
+		int framesPerSecond = -static_cast<std::int8_t>(division >> 8);
+		ticksPerQuarter = -(framesPerSecond * static_cast<int>(division & 0xFF));
+	}
+	listener.OnHeader(static_cast<int>(format), static_cast<int>(tracks), ticksPerQuarter);
+
+	int track = 0;
+	while (cursor.GetRemaining() >= 8) {
+		const std::uint8_t* chunk = cursor.GetData();
+		std::uint32_t length;
+		cursor.Skip(4);
+		cursor.ReadBigEndian(4, length);
+		if (cursor.GetRemaining() < length)
+			return false;
+		// unknown chunks are skipped
+		if (std::memcmp(chunk, "MTrk", 4) == 0) {
+			listener.OnTrack(track++);
+			if (!ParseTrack(Cursor(cursor.GetData(), cursor.GetData() + length), listener))
+				return false;
+		}
+		cursor.Skip(length);
+	}
+	return track > 0;
+}
+
+// Import, the notes are accumulated per quarter note then grouped in bars
+
+namespace {
+
+struct Beat {
+	std::array<float, music::Note::TOTAL> weights{};
+	int lowestKey = KEYS;
+};
+
+class ChordCollector : public Listener {
+public:
+	ChordCollector() {
+		for (auto& channel : m_Starts) {
+			channel.fill(NOT_SOUNDING);
+		}
+	}
+
+	void OnHeader(int, int, int ticksPerQuarter) {
+		m_TicksPerQuarter = ticksPerQuarter > 0 ? ticksPerQuarter : std::max(1, -ticksPerQuarter / SMPTE_QUARTERS_PER_SECOND);
+	}
+
+	void OnTrack(int) { ReleaseAll(); }
+
+	void OnNote(std::uint64_t tick, int channel, int key, int velocity) {
+		if (channel == DRUMS_CHANNEL)
+			return;
+		m_LastTick = std::max(m_LastTick, tick);
+		// a note played again ends the previous one
+		Release(tick, channel, key);
+		if (velocity > 0) {
+			m_Starts[channel][key] = tick;
+			m_Velocities[channel][key] = static_cast<std::uint8_t>(velocity);
+		}
+	}
+
+	void OnTimeSignature(std::uint64_t, int numerator, int denominator) {
+		// the first one gives the bars
+		if (m_QuartersPerBar == 0)
+			m_QuartersPerBar = std::max(1, static_cast<int>(std::lround(4.0 * numerator / denominator)));
+	}
+
+	void ReleaseAll() {
+		for (int channel = 0; channel < CHANNELS; channel++) {
+			for (int key = 0; key < KEYS; key++) {
+				Release(m_LastTick, channel, key);
+			}
+		}
+		m_LastTick = 0;
+	}
+
+	int GetQuartersPerBar() const { return m_QuartersPerBar == 0 ? 4 : m_QuartersPerBar; }
+	const std::vector<Beat>& GetBeats() const { return m_Beats; }
+
+private:
+	static constexpr std::uint64_t NOT_SOUNDING = std::numeric_limits<std::uint64_t>::max();
+
+	// the note weighs its duration and velocity in every beat it sounds
+	void Release(std::uint64_t tick, int channel, int key) {
+		std::uint64_t start = m_Starts[channel][key];
+		if (start == NOT_SOUNDING)
+			return;
+		m_Starts[channel][key] = NOT_SOUNDING;
+
+		const std::uint64_t ticks = static_cast<std::uint64_t>(m_TicksPerQuarter);
+		const int pitchClass = (key + music::Note::TOTAL - MIDI_A0 % music::Note::TOTAL) % music::Note::TOTAL;
+		const float velocity = m_Velocities[channel][key] / 127.0f;
+		for (std::uint64_t beat = start / ticks; beat * ticks < tick && beat < MAX_BEATS; beat++) {
+			if (beat >= m_Beats.size())
+				m_Beats.resize(beat + 1);
+			std::uint64_t overlap = std::min(tick, (beat + 1) * ticks) - std::max(start, beat * ticks);
+			m_Beats[beat].weights[pitchClass] += velocity * overlap / ticks;
+			m_Beats[beat].lowestKey = std::min(m_Beats[beat].lowestKey, key);
+		}
+	}
+
+	int m_TicksPerQuarter = 480;
+	int m_QuartersPerBar = 0;
+	std::uint64_t m_LastTick = 0;
+	std::array<std::array<std::uint64_t, KEYS>, CHANNELS> m_Starts;
+	std::array<std::array<std::uint8_t, KEYS>, CHANNELS> m_Velocities{};
+	std::vector<Beat> m_Beats;
+};
+
+} // namespace
+
+bool ImportSong(const std::string& fileName, save::Song& song, const Options& options) {
+	GP_TRACE_FUNCTION();
+	file::MappedFile file;
+	ChordCollector collector;
+	if (!file.Open(fileName) || !Parse(file.GetData(), file.GetSize(), collector))
+		return false;
+	collector.ReleaseAll();
+
+	song = save::Song(std::filesystem::path(fileName).stem().string(), 0);
+	const std::vector<Beat>& beats = collector.GetBeats();
+	const std::size_t beatsPerChord = options.beatsPerChord > 0 ? options.beatsPerChord : collector.GetQuartersPerBar();
+	for (std::size_t first = 0; first < beats.size() && song.chords.size() < MAX_CHORDS; first += beatsPerChord) {
+		Beat bar;
+		for (std::size_t beat = first; beat < std::min(beats.size(), first + beatsPerChord); beat++) {
+			for (int pitch = 0; pitch < music::Note::TOTAL; pitch++) {
+				bar.weights[pitch] += beats[beat].weights[pitch];
+			}
+			bar.lowestKey = std::min(bar.lowestKey, beats[beat].lowestKey);
+		}
+		float maxWeight = *std::max_element(bar.weights.begin(), bar.weights.end());
+		if (maxWeight <= 0)
+			continue;
+
+		music::PitchClasses pitchClasses = 0;
+		for (int pitch = 0; pitch < music::Note::TOTAL; pitch++) {
+			if (bar.weights[pitch] >= options.minWeight * maxWeight)
+				pitchClasses |= 1 << pitch;
+		}
+		music::Note bass = music::Note((bar.lowestKey + music::Note::TOTAL - MIDI_A0 % music::Note::TOTAL) % music::Note::TOTAL);
+		save::ChordSave chord;
+		music::Note root;
+		music::ChordType type;
+		if (!music::RecognizeChord(pitchClasses, bass, root, type))
+			continue;  // a melody alone
+		chord.note = root;
+		chord.type = type;
+		chord.guitaroPiano = true;
+		chord.octave = 2;
+		chord.inversion = 0;
+		chord.fretMax = 5;
+		song.chords.push_back(chord);
+	}
+	return true;
+}
+
+std::size_t ImportFiles(const std::vector<std::string>& fileNames, const std::string& outputDirectory, const Options& options, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	std::atomic<std::size_t> written{ 0 };
+	parallel::ForEach(fileNames.size(), [&](std::size_t i) {
+		save::Song song("", 0);
+		if (!ImportSong(fileNames[i], song, options)) {
+			fprintf(stderr, "Unable to read %s\n", fileNames[i].c_str());
+			return;
+		}
+		if (song.chords.empty()) {
+			fprintf(stderr, "No chord found in %s\n", fileNames[i].c_str());
+			return;
+		}
+		save::SaveSongToFile(song, (std::filesystem::path(outputDirectory) / (song.title + ".gp")).string());
+		written++;
+	}, threads);
+	return written;
+}
+
+} // namespace midi
+} // namespace gpgui
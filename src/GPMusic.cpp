@@ -1,8 +1,13 @@
 #include "GPMusic.h"
 #include "GPData.h"
+#include "GPMemory.h"
+#include "GPParallel.h"
 #include "GPSave.h"
+#include "GPTrace.h"
 
+#include <cmath>
 #include <map>
+#include <memory>
 
 #define ARRAY_SIZE(A) sizeof(A) / sizeof(A[0])
 
@@ -21,6 +26,13 @@ int GetStringOffset(int string) {
 	return Cordes[string];
 }
 
+int GetStringKey(int string, int fret, int capo) {
+	if (fret == data::EMPTY_TAB)
+		return -1;
+	// the fret 0 is the capo
+	return Cordes[string] + (fret == 0 ? capo : fret);
+}
+
 Note GetNote(std::uint8_t touche) {
 	return Note(touche % 12);
 }
@@ -29,57 +41,158 @@ std::uint8_t GetOctave(std::uint8_t touche) {
 	return touche / 12 + 1;
 }
 
-std::string ToString(Note note) {
-	switch (note) {
-	case A:
-		return "A";
-	case Bb:
-		return "A#";
-	case B:
-		return "B";
-	case C:
-		return "C";
-	case Db:
-		return "C#";
-	case D:
-		return "D";
-	case Eb:
-		return "D#";
-	case E:
-		return "E";
-	case F:
-		return "F";
-	case Gb:
-		return "F#";
-	case G:
-		return "G";
-	case Ab:
-		return "G#";
-	default:
+static constexpr std::array<std::string_view, Note::TOTAL> NOTE_NAMES = {
+	"A", "A#", "B", "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#",
+};
+
+// same order as ChordType
+static constexpr std::array<std::string_view, static_cast<std::size_t>(ChordType::COUNT)> CHORD_NAMES = {
+	"Majeur", "Mineur", "Dim", "Majeur7", "Mineur7", "Sus",
+};
+
+std::string_view GetName(Note note) {
+	if (note >= Note::TOTAL)
 		return "wtf";
-	}
+	return NOTE_NAMES[note];
 }
 
-std::string ToString(ChordType chord) {
-	switch (chord) {
-	case ChordType::Major:
-		return "Majeur";
-	case ChordType::Minor:
-		return "Mineur";
-	case ChordType::Dim:
-		return "Dim";
-	case ChordType::Sus:
-		return "Sus";
-	case ChordType::Major7:
-		return "Majeur7";
-	case ChordType::Minor7:
-		return "Mineur7";
-	default:
+std::string_view GetName(ChordType chord) {
+	if (chord >= ChordType::COUNT)
 		return "";
+	return CHORD_NAMES[static_cast<std::size_t>(chord)];
+}
+
+// same order as ChordType
+static constexpr std::array<std::string_view, static_cast<std::size_t>(ChordType::COUNT)> SYMBOL_SUFFIXES = {
+	"", "m", "dim", "7", "m7", "sus4",
+};
+
+// Notes of the letters from A to G
+static constexpr Note LETTER_NOTES[] = { Note::A, Note::B, Note::C, Note::D, Note::E, Note::F, Note::G };
+
+// Compared character by character, the prefixes are short literals
+static bool Consume(std::string_view& text, std::string_view prefix) {
+	if (text.size() < prefix.size())
+		return false;
+	for (std::size_t i = 0; i < prefix.size(); i++) {
+		if (text[i] != prefix[i])
+			return false;
 	}
+	text.remove_prefix(prefix.size());
+	return true;
+}
+
+static bool Contains(std::string_view text, std::string_view part) {
+	for (; text.size() >= part.size(); text.remove_prefix(1)) {
+		std::string_view rest = text;
+		if (Consume(rest, part))
+			return true;
+	}
+	return false;
+}
+
+// Longest first when one is the prefix of another
+static constexpr std::string_view SUFFIX_TOKENS[] = {
+	"maj", "Maj", "min", "mi", "dim", "aug", "sus", "add", "alt", "no", "M", "m", "-", "+", "o", "b", "#", "(", ")", ",",
+	"\xE2\x99\xAD", "\xE2\x99\xAF", "\xC2\xB0", "\xC3\xB8", "\xCE\x94",
+};
+
+static bool IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// What follows the root : qualities, degrees and alterations ("m7b5", "add9", "sus2/4", "6/9", "7(#9)"), then an
+// optional bass note. Section labels ("Chorus", "Bridge", "Coda") are not.
+static bool IsChordSuffix(std::string_view text) {
+	while (!text.empty()) {
+		if (IsDigit(text[0])) {
+			text.remove_prefix(1);
+			continue;
+		}
+		if (text[0] == '/') {
+			text.remove_prefix(1);
+			if (!text.empty() && IsDigit(text[0]))
+				continue;
+			if (text.empty() || text[0] < 'A' || text[0] > 'G')
+				return false;
+			text.remove_prefix(1);
+			if (!Consume(text, "#") && !Consume(text, "\xE2\x99\xAF") && !Consume(text, "b"))
+				Consume(text, "\xE2\x99\xAD");
+			return text.empty();
+		}
+		bool found = false;
+		for (std::string_view token : SUFFIX_TOKENS) {
+			if (Consume(text, token)) {
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			return false;
+	}
+	return true;
+}
+
+static bool IsSeventh(std::string_view text) {
+	return !text.empty() && (text[0] == '7' || text[0] == '9' || text[0] == '1');
+}
+
+bool ParseChordSymbol(std::string_view symbol, Note& root, ChordType& type) {
+	if (symbol.empty() || symbol[0] < 'A' || symbol[0] > 'G')
+		return false;
+	int note = LETTER_NOTES[symbol[0] - 'A'];
+	symbol.remove_prefix(1);
+	if (Consume(symbol, "#") || Consume(symbol, "\xE2\x99\xAF"))
+		note++;
+	else if (Consume(symbol, "b") || Consume(symbol, "\xE2\x99\xAD"))
+		note--;
+	if (!IsChordSuffix(symbol))
+		return false;
+	root = Note((note + Note::TOTAL) % Note::TOTAL);
+
+	std::string_view quality = symbol;
+	for (std::size_t i = 0; i < symbol.size(); i++) {
+		if (symbol[i] == '/') {
+			quality = symbol.substr(0, i);  // bass
+			break;
+		}
+	}
+	if (Contains(quality, "sus")) {
+		type = ChordType::Sus;
+	} else if (Consume(quality, "dim") || Consume(quality, "o") || Consume(quality, "\xC2\xB0") || Consume(quality, "\xC3\xB8")) {
+		type = ChordType::Dim;
+	} else if (Consume(quality, "maj") || Consume(quality, "Maj") || Consume(quality, "M") || Consume(quality, "\xCE\x94")) {
+		type = ChordType::Major;  // the major seventh is nearer the triad than the dominant seventh
+	} else if (Consume(quality, "min") || Consume(quality, "mi") || Consume(quality, "m") || Consume(quality, "-")) {
+		if (Contains(quality, "b5"))
+			type = ChordType::Dim;  // half diminished
+		else
+			type = IsSeventh(quality) ? ChordType::Minor7 : ChordType::Minor;  // "mMaj7" too, the triad for the same reason
+	} else {
+		// "7", "9", "13" or the triad with "6", "5", "add9", "aug", "+"
+		type = IsSeventh(quality) ? ChordType::Major7 : ChordType::Major;
+	}
+	return true;
+}
+
+std::string_view GetSymbolSuffix(ChordType type) {
+	if (type >= ChordType::COUNT)
+		return "";
+	return SYMBOL_SUFFIXES[static_cast<std::size_t>(type)];
+}
+
+std::string ToString(Note note) {
+	GP_ALLOC_TAG(Music);
+	return std::string(GetName(note));
+}
+
+std::string ToString(ChordType chord) {
+	GP_ALLOC_TAG(Music);
+	return std::string(GetName(chord));
 }
 
 std::string ToString(const Tab& tab) {
+	GP_ALLOC_TAG(Music);
 	std::string result;
 	for (int fret : tab) {
 		if (fret == data::EMPTY_TAB) {
@@ -92,6 +205,7 @@ std::string ToString(const Tab& tab) {
 }
 
 std::string ToString(const ChordSave& chord) {
+	GP_ALLOC_TAG(Music);
 	return ToString(chord.note) + " " + ToString(chord.type);
 }
 
@@ -192,5 +306,242 @@ ChordOffsets GetChordOffsets(Note note, ChordType type) {
 	}
 }
 
+// Every set of pitch classes for every bass, root * COUNT + type or NO_CHORD
+static constexpr std::uint8_t NO_CHORD = 0xFF;
+static constexpr int PITCH_CLASS_SETS = 1 << Note::TOTAL;
+typedef std::array<std::uint8_t, PITCH_CLASS_SETS * Note::TOTAL> ChordTable;
+
+static int CountNotes(PitchClasses pitchClasses) {
+	int count = 0;
+	for (; pitchClasses != 0; pitchClasses &= pitchClasses - 1) {
+		count++;
+	}
+	return count;
+}
+
+static std::unique_ptr<ChordTable> BuildChordTable() {
+	constexpr int TYPES = static_cast<int>(ChordType::COUNT);
+	std::array<PitchClasses, Note::TOTAL * TYPES> chords;
+	for (int root = 0; root < Note::TOTAL; root++) {
+		for (int type = 0; type < TYPES; type++) {
+			PitchClasses notes = 0;
+			for (std::uint8_t offset : GetChordOffsets(Note(root), ChordType(type))) {
+				if (offset != data::EMPTY_NOTE)
+					notes |= 1 << ((root + offset) % Note::TOTAL);
+			}
+			chords[root * TYPES + type] = notes;
+		}
+	}
+
+	auto table = std::make_unique<ChordTable>();
+	for (int pitchClasses = 0; pitchClasses < PITCH_CLASS_SETS; pitchClasses++) {
+		for (int bass = 0; bass < Note::TOTAL; bass++) {
+			std::uint8_t best = NO_CHORD;
+			int bestScore = 0;
+			for (int chord = 0; chord < Note::TOTAL * TYPES; chord++) {
+				int matching = CountNotes(pitchClasses & chords[chord]);
+				if (matching < 2)
+					continue;
+				int missing = CountNotes(chords[chord] & ~pitchClasses);
+				int extra = CountNotes(pitchClasses & ~chords[chord]);
+				// a complete seventh beats its triad plus an extra note, a complete triad beats the seventh missing a note
+				int score = 4 * (4 * matching - 3 * missing - 2 * extra) + (chord / TYPES == bass ? 1 : 0);
+				if (score > bestScore) {
+					bestScore = score;
+					best = static_cast<std::uint8_t>(chord);
+				}
+			}
+			(*table)[pitchClasses * Note::TOTAL + bass] = best;
+		}
+	}
+	return table;
+}
+
+bool RecognizeChord(PitchClasses pitchClasses, Note bass, Note& root, ChordType& type) {
+	static const std::unique_ptr<ChordTable> table = BuildChordTable();
+	if (bass >= Note::TOTAL || pitchClasses >= PITCH_CLASS_SETS)
+		return false;
+	std::uint8_t chord = (*table)[pitchClasses * Note::TOTAL + bass];
+	if (chord == NO_CHORD)
+		return false;
+	root = Note(chord / static_cast<int>(ChordType::COUNT));
+	type = ChordType(chord % static_cast<int>(ChordType::COUNT));
+	return true;
+}
+
+static void InverseChord(ChordOffsets& notes, int inversion) {
+	for (int i = 0; i < inversion; i++) {
+		std::uint8_t lastNote = notes[notes[3] == data::EMPTY_NOTE ? 2 : 3] - 12;
+		std::uint8_t count = notes[3] == data::EMPTY_NOTE ? 2 : 3;
+		for (int j = count; j > 0; j--) {
+			notes[j] = notes[j - 1];
+		}
+		notes[0] = lastNote;
+	}
+}
+
+static ChordOffsets OffsetsToNote(const ChordOffsets& offsets, Note note, int octave) {
+	ChordOffsets notes;
+	for (int i = 0; i < offsets.size(); i++) {
+		if (offsets[i] == data::EMPTY_NOTE) {
+			notes[i] = data::EMPTY_NOTE;
+			continue;
+		}
+		notes[i] = note + offsets[i] + 12 * octave;
+	}
+	return notes;
+}
+
+ChordOffsets GetChordNotes(const ChordSave& chord) {
+	ChordOffsets offsets = GetChordOffsets(chord.note, chord.type);
+	ChordOffsets notes = OffsetsToNote(offsets, chord.note, chord.octave);
+	InverseChord(notes, chord.inversion);
+	return notes;
+}
+
+Tab GetChordTab(const ChordSave& chord, const ChordOffsets& notes, int capo) {
+	if (chord.guitaroPiano) {
+		return FindPianoChord(notes, capo, chord.fretMax);
+	} else {
+		return FindChord(GetChord(chord.note, chord.type), capo);
+	}
+}
+
+// Ratings of the pitch classes above the tonic in a major and a minor context (Krumhansl and Kessler, 1982)
+static constexpr float MAJOR_PROFILE[Note::TOTAL] = { 6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f, 2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f };
+static constexpr float MINOR_PROFILE[Note::TOTAL] = { 6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f, 2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f };
+static constexpr float ROOT_WEIGHT = 2.0f;
+static constexpr float TONE_WEIGHT = 1.0f;
+
+// Pearson correlation of the weights with the profile turned to the tonic, the weights being centered
+static float Correlate(const float* centered, float norm, const float* profile, int tonic) {
+	float mean = 0;
+	for (int i = 0; i < Note::TOTAL; i++) {
+		mean += profile[i];
+	}
+	mean /= Note::TOTAL;
+	float product = 0;
+	float profileNorm = 0;
+	for (int pitchClass = 0; pitchClass < Note::TOTAL; pitchClass++) {
+		const float value = profile[(pitchClass - tonic + Note::TOTAL) % Note::TOTAL] - mean;
+		product += centered[pitchClass] * value;
+		profileNorm += value * value;
+	}
+	return product / std::sqrt(norm * profileNorm);
+}
+
+static bool IsSet(const ChordSave& chord) {
+	return chord.note < Note::TOTAL && chord.type < ChordType::COUNT;
+}
+
+SongAnalysis AnalyzeSong(const save::Song& song) {
+	GP_ALLOC_TAG(Music);
+	SongAnalysis analysis{ { Note::C, false }, 0.0f, {} };
+	float weights[Note::TOTAL] = {};
+	for (const ChordSave& chord : song.chords) {
+		if (!IsSet(chord))
+			continue;
+		for (std::uint8_t offset : GetChordOffsets(chord.note, chord.type)) {
+			if (offset != data::EMPTY_NOTE)
+				weights[(chord.note + offset) % Note::TOTAL] += offset == 0 ? ROOT_WEIGHT : TONE_WEIGHT;
+		}
+	}
+	float mean = 0;
+	for (float weight : weights) {
+		mean += weight;
+	}
+	mean /= Note::TOTAL;
+	float norm = 0;
+	for (float& weight : weights) {
+		weight -= mean;
+		norm += weight * weight;
+	}
+
+	// no chords or every pitch class as often, no key
+	if (norm > 0) {
+		analysis.correlation = -1.0f;
+		for (int tonic = 0; tonic < Note::TOTAL; tonic++) {
+			for (bool minor : { false, true }) {
+				const float correlation = Correlate(weights, norm, minor ? MINOR_PROFILE : MAJOR_PROFILE, tonic);
+				if (correlation > analysis.correlation) {
+					analysis.correlation = correlation;
+					analysis.key = { Note(tonic), minor };
+				}
+			}
+		}
+	}
+
+	analysis.numerals.reserve(song.chords.size());
+	for (const ChordSave& chord : song.chords) {
+		if (IsSet(chord))
+			analysis.numerals.push_back({ static_cast<std::uint8_t>((chord.note - analysis.key.tonic + Note::TOTAL) % Note::TOTAL), chord.type });
+		else
+			analysis.numerals.push_back({ Note::TOTAL, ChordType::Major });
+	}
+	return analysis;
+}
+
+// Semitones above the tonic, the notes out of the major scale as flats
+static constexpr std::array<std::string_view, Note::TOTAL> NUMERAL_NAMES = {
+	"I", "bII", "II", "bIII", "III", "IV", "bV", "V", "bVI", "VI", "bVII", "VII",
+};
+
+std::string ToString(const Numeral& numeral) {
+	if (numeral.interval >= Note::TOTAL || numeral.type >= ChordType::COUNT)
+		return "N.C.";
+	std::string name(NUMERAL_NAMES[numeral.interval]);
+	if (numeral.type == ChordType::Minor || numeral.type == ChordType::Minor7 || numeral.type == ChordType::Dim) {
+		for (char& c : name) {
+			if (c != 'b')
+				c = c - 'A' + 'a';
+		}
+	}
+	if (numeral.type == ChordType::Dim)
+		name += "\xC2\xB0";
+	else if (numeral.type == ChordType::Major7 || numeral.type == ChordType::Minor7)
+		name += "7";
+	else if (numeral.type == ChordType::Sus)
+		name += "sus";
+	return name;
+}
+
+static constexpr std::size_t ANALYSIS_CACHE_MAX = 1 << 16;
+
+void AnalysisCache::Reserve(std::size_t count) {
+	if (m_analyses.size() + count > ANALYSIS_CACHE_MAX)
+		m_analyses.clear();
+}
+
+const SongAnalysis& AnalysisCache::Analyze(const save::Song& song) {
+	GP_ALLOC_TAG(Music);
+	Reserve(1);
+	auto [it, inserted] = m_analyses.try_emplace(save::HashSong(song));
+	if (inserted)
+		it->second = AnalyzeSong(song);
+	return it->second;
+}
+
+void AnalysisCache::AnalyzeSongs(const std::vector<const save::Song*>& songs, std::vector<const SongAnalysis*>& analyses, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Music);
+	Reserve(songs.size());
+	analyses.resize(songs.size());
+	// the first song of every new content, its analysis written by one thread in its own node of the map
+	std::vector<std::pair<const save::Song*, SongAnalysis*>> missing;
+	for (std::size_t i = 0; i < songs.size(); i++) {
+		auto [it, inserted] = m_analyses.try_emplace(save::HashSong(*songs[i]));
+		if (inserted)
+			missing.push_back({ songs[i], &it->second });
+		analyses[i] = &it->second;
+	}
+	parallel::ForEach(missing.size(), [&missing](std::size_t i) {
+		*missing[i].second = AnalyzeSong(*missing[i].first);
+	}, threads);
+}
+
+std::size_t AnalysisCache::GetSize() const {
+	return m_analyses.size();
+}
+
 } // namespace music
 } // namespace gpgui
\ No newline at end of file
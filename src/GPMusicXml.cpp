@@ -0,0 +1,403 @@
+#include "GPMusicXml.h"
+#include "GPMemory.h"
+#include "GPMusic.h"
+#include "GPParallel.h"
+#include "GPTrace.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+
+namespace gpgui {
+namespace musicxml {
+
+// Longest tag, and memory used whatever the size of the score
+static constexpr std::size_t BUFFER_SIZE = 64 * 1024;
+// Same range as the capo of the gui
+static constexpr int MAX_CAPO = 10;
+
+// Tokenizer, a window on the file moved forward token by token
+
+namespace {
+
+class Tokenizer {
+public:
+	Tokenizer(std::FILE* file, Listener& listener) : m_File(file), m_Listener(listener), m_Buffer(BUFFER_SIZE) {}
+
+	bool Run() {
+		for (;;) {
+			if (m_Begin == m_End && !Refill())
+				return true;
+			if (m_Buffer[m_Begin] == '<') {
+				if (!ReadMarkup())
+					return false;
+			} else {
+				ReadText();
+			}
+		}
+	}
+
+private:
+	std::string_view GetView() const { return std::string_view(m_Buffer.data() + m_Begin, m_End - m_Begin); }
+	bool IsFull() const { return m_End - m_Begin == BUFFER_SIZE; }
+
+	// Moves the bytes not read yet to the front and reads the file after them, false when nothing more was read
+	bool Refill() {
+		if (m_EndOfFile || IsFull())
+			return false;
+		std::memmove(m_Buffer.data(), m_Buffer.data() + m_Begin, m_End - m_Begin);
+		m_End -= m_Begin;
+		m_Begin = 0;
+		std::size_t read = std::fread(m_Buffer.data() + m_End, 1, BUFFER_SIZE - m_End, m_File);
+		m_End += read;
+		if (read == 0)
+			m_EndOfFile = true;
+		return read > 0;
+	}
+
+	bool StartsWith(std::string_view prefix) {
+		while (m_End - m_Begin < prefix.size()) {
+			if (!Refill())
+				return false;
+		}
+		return GetView().compare(0, prefix.size(), prefix) == 0;
+	}
+
+	// Position of the terminator from the token start, npos when the file or the buffer ends before it
+	std::size_t Find(std::string_view terminator, std::size_t offset) {
+		for (;;) {
+			std::size_t found = GetView().find(terminator, offset);
+			if (found != std::string_view::npos)
+				return found;
+			if (!Refill())
+				return std::string_view::npos;
+		}
+	}
+
+	// Goes past the terminator, only its length being kept in the buffer while searching
+	bool Skip(std::string_view terminator, std::size_t offset) {
+		for (;;) {
+			std::size_t found = GetView().find(terminator, offset);
+			if (found != std::string_view::npos) {
+				m_Begin += found + terminator.size();
+				return true;
+			}
+			m_Begin = std::max(m_Begin + offset, m_End - std::min(m_End, terminator.size() - 1));
+			offset = 0;
+			if (!Refill())
+				return false;
+		}
+	}
+
+	void ReadText() {
+		for (;;) {
+			std::string_view view = GetView();
+			std::size_t tag = view.find('<');
+			if (tag != std::string_view::npos || !Refill()) {
+				std::string_view text = view.substr(0, tag);
+				m_Listener.OnText(text);
+				m_Begin += text.size();
+				return;
+			}
+		}
+	}
+
+	// End of a tag, the quoted attribute values may hold '>'
+	std::size_t FindTagEnd() {
+		char quote = 0;
+		for (std::size_t i = 1;; i++) {
+			if (m_Begin + i == m_End && !Refill())
+				return std::string_view::npos;
+			char c = m_Buffer[m_Begin + i];
+			if (quote != 0) {
+				if (c == quote)
+					quote = 0;
+			} else if (c == '"' || c == '\'') {
+				quote = c;
+			} else if (c == '>') {
+				return i;
+			}
+		}
+	}
+
+	bool ReadMarkup() {
+		if (StartsWith("<!--"))
+			return Skip("-->", 4);
+		if (StartsWith("<![CDATA[")) {
+			std::size_t end = Find("]]>", 9);
+			if (end == std::string_view::npos)
+				return Skip("]]>", 9);  // longer than the buffer, ignored
+			m_Listener.OnText(GetView().substr(9, end - 9));
+			m_Begin += end + 3;
+			return true;
+		}
+		if (StartsWith("<?"))
+			return Skip("?>", 2);
+		if (StartsWith("<!"))
+			return Skip(">", 2);  // doctype, without internal subset in MusicXML
+
+		std::size_t end = FindTagEnd();
+		if (end == std::string_view::npos)
+			return false;
+		std::string_view tag = GetView().substr(1, end - 1);
+		m_Begin += end + 1;
+
+		bool endTag = !tag.empty() && tag.front() == '/';
+		bool emptyTag = !tag.empty() && tag.back() == '/';
+		if (endTag)
+			tag.remove_prefix(1);
+		std::string_view name = tag.substr(0, tag.find_first_of(" \t\r\n/"));
+		if (name.empty())
+			return false;
+		if (!endTag)
+			m_Listener.OnStartElement(name);
+		if (endTag || emptyTag)
+			m_Listener.OnEndElement(name);
+		return true;
+	}
+
+	std::FILE* m_File;
+	Listener& m_Listener;
+	std::vector<char> m_Buffer;
+	std::size_t m_Begin = 0;
+	std::size_t m_End = 0;
+	bool m_EndOfFile = false;
+};
+
+} // namespace
+
+bool Parse(std::FILE* file, Listener& listener) {
+	GP_ALLOC_TAG(Save);
+	Tokenizer tokenizer(file, listener);
+	return tokenizer.Run();
+}
+
+// Harmonies
+
+struct Kind {
+	std::string_view name;
+	music::ChordType type;
+	bool exact;  // false : the chord type sharing the most notes
+};
+
+// The values of <kind>, the seventh of the dictionary being the dominant one
+static constexpr Kind KINDS[] = {
+	{ "major", music::ChordType::Major, true },
+	{ "minor", music::ChordType::Minor, true },
+	{ "diminished", music::ChordType::Dim, true },
+	{ "dominant", music::ChordType::Major7, true },
+	{ "minor-seventh", music::ChordType::Minor7, true },
+	{ "suspended-fourth", music::ChordType::Sus, true },
+	{ "German", music::ChordType::Major7, true },  // the notes of the dominant seventh
+	{ "augmented", music::ChordType::Major, false },
+	{ "major-seventh", music::ChordType::Major, false },
+	{ "diminished-seventh", music::ChordType::Dim, false },
+	{ "augmented-seventh", music::ChordType::Major7, false },
+	{ "half-diminished", music::ChordType::Dim, false },
+	{ "major-minor", music::ChordType::Minor, false },
+	{ "major-sixth", music::ChordType::Major, false },
+	{ "minor-sixth", music::ChordType::Minor, false },
+	{ "dominant-ninth", music::ChordType::Major7, false },
+	{ "major-ninth", music::ChordType::Major, false },
+	{ "minor-ninth", music::ChordType::Minor7, false },
+	{ "dominant-11th", music::ChordType::Major7, false },
+	{ "major-11th", music::ChordType::Major, false },
+	{ "minor-11th", music::ChordType::Minor7, false },
+	{ "dominant-13th", music::ChordType::Major7, false },
+	{ "major-13th", music::ChordType::Major, false },
+	{ "minor-13th", music::ChordType::Minor7, false },
+	{ "suspended-second", music::ChordType::Sus, false },
+	{ "Neapolitan", music::ChordType::Major, false },
+	{ "Italian", music::ChordType::Major7, false },
+	{ "French", music::ChordType::Major7, false },
+	{ "pedal", music::ChordType::Major, false },
+	{ "power", music::ChordType::Major, false },
+	{ "Tristan", music::ChordType::Dim, false },
+	{ "other", music::ChordType::Major, false },
+};
+
+// Notes of the steps from A to G
+static constexpr music::Note STEP_NOTES[] = { music::A, music::B, music::C, music::D, music::E, music::F, music::G };
+
+// Longest text kept, the values read are short
+static constexpr std::size_t MAX_TEXT = 255;
+
+static constexpr std::pair<std::string_view, char> ENTITIES[] = {
+	{ "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' },
+};
+
+// The predefined entities of xml are decoded, the others are left as they are
+static void AssignText(std::string& result, std::string_view text) {
+	result.clear();
+	while (!text.empty()) {
+		std::size_t entity = text.find('&');
+		result.append(text.data(), std::min(entity, text.size()));
+		if (entity == std::string_view::npos)
+			return;
+		text.remove_prefix(entity);
+		std::size_t length = 1;
+		for (const auto& [name, character] : ENTITIES) {
+			if (text.compare(0, name.size(), name) == 0) {
+				result += character;
+				length = name.size();
+				break;
+			}
+		}
+		if (length == 1)
+			result += '&';
+		text.remove_prefix(length);
+	}
+}
+
+namespace {
+
+class HarmonyCollector : public Listener {
+public:
+	HarmonyCollector(save::Song& song, Stats& stats) : m_Song(song), m_Stats(stats) {}
+
+	void OnStartElement(std::string_view name) {
+		m_TextSize = 0;
+		if (name == "part") {
+			m_Part++;
+		} else if (name == "harmony") {
+			m_InHarmony = true;
+			m_Step = -1;
+			m_Alter = 0;
+			m_Kind = nullptr;
+			m_NoChord = false;
+		}
+	}
+
+	void OnText(std::string_view text) {
+		std::size_t size = std::min(text.size(), MAX_TEXT - m_TextSize);
+		std::memcpy(m_Text.data() + m_TextSize, text.data(), size);
+		m_TextSize += size;
+	}
+
+	void OnEndElement(std::string_view name) {
+		m_Text[m_TextSize] = 0;
+		std::string_view text = GetText();
+		if (m_InHarmony) {
+			if (name == "root-step") {
+				if (text.size() == 1 && text[0] >= 'A' && text[0] <= 'G')
+					m_Step = STEP_NOTES[text[0] - 'A'];
+			} else if (name == "root-alter") {
+				m_Alter = static_cast<int>(std::lround(std::strtod(text.data(), nullptr)));
+			} else if (name == "kind") {
+				m_NoChord = text == "none";
+				m_Kind = &KINDS[std::size(KINDS) - 1];  // other
+				for (const Kind& kind : KINDS) {
+					if (kind.name == text)
+						m_Kind = &kind;
+				}
+			} else if (name == "harmony") {
+				m_InHarmony = false;
+				AddHarmony();
+			}
+		} else if (name == "work-title") {
+			AssignText(m_WorkTitle, text);
+		} else if (name == "movement-title") {
+			AssignText(m_MovementTitle, text);
+		} else if (name == "capo" && !m_HasCapo) {
+			m_HasCapo = true;
+			m_Song.capo = static_cast<save::CapoPosType>(std::clamp(std::atoi(text.data()), 0, MAX_CAPO));
+		}
+		m_TextSize = 0;
+	}
+
+	const std::string& GetTitle() const { return m_WorkTitle.empty() ? m_MovementTitle : m_WorkTitle; }
+
+private:
+	std::string_view GetText() const {
+		std::string_view text(m_Text.data(), m_TextSize);
+		std::size_t first = text.find_first_not_of(" \t\r\n");
+		if (first == std::string_view::npos)
+			return std::string_view(m_Text.data() + m_TextSize, 0);  // null terminated
+		return text.substr(first, text.find_last_not_of(" \t\r\n") + 1 - first);
+	}
+
+	void AddHarmony() {
+		if (m_HarmonyPart >= 0 && m_Part != m_HarmonyPart)
+			return;  // the chords of the other parts would repeat them
+		if (m_Step < 0 || m_NoChord || m_Kind == nullptr) {
+			m_Stats.skippedHarmonies++;
+			return;
+		}
+		m_HarmonyPart = m_Part;
+		if (!m_Kind->exact)
+			m_Stats.approximatedKinds++;
+
+		save::ChordSave chord;
+		chord.note = music::Note(((m_Step + m_Alter) % music::TOTAL + music::TOTAL) % music::TOTAL);
+		chord.type = m_Kind->type;
+		chord.guitaroPiano = true;
+		chord.octave = 2;
+		chord.inversion = 0;
+		chord.fretMax = 5;
+		m_Song.chords.push_back(chord);
+		m_Stats.chords++;
+	}
+
+	save::Song& m_Song;
+	Stats& m_Stats;
+	std::array<char, MAX_TEXT + 1> m_Text;
+	std::size_t m_TextSize = 0;
+	int m_Part = 0;
+	int m_HarmonyPart = -1;
+	bool m_HasCapo = false;
+	std::string m_WorkTitle;
+	std::string m_MovementTitle;
+
+	bool m_InHarmony = false;
+	int m_Step;
+	int m_Alter;
+	const Kind* m_Kind;
+	bool m_NoChord;
+};
+
+} // namespace
+
+bool ImportSong(const std::string& fileName, save::Song& song, Stats& stats) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Save);
+	std::FILE* file = std::fopen(fileName.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	song = save::Song(std::filesystem::path(fileName).stem().string(), 0);
+	HarmonyCollector collector(song, stats);
+	bool parsed = Parse(file, collector);
+	std::fclose(file);
+	if (!collector.GetTitle().empty())
+		song.title = collector.GetTitle();
+	return parsed;
+}
+
+std::size_t ImportFiles(const std::vector<std::string>& fileNames, const std::string& outputDirectory, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	std::atomic<std::size_t> written{ 0 };
+	parallel::ForEach(fileNames.size(), [&](std::size_t i) {
+		save::Song song("", 0);
+		Stats stats;
+		if (!ImportSong(fileNames[i], song, stats)) {
+			fprintf(stderr, "Unable to read %s\n", fileNames[i].c_str());
+			return;
+		}
+		if (song.chords.empty()) {
+			fprintf(stderr, "No harmony found in %s\n", fileNames[i].c_str());
+			return;
+		}
+		if (stats.approximatedKinds > 0)
+			fprintf(stderr, "%s : %zu/%zu chords imported as the nearest chord type\n", fileNames[i].c_str(), stats.approximatedKinds, stats.chords);
+		save::SaveSongToFile(song, (std::filesystem::path(outputDirectory) / (save::GetFileName(song.title) + ".gp")).string());
+		written++;
+	}, threads);
+	return written;
+}
+
+} // namespace musicxml
+} // namespace gpgui
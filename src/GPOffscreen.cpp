@@ -0,0 +1,232 @@
+#include "GPOffscreen.h"
+#include "GPImage.h"
+#include "GPParallel.h"
+#include "GPRenderer.h"
+#include "GPTrace.h"
+#include "ShaderProgram.h"
+
+#ifdef GP_HAVE_EGL
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+namespace gpgui {
+namespace offscreen {
+
+using ChordSave = save::ChordSave;
+
+static std::string GetDiagramName(const ChordSave& chord) {
+	return music::ToString(chord.note) + "_" + music::ToString(chord.type);
+}
+
+std::vector<DiagramJob> GetDictionaryJobs(const std::string& directory) {
+	std::vector<DiagramJob> jobs;
+	for (int note = 0; note < music::Note::TOTAL; note++) {
+		for (int type = 0; type < static_cast<int>(music::ChordType::COUNT); type++) {
+			for (int inversion = 0; inversion < 4; inversion++) {
+				ChordSave chord;
+				chord.note = music::Note(note);
+				chord.type = music::ChordType(type);
+				chord.guitaroPiano = true;
+				chord.octave = 2;
+				chord.inversion = inversion;
+				chord.fretMax = 5;
+				jobs.push_back({ chord, 0, directory + "/" + GetDiagramName(chord) + "_" + std::to_string(inversion) + ".png" });
+			}
+		}
+	}
+	return jobs;
+}
+
+std::vector<DiagramJob> GetSongJobs(const save::Song& song, const std::string& directory) {
+	std::vector<DiagramJob> jobs;
+	for (std::size_t i = 0; i < song.chords.size(); i++) {
+		const ChordSave& chord = song.chords[i];
+		jobs.push_back({ chord, song.capo, directory + "/" + std::to_string(i) + "_" + GetDiagramName(chord) + ".png" });
+	}
+	return jobs;
+}
+
+#ifdef GP_HAVE_EGL
+
+static EGLDisplay GetDisplay() {
+	static EGLDisplay display = []() {
+		EGLDisplay display = EGL_NO_DISPLAY;
+		// surfaceless Mesa does not need any gpu nor display server (llvmpipe)
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay != nullptr)
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display == EGL_NO_DISPLAY)
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (display != EGL_NO_DISPLAY && !eglInitialize(display, nullptr, nullptr))
+			display = EGL_NO_DISPLAY;
+		return display;
+	}();
+	return display;
+}
+
+// One per thread : an OpenGL context rendering into a framebuffer object
+class Context {
+public:
+	Context(int width, int height) : m_Width(width), m_Height(height) {}
+
+	~Context() {
+		if (m_Context == EGL_NO_CONTEXT)
+			return;
+		// the OpenGL calls need the context current and the functions loaded, Init may have failed before
+		if (m_GlLoaded) {
+			m_Shader.reset();
+			if (m_Framebuffer != 0)
+				glDeleteFramebuffers(1, &m_Framebuffer);
+			if (m_Renderbuffer != 0)
+				glDeleteRenderbuffers(1, &m_Renderbuffer);
+		}
+		if (m_Current)
+			eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(m_Display, m_Context);
+	}
+
+	bool Init() {
+		m_Display = GetDisplay();
+		if (m_Display == EGL_NO_DISPLAY)
+			return false;
+
+		static const EGLint configAttribs[] = {
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config = EGL_NO_CONFIG_KHR;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(m_Display, configAttribs, &config, 1, &configCount) || configCount == 0)
+			config = EGL_NO_CONFIG_KHR;  // we never draw to a surface (EGL_KHR_no_config_context)
+
+		static const EGLint contextAttribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		eglBindAPI(EGL_OPENGL_API);  // per thread
+		m_Context = eglCreateContext(m_Display, config, EGL_NO_CONTEXT, contextAttribs);
+		if (m_Context == EGL_NO_CONTEXT)
+			return false;
+		if (!eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_Context))
+			return false;
+		m_Current = true;
+
+		if (!InitGlew())
+			return false;
+		m_GlLoaded = true;
+
+		glGenRenderbuffers(1, &m_Renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_Width, m_Height);
+		glGenFramebuffers(1, &m_Framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_Renderbuffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			return false;
+
+		m_Shader = renderer::CreateWidgetShader();
+		data::InitBatch(m_Batch);
+		return true;
+	}
+
+	void Render(const renderer::WidgetState& state, image::Image& image) {
+		renderer::BuildWidgetBatch(m_Batch, m_Scene, state);
+
+		// the widgets only cover the bottom of the window, the viewport is stretched so they fill the image
+		glViewport(0, 0, m_Width, static_cast<GLsizei>(m_Height / renderer::WIDGETS_HEIGHT));
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		renderer::DrawWidgetBatch(m_Batch, *m_Shader);
+
+		image.width = m_Width;
+		image.height = m_Height;
+		image.rgba.resize(static_cast<std::size_t>(m_Width) * m_Height * 4);
+		glReadPixels(0, 0, m_Width, m_Height, GL_RGBA, GL_UNSIGNED_BYTE, image.rgba.data());
+		image::FlipVertically(image);
+	}
+
+private:
+	int m_Width, m_Height;
+	EGLDisplay m_Display = EGL_NO_DISPLAY;
+	EGLContext m_Context = EGL_NO_CONTEXT;
+	bool m_Current = false;  // made current by Init
+	bool m_GlLoaded = false;  // current, and the OpenGL functions loaded
+	GLuint m_Framebuffer = 0, m_Renderbuffer = 0;
+	std::unique_ptr<ShaderProgram> m_Shader;
+	data::Batch m_Batch;
+	scene::Scene m_Scene;
+
+	static bool InitGlew() {
+		// function pointers are shared by every context of the same driver
+		static std::once_flag glewFlag;
+		static bool glewLoaded = false;
+		std::call_once(glewFlag, []() {
+			glewExperimental = GL_TRUE;
+			GLenum error = glewInit();
+			// glew may fail to find a glx display while still loading the gl functions
+			glewLoaded = error == GLEW_OK || error == GLEW_ERROR_NO_GLX_DISPLAY;
+		});
+		return glewLoaded;
+	}
+};
+
+bool IsAvailable() {
+	return GetDisplay() != EGL_NO_DISPLAY;
+}
+
+std::size_t ExportDiagrams(const std::vector<DiagramJob>& jobs, const ExportOptions& options) {
+	GP_TRACE_FUNCTION();
+
+	std::atomic<std::size_t> written{ 0 };
+	std::atomic<std::size_t> nextJob{ 0 };
+
+	unsigned threadCount = options.threads == 0 ? parallel::GetThreadCount() : options.threads;
+	threadCount = static_cast<unsigned>(std::min<std::size_t>(threadCount, std::max<std::size_t>(jobs.size(), 1)));
+
+	parallel::RunWorkers(threadCount, [&](unsigned) {
+		Context context(options.width, options.height);
+		if (!context.Init()) {
+			std::fprintf(stderr, "Unable to create an offscreen OpenGL context\n");
+			return;
+		}
+
+		image::Image image;
+		for (std::size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+			GP_TRACE_SCOPE("RenderDiagram");
+			const DiagramJob& job = jobs[i];
+
+			context.Render(renderer::GetChordState(job.chord, job.capo), image);
+			if (image::WritePng(image, job.fileName)) {
+				written++;
+			} else {
+				std::fprintf(stderr, "Unable to write %s\n", job.fileName.c_str());
+			}
+		}
+	});
+
+	return written;
+}
+
+#else
+
+bool IsAvailable() {
+	return false;
+}
+
+std::size_t ExportDiagrams(const std::vector<DiagramJob>&, const ExportOptions&) {
+	std::fprintf(stderr, "GuitarPiano was built without headless support (xmake f --headless=y)\n");
+	return 0;
+}
+
+#endif
+
+} // namespace offscreen
+} // namespace gpgui
@@ -0,0 +1,163 @@
+#include "GPProfiler.h"
+#include "GPTrace.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace gpgui {
+namespace profiler {
+
+static constexpr std::size_t PHASE_COUNT = static_cast<std::size_t>(Phase::COUNT);
+
+// Results of timer queries are read a few frames later to avoid stalling the pipeline
+static constexpr std::size_t QUERY_LATENCY = 4;
+
+struct GpuQuery {
+	GLuint id = 0;
+	bool issued = false;
+};
+
+static std::array<History, PHASE_COUNT> cpuHistory{};
+static std::array<History, PHASE_COUNT> gpuHistory{};
+static std::array<float, PHASE_COUNT> cpuCurrentFrame{};
+
+static std::array<std::array<GpuQuery, QUERY_LATENCY>, PHASE_COUNT> gpuQueries;
+static bool gpuTimers = false;
+
+static std::size_t historyOffset = 0;
+static std::size_t frameIndex = 0;
+
+static std::size_t Index(Phase phase) {
+	return static_cast<std::size_t>(phase);
+}
+
+static bool HasTimerQueryExtension() {
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 3 || (major == 3 && minor >= 3))
+		return true;
+
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; i++) {
+		const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (extension != nullptr && std::strcmp(extension, "GL_ARB_timer_query") == 0)
+			return true;
+	}
+	return false;
+}
+
+void Init() {
+	gpuTimers = HasTimerQueryExtension();
+	if (!gpuTimers)
+		return;
+
+	for (auto& queries : gpuQueries) {
+		for (GpuQuery& query : queries) {
+			glGenQueries(1, &query.id);
+		}
+	}
+}
+
+static void CollectGpuResults(std::size_t slot) {
+	for (std::size_t phase = 0; phase < PHASE_COUNT; phase++) {
+		GpuQuery& query = gpuQueries[phase][slot];
+		float milliseconds = 0.0f;
+		if (query.issued) {
+			GLint available = 0;
+			glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+				milliseconds = static_cast<float>(nanoseconds) / 1000000.0f;
+			}
+			query.issued = false;
+		}
+		gpuHistory[phase][historyOffset] = milliseconds;
+	}
+}
+
+void NewFrame() {
+	for (std::size_t phase = 0; phase < PHASE_COUNT; phase++) {
+		cpuHistory[phase][historyOffset] = cpuCurrentFrame[phase];
+	}
+	cpuCurrentFrame.fill(0.0f);
+
+	frameIndex++;
+	// the slot we are about to reuse holds the oldest queries
+	if (gpuTimers)
+		CollectGpuResults(frameIndex % QUERY_LATENCY);
+
+	historyOffset = (historyOffset + 1) % HISTORY_SIZE;
+}
+
+void AddCpuTime(Phase phase, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	std::chrono::duration<float, std::milli> elapsed = end - start;
+	cpuCurrentFrame[Index(phase)] += elapsed.count();
+	trace::Record(GetPhaseName(phase), start, end);
+}
+
+void BeginGpu(Phase phase) {
+	if (!gpuTimers)
+		return;
+	GpuQuery& query = gpuQueries[Index(phase)][frameIndex % QUERY_LATENCY];
+	if (query.issued)  // only one query per phase and per frame
+		return;
+	glBeginQuery(GL_TIME_ELAPSED, query.id);
+}
+
+void EndGpu(Phase phase) {
+	if (!gpuTimers)
+		return;
+	GpuQuery& query = gpuQueries[Index(phase)][frameIndex % QUERY_LATENCY];
+	if (query.issued)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	query.issued = true;
+}
+
+bool HasGpuTimers() {
+	return gpuTimers;
+}
+
+const char* GetPhaseName(Phase phase) {
+	switch (phase) {
+	case Phase::GuiRender:
+		return "gui::Render";
+	case Phase::UpdateBuffers:
+		return "renderer::UpdateBuffers";
+	case Phase::DrawWidgets:
+		return "renderer::DrawWidgets";
+	case Phase::ImGuiRender:
+		return "ImGui_ImplOpenGL3_RenderDrawData";
+	default:
+		return "";
+	}
+}
+
+const History& GetCpuHistory(Phase phase) {
+	return cpuHistory[Index(phase)];
+}
+
+const History& GetGpuHistory(Phase phase) {
+	return gpuHistory[Index(phase)];
+}
+
+std::size_t GetHistoryOffset() {
+	return historyOffset;
+}
+
+PhaseStats GetStats(const History& history) {
+	History sorted = history;
+	auto p50 = sorted.begin() + HISTORY_SIZE / 2;
+	auto p99 = sorted.begin() + HISTORY_SIZE * 99 / 100;
+	std::nth_element(sorted.begin(), p50, sorted.end());
+	std::nth_element(p50, p99, sorted.end());
+	return { *p50, *p99, *std::max_element(p99, sorted.end()) };
+}
+
+} // namespace profiler
+} // namespace gpgui
@@ -0,0 +1,411 @@
+#include "GPProgression.h"
+#include "GPMemory.h"
+#include "GPMusic.h"
+#include "GPTrace.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace gpgui {
+namespace progression {
+
+static constexpr int TYPES = static_cast<int>(music::ChordType::COUNT);
+static constexpr int INTERVALS = music::Note::TOTAL;
+// Longest n-gram having a posting list
+static constexpr int GRAM_MAX = 3;
+// First key of the n-grams of each length, the types of the chords and the intervals between them
+static constexpr std::uint32_t KEY_OFFSETS[GRAM_MAX + 1] = {
+	0,
+	TYPES,
+	TYPES + TYPES * INTERVALS * TYPES,
+	TYPES + TYPES * INTERVALS * TYPES + TYPES * INTERVALS * TYPES * INTERVALS * TYPES,
+};
+static constexpr std::uint32_t SKIP_INTERVAL = 64;
+static constexpr std::uint32_t NO_DOCUMENT = 0xFFFFFFFF;
+
+// A step is a chord : its type in the low 3 bits and the interval from the previous root above,
+// the interval of the first chord after a break being 0
+static constexpr std::uint8_t BREAK = 0xFF;
+
+static int GetType(std::uint8_t step) {
+	return step & 7;
+}
+
+static int GetInterval(std::uint8_t step) {
+	return step >> 3;
+}
+
+static void AppendSteps(const std::vector<save::ChordSave>& chords, std::vector<std::uint8_t>& steps) {
+	int previousRoot = -1;
+	int previousType = -1;
+	for (const save::ChordSave& chord : chords) {
+		const int root = chord.note;
+		const int type = static_cast<int>(chord.type);
+		if (root >= INTERVALS || type >= TYPES) {
+			if (previousRoot >= 0)
+				steps.push_back(BREAK);
+			previousRoot = -1;
+			continue;
+		}
+		if (root == previousRoot && type == previousType)
+			continue;
+		const int interval = previousRoot < 0 ? 0 : (root - previousRoot + INTERVALS) % INTERVALS;
+		steps.push_back(static_cast<std::uint8_t>(interval << 3 | type));
+		previousRoot = root;
+		previousType = type;
+	}
+}
+
+// The interval of the first step is left out, the n-gram starting there
+static std::uint32_t GetKey(const std::uint8_t* steps, int length) {
+	std::uint32_t key = GetType(steps[0]);
+	for (int i = 1; i < length; i++) {
+		key = (key * INTERVALS + GetInterval(steps[i])) * TYPES + GetType(steps[i]);
+	}
+	return KEY_OFFSETS[length - 1] + key;
+}
+
+// Progressions longer than the n-grams : the second step is looked for with memchr, then the others are compared
+static bool Contains(const std::uint8_t* steps, std::size_t count, const std::vector<std::uint8_t>& pattern) {
+	if (count < pattern.size())
+		return false;
+	const std::uint8_t* end = steps + count - pattern.size() + 2;
+	for (const std::uint8_t* second = steps + 1; second < end; second++) {
+		second = static_cast<const std::uint8_t*>(std::memchr(second, pattern[1], end - second));
+		if (second == nullptr)
+			return false;
+		if (second[-1] != BREAK && GetType(second[-1]) == GetType(pattern[0])
+			&& std::memcmp(second + 1, pattern.data() + 2, pattern.size() - 2) == 0)
+			return true;
+	}
+	return false;
+}
+
+static void WriteVarint(std::vector<std::uint8_t>& data, std::uint32_t value) {
+	while (value >= 0x80) {
+		data.push_back(static_cast<std::uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	data.push_back(static_cast<std::uint8_t>(value));
+}
+
+static std::uint32_t ReadVarint(const std::uint8_t* data, std::size_t& offset) {
+	std::uint32_t value = 0;
+	for (int shift = 0;; shift += 7) {
+		const std::uint8_t byte = data[offset++];
+		value |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return value;
+	}
+}
+
+static void Append(Postings& postings, std::uint32_t document) {
+	if (postings.count > 0 && postings.last == document)
+		return;  // repeated in the song
+	if (postings.count > 0 && postings.count % SKIP_INTERVAL == 0)
+		postings.skips.push_back({ postings.last, static_cast<std::uint32_t>(postings.gaps.size()) });
+	WriteVarint(postings.gaps, document - (postings.count > 0 ? postings.last : 0));
+	postings.count++;
+	postings.last = document;
+}
+
+namespace {
+
+// Reads a posting list in order, jumping over the blocks entirely before the target
+class Cursor {
+public:
+	explicit Cursor(const Postings& postings) : m_postings(postings) {}
+
+	// First document not before the target, the targets increasing. False past the end.
+	bool Seek(std::uint32_t target, std::uint32_t& document) {
+		if (m_read > 0 && m_current >= target) {
+			document = m_current;
+			return true;
+		}
+		// skips[k] starts the block k + 1
+		const std::size_t block = m_read / SKIP_INTERVAL;
+		std::size_t skip = block;
+		while (skip < m_postings.skips.size() && m_postings.skips[skip].previous < target)
+			skip++;
+		if (skip > block) {
+			m_current = m_postings.skips[skip - 1].previous;
+			m_offset = m_postings.skips[skip - 1].offset;
+			m_read = static_cast<std::uint32_t>(skip * SKIP_INTERVAL);
+		}
+		while (m_read < m_postings.count) {
+			m_current += ReadVarint(m_postings.gaps.data(), m_offset);
+			m_read++;
+			if (m_current >= target) {
+				document = m_current;
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	const Postings& m_postings;
+	std::size_t m_offset = 0;
+	std::uint32_t m_read = 0;
+	std::uint32_t m_current = 0;
+};
+
+} // namespace
+
+SongId Index::Add(const std::vector<save::ChordSave>& chords) {
+	GP_ALLOC_TAG(Music);
+	const SongId song = static_cast<SongId>(m_documents.size());
+	m_documents.push_back(NO_DOCUMENT);
+	AppendSteps(chords, m_steps);
+	IndexDocument(song);
+	return song;
+}
+
+void Index::Update(SongId song, const std::vector<save::ChordSave>& chords) {
+	if (song >= m_documents.size() || m_documents[song] == NO_DOCUMENT)
+		return;
+	GP_ALLOC_TAG(Music);
+	m_removed[m_documents[song]] = true;
+	m_removedCount++;
+	AppendSteps(chords, m_steps);
+	IndexDocument(song);
+	if (m_removedCount * 2 > m_songs.size())
+		Compact();
+}
+
+void Index::Remove(SongId song) {
+	if (song >= m_documents.size() || m_documents[song] == NO_DOCUMENT)
+		return;
+	GP_ALLOC_TAG(Music);
+	m_removed[m_documents[song]] = true;
+	m_removedCount++;
+	m_documents[song] = NO_DOCUMENT;
+	if (m_removedCount * 2 > m_songs.size())
+		Compact();
+}
+
+void Index::IndexDocument(SongId song) {
+	if (m_postings.empty())
+		m_postings.resize(KEY_OFFSETS[GRAM_MAX]);
+	const std::uint32_t document = static_cast<std::uint32_t>(m_songs.size());
+	const std::size_t end = m_steps.size();
+	for (std::size_t i = m_stepOffsets.back(); i < end; i++) {
+		for (int length = 1; length <= GRAM_MAX && i + length <= end && m_steps[i + length - 1] != BREAK; length++) {
+			Append(m_postings[GetKey(&m_steps[i], length)], document);
+		}
+	}
+	m_stepOffsets.push_back(static_cast<std::uint32_t>(end));
+	m_songs.push_back(song);
+	m_removed.push_back(false);
+	m_documents[song] = document;
+}
+
+void Index::Compact() {
+	GP_TRACE_FUNCTION();
+	std::vector<std::uint8_t> steps;
+	std::vector<std::uint32_t> stepOffsets{ 0 };
+	std::vector<SongId> songs;
+	std::vector<bool> removed;
+	steps.swap(m_steps);
+	stepOffsets.swap(m_stepOffsets);
+	songs.swap(m_songs);
+	removed.swap(m_removed);
+	m_removedCount = 0;
+	for (Postings& postings : m_postings) {
+		postings.gaps.clear();
+		postings.skips.clear();
+		postings.count = 0;
+		postings.last = 0;
+	}
+	for (std::size_t document = 0; document < songs.size(); document++) {
+		if (removed[document])
+			continue;
+		m_steps.insert(m_steps.end(), steps.begin() + stepOffsets[document], steps.begin() + stepOffsets[document + 1]);
+		IndexDocument(songs[document]);
+	}
+}
+
+void Index::Find(const std::vector<save::ChordSave>& progression, std::vector<SongId>& songs) const {
+	GP_TRACE_FUNCTION();
+	songs.clear();
+	std::vector<std::uint8_t> pattern;
+	AppendSteps(progression, pattern);
+	if (pattern.empty() || m_postings.empty() || std::find(pattern.begin(), pattern.end(), BREAK) != pattern.end())
+		return;
+
+	const int length = static_cast<int>(pattern.size());
+	if (length <= GRAM_MAX) {
+		// the n-gram is the progression
+		const Postings& postings = m_postings[GetKey(pattern.data(), length)];
+		std::size_t offset = 0;
+		std::uint32_t document = 0;
+		for (std::uint32_t i = 0; i < postings.count; i++) {
+			document += ReadVarint(postings.gaps.data(), offset);
+			if (!m_removed[document])
+				songs.push_back(m_songs[document]);
+		}
+	} else {
+		// the rarest n-grams first, the candidates only decrease
+		std::vector<const Postings*> lists;
+		for (int i = 0; i + GRAM_MAX <= length; i++) {
+			lists.push_back(&m_postings[GetKey(&pattern[i], GRAM_MAX)]);
+		}
+		std::sort(lists.begin(), lists.end(), [](const Postings* a, const Postings* b) {
+			return a->count < b->count || (a->count == b->count && a < b);
+		});
+		lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+		std::vector<std::uint32_t> documents(lists[0]->count);
+		std::size_t offset = 0;
+		std::uint32_t document = 0;
+		for (std::uint32_t& candidate : documents) {
+			document += ReadVarint(lists[0]->gaps.data(), offset);
+			candidate = document;
+		}
+		for (std::size_t list = 1; list < lists.size() && !documents.empty(); list++) {
+			Cursor cursor(*lists[list]);
+			std::size_t kept = 0;
+			for (std::uint32_t candidate : documents) {
+				if (!cursor.Seek(candidate, document))
+					break;
+				if (document == candidate)
+					documents[kept++] = candidate;
+			}
+			documents.resize(kept);
+		}
+
+		// the n-grams may be in the song without following each other
+		for (std::uint32_t candidate : documents) {
+			if (m_removed[candidate])
+				continue;
+			if (Contains(m_steps.data() + m_stepOffsets[candidate], m_stepOffsets[candidate + 1] - m_stepOffsets[candidate], pattern))
+				songs.push_back(m_songs[candidate]);
+		}
+	}
+	// documents of edited songs are after the others
+	if (!std::is_sorted(songs.begin(), songs.end()))
+		std::sort(songs.begin(), songs.end());
+}
+
+std::size_t Index::GetSongCount() const {
+	return m_songs.size() - m_removedCount;
+}
+
+std::size_t Index::GetByteCount() const {
+	std::size_t bytes = m_postings.capacity() * sizeof(Postings);
+	for (const Postings& postings : m_postings) {
+		bytes += postings.gaps.capacity() + postings.skips.capacity() * sizeof(Skip);
+	}
+	return bytes + m_steps.capacity() + m_stepOffsets.capacity() * sizeof(std::uint32_t) + m_songs.capacity() * sizeof(SongId)
+		+ m_removed.capacity() / 8 + m_documents.capacity() * sizeof(std::uint32_t);
+}
+
+// Semitones of the degrees of the major scale above the tonic
+static constexpr int DEGREE_OFFSETS[] = { 0, 2, 4, 5, 7, 9, 11 };
+// Longest numerals first, "VII" before "VI" and "V"
+static constexpr std::pair<const char*, int> NUMERALS[] = {
+	{ "VII", 6 }, { "VI", 5 }, { "V", 4 }, { "IV", 3 }, { "III", 2 }, { "II", 1 }, { "I", 0 },
+};
+
+static bool Consume(std::string_view& text, std::string_view prefix) {
+	if (text.size() < prefix.size())
+		return false;
+	for (std::size_t i = 0; i < prefix.size(); i++) {
+		if (text[i] != prefix[i])
+			return false;
+	}
+	text.remove_prefix(prefix.size());
+	return true;
+}
+
+// The letters all in the case of the first one
+static bool ConsumeNumeral(std::string_view& text, std::string_view numeral, bool lower) {
+	if (text.size() < numeral.size())
+		return false;
+	for (std::size_t i = 0; i < numeral.size(); i++) {
+		if (text[i] != (lower ? numeral[i] - 'A' + 'a' : numeral[i]))
+			return false;
+	}
+	text.remove_prefix(numeral.size());
+	return true;
+}
+
+// Upper case numerals are major chords and lower case ones minor chords, the seventh following the case
+static bool ParseNumeral(std::string_view token, music::Note& root, music::ChordType& type) {
+	int accidental = 0;
+	if (Consume(token, "b") || Consume(token, "\xE2\x99\xAD"))
+		accidental = -1;
+	else if (Consume(token, "#") || Consume(token, "\xE2\x99\xAF"))
+		accidental = 1;
+	if (token.empty())
+		return false;
+	const bool lower = token[0] >= 'a' && token[0] <= 'z';
+	int degree = -1;
+	for (const std::pair<const char*, int>& numeral : NUMERALS) {
+		if (ConsumeNumeral(token, numeral.first, lower)) {
+			degree = numeral.second;
+			break;
+		}
+	}
+	if (degree < 0)
+		return false;
+	root = music::Note((music::Note::C + DEGREE_OFFSETS[degree] + accidental + music::Note::TOTAL) % music::Note::TOTAL);
+
+	if (token.empty()) {
+		type = lower ? music::ChordType::Minor : music::ChordType::Major;
+	} else if (Consume(token, "dim") || Consume(token, "o") || Consume(token, "\xC2\xB0") || Consume(token, "\xC3\xB8")) {
+		type = music::ChordType::Dim;
+	} else if (Consume(token, "sus")) {
+		type = music::ChordType::Sus;
+	} else if (Consume(token, "maj") || Consume(token, "M") || Consume(token, "\xCE\x94")) {
+		type = lower ? music::ChordType::Minor : music::ChordType::Major;  // the major seventh is nearer the triad
+	} else if (Consume(token, "7")) {
+		type = lower ? music::ChordType::Minor7 : music::ChordType::Major7;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static bool IsSeparator(std::string_view text, std::size_t i) {
+	const char c = text[i];
+	if (c == ' ' || c == '\t' || c == ',' || c == '|')
+		return true;
+	// "C-7" is a minor seventh but "Am-F" two chords
+	if (c == '-')
+		return i + 1 < text.size() && ((text[i + 1] >= 'A' && text[i + 1] <= 'Z') || (text[i + 1] >= 'a' && text[i + 1] <= 'z') || text[i + 1] == '#');
+	return false;
+}
+
+bool ParseProgression(std::string_view text, std::vector<save::ChordSave>& chords) {
+	chords.clear();
+	std::size_t start = 0;
+	for (std::size_t i = 0; i <= text.size(); i++) {
+		// en and em dashes ("I–V–vi–IV") are three bytes long
+		std::size_t separator = 0;
+		if (i == text.size() || IsSeparator(text, i))
+			separator = 1;
+		else if (text.substr(i, 3) == "\xE2\x80\x93" || text.substr(i, 3) == "\xE2\x80\x94")
+			separator = 3;
+		if (separator == 0)
+			continue;
+
+		std::string_view token = text.substr(start, i - start);
+		start = i + separator;
+		i = start - 1;
+		if (token.empty())
+			continue;
+		music::Note root;
+		music::ChordType type;
+		if (!music::ParseChordSymbol(token, root, type) && !ParseNumeral(token, root, type))
+			return false;
+		save::ChordSave chord;
+		chord.note = root;
+		chord.type = type;
+		chords.push_back(chord);
+	}
+	return true;
+}
+
+} // namespace progression
+} // namespace gpgui
@@ -0,0 +1,275 @@
+#include "GPRecognition.h"
+#include "GPAudio.h"
+#include "GPFft.h"
+#include "GPParallel.h"
+#include "GPTrace.h"
+#include "GPWav.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+
+namespace gpgui {
+namespace recognition {
+
+// 170 ms at 48 kHz, fine enough to separate the semitones from 100 Hz
+static constexpr int FRAME_SIZE = 8192;
+static constexpr int HOP_SIZE = FRAME_SIZE / 2;
+// fundamentals of the chords, the harmonics above would be taken for other notes
+static constexpr float MIN_FREQUENCY = 100.0f;
+static constexpr float MAX_FREQUENCY = 700.0f;
+// log compression of the magnitudes, the loudest notes do not hide the others
+static constexpr float COMPRESSION = 100.0f;
+// -50 dB, quieter frames are silences
+static constexpr float SILENCE_POWER = 1e-5f;
+// frames of the majority vote smoothing the chords
+static constexpr int SMOOTHING_FRAMES = 5;
+static constexpr int SILENCE = -1;
+
+static constexpr int CHORD_COUNT = music::Note::TOTAL * static_cast<int>(music::ChordType::COUNT);
+
+typedef std::array<float, music::Note::TOTAL> Chroma;
+
+// Normalized pitch classes of every chord of the dictionary, indexed by note * COUNT + type
+static const std::array<Chroma, CHORD_COUNT>& GetChordTemplates() {
+	static const std::array<Chroma, CHORD_COUNT> templates = []() {
+		std::array<Chroma, CHORD_COUNT> result{};
+		for (int chord = 0; chord < CHORD_COUNT; chord++) {
+			music::Note note = music::Note(chord / static_cast<int>(music::ChordType::COUNT));
+			music::ChordOffsets offsets = music::GetChordOffsets(note, music::ChordType(chord % static_cast<int>(music::ChordType::COUNT)));
+			int count = 0;
+			for (std::uint8_t offset : offsets) {
+				if (offset >= music::Note::TOTAL)
+					continue;  // EMPTY_NOTE of the triads
+				result[chord][(note + offset) % music::Note::TOTAL] = 1;
+				count++;
+			}
+			for (float& value : result[chord]) {
+				value /= std::sqrt(static_cast<float>(count));
+			}
+		}
+		return result;
+	}();
+	return templates;
+}
+
+static save::ChordSave GetChordSave(int chord) {
+	save::ChordSave result;
+	result.note = music::Note(chord / static_cast<int>(music::ChordType::COUNT));
+	result.type = music::ChordType(chord % static_cast<int>(music::ChordType::COUNT));
+	result.guitaroPiano = true;
+	result.octave = 2;
+	result.inversion = 0;
+	result.fretMax = 5;
+	return result;
+}
+
+// Buffers of a recording, allocated once before streaming
+class Recognizer {
+public:
+	explicit Recognizer(int sampleRate)
+		: m_Plan(FRAME_SIZE), m_Window(fft::GetHannWindow(FRAME_SIZE)), m_Samples(FRAME_SIZE, 0.0f),
+		m_Real(FRAME_SIZE), m_Imaginary(FRAME_SIZE), m_Power(FRAME_SIZE / 2 + 1) {
+		// pitch class of every bin in the analysed range, keys count semitones from A
+		m_FirstBin = std::max(1, static_cast<int>(std::ceil(MIN_FREQUENCY * FRAME_SIZE / sampleRate)));
+		int lastBin = std::min(FRAME_SIZE / 2, static_cast<int>(MAX_FREQUENCY * FRAME_SIZE / sampleRate));
+		for (int bin = m_FirstBin; bin <= lastBin; bin++) {
+			float frequency = static_cast<float>(bin) * sampleRate / FRAME_SIZE;
+			int key = static_cast<int>(std::lround(12.0f * std::log2(frequency / 55.0f)));
+			m_PitchClasses.push_back(static_cast<std::uint8_t>(((key % music::Note::TOTAL) + music::Note::TOTAL) % music::Note::TOTAL));
+		}
+	}
+
+	// The newest samples are at the end of the frame
+	float* GetHop() { return m_Samples.data() + FRAME_SIZE - HOP_SIZE; }
+
+	void Slide() { std::copy(m_Samples.begin() + HOP_SIZE, m_Samples.end(), m_Samples.begin()); }
+
+	int ClassifyFrame() {
+		float energy = 0;
+		for (int i = 0; i < FRAME_SIZE; i++) {
+			m_Real[i] = m_Samples[i] * m_Window[i];
+			m_Imaginary[i] = 0;
+			energy += m_Real[i] * m_Real[i];
+		}
+		if (energy / FRAME_SIZE < SILENCE_POWER)
+			return SILENCE;
+
+		m_Plan.Forward(m_Real.data(), m_Imaginary.data());
+		fft::GetPowerSpectrum(m_Real.data(), m_Imaginary.data(), FRAME_SIZE, m_Power.data());
+
+		Chroma chroma{};
+		for (std::size_t i = 0; i < m_PitchClasses.size(); i++) {
+			chroma[m_PitchClasses[i]] += std::log1p(COMPRESSION * std::sqrt(m_Power[m_FirstBin + i]));
+		}
+
+		// cosine between the chromagram and the templates, the norm of the chromagram is the same for all
+		const std::array<Chroma, CHORD_COUNT>& templates = GetChordTemplates();
+		int best = SILENCE;
+		float bestScore = 0;
+		for (int chord = 0; chord < CHORD_COUNT; chord++) {
+			float score = 0;
+			for (int pitch = 0; pitch < music::Note::TOTAL; pitch++) {
+				score += chroma[pitch] * templates[chord][pitch];
+			}
+			if (score > bestScore) {
+				bestScore = score;
+				best = chord;
+			}
+		}
+		return best;
+	}
+
+private:
+	fft::Plan m_Plan;
+	std::vector<float> m_Window;
+	std::vector<float> m_Samples;
+	std::vector<float> m_Real;
+	std::vector<float> m_Imaginary;
+	std::vector<float> m_Power;
+	int m_FirstBin = 0;
+	std::vector<std::uint8_t> m_PitchClasses;
+};
+
+struct Run {
+	int chord;
+	std::size_t start;  // frames
+	std::size_t length;
+};
+
+// Majority vote over the neighbouring frames, removes the isolated errors
+static std::vector<int> SmoothChords(const std::vector<int>& chords) {
+	std::vector<int> smoothed(chords.size());
+	std::array<int, CHORD_COUNT + 1> votes{};
+	for (std::size_t i = 0; i < chords.size(); i++) {
+		std::size_t first = i >= SMOOTHING_FRAMES / 2 ? i - SMOOTHING_FRAMES / 2 : 0;
+		std::size_t last = std::min(chords.size(), i + SMOOTHING_FRAMES / 2 + 1);
+		votes.fill(0);
+		for (std::size_t j = first; j < last; j++) {
+			votes[chords[j] + 1]++;
+		}
+		// ties keep the frame's own chord
+		int best = chords[i];
+		for (int chord = SILENCE; chord < CHORD_COUNT; chord++) {
+			if (votes[chord + 1] > votes[best + 1])
+				best = chord;
+		}
+		smoothed[i] = best;
+	}
+	return smoothed;
+}
+
+static std::vector<Run> GetRuns(const std::vector<int>& chords, std::size_t minLength) {
+	std::vector<Run> runs;
+	for (std::size_t i = 0; i < chords.size(); i++) {
+		if (!runs.empty() && runs.back().chord == chords[i])
+			runs.back().length++;
+		else
+			runs.push_back({ chords[i], i, 1 });
+	}
+
+	// the short runs extend the previous one, or the next one at the beginning
+	std::vector<Run> merged;
+	for (std::size_t i = 0; i < runs.size(); i++) {
+		Run run = runs[i];
+		if (run.length < minLength && runs.size() > 1) {
+			if (!merged.empty()) {
+				merged.back().length += run.length;
+				continue;
+			}
+			if (i + 1 < runs.size()) {
+				runs[i + 1].start = run.start;
+				runs[i + 1].length += run.length;
+				continue;
+			}
+		}
+		if (!merged.empty() && merged.back().chord == run.chord)
+			merged.back().length += run.length;
+		else
+			merged.push_back(run);
+	}
+	return merged;
+}
+
+bool RecognizeChords(wav::Reader& reader, std::vector<Segment>& segments, const Options& options) {
+	GP_TRACE_FUNCTION();
+	if (reader.GetSampleRate() <= 0)
+		return false;
+
+	Recognizer recognizer(reader.GetSampleRate());
+	std::vector<int> chords;
+	// the first frame is centered on the beginning of the recording
+	std::size_t read = reader.Read(recognizer.GetHop(), HOP_SIZE);
+	while (read > 0) {
+		std::fill(recognizer.GetHop() + read, recognizer.GetHop() + HOP_SIZE, 0.0f);
+		chords.push_back(recognizer.ClassifyFrame());
+		recognizer.Slide();
+		read = reader.Read(recognizer.GetHop(), HOP_SIZE);
+	}
+
+	const double hopSeconds = static_cast<double>(HOP_SIZE) / reader.GetSampleRate();
+	std::size_t minLength = static_cast<std::size_t>(std::max(1.0, std::round(options.minChordSeconds / hopSeconds)));
+	segments.clear();
+	for (const Run& run : GetRuns(SmoothChords(chords), minLength)) {
+		if (run.chord != SILENCE)
+			segments.push_back({ GetChordSave(run.chord), run.start * hopSeconds, (run.start + run.length) * hopSeconds });
+	}
+	return true;
+}
+
+save::Song ToSong(const std::vector<Segment>& segments, const std::string& title, const Options& options) {
+	save::Song song(title, 0);
+	if (segments.empty() || options.bpm <= 0)
+		return song;
+
+	// every bar gets the chord heard the longest during it, the silent bars are skipped
+	const double barSeconds = audio::CHORD_BEATS * 60.0 / options.bpm;
+	const long barCount = std::max(1l, std::lround(segments.back().end / barSeconds));
+	std::size_t first = 0;
+	for (long bar = 0; bar < barCount; bar++) {
+		const double start = bar * barSeconds;
+		const double end = start + barSeconds;
+		while (first < segments.size() && segments[first].end <= start) {
+			first++;
+		}
+		const Segment* best = nullptr;
+		double bestDuration = 0;
+		for (std::size_t i = first; i < segments.size() && segments[i].start < end; i++) {
+			double duration = std::min(end, segments[i].end) - std::max(start, segments[i].start);
+			if (duration > bestDuration) {
+				bestDuration = duration;
+				best = &segments[i];
+			}
+		}
+		if (best != nullptr)
+			song.chords.push_back(best->chord);
+	}
+	return song;
+}
+
+std::size_t RecognizeFiles(const std::vector<std::string>& wavFiles, const std::string& outputDirectory, const Options& options, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	std::atomic<std::size_t> written{ 0 };
+	parallel::ForEach(wavFiles.size(), [&](std::size_t i) {
+		wav::Reader reader;
+		std::vector<Segment> segments;
+		if (!reader.Open(wavFiles[i]) || !RecognizeChords(reader, segments, options)) {
+			fprintf(stderr, "Unable to read %s\n", wavFiles[i].c_str());
+			return;
+		}
+		if (segments.empty()) {
+			fprintf(stderr, "No chord heard in %s\n", wavFiles[i].c_str());
+			return;
+		}
+		std::string title = std::filesystem::path(wavFiles[i]).stem().string();
+		save::SaveSongToFile(ToSong(segments, title, options), (std::filesystem::path(outputDirectory) / (title + ".gp")).string());
+		written++;
+	}, threads);
+	return written;
+}
+
+} // namespace recognition
+} // namespace gpgui
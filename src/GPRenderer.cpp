@@ -1,14 +1,18 @@
 #include "GPRenderer.h"
 #include "GPData.h"
+#include "GPFrame.h"
+#include "GPMemory.h"
+#include "GPProfiler.h"
+#include "GPScene.h"
 #include "ShaderProgram.h"
 
 #include <array>
 #include <cmath>
+#include <memory>
 
 namespace gpgui {
 namespace renderer {
 
-using VertexData = data::VertexData;
 using Color = data::Color;
 
 class GPShader : public ShaderProgram {
@@ -50,38 +54,64 @@ enum KeyType : std::uint8_t {
 	Minor
 };
 
-static data::DrawData keyData, stringsData;
+static data::Batch widgetBatch;
+static scene::Scene widgetScene;  // rebuilt at every chord, playback included
+static data::BatchStats frameStats;
 static GPShader gpShader;
-static std::array<std::uint8_t, 7> highlitedKeys; // not 6 to avoid visual glitches with the strings
-static std::array<std::uint8_t, 6> highlitedStrings;
-static int capo = 0;
+static WidgetState widgetState;
 
 constexpr int KEY_NUMBER = 52;
-constexpr float KEYBOARD_HEIGHT = 0.3;
-constexpr float TAB_HEIGHT = 0.3;
 
-bool IsKeyHighlited(int key) {
-	bool result = (highlitedKeys[key / 8] >> (7 - (key % 8))) & 0x1;
+bool IsKeyHighlited(const WidgetState& state, int key) {
+	bool result = (state.highlitedKeys[key / 8] >> (7 - (key % 8))) & 0x1;
 	return result;
 }
 
-void SetKeyHighlight(int key, bool highlight) {
-	bool value = IsKeyHighlited(key);
+void SetKeyHighlight(WidgetState& state, int key, bool highlight) {
+	bool value = IsKeyHighlited(state, key);
 	if (value == highlight)
 		return;
-	highlitedKeys[key / 8] ^= (1 << (7 - (key % 8)));
+	state.highlitedKeys[key / 8] ^= (1 << (7 - (key % 8)));
+}
+
+void SetChord(WidgetState& state, const music::ChordOffsets& notes, const music::Tab& tab) {
+	state.highlitedKeys.fill(0);
+	for (std::uint8_t note : notes) {
+		if (note == data::EMPTY_NOTE)
+			continue;
+		SetKeyHighlight(state, note, true);
+	}
+	for (int i = 0; i < tab.size(); i++) {
+		state.highlitedStrings[i] = static_cast<std::uint8_t>(tab[i]);
+	}
+}
+
+WidgetState GetChordState(const save::ChordSave& chord, int capo) {
+	WidgetState state;
+	state.capo = capo;
+	music::ChordOffsets notes = music::GetChordNotes(chord);
+	SetChord(state, notes, music::GetChordTab(chord, notes, capo));
+	return state;
+}
+
+bool IsKeyHighlited(int key) {
+	return IsKeyHighlited(widgetState, key);
+}
+
+void SetKeyHighlight(int key, bool highlight) {
+	SetKeyHighlight(widgetState, key, highlight);
 }
 
 void SetTab(int tab, int fret) {
-	highlitedStrings[tab] = static_cast<std::uint8_t>(fret);
+	widgetState.highlitedStrings[tab] = static_cast<std::uint8_t>(fret);
 }
 
 void ClearKeyboard() {
-	highlitedKeys.fill(0);
+	widgetState.highlitedKeys.fill(0);
 }
 
 void ClearTab() {
-	highlitedStrings.fill(data::EMPTY_TAB);
+	widgetState.highlitedStrings.fill(data::EMPTY_TAB);
 }
 
 int GetKeyFromWhite(int whiteIndex) {
@@ -127,31 +157,26 @@ int GetKeyFromBlack(int blackIndex) {
 }
 
 void SetCapoPos(int capoPos) {
-	capo = capoPos;
+	widgetState.capo = capoPos;
 }
 
-VertexData GetKeyboardData() {
-	VertexData vertexData;
-	vertexData.reserve(2048);
+static void AddKeyboardShapes(scene::Scene& scene, const WidgetState& state) {
+	constexpr data::Layer LAYER = data::Layer::Keyboard;
 
 	constexpr Color WHITE{ 255, 255, 255 };
 	constexpr Color BLACK{ 0, 0, 0 };
 	constexpr Color GREEN{ 132, 255, 0 };
 	constexpr Color DARK_GREEN{ 57, 190, 0 };
 
-	float whiteColor = data::GetIntColor(WHITE);
-
 	// white background
-	VertexData backgroundData = data::GetRectData(0.0f, 0.0f, 1.0f, KEYBOARD_HEIGHT, whiteColor);
-	vertexData.insert(vertexData.end(), backgroundData.begin(), backgroundData.end());
+	scene::AddRect(scene, LAYER, 0.0f, 0.0f, 1.0f, KEYBOARD_HEIGHT, WHITE);
 
 	// highlited white keys
 	constexpr int WHITE_KEYS_COUNT = 31;
-	static float greenColor = data::GetIntColor(GREEN);
 	for (int i = 0; i < WHITE_KEYS_COUNT; i++) {
 		int touche = GetKeyFromWhite(i);
 
-		if (!IsKeyHighlited(touche))
+		if (!IsKeyHighlited(state, touche))
 			continue;
 
 		float x = (float)i / (float)WHITE_KEYS_COUNT;
@@ -159,29 +184,25 @@ VertexData GetKeyboardData() {
 		float y = 0.0f;
 		float dy = KEYBOARD_HEIGHT;
 
-		VertexData rectData = data::GetRectData(x, y, dx, dy, greenColor);
-		vertexData.insert(vertexData.end(), rectData.begin(), rectData.end());
+		scene::AddRect(scene, LAYER, x, y, dx, dy, GREEN);
 	}
 
 
 	// black borders
 	constexpr float BORDER_THIKNESS = 0.001;
 	constexpr int BORDER_COUNT = 31;
-	static float color = data::GetIntColor(BLACK);
 
 	for (int i = 1; i < BORDER_COUNT; i++) {
 		float centerX = (float)(i) / (float)BORDER_COUNT;
 		float x = centerX - BORDER_THIKNESS / 2.0;
 		float dx = centerX + BORDER_THIKNESS / 2.0;
 
-		VertexData rectData = data::GetRectData(x, 0.0f, dx, KEYBOARD_HEIGHT, color);
-		vertexData.insert(vertexData.end(), rectData.begin(), rectData.end());
+		scene::AddRect(scene, LAYER, x, 0.0f, dx, KEYBOARD_HEIGHT, BLACK);
 	}
 
 	// black keys
 	constexpr float KEY_THIKNESS = 0.02;
 	constexpr float KEY_HEIGHT = KEYBOARD_HEIGHT * 5.0 / 8.0;
-	static float blackColor = data::GetIntColor(BLACK);
 
 	for (int i = 1; i < BORDER_COUNT; i++) {
 		if (i % 7 != 2 && i % 7 != 5) {
@@ -189,36 +210,30 @@ VertexData GetKeyboardData() {
 			float x = centerX - KEY_THIKNESS / 2.0;
 			float dx = centerX + KEY_THIKNESS / 2.0;
 
-			VertexData rectData = data::GetRectData(x, KEYBOARD_HEIGHT - KEY_HEIGHT, dx, KEYBOARD_HEIGHT, blackColor);
-			vertexData.insert(vertexData.end(), rectData.begin(), rectData.end());
+			scene::AddRect(scene, LAYER, x, KEYBOARD_HEIGHT - KEY_HEIGHT, dx, KEYBOARD_HEIGHT, BLACK);
 		}
 	}
 
 	// highlited black keys
 	constexpr float KEY_HIGHLIGHT_BORDER = 0.002f;
-	static float darkGreenColor = data::GetIntColor(DARK_GREEN);
 	for (int i = 1; i < BORDER_COUNT; i++) {
 		if (i % 7 != 2 && i % 7 != 5) {
 			int touche = GetKeyFromBlack(i);
 
-			if (!IsKeyHighlited(touche))
+			if (!IsKeyHighlited(state, touche))
 				continue;
 
 			float centerX = (float)(i) / (float)BORDER_COUNT;
 			float x = centerX - KEY_THIKNESS / 2.0;
 			float dx = centerX + KEY_THIKNESS / 2.0;
 
-			VertexData rectData = data::GetRectData(x + KEY_HIGHLIGHT_BORDER, KEYBOARD_HEIGHT - KEY_HEIGHT + KEY_HIGHLIGHT_BORDER, dx - KEY_HIGHLIGHT_BORDER, KEYBOARD_HEIGHT, darkGreenColor);
-			vertexData.insert(vertexData.end(), rectData.begin(), rectData.end());
+			scene::AddRect(scene, LAYER, x + KEY_HIGHLIGHT_BORDER, KEYBOARD_HEIGHT - KEY_HEIGHT + KEY_HIGHLIGHT_BORDER, dx - KEY_HIGHLIGHT_BORDER, KEYBOARD_HEIGHT, DARK_GREEN);
 		}
 	}
-
-	return vertexData;
 }
 
-VertexData GetStringsData() {
-	VertexData vertexData;
-	vertexData.reserve(2048);
+static void AddStringsShapes(scene::Scene& scene, const WidgetState& state) {
+	constexpr data::Layer LAYER = data::Layer::Strings;
 
 	constexpr float TAB_OFFSET = KEYBOARD_HEIGHT;
 
@@ -233,17 +248,13 @@ VertexData GetStringsData() {
 	constexpr Color CAPO{ 95, 95, 95 };
 
 	// brown background
-	static const float brownColor = data::GetIntColor(BROWN);
-	VertexData brownBackground = data::GetRectData(0.0f, TAB_OFFSET, 1.0f, TAB_OFFSET + TAB_HEIGHT, brownColor);
-	vertexData.insert(vertexData.end(), brownBackground.begin(), brownBackground.end());
+	scene::AddRect(scene, LAYER, 0.0f, TAB_OFFSET, 1.0f, TAB_OFFSET + TAB_HEIGHT, BROWN);
 
 	// the 12 frets
 	constexpr int FRET_COUNT = 12;
 	constexpr float FRET_THIKNESS = 0.01;
 	constexpr float FRET_START = 0.105;
 
-	float silverColor = data::GetIntColor(SILVER);
-
 	for (int i = 0; i < FRET_COUNT; i++) {
 		float centerX = FRET_START;
 		for (int j = 0; j < i; j++) {
@@ -252,14 +263,11 @@ VertexData GetStringsData() {
 		float x = centerX - FRET_THIKNESS / 2;
 		float dx = centerX + FRET_THIKNESS / 2;
 
-		VertexData fretData = data::GetRectData(x, TAB_OFFSET, dx, TAB_OFFSET + TAB_HEIGHT, silverColor);
-		vertexData.insert(vertexData.end(), fretData.begin(), fretData.end());
+		scene::AddRect(scene, LAYER, x, TAB_OFFSET, dx, TAB_OFFSET + TAB_HEIGHT, SILVER);
 	}
 
 	// the 6 strings
 	constexpr float STRING_THIKNESS = 0.01;
-	static const float darkGreenColor = data::GetIntColor(DARK_GREEN);
-	static const float greyColor = data::GetIntColor(GREY);
 
 	for (int i = 0; i < STRING_COUNT; i++) {
 		float stringThikness = STRING_THIKNESS / (((float)i / 3.0f) + 1.0f);
@@ -267,8 +275,7 @@ VertexData GetStringsData() {
 		float y = centerY - stringThikness / 2;
 		float dy = centerY + stringThikness / 2;
 
-		VertexData stringData = data::GetRectData(0.0f, y, 1.0f, dy, highlitedStrings[i] == data::EMPTY_TAB ? greyColor : darkGreenColor);
-		vertexData.insert(vertexData.end(), stringData.begin(), stringData.end());
+		scene::AddRect(scene, LAYER, 0.0f, y, 1.0f, dy, state.highlitedStrings[i] == data::EMPTY_TAB ? GREY : DARK_GREEN);
 	}
 
 	// drawing circles
@@ -291,24 +298,21 @@ VertexData GetStringsData() {
 
 	static const std::vector<int> circlesX = { 3, 5, 7, 9 };
 	for (int i = 0; i < circlesX.size(); i++) {
-		auto circleData = data::GetCircleData(getCircleCenterX(circlesX[i]), TAB_OFFSET + TAB_HEIGHT / 2.0f, circleRadius, data::GetIntColor(WHITE), 20);
-		vertexData.insert(vertexData.end(), circleData.begin(), circleData.end());
+		scene::AddCircle(scene, LAYER, getCircleCenterX(circlesX[i]), TAB_OFFSET + TAB_HEIGHT / 2.0f, circleRadius, WHITE);
 	}
 
 	static const std::vector<int> circlesY = { 1, 5 };
 	for (int i = 0; i < circlesY.size(); i++) {
-		auto circleData = data::GetCircleData(getCircleCenterX(12), getCircleCenterY(circlesY[i]), circleRadius, data::GetIntColor(WHITE), 20);
-		vertexData.insert(vertexData.end(), circleData.begin(), circleData.end());
+		scene::AddCircle(scene, LAYER, getCircleCenterX(12), getCircleCenterY(circlesY[i]), circleRadius, WHITE);
 	}
 
 	// fret highlight
-	float greenColor = data::GetIntColor(GREEN);
 	for (int i = 0; i < STRING_COUNT; i++) {
 
-		if (highlitedStrings[i] == data::EMPTY_TAB || highlitedStrings[i] == 0)
+		if (state.highlitedStrings[i] == data::EMPTY_TAB || state.highlitedStrings[i] == 0)
 			continue;
 
-		int position = highlitedStrings[i];
+		int position = state.highlitedStrings[i];
 
 		float centerY = TAB_OFFSET + (float)(i + 1) / (float)(STRING_COUNT + 1) * TAB_HEIGHT;
 		float y = centerY - (1.0f / (float)(STRING_COUNT + 1) * TAB_HEIGHT) / 2;
@@ -321,28 +325,49 @@ VertexData GetStringsData() {
 		float x = centerX - FRET_THIKNESS / 2 * 6;
 		float dx = centerX - FRET_THIKNESS / 2;
 
-		VertexData fretData = data::GetRectData(x, y, dx, dy, greenColor);
-		vertexData.insert(vertexData.end(), fretData.begin(), fretData.end());
+		scene::AddRect(scene, LAYER, x, y, dx, dy, GREEN);
 	}
 
 	// draw capo
-	static float capoColor = data::GetIntColor(CAPO);
 	constexpr float CAPO_OFFSET = 0.01;
 
-	if (capo != 0) {
+	if (state.capo != 0) {
 		float centerX = FRET_START;
-		for (int j = 0; j < capo - 1; j++) {
+		for (int j = 0; j < state.capo - 1; j++) {
 			centerX += FRET_START / std::pow(2, (float)j / 12.0f);
 		}
 		centerX -= CAPO_OFFSET;
 		float x = centerX - FRET_THIKNESS / 2 * 6;
 		float dx = centerX - FRET_THIKNESS / 2;
 
-		VertexData fretData = data::GetRectData(x, TAB_OFFSET, dx, TAB_OFFSET + TAB_HEIGHT, capoColor);
-		vertexData.insert(vertexData.end(), fretData.begin(), fretData.end());
+		scene::AddRect(scene, LAYER, x, TAB_OFFSET, dx, TAB_OFFSET + TAB_HEIGHT, CAPO);
 	}
+}
+
+std::unique_ptr<ShaderProgram> CreateWidgetShader() {
+	auto shader = std::make_unique<GPShader>();
+	shader->LoadProgram(vertexShader, fragmentShader);
+	return shader;
+}
+
+void BuildScene(scene::Scene& scene, const WidgetState& state) {
+	AddKeyboardShapes(scene, state);
+	AddStringsShapes(scene, state);
+}
+
+void BuildWidgetBatch(data::Batch& batch, scene::Scene& scene, const WidgetState& state) {
+	scene.clear();
+	BuildScene(scene, state);
 
-	return vertexData;
+	data::BatchBegin(batch);
+	scene::SubmitScene(batch, scene);
+	data::BatchEnd(batch);
+}
+
+void DrawWidgetBatch(data::Batch& batch, const ShaderProgram& shader) {
+	shader.Start();
+	data::BatchDraw(batch);
+	shader.Stop();
 }
 
 void InitRendering() {
@@ -350,20 +375,38 @@ void InitRendering() {
 
 	ClearTab();
 
-	keyData = data::GetDrawData(GetKeyboardData());
-	stringsData = data::GetDrawData(GetStringsData());
+	data::InitBatch(widgetBatch);
+	UpdateBuffers();
+}
+
+// Every shape that can be drawn : all keys and strings highlighted, a capo
+static WidgetState GetFullState() {
+	WidgetState state;
+	state.highlitedKeys.fill(0xFF);
+	state.highlitedStrings.fill(1);
+	state.capo = 1;
+	return state;
 }
 
 void UpdateBuffers() {
-	data::UpdateData(keyData, GetKeyboardData());
-	data::UpdateData(stringsData, GetStringsData());
+	GP_PROFILE_CPU(UpdateBuffers);
+	GP_ALLOC_TAG(Renderer);
+	// the first build sizes the buffers for the largest scene, the next ones (playback) never allocate
+	if (widgetScene.empty())
+		BuildWidgetBatch(widgetBatch, widgetScene, GetFullState());
+	BuildWidgetBatch(widgetBatch, widgetScene, widgetState);
+	frame::RequestRedraw();
 }
 
 void DrawWidgets() {
-	gpShader.Start();
-	data::DrawVertexData(keyData);
-	data::DrawVertexData(stringsData);
-	gpShader.Stop();
+	DrawWidgetBatch(widgetBatch, gpShader);
+
+	frameStats = widgetBatch.stats;
+	widgetBatch.stats = {};
+}
+
+const data::BatchStats& GetFrameStats() {
+	return frameStats;
 }
 
 } // namespace renderer
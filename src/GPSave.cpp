@@ -1,8 +1,19 @@
 #include "GPSave.h"
+#include "GPData.h"
+#include "GPHash.h"
+#include "GPMappedFile.h"
+#include "GPMemory.h"
+#include "GPParallel.h"
+#include "GPTrace.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <unordered_set>
 
 namespace gpgui {
 namespace save {
@@ -30,6 +41,7 @@ static void WriteFile(const DataBuffer& buffer, const std::string& fileName) {
 }
 
 void SaveSongToFile(const Song& song, const std::string& fileName) {
+	GP_ALLOC_TAG(Save);
 	DataBuffer buffer;
 
 	WriteData(buffer, &SAVE_VERSION);  // writing file version
@@ -44,26 +56,232 @@ void SaveSongToFile(const Song& song, const std::string& fileName) {
 	WriteFile(buffer, fileName);
 }
 
-static Song LoadSongVersion0(const std::string& data, std::size_t offset, const std::string& filePath) {
+static constexpr std::uint16_t MIDI_TICKS_PER_QUARTER = 480;
+// Midi key of the keyboard key 0, A1
+static constexpr int MIDI_KEY_OFFSET = 33;
+static constexpr std::uint8_t MIDI_PIANO = 0;
+static constexpr std::uint8_t MIDI_NYLON_GUITAR = 24;
+// A note per string at most, more than the piano keys
+static constexpr int MIDI_CHORD_NOTES = static_cast<int>(std::tuple_size<music::Tab>::value);
+// Every note takes at most 4 + 3 bytes to start and as much to end
+static constexpr std::size_t MIDI_CHORD_BYTES = 2 * MIDI_CHORD_NOTES * 7;
+static constexpr std::size_t MIDI_HEADER_BYTES = 128;
+
+// Writes in a buffer sized beforehand, nothing is checked nor reallocated
+class MidiWriter {
+public:
+	explicit MidiWriter(std::uint8_t* data) : m_Data(data) {}
+
+	std::uint8_t* GetData() const { return m_Data; }
+
+	void Write(std::uint8_t byte) { *m_Data++ = byte; }
+
+	void Write(const void* data, std::size_t size) {
+		std::memcpy(m_Data, data, size);
+		m_Data += size;
+	}
+
+	void WriteBigEndian(std::uint32_t value, int bytes) {
+		for (int shift = 8 * (bytes - 1); shift >= 0; shift -= 8) {
+			Write(static_cast<std::uint8_t>(value >> shift));
+		}
+	}
+
+	void WriteVarint(std::uint32_t value) {
+		int shift = 21;
+		while (shift > 0 && (value >> shift) == 0) {
+			shift -= 7;
+		}
+		for (; shift > 0; shift -= 7) {
+			Write(static_cast<std::uint8_t>(0x80 | ((value >> shift) & 0x7F)));
+		}
+		Write(static_cast<std::uint8_t>(value & 0x7F));
+	}
+
+private:
+	std::uint8_t* m_Data;
+};
+
+// Midi keys of a chord, -1 for the unused notes
+static std::array<int, MIDI_CHORD_NOTES> GetMidiKeys(const ChordSave& chord, int capo, MidiVoicing voicing) {
+	std::array<int, MIDI_CHORD_NOTES> keys;
+	keys.fill(-1);
+	music::ChordOffsets notes = music::GetChordNotes(chord);
+	if (voicing == MidiVoicing::Piano) {
+		for (std::size_t i = 0; i < notes.size(); i++) {
+			if (notes[i] != data::EMPTY_NOTE)
+				keys[i] = notes[i] + MIDI_KEY_OFFSET;
+		}
+	} else {
+		music::Tab tab = music::GetChordTab(chord, notes, capo);
+		for (int string = 0; string < MIDI_CHORD_NOTES; string++) {
+			int key = music::GetStringKey(string, tab[string], capo);
+			if (key >= 0)
+				keys[string] = key + MIDI_KEY_OFFSET;
+		}
+	}
+	return keys;
+}
+
+// The whole file in the buffer, whose capacity is kept between songs
+static void WriteMidi(const Song& song, const MidiOptions& options, std::vector<std::uint8_t>& buffer) {
+	const std::size_t titleSize = std::min<std::size_t>(song.title.size(), 0xFFFF);
+	buffer.resize(MIDI_HEADER_BYTES + titleSize + song.chords.size() * MIDI_CHORD_BYTES);
+	MidiWriter writer(buffer.data());
+
+	writer.Write("MThd", 4);
+	writer.WriteBigEndian(6, 4);
+	writer.WriteBigEndian(0, 2);  // format 0, a single track
+	writer.WriteBigEndian(1, 2);
+	writer.WriteBigEndian(MIDI_TICKS_PER_QUARTER, 2);
+
+	writer.Write("MTrk", 4);
+	std::uint8_t* trackSize = writer.GetData();
+	writer.WriteBigEndian(0, 4);  // patched at the end
+	std::uint8_t* trackStart = writer.GetData();
+
+	writer.Write(0);
+	writer.Write("\xFF\x03", 2);  // track name
+	writer.WriteVarint(static_cast<std::uint32_t>(titleSize));
+	writer.Write(song.title.data(), titleSize);
+
+	const float bpm = options.bpm > 0 ? options.bpm : 90;
+	writer.Write(0);
+	writer.Write("\xFF\x51\x03", 3);
+	writer.WriteBigEndian(static_cast<std::uint32_t>(std::lround(60000000.0 / bpm)), 3);
+
+	writer.Write(0);
+	writer.Write("\xFF\x58\x04", 3);  // time signature, 4/4
+	writer.Write("\x04\x02\x18\x08", 4);
+
+	writer.Write(0);
+	writer.Write(0xC0);  // program change
+	writer.Write(options.voicing == MidiVoicing::Piano ? MIDI_PIANO : MIDI_NYLON_GUITAR);
+
+	// note ons of velocity 0 end the notes, the whole track is under the running status of the first one
+	const std::uint32_t chordTicks = static_cast<std::uint32_t>(std::clamp(options.beatsPerChord, 1, MAX_BEATS_PER_CHORD)) * MIDI_TICKS_PER_QUARTER;
+	const std::uint8_t velocity = std::clamp<std::uint8_t>(options.velocity, 1, 127);
+	std::uint32_t delta = 0;
+	bool runningStatus = false;
+	for (const ChordSave& chord : song.chords) {
+		std::array<int, MIDI_CHORD_NOTES> keys = GetMidiKeys(chord, song.capo, options.voicing);
+		for (int key : keys) {
+			if (key < 0 || key > 127)
+				continue;
+			writer.WriteVarint(delta);
+			if (!runningStatus)
+				writer.Write(0x90);
+			runningStatus = true;
+			writer.Write(static_cast<std::uint8_t>(key));
+			writer.Write(velocity);
+			delta = 0;
+		}
+		delta += chordTicks;
+		for (int key : keys) {
+			if (key < 0 || key > 127)
+				continue;
+			writer.WriteVarint(delta);
+			writer.Write(static_cast<std::uint8_t>(key));
+			writer.Write(0);
+			delta = 0;
+		}
+	}
+
+	writer.WriteVarint(delta);
+	writer.Write("\xFF\x2F\x00", 3);  // end of track
+
+	MidiWriter(trackSize).WriteBigEndian(static_cast<std::uint32_t>(writer.GetData() - trackStart), 4);
+	buffer.resize(writer.GetData() - buffer.data());
+}
+
+static bool WriteBuffer(const std::vector<std::uint8_t>& buffer, const std::string& fileName) {
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	return fclose(file) == 0 && written;
+}
+
+bool SaveSongToMidi(const Song& song, const std::string& fileName, const MidiOptions& options) {
+	GP_ALLOC_TAG(Save);
+	std::vector<std::uint8_t> buffer;
+	WriteMidi(song, options, buffer);
+	return WriteBuffer(buffer, fileName);
+}
+
+std::size_t SaveSongsToMidi(const std::vector<Song>& songs, const std::string& directory, const MidiOptions& options, unsigned threads) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Save);
+	std::atomic<std::size_t> next{ 0 };
+	std::atomic<std::size_t> written{ 0 };
+	if (threads == 0)
+		threads = parallel::GetThreadCount();
+	threads = static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(songs.size(), 1)));
+	parallel::RunWorkers(threads, [&](unsigned) {
+		GP_ALLOC_TAG(Save);
+		// one buffer per worker, grown to the longest of its songs
+		std::vector<std::uint8_t> buffer;
+		std::string fileName;
+		for (std::size_t i = next++; i < songs.size(); i = next++) {
+			WriteMidi(songs[i], options, buffer);
+			fileName = directory;
+			fileName += '/';
+			fileName += GetFileName(songs[i].title);
+			fileName += ".mid";
+			if (WriteBuffer(buffer, fileName))
+				written++;
+		}
+	});
+	return written;
+}
+
+static Song LoadSongVersion0(const std::uint8_t* data, std::size_t size, std::size_t offset, const std::string& filePath) {
 	Song song{ "", 0 };
 
-	std::memcpy(&song.capo, data.data() + offset, sizeof(song.capo));  // reading capo pos
+	SongSizeType songSize;
+	if (size < offset + sizeof(song.capo) + sizeof(songSize))
+		return song;
+
+	std::memcpy(&song.capo, data + offset, sizeof(song.capo));  // reading capo pos
 	offset += sizeof(song.capo);
 
-	SongSizeType songSize;
-	std::memcpy(&songSize, data.data() + offset, sizeof(songSize));  // reading song size
+	std::memcpy(&songSize, data + offset, sizeof(songSize));  // reading song size
 
 	offset += sizeof(songSize);
 
+	if (size < offset + songSize * sizeof(ChordSave))
+		return song;
 	song.chords.resize(songSize);
-	std::memcpy(song.chords.data(), data.data() + offset, songSize * sizeof(ChordSave));  // reading chords
+	std::memcpy(song.chords.data(), data + offset, songSize * sizeof(ChordSave));  // reading chords
 
 	song.title = filePath.substr(0, filePath.find_last_of('.'));
 
 	return song;
 }
 
+// Empty title when the bytes are not a song
+static Song LoadSong(const std::uint8_t* data, std::size_t size, const std::string& filePath) {
+	if (size < sizeof(SAVE_VERSION))
+		return { "", 0 };
+
+	std::uint8_t fileVersion;
+	std::memcpy(&fileVersion, data, sizeof(fileVersion));  // reading file save version
+
+	std::size_t offset = sizeof(fileVersion);
+
+	switch (fileVersion) {
+	case 0:
+		return LoadSongVersion0(data, size, offset, filePath);
+
+	default:
+		return { "", 0 };
+	}
+}
+
 Song LoadSongFromFile(const std::string& filePath) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Save);
+
 	std::ifstream fileStream(filePath);
 
 	if (!fileStream)
@@ -73,19 +291,109 @@ Song LoadSongFromFile(const std::string& filePath) {
 	oss << fileStream.rdbuf();
 
 	std::string str = oss.str();
+	return LoadSong(reinterpret_cast<const std::uint8_t*>(str.data()), str.size(), filePath);
+}
 
-	std::uint8_t fileVersion;
-	std::memcpy(&fileVersion, str.data(), sizeof(fileVersion));  // reading file save version
+std::uint64_t HashSong(const Song& song) {
+	return hash::Hash64(song.chords.data(), song.chords.size() * sizeof(ChordSave), song.capo);
+}
 
-	std::size_t offset = sizeof(fileVersion);
+std::string GetFileName(const std::string& title) {
+	std::string fileName = title;
+	std::replace(fileName.begin(), fileName.end(), '/', '-');
+	std::replace(fileName.begin(), fileName.end(), '\\', '-');
+	return fileName;
+}
 
-	switch (fileVersion) {
-	case 0:
-		return LoadSongVersion0(str, offset, filePath);
+std::vector<Song> LoadSongsInDirectory(const std::string& directory) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Save);
 
-	default:
-		return { "", 0 };
+	std::vector<Song> songs;
+	for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+		const auto& path = entry.path();
+		if (path.extension().string() != ".gp")
+			continue;
+
+		Song song = LoadSongFromFile(path.string());
+		if (song.title.empty())
+			continue;
+
+		song.title = path.stem().string();
+		songs.push_back(std::move(song));
+	}
+	return songs;
+}
+
+std::vector<Song> ScanCache::Scan(const std::string& directory) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Save);
+
+	m_scan++;
+	m_stats = {};
+	std::vector<Song> songs;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		const auto& path = entry.path();
+		if (path.extension().string() != ".gp")
+			continue;
+		m_stats.files++;
+
+		const std::string fileName = path.string();
+		std::uintmax_t size = 0;
+		std::int64_t time = 0;
+		if (!file::GetStatus(fileName, size, time))
+			continue;
+		auto [it, inserted] = m_files.try_emplace(fileName);
+		File& file = it->second;
+		file.scan = m_scan;
+		if (!inserted && file.size == size && file.time == time)
+			continue;
+		file.size = size;
+		file.time = time;
+
+		file::MappedFile mapped;
+		if (!mapped.Open(fileName)) {
+			file.time = 0;  // read again at the next scan
+			continue;
+		}
+		m_stats.read++;
+		const std::uint64_t hash = hash::Hash64(mapped.GetData(), mapped.GetSize());
+		// touched, its bytes being the same
+		if (!inserted && file.hash == hash)
+			continue;
+		file.hash = hash;
+
+		auto song = m_songs.find(hash);
+		if (song == m_songs.end()) {
+			m_stats.parsed++;
+			Song parsed = LoadSong(mapped.GetData(), mapped.GetSize(), fileName);
+			if (parsed.title.empty())
+				continue;
+			song = m_songs.emplace(hash, std::move(parsed)).first;
+		}
+		songs.push_back(song->second);
+		songs.back().title = path.stem().string();
 	}
+
+	// the removed files, then the songs of no file
+	if (m_files.size() > m_stats.files) {
+		for (auto it = m_files.begin(); it != m_files.end();) {
+			it = it->second.scan == m_scan ? std::next(it) : m_files.erase(it);
+		}
+		std::unordered_set<std::uint64_t> hashes;
+		for (const auto& [path, file] : m_files) {
+			hashes.insert(file.hash);
+		}
+		for (auto it = m_songs.begin(); it != m_songs.end();) {
+			it = hashes.count(it->first) > 0 ? std::next(it) : m_songs.erase(it);
+		}
+	}
+	return songs;
+}
+
+const ScanStats& ScanCache::GetStats() const {
+	return m_stats;
 }
 
 } // namespace save
@@ -0,0 +1,42 @@
+#include "GPScene.h"
+
+namespace gpgui {
+namespace scene {
+
+static constexpr int CIRCLE_PRECISION = 20;
+
+void AddRect(Scene& scene, data::Layer layer, float x, float y, float dx, float dy, const data::Color& color) {
+	scene.push_back({ ShapeType::Rect, layer, color, x, y, dx, dy });
+}
+
+void AddCircle(Scene& scene, data::Layer layer, float centerX, float centerY, float radius, const data::Color& color) {
+	scene.push_back({ ShapeType::Circle, layer, color, centerX, centerY, radius, radius });
+}
+
+static void AppendShape(data::VertexData& vertexData, const Shape& shape) {
+	float color = data::GetIntColor(shape.color);
+	switch (shape.type) {
+	case ShapeType::Rect:
+		data::AppendRectData(vertexData, shape.x, shape.y, shape.dx, shape.dy, color);
+		break;
+	case ShapeType::Circle:
+		data::AppendCircleData(vertexData, shape.x, shape.y, shape.dx, color, CIRCLE_PRECISION);
+		break;
+	}
+}
+
+void SubmitScene(data::Batch& batch, const Scene& scene) {
+	// consecutive shapes of the same layer are submitted together
+	data::VertexData& vertexData = batch.shapeVertices;
+	vertexData.clear();
+	for (std::size_t i = 0; i < scene.size(); i++) {
+		AppendShape(vertexData, scene[i]);
+		if (i + 1 == scene.size() || scene[i + 1].layer != scene[i].layer) {
+			data::BatchSubmit(batch, data::MakeSortKey(data::DrawState::Flat, scene[i].layer), vertexData);
+			vertexData.clear();
+		}
+	}
+}
+
+} // namespace scene
+} // namespace gpgui
@@ -0,0 +1,321 @@
+#include "GPSearch.h"
+#include "GPMemory.h"
+#include "GPTrace.h"
+
+#include <algorithm>
+
+namespace gpgui {
+namespace search {
+
+// Space, a to z, 0 to 9
+static constexpr int ALPHABET = 37;
+static constexpr std::uint8_t SPACE = 0;
+static constexpr std::uint32_t TRIGRAMS = ALPHABET * ALPHABET * ALPHABET;
+// Bits of the edit distance
+static constexpr std::size_t QUERY_MAX = 64;
+
+static constexpr int SCORE_CHARACTER = 16;
+static constexpr int SCORE_FOLLOWING = 12;  // the character after the previous one
+static constexpr int SCORE_WORD_START = 10;
+static constexpr int SCORE_TITLE_START = 6;
+static constexpr int MAX_GAP_PENALTY = 8;
+
+// Letters of the UTF-8 sequences C3 80 to C3 BF (Latin-1) without their accent, a space for the signs
+static constexpr char LATIN_LETTERS[] = "aaaaaaaceeeeiiiidnooooo ouuuuyts"
+	"aaaaaaaceeeeiiiidnooooo ouuuuyty";
+
+static std::uint8_t GetCode(char c) {
+	if (c >= 'a' && c <= 'z')
+		return static_cast<std::uint8_t>(c - 'a' + 1);
+	if (c >= 'A' && c <= 'Z')
+		return static_cast<std::uint8_t>(c - 'A' + 1);
+	if (c >= '0' && c <= '9')
+		return static_cast<std::uint8_t>(c - '0' + 27);
+	return SPACE;
+}
+
+static void Push(std::vector<std::uint8_t>& codes, std::uint8_t code) {
+	// a single space between the words, none at the start
+	if (code != SPACE || (!codes.empty() && codes.back() != SPACE))
+		codes.push_back(code);
+}
+
+// Appends the codes of the text, the spaces at its end left out
+static void Normalize(std::string_view text, std::vector<std::uint8_t>& codes) {
+	const std::size_t start = codes.size();
+	for (std::size_t i = 0; i < text.size(); i++) {
+		const unsigned char c = static_cast<unsigned char>(text[i]);
+		if (c < 0x80) {
+			Push(codes, GetCode(static_cast<char>(c)));
+		} else if (c == 0xC3 && i + 1 < text.size() && static_cast<unsigned char>(text[i + 1]) >= 0x80 && static_cast<unsigned char>(text[i + 1]) < 0xC0) {
+			Push(codes, GetCode(LATIN_LETTERS[static_cast<unsigned char>(text[++i]) - 0x80]));
+		} else if (c == 0xC5 && i + 1 < text.size() && (text[i + 1] == '\x92' || text[i + 1] == '\x93')) {
+			i++;  // oe ligature
+			Push(codes, GetCode('o'));
+			Push(codes, GetCode('e'));
+		} else if (c >= 0xC0) {
+			Push(codes, SPACE);  // other characters, their continuation bytes are skipped below
+		}
+	}
+	while (codes.size() > start && codes.back() == SPACE)
+		codes.pop_back();
+}
+
+static std::uint32_t GetTrigram(const std::uint8_t* codes) {
+	return (codes[0] * ALPHABET + codes[1]) * ALPHABET + codes[2];
+}
+
+// Leftmost characters of the query in the title from its first character or from a start of word, the best one.
+// False when the query is not a subsequence.
+static bool ScoreSubsequence(const std::uint8_t* title, std::size_t length, const std::vector<std::uint8_t>& query, int& score, bool& contiguous) {
+	bool found = false;
+	for (std::size_t start = 0; start < length; start++) {
+		if (title[start] != query[0] || (found && title[start - 1] != SPACE))
+			continue;
+		int startScore = 0;
+		bool startContiguous = true;
+		std::size_t previous = start;
+		std::size_t position = start;
+		std::size_t matched = 0;
+		while (matched < query.size()) {
+			while (position < length && title[position] != query[matched])
+				position++;
+			if (position == length)
+				break;
+			startScore += SCORE_CHARACTER;
+			if (title[position - 1] == SPACE)
+				startScore += SCORE_WORD_START;
+			if (position == 1)
+				startScore += SCORE_TITLE_START;
+			if (matched > 0) {
+				if (position == previous + 1) {
+					startScore += SCORE_FOLLOWING;
+				} else {
+					startScore -= static_cast<int>(std::min<std::size_t>(position - previous - 1, MAX_GAP_PENALTY));
+					startContiguous = false;
+				}
+			}
+			previous = position++;
+			matched++;
+		}
+		if (matched < query.size())
+			break;  // the leftmost start failing, the next ones fail too
+		if (!found || startScore > score) {
+			score = startScore;
+			contiguous = startContiguous;
+		}
+		found = true;
+	}
+	return found;
+}
+
+// Fewest edits turning the query into a part of the title (Myers, one bit per character of the query)
+static int GetDistance(const std::uint8_t* title, std::size_t length, const std::vector<std::uint64_t>& masks, std::size_t queryLength) {
+	const std::uint64_t last = 1ull << (queryLength - 1);
+	std::uint64_t positive = ~0ull;
+	std::uint64_t negative = 0;
+	int distance = static_cast<int>(queryLength);
+	int best = distance;
+	for (std::size_t i = 0; i < length; i++) {
+		const std::uint64_t equal = masks[title[i]];
+		const std::uint64_t vertical = equal | negative;
+		const std::uint64_t horizontal = (((equal & positive) + positive) ^ positive) | equal;
+		std::uint64_t horizontalPositive = negative | ~(horizontal | positive);
+		std::uint64_t horizontalNegative = positive & horizontal;
+		if (horizontalPositive & last)
+			distance++;
+		else if (horizontalNegative & last)
+			distance--;
+		// the title may start anywhere : no carry into the first row
+		horizontalPositive <<= 1;
+		horizontalNegative <<= 1;
+		positive = horizontalNegative | ~(vertical | horizontalPositive);
+		negative = horizontalPositive & vertical;
+		best = std::min(best, distance);
+	}
+	return best;
+}
+
+TitleId TitleIndex::Add(std::string_view title) {
+	GP_ALLOC_TAG(Gui);
+	const TitleId id = static_cast<TitleId>(m_removed.size());
+	const std::size_t start = m_characters.size();
+	m_characters.push_back(SPACE);
+	Normalize(title, m_characters);
+	m_offsets.push_back(static_cast<std::uint32_t>(m_characters.size()));
+	m_removed.push_back(false);
+	std::uint64_t characters = 0;
+	std::uint64_t wordStarts = 0;
+	for (std::size_t i = start + 1; i < m_characters.size(); i++) {
+		characters |= 1ull << m_characters[i];
+		if (m_characters[i - 1] == SPACE)
+			wordStarts |= 1ull << m_characters[i];
+	}
+	m_characterSets.push_back(characters);
+	m_wordStartSets.push_back(wordStarts);
+	IndexTitle(id);
+	return id;
+}
+
+void TitleIndex::Remove(TitleId title) {
+	if (title >= m_removed.size() || m_removed[title])
+		return;
+	m_removed[title] = true;
+	m_removedCount++;
+	m_staleCount++;
+	if (m_staleCount > GetTitleCount())
+		Compact();
+}
+
+void TitleIndex::IndexTitle(TitleId title) {
+	if (m_postings.empty())
+		m_postings.resize(TRIGRAMS);
+	for (std::uint32_t i = m_offsets[title]; i + 3 <= m_offsets[title + 1]; i++) {
+		std::vector<TitleId>& postings = m_postings[GetTrigram(&m_characters[i])];
+		if (postings.empty() || postings.back() != title)
+			postings.push_back(title);
+	}
+}
+
+void TitleIndex::Compact() {
+	GP_TRACE_FUNCTION();
+	for (std::vector<TitleId>& postings : m_postings) {
+		postings.erase(std::remove_if(postings.begin(), postings.end(), [this](TitleId title) { return m_removed[title]; }), postings.end());
+	}
+	m_staleCount = 0;
+}
+
+void TitleIndex::AddMatch(TitleId title, int sharedTrigrams) {
+	const std::uint8_t* characters = &m_characters[m_offsets[title]];
+	const std::size_t length = m_offsets[title + 1] - m_offsets[title];
+	Match match{ title, false, sharedTrigrams, 0 };
+	bool contiguous = false;
+	if ((m_characterSets[title] & m_querySet) == m_querySet && ScoreSubsequence(characters, length, m_query, match.score, contiguous))
+		match.subsequence = true;
+	// the space starting the title is left out
+	match.distance = contiguous ? 0 : GetDistance(characters + 1, length - 1, m_queryMasks, m_query.size());
+	m_matches.push_back(match);
+}
+
+// Every title holding the character, scored from the sets of characters
+void TitleIndex::ScanCharacter() {
+	const std::uint8_t character = m_query[0];
+	const std::uint64_t bit = 1ull << character;
+	for (TitleId title = 0; title < m_removed.size(); title++) {
+		if ((m_characterSets[title] & bit) == 0 || m_removed[title])
+			continue;
+		int score = SCORE_CHARACTER;
+		if (m_characters[m_offsets[title] + 1] == character)
+			score += SCORE_WORD_START + SCORE_TITLE_START;
+		else if (m_wordStartSets[title] & bit)
+			score += SCORE_WORD_START;
+		m_matches.push_back({ title, true, score, 0 });
+	}
+}
+
+// Every title holding the two characters one after the other : the trigrams ending with them, the one starting with
+// a space being the start of a word. Scattered pairs of characters are too common to be worth a match.
+void TitleIndex::FindPair() {
+	const std::uint8_t pair[3] = { SPACE, m_query[0], m_query[1] };
+	const std::uint32_t wordStart = GetTrigram(pair);
+	const int score = 2 * SCORE_CHARACTER + SCORE_FOLLOWING;
+	m_shared.resize(m_removed.size(), 0);
+	m_candidates.clear();
+	for (std::uint32_t trigram = wordStart; trigram < TRIGRAMS && !m_postings.empty(); trigram += ALPHABET * ALPHABET) {
+		for (TitleId title : m_postings[trigram]) {
+			if (m_shared[title] == 0)
+				m_candidates.push_back(title);
+			m_shared[title] |= trigram == wordStart ? 2 : 1;
+		}
+	}
+	for (TitleId title : m_candidates) {
+		if (!m_removed[title]) {
+			Match match{ title, true, score, 0 };
+			if (m_shared[title] & 2) {
+				const std::uint8_t* characters = &m_characters[m_offsets[title]];
+				const bool titleStart = characters[1] == m_query[0] && characters[2] == m_query[1];
+				match.score += SCORE_WORD_START + (titleStart ? SCORE_TITLE_START : 0);
+			}
+			m_matches.push_back(match);
+		}
+		m_shared[title] = 0;
+	}
+}
+
+std::size_t TitleIndex::Find(std::string_view query, std::size_t maxMatches, std::vector<Match>& matches) {
+	GP_TRACE_FUNCTION();
+	GP_ALLOC_TAG(Gui);
+	matches.clear();
+	m_matches.clear();
+	m_query.clear();
+	Normalize(query, m_query);
+	if (m_query.size() > QUERY_MAX)
+		m_query.resize(QUERY_MAX);
+	if (m_query.empty())
+		return 0;
+	m_queryMasks.assign(ALPHABET, 0);
+	m_querySet = 0;
+	for (std::size_t i = 0; i < m_query.size(); i++) {
+		m_queryMasks[m_query[i]] |= 1ull << i;
+		m_querySet |= 1ull << m_query[i];
+	}
+
+	const std::size_t titles = m_removed.size();
+	if (m_query.size() == 1) {
+		ScanCharacter();
+	} else if (m_query.size() == 2) {
+		FindPair();
+	} else {
+		std::uint32_t trigrams[QUERY_MAX];
+		std::size_t trigramCount = 0;
+		for (std::size_t i = 0; i + 3 <= m_query.size(); i++) {
+			trigrams[trigramCount++] = GetTrigram(&m_query[i]);
+		}
+		std::sort(trigrams, trigrams + trigramCount);
+		trigramCount = std::unique(trigrams, trigrams + trigramCount) - trigrams;
+
+		// titles sharing half the trigrams, a typo changing up to three of them
+		m_shared.resize(titles, 0);
+		m_candidates.clear();
+		for (std::size_t t = 0; t < trigramCount && !m_postings.empty(); t++) {
+			for (TitleId title : m_postings[trigrams[t]]) {
+				if (m_shared[title]++ == 0)
+					m_candidates.push_back(title);
+			}
+		}
+		const std::size_t required = (trigramCount + 1) / 2;
+		for (TitleId title : m_candidates) {
+			if (!m_removed[title] && m_shared[title] >= required)
+				AddMatch(title, m_shared[title]);
+			m_shared[title] = 0;
+		}
+	}
+
+	auto better = [this](const Match& a, const Match& b) {
+		if (a.subsequence != b.subsequence)
+			return a.subsequence;
+		if (a.subsequence && a.score != b.score)
+			return a.score > b.score;
+		if (a.distance != b.distance)
+			return a.distance < b.distance;
+		if (a.score != b.score)
+			return a.score > b.score;
+		// then the shortest titles, the closest to the query
+		const std::uint32_t lengthA = m_offsets[a.title + 1] - m_offsets[a.title];
+		const std::uint32_t lengthB = m_offsets[b.title + 1] - m_offsets[b.title];
+		return lengthA != lengthB ? lengthA < lengthB : a.title < b.title;
+	};
+	const std::size_t kept = std::min(maxMatches, m_matches.size());
+	if (kept < m_matches.size())
+		std::nth_element(m_matches.begin(), m_matches.begin() + kept, m_matches.end(), better);
+	std::sort(m_matches.begin(), m_matches.begin() + kept, better);
+	matches.assign(m_matches.begin(), m_matches.begin() + kept);
+	return m_matches.size();
+}
+
+std::size_t TitleIndex::GetTitleCount() const {
+	return m_removed.size() - m_removedCount;
+}
+
+} // namespace search
+} // namespace gpgui
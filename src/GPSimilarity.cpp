@@ -0,0 +1,159 @@
+#include "GPSimilarity.h"
+#include "GPMemory.h"
+#include "GPSimd.h"
+#include "GPTrace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gpgui {
+namespace similarity {
+
+// The style (chord types and root moves) weighs more than the capo
+static constexpr float TYPE_WEIGHT = 1.0f;
+static constexpr float INTERVAL_WEIGHT = 1.0f;
+static constexpr float CAPO_WEIGHT = 0.5f;
+// Same range as the capo of the gui
+static constexpr int CAPO_MAX = 10;
+
+// Rows of the widest simd, the columns are padded to it
+static constexpr std::size_t ROW_PADDING = 8;
+// Scores of a block stay in the L1 cache until the top is updated
+static constexpr std::size_t BLOCK_ROWS = 1024;
+
+static void Normalize(float* features, int count, float length) {
+	float sum = 0;
+	for (int i = 0; i < count; i++) {
+		sum += features[i] * features[i];
+	}
+	if (sum <= 0)
+		return;
+	const float scale = length / std::sqrt(sum);
+	for (int i = 0; i < count; i++) {
+		features[i] *= scale;
+	}
+}
+
+Features GetFeatures(const save::Song& song) {
+	Features features{};
+	float* types = features.data();
+	float* intervals = features.data() + TYPE_FEATURES;
+	int previousRoot = -1;
+	int previousType = -1;
+	for (const save::ChordSave& chord : song.chords) {
+		const int root = chord.note;
+		const int type = static_cast<int>(chord.type);
+		if (root >= music::Note::TOTAL || type >= TYPE_FEATURES) {
+			previousRoot = -1;
+			continue;
+		}
+		types[type]++;
+		if (previousRoot >= 0 && (root != previousRoot || type != previousType))
+			intervals[(root - previousRoot + music::Note::TOTAL) % music::Note::TOTAL]++;
+		previousRoot = root;
+		previousType = type;
+	}
+	if (std::all_of(types, types + TYPE_FEATURES, [](float count) { return count == 0; }))
+		return features;
+
+	Normalize(types, TYPE_FEATURES, TYPE_WEIGHT);
+	Normalize(intervals, INTERVAL_FEATURES, INTERVAL_WEIGHT);
+	features[FEATURES - 1] = CAPO_WEIGHT * std::min<int>(song.capo, CAPO_MAX) / CAPO_MAX;
+	Normalize(features.data(), FEATURES, 1.0f);
+	return features;
+}
+
+SongId Index::Add(const save::Song& song) {
+	GP_ALLOC_TAG(Music);
+	const SongId id = static_cast<SongId>(m_removed.size());
+	m_removed.push_back(false);
+	if (m_columns[0].size() < m_removed.size()) {
+		for (std::vector<float>& column : m_columns) {
+			column.resize(column.size() + ROW_PADDING, 0.0f);
+		}
+	}
+	SetRow(id, GetFeatures(song));
+	return id;
+}
+
+void Index::Update(SongId id, const save::Song& song) {
+	if (id >= m_removed.size() || m_removed[id])
+		return;
+	SetRow(id, GetFeatures(song));
+}
+
+void Index::Remove(SongId id) {
+	if (id >= m_removed.size() || m_removed[id])
+		return;
+	// a null row never scores above 0
+	SetRow(id, Features{});
+	m_removed[id] = true;
+	m_removedCount++;
+}
+
+void Index::SetRow(SongId id, const Features& features) {
+	for (int feature = 0; feature < FEATURES; feature++) {
+		m_columns[feature][id] = features[feature];
+	}
+}
+
+void Index::FindSimilar(SongId id, std::size_t count, std::vector<Match>& matches) const {
+	if (id >= m_removed.size() || m_removed[id]) {
+		matches.clear();
+		return;
+	}
+	Features features;
+	for (int feature = 0; feature < FEATURES; feature++) {
+		features[feature] = m_columns[feature][id];
+	}
+	FindSimilar(features, count, matches, id);
+}
+
+void Index::FindSimilar(const Features& features, std::size_t count, std::vector<Match>& matches, SongId excluded) const {
+	GP_TRACE_FUNCTION();
+	matches.clear();
+	if (count == 0)
+		return;
+	matches.reserve(count);
+
+	simd::Float query[FEATURES];
+	for (int feature = 0; feature < FEATURES; feature++) {
+		query[feature] = simd::Set1(features[feature]);
+	}
+	// rows are unit vectors, the dot product is the cosine
+	alignas(simd::ALIGNMENT) float scores[BLOCK_ROWS];
+	// heap of the best matches, the worst on top
+	auto better = [](const Match& a, const Match& b) { return a.score > b.score; };
+	float threshold = 0;
+	const std::size_t rows = m_columns[0].size();
+	for (std::size_t block = 0; block < rows; block += BLOCK_ROWS) {
+		const std::size_t blockRows = std::min(BLOCK_ROWS, rows - block);
+		for (std::size_t row = 0; row < blockRows; row += simd::WIDTH) {
+			simd::Float sum = simd::Set1(0.0f);
+			for (int feature = 0; feature < FEATURES; feature++) {
+				sum = simd::MulAdd(query[feature], simd::LoadUnaligned(m_columns[feature].data() + block + row), sum);
+			}
+			simd::Store(scores + row, sum);
+		}
+		for (std::size_t row = 0; row < blockRows; row++) {
+			if (scores[row] <= threshold || block + row == excluded)
+				continue;
+			if (matches.size() == count) {
+				std::pop_heap(matches.begin(), matches.end(), better);
+				matches.pop_back();
+			}
+			matches.push_back({ static_cast<SongId>(block + row), scores[row] });
+			std::push_heap(matches.begin(), matches.end(), better);
+			if (matches.size() == count)
+				threshold = matches.front().score;
+		}
+	}
+	std::sort_heap(matches.begin(), matches.end(), better);
+}
+
+std::size_t Index::GetSongCount() const {
+	return m_removed.size() - m_removedCount;
+}
+
+} // namespace similarity
+} // namespace gpgui
@@ -0,0 +1,465 @@
+#include "GPSongbook.h"
+#include "GPParallel.h"
+#include "GPRenderer.h"
+#include "GPTrace.h"
+
+#include <zlib.h>
+
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+
+namespace gpgui {
+namespace songbook {
+
+using Song = save::Song;
+
+// A4, in points
+static constexpr float PAGE_WIDTH = 595.0f;
+static constexpr float PAGE_HEIGHT = 842.0f;
+static constexpr float MARGIN = 36.0f;
+static constexpr float TITLE_HEIGHT = 28.0f;
+static constexpr float TITLE_SIZE = 16.0f;
+static constexpr float LABEL_HEIGHT = 14.0f;
+static constexpr float LABEL_SIZE = 10.0f;
+static constexpr float SPACING = 12.0f;
+
+// Pages generated at the same time, per thread. Bounds the memory used by the export.
+static constexpr std::size_t PAGES_PER_THREAD = 4;
+
+enum class ItemType : std::uint8_t {
+	Title = 0,
+	Diagram,
+};
+
+// y is the top of the item, from the top of the page
+struct Item {
+	ItemType type;
+	std::uint32_t song, chord;
+	float x, y;
+};
+
+struct Page {
+	std::size_t firstItem, itemCount;
+};
+
+struct Layout {
+	float cellWidth, diagramHeight, cellHeight;
+	std::vector<Item> items;
+	std::vector<Page> pages;
+};
+
+Format GetFormat(const std::string& fileName) {
+	const std::string extension = ".pdf";
+	if (fileName.size() >= extension.size() && fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0)
+		return Format::Pdf;
+	return Format::Svg;
+}
+
+static Layout LayoutSongbook(const std::vector<Song>& songs, int columns) {
+	Layout layout;
+	layout.cellWidth = (PAGE_WIDTH - 2.0f * MARGIN - (columns - 1) * SPACING) / columns;
+	layout.diagramHeight = layout.cellWidth * renderer::WIDGETS_HEIGHT;
+	layout.cellHeight = LABEL_HEIGHT + layout.diagramHeight + SPACING;
+
+	constexpr float BOTTOM = PAGE_HEIGHT - MARGIN;
+	float cursorY = MARGIN;
+
+	auto newPage = [&]() {
+		layout.pages.push_back({ layout.items.size(), 0 });
+		cursorY = MARGIN;
+	};
+	auto addItem = [&](const Item& item) {
+		layout.items.push_back(item);
+		layout.pages.back().itemCount++;
+	};
+
+	newPage();
+	for (std::uint32_t song = 0; song < songs.size(); song++) {
+		// the title stays with at least one row of diagrams
+		if (cursorY + TITLE_HEIGHT + layout.cellHeight > BOTTOM && layout.pages.back().itemCount != 0)
+			newPage();
+		addItem({ ItemType::Title, song, 0, MARGIN, cursorY });
+		cursorY += TITLE_HEIGHT;
+
+		const auto& chords = songs[song].chords;
+		for (std::uint32_t chord = 0; chord < chords.size(); chord++) {
+			int column = chord % columns;
+			if (column == 0 && chord != 0)
+				cursorY += layout.cellHeight;
+			if (column == 0 && cursorY + layout.cellHeight > BOTTOM)
+				newPage();
+			addItem({ ItemType::Diagram, song, chord, MARGIN + column * (layout.cellWidth + SPACING), cursorY });
+		}
+		if (!chords.empty())
+			cursorY += layout.cellHeight;
+	}
+	return layout;
+}
+
+static void AppendNumber(std::string& out, float value) {
+	char buffer[32];
+	auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 2);
+	out.append(buffer, result.ptr);
+}
+
+static std::string GetTitle(const Song& song) {
+	return song.title + " (capo " + std::to_string(song.capo) + ")";
+}
+
+// Page content, the coordinates are the ones of the page format
+class PageWriter {
+public:
+	virtual ~PageWriter() {}
+
+	virtual void Begin(std::string& out) = 0;
+	virtual void End(std::string& out) = 0;
+	virtual void Text(std::string& out, float x, float y, float size, const std::string& text) = 0;
+	virtual void Shape(std::string& out, const scene::Shape& shape, float originX, float originY, float scale) = 0;
+
+	// y is from the top of the page
+	virtual float ToPageY(float y) const = 0;
+};
+
+class SvgWriter : public PageWriter {
+public:
+	virtual void Begin(std::string& out) {
+		out += "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"595\" height=\"842\" viewBox=\"0 0 595 842\">\n";
+		out += "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+	}
+
+	virtual void End(std::string& out) {
+		out += "</svg>\n";
+	}
+
+	virtual void Text(std::string& out, float x, float y, float size, const std::string& text) {
+		out += "<text x=\"";
+		AppendNumber(out, x);
+		out += "\" y=\"";
+		AppendNumber(out, y);
+		out += "\" font-family=\"Helvetica, Arial, sans-serif\" font-size=\"";
+		AppendNumber(out, size);
+		out += "\">";
+		for (char c : text) {
+			switch (c) {
+			case '<':
+				out += "&lt;";
+				break;
+			case '>':
+				out += "&gt;";
+				break;
+			case '&':
+				out += "&amp;";
+				break;
+			default:
+				out += c;
+			}
+		}
+		out += "</text>\n";
+	}
+
+	virtual void Shape(std::string& out, const scene::Shape& shape, float originX, float originY, float scale) {
+		// svg goes down, the scene goes up
+		if (shape.type == scene::ShapeType::Rect) {
+			out += "<rect x=\"";
+			AppendNumber(out, originX + shape.x * scale);
+			out += "\" y=\"";
+			AppendNumber(out, originY - shape.dy * scale);
+			out += "\" width=\"";
+			AppendNumber(out, (shape.dx - shape.x) * scale);
+			out += "\" height=\"";
+			AppendNumber(out, (shape.dy - shape.y) * scale);
+		} else {
+			out += "<circle cx=\"";
+			AppendNumber(out, originX + shape.x * scale);
+			out += "\" cy=\"";
+			AppendNumber(out, originY - shape.y * scale);
+			out += "\" r=\"";
+			AppendNumber(out, shape.dx * scale);
+		}
+		char color[8];
+		std::snprintf(color, sizeof(color), "#%02x%02x%02x", shape.color.red, shape.color.green, shape.color.blue);
+		out += "\" fill=\"";
+		out += color;
+		out += "\"/>\n";
+	}
+
+	virtual float ToPageY(float y) const {
+		return y;
+	}
+};
+
+class PdfWriter : public PageWriter {
+public:
+	virtual void Begin(std::string&) {}
+	virtual void End(std::string&) {}
+
+	virtual void Text(std::string& out, float x, float y, float size, const std::string& text) {
+		out += "0 0 0 rg BT /F1 ";
+		AppendNumber(out, size);
+		out += " Tf ";
+		AppendNumber(out, x);
+		out += ' ';
+		AppendNumber(out, y);
+		out += " Td (";
+		AppendLatin1(out, text);
+		out += ") Tj ET\n";
+	}
+
+	virtual void Shape(std::string& out, const scene::Shape& shape, float originX, float originY, float scale) {
+		AppendNumber(out, shape.color.red / 255.0f);
+		out += ' ';
+		AppendNumber(out, shape.color.green / 255.0f);
+		out += ' ';
+		AppendNumber(out, shape.color.blue / 255.0f);
+		out += " rg\n";
+
+		float x = originX + shape.x * scale;
+		float y = originY + shape.y * scale;
+		if (shape.type == scene::ShapeType::Rect) {
+			AppendPoint(out, x, y);
+			AppendPoint(out, (shape.dx - shape.x) * scale, (shape.dy - shape.y) * scale);
+			out += "re f\n";
+		} else {
+			// four bezier curves
+			constexpr float KAPPA = 0.5523f;
+			float r = shape.dx * scale;
+			float k = r * KAPPA;
+			AppendPoint(out, x + r, y);
+			out += "m\n";
+			AppendCurve(out, x + r, y + k, x + k, y + r, x, y + r);
+			AppendCurve(out, x - k, y + r, x - r, y + k, x - r, y);
+			AppendCurve(out, x - r, y - k, x - k, y - r, x, y - r);
+			AppendCurve(out, x + k, y - r, x + r, y - k, x + r, y);
+			out += "f\n";
+		}
+	}
+
+	virtual float ToPageY(float y) const {
+		return PAGE_HEIGHT - y;
+	}
+
+private:
+	static void AppendPoint(std::string& out, float x, float y) {
+		AppendNumber(out, x);
+		out += ' ';
+		AppendNumber(out, y);
+		out += ' ';
+	}
+
+	static void AppendCurve(std::string& out, float x1, float y1, float x2, float y2, float x3, float y3) {
+		AppendPoint(out, x1, y1);
+		AppendPoint(out, x2, y2);
+		AppendPoint(out, x3, y3);
+		out += "c\n";
+	}
+
+	// Helvetica with WinAnsiEncoding, close enough to latin-1 for french titles
+	static void AppendLatin1(std::string& out, const std::string& text) {
+		for (std::size_t i = 0; i < text.size(); i++) {
+			unsigned char c = text[i];
+			unsigned int codePoint = c;
+			if ((c & 0xE0) == 0xC0 && i + 1 < text.size()) {
+				codePoint = (c & 0x1F) << 6 | (text[++i] & 0x3F);
+			} else if (c >= 0x80) {
+				// skipping the rest of a longer utf-8 sequence
+				while (i + 1 < text.size() && (text[i + 1] & 0xC0) == 0x80)
+					i++;
+				codePoint = '?';
+			}
+			if (codePoint > 0xFF)
+				codePoint = '?';
+			if (codePoint == '(' || codePoint == ')' || codePoint == '\\')
+				out += '\\';
+			out += static_cast<char>(codePoint);
+		}
+	}
+};
+
+static void WritePage(std::string& out, PageWriter& writer, const Layout& layout, const Page& page, const std::vector<Song>& songs) {
+	scene::Scene scene;
+	writer.Begin(out);
+	for (std::size_t i = page.firstItem; i < page.firstItem + page.itemCount; i++) {
+		const Item& item = layout.items[i];
+		const Song& song = songs[item.song];
+		if (item.type == ItemType::Title) {
+			writer.Text(out, item.x, writer.ToPageY(item.y + TITLE_SIZE), TITLE_SIZE, GetTitle(song));
+			continue;
+		}
+
+		const save::ChordSave& chord = song.chords[item.chord];
+		writer.Text(out, item.x, writer.ToPageY(item.y + LABEL_SIZE), LABEL_SIZE, music::ToString(chord));
+
+		scene.clear();
+		renderer::BuildScene(scene, renderer::GetChordState(chord, song.capo));
+		// the bottom of the diagram is the origin of the scene
+		float originY = writer.ToPageY(item.y + LABEL_HEIGHT + layout.diagramHeight);
+		for (const scene::Shape& shape : scene) {
+			writer.Shape(out, shape, item.x, originY, layout.cellWidth);
+		}
+	}
+	writer.End(out);
+}
+
+static bool Compress(const std::string& data, std::string& compressed) {
+	uLongf size = compressBound(static_cast<uLong>(data.size()));
+	compressed.assign(size, '\0');
+	if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &size, reinterpret_cast<const Bytef*>(data.data()), static_cast<uLong>(data.size()), Z_BEST_SPEED) != Z_OK)
+		return false;
+	compressed.resize(size);
+	return true;
+}
+
+// Generates the pages by groups of a few pages per thread, and hands them in order to the output.
+// False when a page could not be compressed, the pages after it are not generated.
+template<typename Output>
+static bool GeneratePages(const Layout& layout, const std::vector<Song>& songs, Format format, unsigned threads, Output&& output) {
+	std::size_t groupSize = threads * PAGES_PER_THREAD;
+	std::vector<std::string> contents(groupSize);
+	std::atomic<bool> failed{ false };
+
+	for (std::size_t first = 0; first < layout.pages.size(); first += groupSize) {
+		std::size_t count = std::min(groupSize, layout.pages.size() - first);
+		parallel::ForEach(count, [&](std::size_t i) {
+			GP_TRACE_SCOPE("WritePage");
+			SvgWriter svgWriter;
+			PdfWriter pdfWriter;
+			PageWriter& writer = format == Format::Pdf ? static_cast<PageWriter&>(pdfWriter) : svgWriter;
+
+			std::string page;
+			WritePage(page, writer, layout, layout.pages[first + i], songs);
+			if (format != Format::Pdf)
+				contents[i] = std::move(page);
+			else if (!Compress(page, contents[i]))
+				failed = true;
+		}, threads);
+		if (failed)
+			return false;
+
+		for (std::size_t i = 0; i < count; i++) {
+			output(first + i, contents[i]);
+			std::string().swap(contents[i]);
+		}
+	}
+	return true;
+}
+
+static bool ExportSvg(const Layout& layout, const std::vector<Song>& songs, const std::string& fileName, unsigned threads) {
+	std::string baseName = fileName;
+	if (baseName.size() > 4 && baseName.compare(baseName.size() - 4, 4, ".svg") == 0)
+		baseName.resize(baseName.size() - 4);
+
+	bool success = true;
+	GeneratePages(layout, songs, Format::Svg, threads, [&](std::size_t page, const std::string& content) {
+		std::ofstream fileStream(baseName + "_" + std::to_string(page + 1) + ".svg", std::ios::binary);
+		fileStream.write(content.data(), content.size());
+		success &= static_cast<bool>(fileStream);
+	});
+	return success;
+}
+
+class PdfFile {
+public:
+	PdfFile(const std::string& fileName) : m_Stream(fileName, std::ios::binary) {}
+
+	bool IsOpen() const {
+		return static_cast<bool>(m_Stream);
+	}
+
+	void Write(const std::string& data) {
+		m_Stream.write(data.data(), data.size());
+		m_Offset += data.size();
+	}
+
+	void BeginObject(std::size_t id) {
+		if (m_ObjectOffsets.size() < id)
+			m_ObjectOffsets.resize(id);
+		m_ObjectOffsets[id - 1] = m_Offset;
+		Write(std::to_string(id) + " 0 obj\n");
+	}
+
+	void EndObject() {
+		Write("endobj\n");
+	}
+
+	bool Finish(std::size_t rootId) {
+		std::size_t xrefOffset = m_Offset;
+		std::string xref = "xref\n0 " + std::to_string(m_ObjectOffsets.size() + 1) + "\n0000000000 65535 f \n";
+		char line[32];
+		for (std::size_t offset : m_ObjectOffsets) {
+			std::snprintf(line, sizeof(line), "%010zu 00000 n \n", offset);
+			xref += line;
+		}
+		Write(xref);
+		Write("trailer\n<< /Size " + std::to_string(m_ObjectOffsets.size() + 1) + " /Root " + std::to_string(rootId) + " 0 R >>\n");
+		Write("startxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n");
+		m_Stream.flush();
+		return static_cast<bool>(m_Stream);
+	}
+
+private:
+	std::ofstream m_Stream;
+	std::size_t m_Offset = 0;
+	std::vector<std::size_t> m_ObjectOffsets;
+};
+
+static bool ExportPdf(const Layout& layout, const std::vector<Song>& songs, const std::string& fileName, unsigned threads) {
+	constexpr std::size_t CATALOG_ID = 1;
+	constexpr std::size_t PAGES_ID = 2;
+	constexpr std::size_t FONT_ID = 3;
+	auto getPageId = [](std::size_t page) { return 4 + page * 2; };
+
+	PdfFile file(fileName);
+	if (!file.IsOpen())
+		return false;
+
+	file.Write("%PDF-1.4\n");
+
+	file.BeginObject(CATALOG_ID);
+	file.Write("<< /Type /Catalog /Pages 2 0 R >>\n");
+	file.EndObject();
+
+	// the page count is known from the layout, so the page tree can be written first
+	file.BeginObject(PAGES_ID);
+	std::string kids;
+	for (std::size_t page = 0; page < layout.pages.size(); page++) {
+		kids += std::to_string(getPageId(page)) + " 0 R ";
+	}
+	file.Write("<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(layout.pages.size()) + " >>\n");
+	file.EndObject();
+
+	file.BeginObject(FONT_ID);
+	file.Write("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>\n");
+	file.EndObject();
+
+	bool generated = GeneratePages(layout, songs, Format::Pdf, threads, [&](std::size_t page, const std::string& content) {
+		std::size_t pageId = getPageId(page);
+		file.BeginObject(pageId);
+		file.Write("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 595 842] /Resources << /Font << /F1 3 0 R >> >> /Contents "
+			+ std::to_string(pageId + 1) + " 0 R >>\n");
+		file.EndObject();
+
+		file.BeginObject(pageId + 1);
+		file.Write("<< /Length " + std::to_string(content.size()) + " /Filter /FlateDecode >>\nstream\n");
+		file.Write(content);
+		file.Write("\nendstream\n");
+		file.EndObject();
+	});
+
+	return file.Finish(CATALOG_ID) && generated;
+}
+
+bool ExportSongbook(const std::vector<Song>& songs, const std::string& fileName, const Options& options) {
+	GP_TRACE_FUNCTION();
+
+	Layout layout = LayoutSongbook(songs, std::max(options.columns, 1));
+	unsigned threads = options.threads == 0 ? parallel::GetThreadCount() : options.threads;
+
+	if (options.format == Format::Pdf)
+		return ExportPdf(layout, songs, fileName, threads);
+	return ExportSvg(layout, songs, fileName, threads);
+}
+
+} // namespace songbook
+} // namespace gpgui
@@ -0,0 +1,316 @@
+#include "GPSynth.h"
+#include "GPSimd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gpgui {
+namespace synth {
+
+using namespace simd;
+
+static_assert(PIANO_LANES % (2 * WIDTH) == 0 && STRING_LANES % WIDTH == 0, "The lanes are processed by whole vectors");
+static_assert(WIDTH <= 8, "The accumulator holds up to 8 lanes per frame");
+static_assert(STRING_VOICES <= STRING_LANES, "One lane per string");
+static_assert((MAX_DELAY & (MAX_DELAY - 1)) == 0, "The delay lines wrap with a mask");
+
+static constexpr float PI = 3.14159265358979f;
+
+// Levels below it are inaudible, the voice is freed
+static constexpr float SILENCE = 1e-4f;
+
+static constexpr float HARMONIC_LEVELS[PIANO_HARMONICS] = { 1.0f, 0.45f, 0.22f, 0.1f };
+
+// Time (in seconds) for the lowest notes to decay by 60 dB
+static constexpr float PIANO_DECAY_TIME = 3.0f;
+static constexpr float STRING_DECAY_TIME = 4.0f;
+static constexpr float RELEASE_TIME = 0.08f;
+
+// Per sample gain decaying by 60 dB in the given time
+static float GetDecay(float seconds) {
+	return std::pow(0.001f, 1.0f / (seconds * SAMPLE_RATE));
+}
+
+float GetFrequency(int key) {
+	return 55.0f * std::exp2(key / 12.0f);
+}
+
+Synth::Synth() : m_PendingCount(0), m_Volume(0.3f), m_Clipping(true), m_NoiseState(0x12345678) {
+	m_Piano.re.fill(1.0f);
+	m_Piano.im.fill(0.0f);
+	m_Piano.cosStep.fill(1.0f);
+	m_Piano.sinStep.fill(0.0f);
+	m_Piano.amplitude.fill(0.0f);
+	m_Piano.decay.fill(0.0f);
+	m_Piano.active.fill(false);
+
+	m_Strings.halfLoss.fill(0.0f);
+	m_Strings.previous.fill(0.0f);
+	m_Strings.allpassCoefficient.fill(0.0f);
+	m_Strings.allpassInput.fill(0.0f);
+	m_Strings.allpassOutput.fill(0.0f);
+	m_Strings.peak.fill(0.0f);
+	m_Strings.length.fill(MAX_DELAY);
+	m_Strings.active.fill(false);
+	m_Strings.lines.fill(0.0f);
+	m_Strings.writePosition = 0;
+}
+
+float Synth::NextNoise() {
+	// xorshift32
+	m_NoiseState ^= m_NoiseState << 13;
+	m_NoiseState ^= m_NoiseState >> 17;
+	m_NoiseState ^= m_NoiseState << 5;
+	return static_cast<float>(m_NoiseState) / 2147483648.0f - 1.0f;
+}
+
+void Synth::AddPendingNote(const PendingNote& note) {
+	if (m_PendingCount < MAX_PENDING_NOTES) {
+		m_Pending[m_PendingCount++] = note;
+	} else {
+		StartNote(note);  // too many notes in advance, this one starts early
+	}
+}
+
+void Synth::PlayKey(int key, float velocity, int delayFrames) {
+	AddPendingNote({ delayFrames, -1, key, velocity });
+}
+
+void Synth::PluckString(int string, int key, float velocity, int delayFrames) {
+	if (string < 0 || string >= STRING_VOICES)
+		return;
+	AddPendingNote({ delayFrames, string, key, velocity });
+}
+
+void Synth::StartNote(const PendingNote& note) {
+	if (note.string < 0)
+		StartKey(note.key, note.velocity);
+	else
+		StartString(note.string, note.key, note.velocity);
+}
+
+void Synth::StartKey(int key, float velocity) {
+	// a free voice, else the quietest one
+	int voice = 0;
+	for (int candidate = 0; candidate < PIANO_VOICES; candidate++) {
+		if (!m_Piano.active[candidate]) {
+			voice = candidate;
+			break;
+		}
+		if (m_Piano.amplitude[candidate * PIANO_HARMONICS] < m_Piano.amplitude[voice * PIANO_HARMONICS])
+			voice = candidate;
+	}
+
+	float frequency = GetFrequency(key);
+	// higher notes are shorter
+	float decayTime = PIANO_DECAY_TIME * std::clamp(220.0f / frequency, 0.25f, 1.0f);
+	for (int h = 0; h < PIANO_HARMONICS; h++) {
+		int lane = voice * PIANO_HARMONICS + h;
+		float step = 2.0f * PI * frequency * (h + 1) / SAMPLE_RATE;
+		m_Piano.re[lane] = 1.0f;
+		m_Piano.im[lane] = 0.0f;
+		m_Piano.cosStep[lane] = std::cos(step);
+		m_Piano.sinStep[lane] = std::sin(step);
+		m_Piano.amplitude[lane] = step < PI ? HARMONIC_LEVELS[h] * velocity : 0.0f;
+		m_Piano.decay[lane] = GetDecay(decayTime / (h + 1));
+	}
+	m_Piano.active[voice] = true;
+}
+
+void Synth::StartString(int string, int key, float velocity) {
+	StringLanes& lanes = m_Strings;
+	float period = SAMPLE_RATE / GetFrequency(key);
+	// the averaging filter delays by half a sample, the allpass by [0.1, 1.1[
+	int length = std::clamp(static_cast<int>(period - 0.6f), 2, MAX_DELAY);
+	float fraction = period - 0.5f - length;
+	lanes.length[string] = length;
+	lanes.allpassCoefficient[string] = (1.0f - fraction) / (1.0f + fraction);
+	lanes.allpassInput[string] = 0;
+	lanes.allpassOutput[string] = 0;
+	lanes.previous[string] = 0;
+	lanes.halfLoss[string] = 0.5f * std::pow(0.001f, period / (STRING_DECAY_TIME * SAMPLE_RATE));
+
+	// lowpassed noise without DC as the pluck, in the samples read by the next period
+	float mean = 0;
+	float filtered = 0;
+	for (int i = 0; i < length; i++) {
+		filtered += 0.5f * (NextNoise() - filtered);
+		lanes.lines[((lanes.writePosition - length + i) & (MAX_DELAY - 1)) * STRING_LANES + string] = filtered * velocity;
+		mean += filtered * velocity;
+	}
+	mean /= length;
+	for (int i = 0; i < length; i++) {
+		lanes.lines[((lanes.writePosition - length + i) & (MAX_DELAY - 1)) * STRING_LANES + string] -= mean;
+	}
+	lanes.active[string] = true;
+}
+
+void Synth::Release() {
+	m_PendingCount = 0;
+	m_Piano.decay.fill(GetDecay(RELEASE_TIME));
+	for (int lane = 0; lane < STRING_LANES; lane++) {
+		float releaseLoss = 0.5f * std::pow(0.001f, m_Strings.length[lane] / (RELEASE_TIME * SAMPLE_RATE));
+		m_Strings.halfLoss[lane] = std::min(m_Strings.halfLoss[lane], releaseLoss);
+	}
+}
+
+void Synth::SetVolume(float volume) {
+	m_Volume = volume;
+}
+
+void Synth::SetClipping(bool clipping) {
+	m_Clipping = clipping;
+}
+
+void Synth::RenderPiano(int frames) {
+	PianoLanes& lanes = m_Piano;
+	// two vectors per iteration, their recurrences are independent and hide each other's latency
+	for (int lane = 0; lane < PIANO_LANES; lane += 2 * WIDTH) {
+		bool active = false;
+		for (int voice = lane / PIANO_HARMONICS; voice * PIANO_HARMONICS < lane + 2 * WIDTH; voice++) {
+			active |= lanes.active[voice];
+		}
+		if (!active)
+			continue;
+
+		Float re[2], im[2], cosStep[2], sinStep[2], amplitude[2], decay[2];
+		for (int v = 0; v < 2; v++) {
+			re[v] = Load(&lanes.re[lane + v * WIDTH]);
+			im[v] = Load(&lanes.im[lane + v * WIDTH]);
+			cosStep[v] = Load(&lanes.cosStep[lane + v * WIDTH]);
+			sinStep[v] = Load(&lanes.sinStep[lane + v * WIDTH]);
+			amplitude[v] = Load(&lanes.amplitude[lane + v * WIDTH]);
+			decay[v] = Load(&lanes.decay[lane + v * WIDTH]);
+		}
+		float* accumulator = m_Accumulator.data();
+		for (int i = 0; i < frames; i++, accumulator += WIDTH) {
+			Float sample = Load(accumulator);
+			for (int v = 0; v < 2; v++) {
+				Float rotatedRe = Sub(Mul(re[v], cosStep[v]), Mul(im[v], sinStep[v]));
+				im[v] = MulAdd(re[v], sinStep[v], Mul(im[v], cosStep[v]));
+				re[v] = rotatedRe;
+				sample = MulAdd(im[v], amplitude[v], sample);
+				amplitude[v] = Mul(amplitude[v], decay[v]);
+			}
+			Store(accumulator, sample);
+		}
+		for (int v = 0; v < 2; v++) {
+			Store(&lanes.re[lane + v * WIDTH], re[v]);
+			Store(&lanes.im[lane + v * WIDTH], im[v]);
+			Store(&lanes.amplitude[lane + v * WIDTH], amplitude[v]);
+		}
+	}
+
+	// the phasors slowly drift away from the unit circle
+	for (int lane = 0; lane < PIANO_LANES; lane++) {
+		float norm = 1.0f / std::sqrt(lanes.re[lane] * lanes.re[lane] + lanes.im[lane] * lanes.im[lane]);
+		lanes.re[lane] *= norm;
+		lanes.im[lane] *= norm;
+	}
+	for (int voice = 0; voice < PIANO_VOICES; voice++) {
+		if (lanes.active[voice] && lanes.amplitude[voice * PIANO_HARMONICS] < SILENCE) {
+			lanes.active[voice] = false;
+			std::fill_n(&lanes.amplitude[voice * PIANO_HARMONICS], PIANO_HARMONICS, 0.0f);
+		}
+	}
+}
+
+void Synth::RenderStrings(int frames) {
+	StringLanes& lanes = m_Strings;
+	for (int lane = 0; lane < STRING_LANES; lane += WIDTH) {
+		bool active = false;
+		for (int i = 0; i < WIDTH; i++) {
+			active |= lanes.active[lane + i];
+		}
+		if (!active)
+			continue;
+
+		Float previous = Load(&lanes.previous[lane]);
+		const Float halfLoss = Load(&lanes.halfLoss[lane]);
+		const Float coefficient = Load(&lanes.allpassCoefficient[lane]);
+		Float allpassInput = Load(&lanes.allpassInput[lane]);
+		Float allpassOutput = Load(&lanes.allpassOutput[lane]);
+		Float peak = Set1(0.0f);
+
+		alignas(ALIGNMENT) int readIndices[WIDTH];
+		int readPositions[WIDTH];
+		for (int i = 0; i < WIDTH; i++) {
+			readPositions[i] = lanes.writePosition - lanes.length[lane + i];
+		}
+		int writePosition = lanes.writePosition;
+		float* accumulator = m_Accumulator.data();
+		for (int frame = 0; frame < frames; frame++, accumulator += WIDTH) {
+			for (int i = 0; i < WIDTH; i++) {
+				readIndices[i] = ((readPositions[i] + frame) & (MAX_DELAY - 1)) * STRING_LANES + lane + i;
+			}
+			Float sample = Gather(lanes.lines.data(), readIndices);
+			Float averaged = Mul(Add(sample, previous), halfLoss);
+			previous = sample;
+			Float tuned = MulAdd(coefficient, Sub(averaged, allpassOutput), allpassInput);
+			allpassInput = averaged;
+			allpassOutput = tuned;
+			Store(&lanes.lines[((writePosition + frame) & (MAX_DELAY - 1)) * STRING_LANES + lane], tuned);
+
+			Store(accumulator, Add(Load(accumulator), sample));
+			peak = Max(peak, Abs(sample));
+		}
+		Store(&lanes.previous[lane], previous);
+		Store(&lanes.allpassInput[lane], allpassInput);
+		Store(&lanes.allpassOutput[lane], allpassOutput);
+		Store(&lanes.peak[lane], peak);
+	}
+	lanes.writePosition = (lanes.writePosition + frames) & (MAX_DELAY - 1);
+
+	for (int lane = 0; lane < STRING_LANES; lane++) {
+		if (lanes.active[lane] && lanes.peak[lane] < SILENCE)
+			lanes.active[lane] = false;
+	}
+}
+
+void Synth::RenderBlock(float* out, int frames) {
+	std::fill_n(m_Accumulator.begin(), frames * WIDTH, 0.0f);
+	RenderPiano(frames);
+	RenderStrings(frames);
+
+	for (int i = 0; i < frames; i++) {
+		float sample = HorizontalSum(Load(&m_Accumulator[i * WIDTH])) * m_Volume;
+		out[i] = m_Clipping ? SoftClip(sample) : sample;
+	}
+}
+
+void Synth::Render(float* out, int frames) {
+	while (frames > 0) {
+		// the notes start on the first frame of a block
+		int block = std::min(frames, BLOCK_FRAMES);
+		for (int i = 0; i < m_PendingCount;) {
+			if (m_Pending[i].delay == 0) {
+				StartNote(m_Pending[i]);
+				m_Pending[i] = m_Pending[--m_PendingCount];
+			} else {
+				block = std::min(block, m_Pending[i].delay);
+				i++;
+			}
+		}
+
+		RenderBlock(out, block);
+		for (int i = 0; i < m_PendingCount; i++) {
+			m_Pending[i].delay -= block;
+		}
+		out += block;
+		frames -= block;
+	}
+}
+
+int Synth::GetActiveVoices() const {
+	int count = 0;
+	for (bool active : m_Piano.active) {
+		count += active;
+	}
+	for (bool active : m_Strings.active) {
+		count += active;
+	}
+	return count;
+}
+
+} // namespace synth
+} // namespace gpgui
@@ -0,0 +1,129 @@
+#include "GPTrace.h"
+
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace gpgui {
+namespace trace {
+
+// Events kept per thread, the oldest ones are overwritten
+static constexpr std::size_t RING_SIZE = 1 << 14;
+static constexpr std::size_t MAX_THREADS = 256;
+
+struct Event {
+	const char* name;
+	std::int64_t start, duration;  // in microseconds
+};
+
+// A sequence lock per slot : the sequence is the index of the event plus one once written, 0 while writing.
+// The fields are atomics so that readers copying a slot being overwritten never race, they drop it instead.
+struct Slot {
+	std::atomic<std::uint64_t> sequence{ 0 };
+	std::atomic<const char*> name{ nullptr };
+	std::atomic<std::int64_t> start{ 0 }, duration{ 0 };
+};
+
+// Written only by its own thread, read at any time by the exports
+struct ThreadBuffer {
+	std::array<Slot, RING_SIZE> slots;
+	std::atomic<std::uint64_t> head{ 0 };
+	std::uint32_t threadId;
+};
+
+static const Clock::time_point traceStart = Clock::now();
+
+// Buffers are never freed so that events of finished threads can still be written
+static std::array<std::atomic<ThreadBuffer*>, MAX_THREADS> threadBuffers{};
+static std::atomic<std::uint32_t> threadCount{ 0 };
+
+static ThreadBuffer* RegisterThread() {
+	std::uint32_t index = threadCount.fetch_add(1);
+	if (index >= MAX_THREADS)
+		return nullptr;
+
+	ThreadBuffer* buffer = new ThreadBuffer();
+	buffer->threadId = index;
+	threadBuffers[index].store(buffer, std::memory_order_release);
+	return buffer;
+}
+
+static std::int64_t ToMicroseconds(Clock::duration duration) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+void Record(const char* name, Clock::time_point start, Clock::time_point end) {
+	thread_local ThreadBuffer* buffer = RegisterThread();
+	if (buffer == nullptr)
+		return;
+
+	std::uint64_t head = buffer->head.load(std::memory_order_relaxed);
+	Slot& slot = buffer->slots[head % RING_SIZE];
+	slot.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start.store(ToMicroseconds(start - traceStart), std::memory_order_relaxed);
+	slot.duration.store(ToMicroseconds(end - start), std::memory_order_relaxed);
+	slot.sequence.store(head + 1, std::memory_order_release);
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+static void CopyEvents(const ThreadBuffer& buffer, std::vector<Event>& events) {
+	std::uint64_t head = buffer.head.load(std::memory_order_acquire);
+	std::uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+
+	for (std::uint64_t i = first; i < head; i++) {
+		const Slot& slot = buffer.slots[i % RING_SIZE];
+		std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+		Event event{ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed), slot.duration.load(std::memory_order_relaxed) };
+		std::atomic_thread_fence(std::memory_order_acquire);
+		// being overwritten, or overwritten by a newer event, while we copied it
+		if (sequence != i + 1 || slot.sequence.load(std::memory_order_relaxed) != sequence)
+			continue;
+		events.push_back(event);
+	}
+}
+
+static void WriteEscaped(std::ofstream& stream, const char* text) {
+	for (const char* c = text; *c != 0; c++) {
+		if (*c == '"' || *c == '\\')
+			stream << '\\';
+		stream << *c;
+	}
+}
+
+bool WriteChromeTrace(const std::string& fileName) {
+	std::ofstream stream(fileName);
+	if (!stream)
+		return false;
+
+	stream << "{\"traceEvents\":[";
+	bool firstEvent = true;
+
+	std::vector<Event> events;
+	std::uint32_t count = std::min<std::uint32_t>(threadCount.load(), MAX_THREADS);
+	for (std::uint32_t i = 0; i < count; i++) {
+		const ThreadBuffer* buffer = threadBuffers[i].load(std::memory_order_acquire);
+		if (buffer == nullptr)  // still registering
+			continue;
+
+		events.clear();
+		CopyEvents(*buffer, events);
+		for (const Event& event : events) {
+			stream << (firstEvent ? "\n" : ",\n") << "{\"name\":\"";
+			WriteEscaped(stream, event.name);
+			stream << "\",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration
+				<< ",\"pid\":1,\"tid\":" << buffer->threadId << "}";
+			firstEvent = false;
+		}
+	}
+
+	stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return static_cast<bool>(stream);
+}
+
+} // namespace trace
+} // namespace gpgui
@@ -0,0 +1,298 @@
+#include "GPTuner.h"
+#include "GPFrame.h"
+#include "GPMemory.h"
+#include "GPMusic.h"
+#include "GPSimd.h"
+#include "GPSpscQueue.h"
+#include "GPSynth.h"
+#include "GPWav.h"
+
+#ifdef GP_HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace gpgui {
+namespace tuner {
+
+typedef std::chrono::steady_clock Clock;
+
+static constexpr int WINDOW_HOPS = 4;
+// Yin threshold on the normalized difference, the first dip below it is the period
+static constexpr float THRESHOLD = 0.15f;
+// -60 dB, quieter windows are silences
+static constexpr float SILENCE_POWER = 1e-6f;
+static constexpr int CAPTURE_RATE = 48000;
+static constexpr int STRING_COUNT = 6;
+
+// Sources
+
+class WavSource : public Source {
+public:
+	bool Open(const std::string& fileName) {
+		return fileName == "-" ? m_Reader.Open(stdin) : m_Reader.Open(fileName);
+	}
+
+	int GetSampleRate() const { return m_Reader.GetSampleRate(); }
+	bool IsBlocking() const { return false; }
+	std::size_t Read(float* samples, std::size_t frames) { return m_Reader.Read(samples, frames); }
+
+private:
+	wav::Reader m_Reader;
+};
+
+#ifdef GP_HAVE_ALSA
+
+class CaptureSource : public Source {
+public:
+	~CaptureSource() {
+		if (m_Pcm != nullptr)
+			snd_pcm_close(m_Pcm);
+	}
+
+	bool Open() {
+		if (snd_pcm_open(&m_Pcm, "default", SND_PCM_STREAM_CAPTURE, 0) < 0) {
+			m_Pcm = nullptr;
+			return false;
+		}
+		// two hops of latency, resampled by the plug layer if needed
+		unsigned latency = 2 * HOP_MS * 1000;
+		return snd_pcm_set_params(m_Pcm, SND_PCM_FORMAT_FLOAT, SND_PCM_ACCESS_RW_INTERLEAVED, 1, CAPTURE_RATE, 1, latency) >= 0;
+	}
+
+	int GetSampleRate() const { return CAPTURE_RATE; }
+	bool IsBlocking() const { return true; }
+
+	std::size_t Read(float* samples, std::size_t frames) {
+		std::size_t total = 0;
+		while (total < frames) {
+			snd_pcm_sframes_t read = snd_pcm_readi(m_Pcm, samples + total, frames - total);
+			if (read < 0) {
+				// overrun, the missing samples are simply skipped
+				if (snd_pcm_recover(m_Pcm, static_cast<int>(read), 1) < 0)
+					break;
+				continue;
+			}
+			total += read;
+		}
+		return total;
+	}
+
+private:
+	snd_pcm_t* m_Pcm = nullptr;
+};
+
+#endif
+
+std::unique_ptr<Source> CreateWavSource(const std::string& fileName) {
+	auto source = std::make_unique<WavSource>();
+	if (!source->Open(fileName))
+		return nullptr;
+	return source;
+}
+
+std::unique_ptr<Source> CreateCaptureSource() {
+#ifdef GP_HAVE_ALSA
+	auto source = std::make_unique<CaptureSource>();
+	if (!source->Open())
+		return nullptr;
+	return source;
+#else
+	return nullptr;
+#endif
+}
+
+// Detector
+
+Reading GetStringReading(float frequency, float clarity) {
+	Reading reading;
+	reading.valid = true;
+	reading.frequency = frequency;
+	reading.clarity = clarity;
+	reading.key = static_cast<int>(std::lround(12.0f * std::log2(frequency / synth::GetFrequency(0))));
+	for (int string = 0; string < STRING_COUNT; string++) {
+		float cents = 1200.0f * std::log2(frequency / synth::GetFrequency(music::GetStringOffset(string)));
+		if (string == 0 || std::abs(cents) < std::abs(reading.cents)) {
+			reading.string = string;
+			reading.cents = cents;
+		}
+	}
+	return reading;
+}
+
+Detector::Detector(int sampleRate)
+	: m_SampleRate(sampleRate), m_HopFrames(sampleRate * HOP_MS / 1000), m_WindowFrames(WINDOW_HOPS * m_HopFrames) {
+	m_MinLag = std::max(2, static_cast<int>(sampleRate / MAX_FREQUENCY));
+	int maxLag = static_cast<int>(std::ceil(sampleRate / MIN_FREQUENCY)) + 2;
+	m_MaxLag = (maxLag + simd::WIDTH - 1) / simd::WIDTH * simd::WIDTH;
+	m_History.assign(m_WindowFrames + m_MaxLag, 0.0f);
+	m_HopDifferences.assign(WINDOW_HOPS * m_MaxLag, 0.0f);
+	m_Difference.assign(m_MaxLag, 0.0f);
+}
+
+Reading Detector::Process(const float* hop) {
+	std::copy(m_History.begin() + m_HopFrames, m_History.end(), m_History.begin());
+	std::copy(hop, hop + m_HopFrames, m_History.end() - m_HopFrames);
+
+	// difference function of the newest hop of the window, it replaces the oldest one.
+	// d(lag) = sum (x[j] - x[j + lag])^2, eight lags at once
+	float* newest = m_HopDifferences.data() + m_OldestHop * m_MaxLag;
+	m_OldestHop = (m_OldestHop + 1) % WINDOW_HOPS;
+	const float* samples = m_History.data() + m_WindowFrames - m_HopFrames;
+	for (int lag = 0; lag < m_MaxLag; lag += simd::WIDTH) {
+		simd::Float sum = simd::Set1(0.0f);
+		for (int j = 0; j < m_HopFrames; j++) {
+			simd::Float difference = simd::Sub(simd::Set1(samples[j]), simd::LoadUnaligned(samples + j + lag));
+			sum = simd::MulAdd(difference, difference, sum);
+		}
+		simd::StoreUnaligned(newest + lag, sum);
+	}
+
+	// the window is the sum of its hops, no error accumulates from hop to hop
+	for (int lag = 0; lag < m_MaxLag; lag += simd::WIDTH) {
+		simd::Float sum = simd::LoadUnaligned(m_HopDifferences.data() + lag);
+		for (int i = 1; i < WINDOW_HOPS; i++) {
+			sum = simd::Add(sum, simd::LoadUnaligned(m_HopDifferences.data() + i * m_MaxLag + lag));
+		}
+		simd::StoreUnaligned(m_Difference.data() + lag, sum);
+	}
+
+	float energy = 0;
+	for (int j = 0; j < m_WindowFrames; j++) {
+		energy += m_History[j] * m_History[j];
+	}
+	if (energy < SILENCE_POWER * m_WindowFrames)
+		return Reading();
+
+	// cumulative mean normalized difference, in place
+	float cumulated = 0;
+	m_Difference[0] = 1;
+	for (int lag = 1; lag < m_MaxLag; lag++) {
+		cumulated += m_Difference[lag];
+		m_Difference[lag] = cumulated > 0 ? m_Difference[lag] * lag / cumulated : 1;
+	}
+
+	int period = 0;
+	for (int lag = m_MinLag; lag < m_MaxLag - 1; lag++) {
+		if (m_Difference[lag] < THRESHOLD) {
+			while (lag + 1 < m_MaxLag - 1 && m_Difference[lag + 1] < m_Difference[lag]) {
+				lag++;
+			}
+			period = lag;
+			break;
+		}
+	}
+	if (period == 0)
+		return Reading();
+
+	// parabolic interpolation between the lags
+	float previous = m_Difference[period - 1];
+	float current = m_Difference[period];
+	float next = m_Difference[period + 1];
+	float curvature = previous - 2 * current + next;
+	float offset = curvature > 0 ? 0.5f * (previous - next) / curvature : 0.0f;
+	return GetStringReading(m_SampleRate / (period + offset), std::clamp(1.0f - current, 0.0f, 1.0f));
+}
+
+// Tuner thread, every variable below is either atomic or owned by a single thread
+
+static std::thread tunerThread;
+static std::atomic<bool> running{ false };
+static std::unique_ptr<Source> source;
+static SpscQueue<Reading, 256> readings;
+
+static std::atomic<std::uint64_t> hops{ 0 };
+static std::atomic<std::uint64_t> overruns{ 0 };
+static std::atomic<std::uint64_t> maxProcessNs{ 0 };
+static double budgetUs = 0;
+
+static void TunerThread(Detector* detector, float* hop) {
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(static_cast<double>(detector->GetHopFrames()) / source->GetSampleRate()));
+	const bool blocking = source->IsBlocking();
+	const std::size_t allocationsAtStart = memory::GetThreadAllocations();
+
+	Clock::time_point due = Clock::now();
+	while (running.load(std::memory_order_acquire)) {
+		if (source->Read(hop, detector->GetHopFrames()) < static_cast<std::size_t>(detector->GetHopFrames()))
+			break;  // end of the stream
+
+		Clock::time_point start = Clock::now();
+		Reading reading = detector->Process(hop);
+		Clock::time_point processed = Clock::now();
+		readings.TryPush(reading);  // dropped when the gui is not reading them
+		frame::RequestRedraw();
+
+		std::uint64_t processNs = std::chrono::duration_cast<std::chrono::nanoseconds>(processed - start).count();
+		if (processNs > maxProcessNs.load(std::memory_order_relaxed))
+			maxProcessNs.store(processNs, std::memory_order_relaxed);
+		due += period;
+		if (processed > due) {
+			overruns.fetch_add(1, std::memory_order_relaxed);
+			due = processed;
+		} else if (!blocking) {
+			// a file is played at the pace of a capture device
+			std::this_thread::sleep_until(due);
+		}
+		hops.fetch_add(1, std::memory_order_relaxed);
+		assert(memory::GetThreadAllocations() == allocationsAtStart && "The tuner thread allocated");
+	}
+	running.store(false, std::memory_order_release);
+}
+
+bool Start(std::unique_ptr<Source> newSource) {
+	Stop();
+	if (newSource == nullptr || newSource->GetSampleRate() <= 0)
+		return false;
+
+	source = std::move(newSource);
+	Reading reading;
+	while (readings.TryPop(reading)) {}
+	hops = 0;
+	overruns = 0;
+	maxProcessNs = 0;
+	budgetUs = 1000.0 * HOP_MS;
+
+	running = true;
+	tunerThread = std::thread([]() {
+		// allocated before the loop, the thread doesn't allocate afterwards
+		Detector detector(source->GetSampleRate());
+		std::vector<float> hop(detector.GetHopFrames());
+		TunerThread(&detector, hop.data());
+	});
+	return true;
+}
+
+void Stop() {
+	running = false;
+	if (tunerThread.joinable())
+		tunerThread.join();
+	source.reset();
+}
+
+bool IsRunning() {
+	return running.load(std::memory_order_acquire);
+}
+
+bool PopReading(Reading& reading) {
+	return readings.TryPop(reading);
+}
+
+Stats GetStats() {
+	Stats stats;
+	stats.hops = hops.load(std::memory_order_relaxed);
+	stats.overruns = overruns.load(std::memory_order_relaxed);
+	stats.maxProcessUs = maxProcessNs.load(std::memory_order_relaxed) / 1000.0;
+	stats.budgetUs = budgetUs;
+	return stats;
+}
+
+} // namespace tuner
+} // namespace gpgui
@@ -0,0 +1,215 @@
+#include "GPWav.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace gpgui {
+namespace wav {
+
+static constexpr std::size_t HEADER_SIZE = 44;
+
+static void WriteLittleEndian(std::uint8_t* data, std::uint32_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		data[i] = static_cast<std::uint8_t>(value >> (8 * i));
+	}
+}
+
+static void FillHeader(std::uint8_t* header, int sampleRate, int channels, std::uint32_t dataSize) {
+	const int bytesPerFrame = channels * 2;
+	std::copy_n("RIFF", 4, header);
+	WriteLittleEndian(header + 4, static_cast<std::uint32_t>(HEADER_SIZE - 8) + dataSize, 4);
+	std::copy_n("WAVEfmt ", 8, header + 8);
+	WriteLittleEndian(header + 16, 16, 4);  // fmt chunk size
+	WriteLittleEndian(header + 20, 1, 2);  // PCM
+	WriteLittleEndian(header + 22, channels, 2);
+	WriteLittleEndian(header + 24, sampleRate, 4);
+	WriteLittleEndian(header + 28, sampleRate * bytesPerFrame, 4);
+	WriteLittleEndian(header + 32, bytesPerFrame, 2);
+	WriteLittleEndian(header + 34, 16, 2);  // bits per sample
+	std::copy_n("data", 4, header + 36);
+	WriteLittleEndian(header + 40, dataSize, 4);
+}
+
+Writer::~Writer() {
+	Close();
+}
+
+bool Writer::Open(const std::string& fileName, int sampleRate, int channels) {
+	Close();
+	m_File = fopen(fileName.c_str(), "wb");
+	if (m_File == nullptr)
+		return false;
+	m_SampleRate = sampleRate;
+	m_Channels = channels;
+	m_DataSize = 0;
+
+	// the sizes are patched by Close
+	std::uint8_t header[HEADER_SIZE];
+	FillHeader(header, sampleRate, channels, 0);
+	return fwrite(header, 1, HEADER_SIZE, m_File) == HEADER_SIZE;
+}
+
+bool Writer::Write(const float* samples, std::size_t frames) {
+	if (m_File == nullptr)
+		return false;
+	std::size_t count = frames * m_Channels;
+	while (count > 0) {
+		std::size_t chunk = std::min(count, m_Buffer.size() / 2);
+		for (std::size_t i = 0; i < chunk; i++) {
+			float sample = std::clamp(samples[i], -1.0f, 1.0f);
+			WriteLittleEndian(&m_Buffer[i * 2], static_cast<std::uint16_t>(static_cast<std::int16_t>(std::lround(sample * 32767.0f))), 2);
+		}
+		if (fwrite(m_Buffer.data(), 2, chunk, m_File) != chunk)
+			return false;
+		m_DataSize += static_cast<std::uint32_t>(chunk * 2);
+		samples += chunk;
+		count -= chunk;
+	}
+	return true;
+}
+
+bool Writer::Close() {
+	if (m_File == nullptr)
+		return false;
+
+	std::uint8_t header[HEADER_SIZE];
+	FillHeader(header, m_SampleRate, m_Channels, m_DataSize);
+	bool ok = fseek(m_File, 0, SEEK_SET) == 0 && fwrite(header, 1, HEADER_SIZE, m_File) == HEADER_SIZE;
+	ok = fclose(m_File) == 0 && ok;
+	m_File = nullptr;
+	return ok;
+}
+
+static std::uint32_t ReadLittleEndian(const std::uint8_t* data, int bytes) {
+	std::uint32_t value = 0;
+	for (int i = 0; i < bytes; i++) {
+		value |= static_cast<std::uint32_t>(data[i]) << (8 * i);
+	}
+	return value;
+}
+
+static constexpr std::uint16_t FORMAT_PCM = 1;
+static constexpr std::uint16_t FORMAT_FLOAT = 3;
+static constexpr std::uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+
+Reader::~Reader() {
+	Close();
+}
+
+bool Reader::Open(const std::string& fileName) {
+	Close();
+	m_File = fopen(fileName.c_str(), "rb");
+	if (m_File == nullptr)
+		return false;
+	m_OwnsFile = true;
+	if (!ReadHeader()) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool Reader::Open(FILE* file) {
+	Close();
+	m_File = file;
+	m_OwnsFile = false;
+	if (file == nullptr || !ReadHeader()) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void Reader::Close() {
+	if (m_File != nullptr && m_OwnsFile)
+		fclose(m_File);
+	m_File = nullptr;
+	m_Remaining = 0;
+}
+
+// Reads the chunks until the data one, without seeking (works on pipes)
+bool Reader::ReadHeader() {
+	std::uint8_t header[12];
+	if (fread(header, 1, 12, m_File) != 12 || std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0)
+		return false;
+
+	bool hasFormat = false;
+	std::uint8_t chunk[8];
+	while (fread(chunk, 1, 8, m_File) == 8) {
+		std::uint32_t size = ReadLittleEndian(chunk + 4, 4);
+		if (std::memcmp(chunk, "data", 4) == 0) {
+			// streamed files may not know their size
+			m_Remaining = size == 0 || size == 0xFFFFFFFF ? UINT64_MAX : size;
+			return hasFormat;
+		}
+
+		std::uint32_t skipped = size + (size & 1);  // chunks are padded to an even size
+		if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16 && size <= m_Buffer.size()) {
+			if (fread(m_Buffer.data(), 1, skipped, m_File) != skipped)
+				return false;
+			std::uint16_t format = static_cast<std::uint16_t>(ReadLittleEndian(m_Buffer.data(), 2));
+			if (format == FORMAT_EXTENSIBLE && size >= 26)
+				format = static_cast<std::uint16_t>(ReadLittleEndian(m_Buffer.data() + 24, 2));  // sub format guid
+			m_Channels = static_cast<int>(ReadLittleEndian(m_Buffer.data() + 2, 2));
+			m_SampleRate = static_cast<int>(ReadLittleEndian(m_Buffer.data() + 4, 4));
+			int bits = static_cast<int>(ReadLittleEndian(m_Buffer.data() + 14, 2));
+			m_BytesPerSample = bits / 8;
+			m_Float = format == FORMAT_FLOAT;
+			hasFormat = m_Channels > 0 && m_SampleRate > 0
+				&& ((format == FORMAT_PCM && m_BytesPerSample >= 1 && m_BytesPerSample <= 4) || (m_Float && m_BytesPerSample == 4))
+				&& static_cast<std::size_t>(m_BytesPerSample) * m_Channels <= m_Buffer.size();  // Read decodes whole frames of the buffer
+			continue;
+		}
+		for (; skipped > 0; ) {
+			std::size_t part = std::min<std::size_t>(skipped, m_Buffer.size());
+			if (fread(m_Buffer.data(), 1, part, m_File) != part)
+				return false;
+			skipped -= static_cast<std::uint32_t>(part);
+		}
+	}
+	return false;
+}
+
+static float DecodeSample(const std::uint8_t* data, int bytes, bool isFloat) {
+	if (isFloat) {
+		float value;
+		std::memcpy(&value, data, sizeof(float));
+		return value;
+	}
+	if (bytes == 1)
+		return (data[0] - 128) / 128.0f;  // 8 bits samples are unsigned
+	// sign extension from the highest byte
+	std::int32_t value = static_cast<std::int32_t>(ReadLittleEndian(data, bytes) << (32 - 8 * bytes));
+	return value / 2147483648.0f;
+}
+
+std::size_t Reader::Read(float* samples, std::size_t frames) {
+	if (m_File == nullptr)
+		return 0;
+	const std::size_t frameSize = static_cast<std::size_t>(m_BytesPerSample) * m_Channels;
+	const std::size_t framesPerBuffer = m_Buffer.size() / frameSize;
+	std::size_t total = 0;
+	while (total < frames && m_Remaining >= frameSize) {
+		std::size_t wanted = std::min<std::uint64_t>({ frames - total, framesPerBuffer, m_Remaining / frameSize });
+		std::size_t read = fread(m_Buffer.data(), frameSize, wanted, m_File);
+		for (std::size_t frame = 0; frame < read; frame++) {
+			float sum = 0;
+			for (int channel = 0; channel < m_Channels; channel++) {
+				sum += DecodeSample(&m_Buffer[frame * frameSize + channel * m_BytesPerSample], m_BytesPerSample, m_Float);
+			}
+			samples[total + frame] = sum / m_Channels;
+		}
+		total += read;
+		if (m_Remaining != UINT64_MAX)
+			m_Remaining -= read * frameSize;
+		if (read < wanted) {
+			m_Remaining = 0;
+			break;
+		}
+	}
+	return total;
+}
+
+} // namespace wav
+} // namespace gpgui
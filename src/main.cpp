@@ -20,20 +20,472 @@
 #pragma comment(lib, "legacy_stdio_definitions")
 #endif
 
+#include "GPAudio.h"
+#include "GPBench.h"
+#include "GPChordPro.h"
+#include "GPFrame.h"
 #include "GPGui.h"
+#include "GPGuitarPro.h"
+#include "GPJobs.h"
+#include "GPMemory.h"
+#include "GPMidi.h"
+#include "GPMusicXml.h"
+#include "GPOffscreen.h"
+#include "GPParallel.h"
+#include "GPProfiler.h"
+#include "GPRecognition.h"
 #include "GPRenderer.h"
+#include "GPSongbook.h"
+#include "GPTrace.h"
+#include "GPTuner.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
 
 static void glfw_error_callback(int error, const char* description)
 {
 	fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
-int main(int, char**)
+// Set by any input since the last frame, frames without input should not allocate
+static bool receivedInput = false;
+
+static void OnInput()
+{
+	receivedInput = true;
+	gpgui::frame::RequestRedraw();
+}
+
+// Input callbacks only mark the window dirty, ImGui chains its own callbacks after them
+static void glfw_focus_callback(GLFWwindow*, int) { OnInput(); }
+static void glfw_cursor_pos_callback(GLFWwindow*, double, double) { OnInput(); }
+static void glfw_mouse_button_callback(GLFWwindow*, int, int, int) { OnInput(); }
+static void glfw_scroll_callback(GLFWwindow*, double, double) { OnInput(); }
+static void glfw_key_callback(GLFWwindow*, int, int, int, int) { OnInput(); }
+static void glfw_char_callback(GLFWwindow*, unsigned int) { OnInput(); }
+static void glfw_size_callback(GLFWwindow*, int, int) { OnInput(); }
+static void glfw_refresh_callback(GLFWwindow*) { OnInput(); }
+
+static void InstallRedrawCallbacks(GLFWwindow* window)
+{
+	glfwSetWindowFocusCallback(window, glfw_focus_callback);
+	glfwSetCursorEnterCallback(window, glfw_focus_callback);
+	glfwSetCursorPosCallback(window, glfw_cursor_pos_callback);
+	glfwSetMouseButtonCallback(window, glfw_mouse_button_callback);
+	glfwSetScrollCallback(window, glfw_scroll_callback);
+	glfwSetKeyCallback(window, glfw_key_callback);
+	glfwSetCharCallback(window, glfw_char_callback);
+	glfwSetFramebufferSizeCallback(window, glfw_size_callback);
+	glfwSetWindowRefreshCallback(window, glfw_refresh_callback);
+}
+
+struct CommandLine {
+	std::string traceFile;  // written when the application exits
+	std::string audioWavFile;  // the sound goes to this file instead of the device
+	std::string tunerWavFile;  // the tuner listens to this file instead of the microphone
+
+	// headless diagram export
+	bool exportDictionary = false;
+	std::string exportSong;
+	std::string exportDirectory;
+	gpgui::offscreen::ExportOptions exportOptions;
+
+	// vector songbook of every song of the library
+	std::string songbookFile;
+	std::string libraryDirectory = ".";
+
+	// offline audio rendering of a song or of the whole library
+	std::string renderSong;
+	std::string renderFile;
+	std::string renderDirectory;
+	float bpm = 90;
+	std::string strumPattern = gpgui::audio::DEFAULT_STRUM_PATTERN;
+
+	// chord recognition of a recording or of a directory of recordings
+	std::string recognizeInput;
+
+	// pitch of the strings of a recording, "-" reads it from stdin
+	std::string tuneFile;
+
+	// import of a midi file or of a directory of midi files
+	std::string midiInput;
+
+	// import of a ChordPro file or of a directory of ChordPro files, export of the library
+	std::string chordProInput;
+	std::string chordProDirectory;
+
+	// import of a MusicXML score or of a directory of scores
+	std::string musicXmlInput;
+
+	// import of a Guitar Pro tablature or of a directory of tablatures
+	std::string tablatureInput;
+
+	// midi export of a song or of the whole library
+	std::string midiSong;
+	std::string midiFile;
+	std::string midiDirectory;
+	gpgui::save::MidiOptions midiOptions;
+
+	bool runBenchmarks = false;
+	gpgui::bench::Options benchOptions;
+};
+
+static bool ParseCommandLine(int argc, char** argv, CommandLine& commandLine)
+{
+	for (int i = 1; i < argc; i++) {
+		auto hasValues = [&](int count) { return i + count < argc; };
+		if (std::strcmp(argv[i], "--trace") == 0 && hasValues(1)) {
+			commandLine.traceFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--audio-wav") == 0 && hasValues(1)) {
+			commandLine.audioWavFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--tuner-wav") == 0 && hasValues(1)) {
+			commandLine.tunerWavFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--export-dictionary") == 0 && hasValues(1)) {
+			commandLine.exportDictionary = true;
+			commandLine.exportDirectory = argv[++i];
+		} else if (std::strcmp(argv[i], "--export-song") == 0 && hasValues(2)) {
+			commandLine.exportSong = argv[++i];
+			commandLine.exportDirectory = argv[++i];
+		} else if (std::strcmp(argv[i], "--songbook") == 0 && hasValues(1)) {
+			commandLine.songbookFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--library") == 0 && hasValues(1)) {
+			commandLine.libraryDirectory = argv[++i];
+		} else if (std::strcmp(argv[i], "--render-wav") == 0 && hasValues(2)) {
+			commandLine.renderSong = argv[++i];
+			commandLine.renderFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--render-library") == 0 && hasValues(1)) {
+			commandLine.renderDirectory = argv[++i];
+		} else if (std::strcmp(argv[i], "--recognize") == 0 && hasValues(1)) {
+			commandLine.recognizeInput = argv[++i];
+		} else if (std::strcmp(argv[i], "--import-midi") == 0 && hasValues(1)) {
+			commandLine.midiInput = argv[++i];
+		} else if (std::strcmp(argv[i], "--import-chordpro") == 0 && hasValues(1)) {
+			commandLine.chordProInput = argv[++i];
+		} else if (std::strcmp(argv[i], "--export-chordpro") == 0 && hasValues(1)) {
+			commandLine.chordProDirectory = argv[++i];
+		} else if (std::strcmp(argv[i], "--import-tablature") == 0 && hasValues(1)) {
+			commandLine.tablatureInput = argv[++i];
+		} else if (std::strcmp(argv[i], "--import-musicxml") == 0 && hasValues(1)) {
+			commandLine.musicXmlInput = argv[++i];
+		} else if (std::strcmp(argv[i], "--export-midi") == 0 && hasValues(2)) {
+			commandLine.midiSong = argv[++i];
+			commandLine.midiFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--export-midi-library") == 0 && hasValues(1)) {
+			commandLine.midiDirectory = argv[++i];
+		} else if (std::strcmp(argv[i], "--midi-guitar") == 0) {
+			commandLine.midiOptions.voicing = gpgui::save::MidiVoicing::Guitar;
+		} else if (std::strcmp(argv[i], "--beats") == 0 && hasValues(1)) {
+			commandLine.midiOptions.beatsPerChord = std::atoi(argv[++i]);
+			if (commandLine.midiOptions.beatsPerChord < 1 || commandLine.midiOptions.beatsPerChord > gpgui::save::MAX_BEATS_PER_CHORD) {
+				fprintf(stderr, "A chord lasts from 1 to %d beats\n", gpgui::save::MAX_BEATS_PER_CHORD);
+				return false;
+			}
+		} else if (std::strcmp(argv[i], "--tune") == 0 && hasValues(1)) {
+			commandLine.tuneFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--bpm") == 0 && hasValues(1)) {
+			commandLine.bpm = static_cast<float>(std::atof(argv[++i]));
+			if (!(commandLine.bpm >= gpgui::audio::MIN_BPM && commandLine.bpm <= gpgui::audio::MAX_BPM)) {
+				fprintf(stderr, "The tempo must be between %.0f and %.0f bpm\n", gpgui::audio::MIN_BPM, gpgui::audio::MAX_BPM);
+				return false;
+			}
+		} else if (std::strcmp(argv[i], "--strum") == 0 && hasValues(1)) {
+			commandLine.strumPattern = argv[++i];
+		} else if (std::strcmp(argv[i], "--bench") == 0) {
+			commandLine.runBenchmarks = true;
+			// optional filter
+			if (hasValues(1) && std::strncmp(argv[i + 1], "--", 2) != 0)
+				commandLine.benchOptions.filter = argv[++i];
+		} else if (std::strcmp(argv[i], "--bench-json") == 0 && hasValues(1)) {
+			commandLine.benchOptions.jsonFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--bench-tablatures") == 0 && hasValues(1)) {
+			commandLine.benchOptions.tablatureDirectory = argv[++i];
+		} else if (std::strcmp(argv[i], "--size") == 0 && hasValues(1)) {
+			if (sscanf(argv[++i], "%dx%d", &commandLine.exportOptions.width, &commandLine.exportOptions.height) != 2)
+				return false;
+		} else if (std::strcmp(argv[i], "--threads") == 0 && hasValues(1)) {
+			commandLine.exportOptions.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+		} else {
+			fprintf(stderr, "Unknown argument : %s\n", argv[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static int RunDiagramExport(const CommandLine& commandLine)
+{
+	std::vector<gpgui::offscreen::DiagramJob> jobs;
+	if (commandLine.exportDictionary) {
+		jobs = gpgui::offscreen::GetDictionaryJobs(commandLine.exportDirectory);
+	} else {
+		gpgui::save::Song song = gpgui::save::LoadSongFromFile(commandLine.exportSong);
+		if (song.title.empty()) {
+			fprintf(stderr, "Unable to load %s\n", commandLine.exportSong.c_str());
+			return 1;
+		}
+		jobs = gpgui::offscreen::GetSongJobs(song, commandLine.exportDirectory);
+	}
+
+	std::filesystem::create_directories(commandLine.exportDirectory);
+	std::size_t written = gpgui::offscreen::ExportDiagrams(jobs, commandLine.exportOptions);
+	printf("%zu/%zu diagrams written to %s\n", written, jobs.size(), commandLine.exportDirectory.c_str());
+	return written == jobs.size() ? 0 : 1;
+}
+
+static int RunSongbookExport(const CommandLine& commandLine)
+{
+	std::vector<gpgui::save::Song> songs = gpgui::save::LoadSongsInDirectory(commandLine.libraryDirectory);
+
+	gpgui::songbook::Options options;
+	options.format = gpgui::songbook::GetFormat(commandLine.songbookFile);
+	options.threads = commandLine.exportOptions.threads;
+	if (!gpgui::songbook::ExportSongbook(songs, commandLine.songbookFile, options)) {
+		fprintf(stderr, "Unable to write %s\n", commandLine.songbookFile.c_str());
+		return 1;
+	}
+	printf("Songbook of %zu songs written to %s\n", songs.size(), commandLine.songbookFile.c_str());
+	return 0;
+}
+
+static int RunAudioRender(const CommandLine& commandLine)
+{
+	std::vector<gpgui::save::Song> songs;
+	std::vector<std::string> fileNames;
+	if (!commandLine.renderSong.empty()) {
+		songs.push_back(gpgui::save::LoadSongFromFile(commandLine.renderSong));
+		if (songs.back().title.empty()) {
+			fprintf(stderr, "Unable to load %s\n", commandLine.renderSong.c_str());
+			return 1;
+		}
+		fileNames.push_back(commandLine.renderFile);
+	} else {
+		songs = gpgui::save::LoadSongsInDirectory(commandLine.libraryDirectory);
+		std::filesystem::create_directories(commandLine.renderDirectory);
+		for (const gpgui::save::Song& song : songs) {
+			fileNames.push_back((std::filesystem::path(commandLine.renderDirectory) / (gpgui::save::GetFileName(song.title) + ".wav")).string());
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::atomic<std::size_t> failures{ 0 };
+	if (songs.size() == 1) {
+		// the bars of the song in parallel
+		if (!gpgui::audio::RenderSongToWav(songs[0], commandLine.bpm, commandLine.strumPattern, fileNames[0], commandLine.exportOptions.threads))
+			failures++;
+	} else {
+		// one song per thread
+		gpgui::parallel::ForEach(songs.size(), [&](std::size_t i) {
+			if (!gpgui::audio::RenderSongToWav(songs[i], commandLine.bpm, commandLine.strumPattern, fileNames[i], 1))
+				failures++;
+		}, commandLine.exportOptions.threads);
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double audioSeconds = 0;
+	for (const gpgui::save::Song& song : songs) {
+		audioSeconds += song.chords.size() * gpgui::audio::CHORD_BEATS * 60.0 / commandLine.bpm;
+	}
+	printf("%zu/%zu songs rendered, %.0f s of audio in %.2f s (%.0fx real time)\n", songs.size() - failures, songs.size(),
+		audioSeconds, elapsed, audioSeconds / std::max(elapsed, 1e-6));
+	return failures == 0 ? 0 : 1;
+}
+
+// The file itself, or the files of the directory with the extension
+static std::vector<std::string> GetInputFiles(const std::string& path, std::initializer_list<const char*> extensions)
+{
+	std::vector<std::string> files;
+	if (!std::filesystem::is_directory(path)) {
+		files.push_back(path);
+		return files;
+	}
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(path)) {
+		for (const char* extension : extensions) {
+			if (entry.path().extension() == extension)
+				files.push_back(entry.path().string());
+		}
+	}
+	return files;
+}
+
+static int RunRecognition(const CommandLine& commandLine)
 {
+	std::vector<std::string> wavFiles = GetInputFiles(commandLine.recognizeInput, { ".wav" });
+
+	gpgui::recognition::Options options;
+	options.bpm = commandLine.bpm;
+	std::filesystem::create_directories(commandLine.libraryDirectory);
+	std::size_t written = gpgui::recognition::RecognizeFiles(wavFiles, commandLine.libraryDirectory, options, commandLine.exportOptions.threads);
+	printf("%zu/%zu songs recognized to %s\n", written, wavFiles.size(), commandLine.libraryDirectory.c_str());
+	return written == wavFiles.size() ? 0 : 1;
+}
+
+static int RunMidiImport(const CommandLine& commandLine)
+{
+	std::vector<std::string> midiFiles = GetInputFiles(commandLine.midiInput, { ".mid", ".midi" });
+	std::filesystem::create_directories(commandLine.libraryDirectory);
+	auto start = std::chrono::steady_clock::now();
+	std::size_t written = gpgui::midi::ImportFiles(midiFiles, commandLine.libraryDirectory, gpgui::midi::Options(), commandLine.exportOptions.threads);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%zu/%zu midi files imported to %s in %.2f s\n", written, midiFiles.size(), commandLine.libraryDirectory.c_str(), elapsed);
+	return written == midiFiles.size() ? 0 : 1;
+}
+
+static int RunChordPro(const CommandLine& commandLine)
+{
+	auto start = std::chrono::steady_clock::now();
+	if (!commandLine.chordProInput.empty()) {
+		std::vector<std::string> files = GetInputFiles(commandLine.chordProInput, { ".cho", ".chopro", ".chordpro" });
+		std::filesystem::create_directories(commandLine.libraryDirectory);
+		std::size_t written = gpgui::chordpro::ImportFiles(files, commandLine.libraryDirectory, commandLine.exportOptions.threads);
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("%zu/%zu ChordPro files imported to %s in %.2f s\n", written, files.size(), commandLine.libraryDirectory.c_str(), elapsed);
+		return written == files.size() ? 0 : 1;
+	}
+
+	std::vector<gpgui::save::Song> songs = gpgui::save::LoadSongsInDirectory(commandLine.libraryDirectory);
+	std::filesystem::create_directories(commandLine.chordProDirectory);
+	std::size_t written = gpgui::chordpro::ExportFiles(songs, commandLine.chordProDirectory, commandLine.exportOptions.threads);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%zu/%zu songs exported to %s in %.2f s\n", written, songs.size(), commandLine.chordProDirectory.c_str(), elapsed);
+	return written == songs.size() ? 0 : 1;
+}
+
+static int RunMusicXmlImport(const CommandLine& commandLine)
+{
+	std::vector<std::string> scores = GetInputFiles(commandLine.musicXmlInput, { ".musicxml", ".xml" });
+	std::filesystem::create_directories(commandLine.libraryDirectory);
+	auto start = std::chrono::steady_clock::now();
+	std::size_t written = gpgui::musicxml::ImportFiles(scores, commandLine.libraryDirectory, commandLine.exportOptions.threads);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%zu/%zu scores imported to %s in %.2f s\n", written, scores.size(), commandLine.libraryDirectory.c_str(), elapsed);
+	return written == scores.size() ? 0 : 1;
+}
+
+static int RunTablatureImport(const CommandLine& commandLine)
+{
+	std::vector<std::string> tablatures = GetInputFiles(commandLine.tablatureInput, { ".gp3", ".gp4", ".gp5" });
+	std::filesystem::create_directories(commandLine.libraryDirectory);
+	auto start = std::chrono::steady_clock::now();
+	std::size_t written = gpgui::guitarpro::ImportFiles(tablatures, commandLine.libraryDirectory, commandLine.exportOptions.threads);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%zu/%zu tablatures imported to %s in %.2f s\n", written, tablatures.size(), commandLine.libraryDirectory.c_str(), elapsed);
+	return written == tablatures.size() ? 0 : 1;
+}
+
+static int RunMidiExport(const CommandLine& commandLine)
+{
+	gpgui::save::MidiOptions options = commandLine.midiOptions;
+	options.bpm = commandLine.bpm;
+	if (!commandLine.midiSong.empty()) {
+		gpgui::save::Song song = gpgui::save::LoadSongFromFile(commandLine.midiSong);
+		if (song.title.empty()) {
+			fprintf(stderr, "Unable to load %s\n", commandLine.midiSong.c_str());
+			return 1;
+		}
+		if (!gpgui::save::SaveSongToMidi(song, commandLine.midiFile, options)) {
+			fprintf(stderr, "Unable to write %s\n", commandLine.midiFile.c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	std::vector<gpgui::save::Song> songs = gpgui::save::LoadSongsInDirectory(commandLine.libraryDirectory);
+	std::filesystem::create_directories(commandLine.midiDirectory);
+	auto start = std::chrono::steady_clock::now();
+	std::size_t written = gpgui::save::SaveSongsToMidi(songs, commandLine.midiDirectory, options, commandLine.exportOptions.threads);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%zu/%zu songs exported to %s in %.2f s\n", written, songs.size(), commandLine.midiDirectory.c_str(), elapsed);
+	return written == songs.size() ? 0 : 1;
+}
+
+static int RunTuner(const CommandLine& commandLine)
+{
+	// one line every 100 ms
+	constexpr std::uint64_t PRINTED_HOPS = 100 / gpgui::tuner::HOP_MS;
+
+	std::unique_ptr<gpgui::tuner::Source> source = gpgui::tuner::CreateWavSource(commandLine.tuneFile);
+	if (source == nullptr) {
+		fprintf(stderr, "Unable to read %s\n", commandLine.tuneFile.c_str());
+		return 1;
+	}
+	gpgui::tuner::Detector detector(source->GetSampleRate());
+	std::vector<float> hop(detector.GetHopFrames());
+	for (std::uint64_t index = 0; source->Read(hop.data(), hop.size()) == hop.size(); index++) {
+		gpgui::tuner::Reading reading = detector.Process(hop.data());
+		if (!reading.valid || index % PRINTED_HOPS != 0)
+			continue;
+		double seconds = static_cast<double>((index + 1) * hop.size()) / source->GetSampleRate();
+		std::uint8_t stringKey = static_cast<std::uint8_t>(gpgui::music::GetStringOffset(reading.string));
+		printf("%8.3f s  %-2s %8.2f Hz  string %d (%s) %+6.1f cents\n", seconds,
+			gpgui::music::GetName(gpgui::music::GetNote(static_cast<std::uint8_t>(reading.key))).data(), reading.frequency,
+			6 - reading.string, gpgui::music::GetName(gpgui::music::GetNote(stringKey)).data(), reading.cents);
+	}
+	return 0;
+}
+
+static int RunBenchmarks(const CommandLine& commandLine)
+{
+	gpgui::bench::Options options = commandLine.benchOptions;
+	options.libraryDirectory = commandLine.libraryDirectory;
+	return gpgui::bench::Run(options) ? 0 : 1;
+}
+
+static int RunHeadless(const CommandLine& commandLine)
+{
+	int result = 0;
+	if (commandLine.runBenchmarks)
+		result = RunBenchmarks(commandLine);
+	else if (!commandLine.renderSong.empty() || !commandLine.renderDirectory.empty())
+		result = RunAudioRender(commandLine);
+	else if (!commandLine.recognizeInput.empty())
+		result = RunRecognition(commandLine);
+	else if (!commandLine.tuneFile.empty())
+		result = RunTuner(commandLine);
+	else if (!commandLine.midiInput.empty())
+		result = RunMidiImport(commandLine);
+	else if (!commandLine.midiSong.empty() || !commandLine.midiDirectory.empty())
+		result = RunMidiExport(commandLine);
+	else if (!commandLine.chordProInput.empty() || !commandLine.chordProDirectory.empty())
+		result = RunChordPro(commandLine);
+	else if (!commandLine.musicXmlInput.empty())
+		result = RunMusicXmlImport(commandLine);
+	else if (!commandLine.tablatureInput.empty())
+		result = RunTablatureImport(commandLine);
+	else if (!commandLine.songbookFile.empty())
+		result = RunSongbookExport(commandLine);
+	else
+		result = RunDiagramExport(commandLine);
+
+	if (!commandLine.traceFile.empty())
+		gpgui::trace::WriteChromeTrace(commandLine.traceFile);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	CommandLine commandLine;
+	if (!ParseCommandLine(argc, argv, commandLine))
+		return 1;
+
+	// Headless modes, no window is created
+	if (commandLine.exportDictionary || !commandLine.exportSong.empty() || !commandLine.songbookFile.empty() || commandLine.runBenchmarks
+		|| !commandLine.renderSong.empty() || !commandLine.renderDirectory.empty() || !commandLine.recognizeInput.empty()
+		|| !commandLine.tuneFile.empty() || !commandLine.midiInput.empty() || !commandLine.midiSong.empty() || !commandLine.midiDirectory.empty()
+		|| !commandLine.chordProInput.empty() || !commandLine.chordProDirectory.empty() || !commandLine.musicXmlInput.empty()
+		|| !commandLine.tablatureInput.empty())
+		return RunHeadless(commandLine);
+
 	// Setup window
 	glfwSetErrorCallback(glfw_error_callback);
-	if (!glfwInit())
-		return 1;
+	{
+		GP_TRACE_SCOPE("glfwInit");
+		if (!glfwInit())
+			return 1;
+	}
 
 	// Decide GL+GLSL versions
 #if defined(IMGUI_IMPL_OPENGL_ES2)
@@ -59,7 +511,11 @@ int main(int, char**)
 #endif
 
 	// Create window with graphics context
-	GLFWwindow* window = glfwCreateWindow(1920, 1080, "GuitaroPianoGui", NULL, NULL);
+	GLFWwindow* window;
+	{
+		GP_TRACE_SCOPE("glfwCreateWindow");
+		window = glfwCreateWindow(1920, 1080, "GuitaroPianoGui", NULL, NULL);
+	}
 	if (window == NULL)
 		return 1;
 	glfwMakeContextCurrent(window);
@@ -67,6 +523,7 @@ int main(int, char**)
 
 	// Setup Dear ImGui context
 	IMGUI_CHECKVERSION();
+	ImGui::SetAllocatorFunctions(gpgui::memory::ImGuiAlloc, gpgui::memory::ImGuiFree);
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
 	//io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
@@ -77,6 +534,7 @@ int main(int, char**)
 	//ImGui::StyleColorsClassic();
 
 	// Setup Platform/Renderer backends
+	InstallRedrawCallbacks(window);  // must be installed before ImGui so that it chains them
 	ImGui_ImplGlfw_InitForOpenGL(window, true);
 	ImGui_ImplOpenGL3_Init(glsl_version);
 
@@ -94,14 +552,31 @@ int main(int, char**)
 	//io.Fonts->AddFontFromFileTTF("../../misc/fonts/ProggyTiny.ttf", 10.0f);
 	//ImFont* font = io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\ArialUni.ttf", 18.0f, NULL, io.Fonts->GetGlyphRangesJapanese());
 	//IM_ASSERT(font != NULL);
+	{
+		// built now rather than lazily in the first frame, so it shows up in the trace
+		GP_TRACE_SCOPE("ImFontAtlas::Build");
+		io.Fonts->Build();
+	}
 
 	// Our state
 	bool show_demo_window = true;
 	bool show_another_window = false;
 	ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
-	gpgui::renderer::InitRendering();
-	gpgui::gui::Init();
+	{
+		GP_TRACE_SCOPE("InitRendering");
+		gpgui::renderer::InitRendering();
+	}
+	gpgui::profiler::Init();
+	gpgui::jobs::SetMainThreadWakeup(gpgui::frame::RequestRedraw);
+	{
+		GP_TRACE_SCOPE("gui::Init");
+		gpgui::gui::Init();
+	}
+	if (!commandLine.audioWavFile.empty() && !gpgui::audio::Start(gpgui::audio::CreateWavSink(commandLine.audioWavFile)))
+		fprintf(stderr, "Unable to write %s\n", commandLine.audioWavFile.c_str());
+	if (!commandLine.tunerWavFile.empty() && !gpgui::tuner::Start(gpgui::tuner::CreateWavSource(commandLine.tunerWavFile)))
+		fprintf(stderr, "Unable to read %s\n", commandLine.tunerWavFile.c_str());
 
 	// Main loop
 	while (!glfwWindowShouldClose(window)) {
@@ -110,7 +585,23 @@ int main(int, char**)
 		// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
 		// - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
 		// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-		glfwPollEvents();
+		// When nothing changed, we sleep until the next event instead of drawing the same frame at every vsync.
+		if (gpgui::frame::NeedsRedraw()) {
+			glfwPollEvents();
+		} else {
+			glfwWaitEventsTimeout(gpgui::frame::IDLE_TIMEOUT);
+			if (io.WantTextInput)
+				gpgui::frame::RequestRedraw();  // keep the text cursor blinking
+			if (!gpgui::frame::NeedsRedraw())
+				continue;
+		}
+
+		GP_TRACE_SCOPE("Frame");
+		gpgui::profiler::NewFrame();
+		gpgui::memory::NewFrame();
+		// completions of the jobs, they may change the songs
+		if (gpgui::jobs::DrainMainThread() > 0)
+			receivedInput = true;
 
 		// Start the Dear ImGui frame
 		ImGui_ImplOpenGL3_NewFrame();
@@ -124,15 +615,37 @@ int main(int, char**)
 		glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		gpgui::gui::Render();
-		gpgui::renderer::DrawWidgets();
+		{
+			GP_PROFILE_CPU(GuiRender);
+			gpgui::gui::Render();
+		}
+		{
+			GP_PROFILE_CPU(DrawWidgets);
+			GP_PROFILE_GPU(DrawWidgets);
+			gpgui::renderer::DrawWidgets();
+		}
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		{
+			GP_PROFILE_CPU(ImGuiRender);
+			GP_PROFILE_GPU(ImGuiRender);
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
 
 		glfwSwapBuffers(window);
+		gpgui::frame::FrameRendered();
+		gpgui::memory::EndFrame(!receivedInput);
+		receivedInput = false;
 	}
 
+	if (!commandLine.traceFile.empty() && !gpgui::trace::WriteChromeTrace(commandLine.traceFile))
+		fprintf(stderr, "Unable to write the trace to %s\n", commandLine.traceFile.c_str());
+
 	// Cleanup
+	// the jobs still running must not wake up a terminated glfw
+	gpgui::jobs::SetMainThreadWakeup(nullptr);
+	gpgui::gui::Shutdown();
+	gpgui::tuner::Stop();
+	gpgui::audio::Stop();
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -1,13 +1,63 @@
 add_rules("mode.debug", "mode.release")
 
-add_requires("opengl", "glfw >= 3", "glew >= 2")
+add_requires("opengl", "glfw >= 3", "glew >= 2", "zlib")
+
+option("headless")
+	set_default(false)
+	set_showmenu(true)
+	set_description("Offscreen diagram export through EGL (works without any display, e.g. Mesa llvmpipe)")
+option_end()
+
+option("alsa")
+	set_default(false)
+	set_showmenu(true)
+	set_description("Sound output and microphone capture (tuner) through ALSA (libasound)")
+option_end()
+
+option("native")
+	set_default(false)
+	set_showmenu(true)
+	set_description("Optimizes for the cpu of the build machine (AVX synthesizer kernels on recent x86)")
+option_end()
+
+option("alloc_tracking")
+	set_default(false)
+	set_showmenu(true)
+	set_description("Counts the heap allocations, bytes and peaks per frame and per module (Infos tab and benchmark json)")
+option_end()
 
 target("GuitarPiano")
     set_kind("binary")
     add_files("src/*.cpp")
 	add_includedirs("include")
 
-	add_packages("opengl", "glfw", "glew")
+	add_packages("opengl", "glfw", "glew", "zlib")
+
+	if has_config("headless") then
+		add_defines("GP_HAVE_EGL")
+		add_syslinks("EGL")
+	end
+
+	if has_config("alsa") then
+		add_defines("GP_HAVE_ALSA")
+		add_syslinks("asound")
+	end
+
+	if has_config("native") then
+		add_cxflags("-march=native")
+	end
+
+	if has_config("alloc_tracking") then
+		add_defines("GP_ALLOC_TRACKING")
+	end
+
+	if is_mode("debug") then
+		add_defines("GP_DEBUG")
+	end
+
+	if is_plat("linux") then
+		add_syslinks("pthread")
+	end
 
 	set_languages("c++17")
 